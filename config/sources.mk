@@ -2,9 +2,15 @@
 SRCS := main.c \
 		log.c \
         cmd.c \
+		sched.c \
+		tick.c \
+		mem.c \
 		sdram.c \
 		prof.c \
 		cam.c \
+		img.c \
+		jpeg.c \
+		lz.c \
 		\
         system_stm32f4xx.c \
         startup_stm32f429_439xx.s \
@@ -13,7 +19,9 @@ SRCS := main.c \
 		misc.c \
 		stm32f4xx_rcc.c \
 		stm32f4xx_gpio.c \
-		stm32f4xx_exti.c
+		stm32f4xx_exti.c \
+		stm32f4xx_tim.c \
+		stm32f4xx_dma2d.c
 
 ifeq ($(DEBUG),TRUE)
   ifneq ($(LOG),NONE)
@@ -24,36 +32,56 @@ ifeq ($(DEBUG),TRUE)
     endif	
   endif
 
-  ifeq ($(PROF),TRUE)
-    SRCS += stm32f4xx_tim.c
+  ifeq ($(TRACE),TRUE)
+    SRCS += trace.c
+  endif
+
+  ifeq ($(MON),TRUE)
+    SRCS += mon.c
   endif
 
   ifeq ($(TEST),TRUE)
     ifneq ($(LOG),NONE) 
-      SRCS += test_log.c
+      SRCS += test_log.c \
+              bench.c
     endif
 
     ifeq ($(PROF),TRUE)
       SRCS += test_prof.c
     endif
+
+    ifeq ($(MON),TRUE)
+      SRCS += test_mon.c
+    endif
+
+    SRCS += test_sched.c \
+            test_tick.c \
+            test_mem.c \
+            test_sdram.c \
+            test_img.c \
+            test_jpeg.c \
+            test_lz.c
   endif
 
 endif
 
+ifeq ($(KERNEL),TRUE)
+  SRCS += kern.c
+endif
+
 ifeq ($(BOARD),STM32F429I_DISCOVERY)
   SRCS += stm32f429i_discovery_sdram.c \
-		  stm32f4xx_fmc.c
+		  stm32f4xx_fmc.c \
+		  stm32f4xx_dma.c
 endif
 
 ifeq ($(CAMERA),OV5642)
   SRCS += ov5642.c \
-		  stm32f4xx_dma.c \
 		  stm32f4xx_dcmi.c \
 		  stm32f4xx_i2c.c
 else
   ifeq ($(CAMERA),OV7670)
 	SRCS += ov7670.c \
-			stm32f4xx_dma.c \
             stm32f4xx_dcmi.c \
             stm32f4xx_i2c.c
   endif 
@@ -66,6 +94,25 @@ ifneq ($(WIFI),NONE)
   endif
 endif
 
+# Host build, 'make host'
+# Startup code, the kernel, and drivers without a register
+# level model are swapped for the stand-ins in src/host
+HOST_EXCLUDE := startup_stm32f429_439xx.s \
+                system_stm32f4xx.c \
+                stm32f4xx_it.c \
+                kern.c \
+                stm32f4xx_usart.c \
+                stm32f4xx_i2c.c
+
+HOST_SRCS := $(filter-out $(HOST_EXCLUDE), $(SRCS)) \
+             host.c \
+             host_usart.c \
+             host_i2c.c \
+             host_sensor.c \
+             host_sim.c
+
+HOST_OBJS := $(HOST_SRCS:.c=.o)
+
 # Object files
 OBJS := $(SRCS:.c=.o)
 OBJS := $(OBJS:.s=.o)
@@ -77,7 +124,7 @@ ASMS := $(SRCS:.c=.s)
 PRES := $(SRCS:.c=.i)
 
 # Search path for source files
-VPATH = src:src/drivers:src/drivers/discovery:src/project:src/startup:src/test
+VPATH = src:src/drivers:src/drivers/discovery:src/project:src/startup:src/test:src/host
 
 # Include directory
 INC_DIR := inc \
@@ -90,9 +137,16 @@ INC_DIR := inc \
 # Config directory
 CONF_DIR := config
 
+# Host include directory, ahead of INC_DIR so its CMSIS
+# headers win
+HOST_INC_DIR := inc/host
+
 # Build directory
 BUILD_DIR := build
 
+# Host build directory
+HOST_BUILD_DIR := $(BUILD_DIR)/host
+
 # Binary directory
 BIN_DIR := bin
 
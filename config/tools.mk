@@ -1,2 +1,3 @@
 CC := arm-none-eabi-gcc
 OBJCOPY := arm-none-eabi-objcopy
+HOST_CC := gcc
@@ -12,7 +12,10 @@ import atexit
 import time
 import signal
 import struct
+import json
+import bisect
 import gc
+import io
 import fifo
 from PIL import Image
 import socket
@@ -32,6 +35,15 @@ log_modules = {
     8:  'CAM',
     9:  'ESP8266',
     10: 'WIFI',
+    11: 'SCHED',
+    12: 'KERN',
+    13: 'TICK',
+    14: 'TRACE',
+    15: 'MON',
+    16: 'MEM',
+    17: 'IMG',
+    18: 'JPEG',
+    19: 'LZ',
 }
 
 # reversed for easier sending
@@ -47,8 +59,103 @@ cmd_modules = {
     'CAM':     8,
     'ESP8266': 9,
     'WIFI':    10,
+    'SCHED':   11,
+    'KERN':    12,
+    'TICK':    13,
+    'TRACE':   14,
+    'MON':     15,
+    'MEM':     16,
+    'IMG':     17,
+    'JPEG':    18,
+    'LZ':      19,
 }
 
+# Core clock for converting profiler cycles
+prof_core_hz = 168000000
+
+# Profiler probe names, in prof_probe_t order
+# KEEP IN SYNC WITH C CODE
+prof_probes = [
+    'CAM_CAPTURE',
+    'CAM_TRANSFER',
+    'CMD_EXECUTE',
+    'SCCB_WRITE',
+    'LOG_SEND',
+    'USER0',
+    'USER1',
+]
+
+# Trace categories and interrupt names
+# KEEP IN SYNC WITH C CODE
+trace_cats = ['probe', 'irq', 'cmd', 'frame', 'mark']
+trace_irqs = {
+    37: 'USART1',
+    38: 'USART2',
+    50: 'TIM5',
+    54: 'TIM6',
+    55: 'TIM7',
+    56: 'DMA2_Stream0',
+    57: 'DMA2_Stream1',
+    78: 'DCMI',
+    90: 'DMA2D',
+}
+
+# Monitored interrupts and DMA streams
+# KEEP IN SYNC WITH C CODE
+mon_irqs = ['USART2', 'DCMI', 'DMA2_Stream1', 'TIM5', 'DMA2_Stream0', 'DMA2D']
+mon_dmas = ['DCMI', 'COPY', 'DMA2D']
+
+# Last telemetry report, for rates
+mon_last = None
+
+# Benchmark units, baseline file, and the slowdown
+# reported as a regression
+# KEEP IN SYNC WITH C CODE
+bench_units = ['B', 'op']
+bench_baseline_file = 'data/bench_baseline.json'
+bench_threshold = 0.05
+
+# Last benchmark results
+bench_last = None
+
+# Frame rebuilt from delta transfers, and its size
+# KEEP IN SYNC WITH C CODE
+delta_header = '<HHBBH'
+delta_frame = None
+delta_size = None
+
+# Thumbnail header, before the pixels
+# KEEP IN SYNC WITH C CODE
+thumb_header = '<HH'
+
+# Frame statistics, the histogram follows
+# KEEP IN SYNC WITH C CODE
+stats_header = '<HHBBIIII'
+stats_motion = 0x01
+
+# Change detector result, and what a watch sends
+# KEEP IN SYNC WITH C CODE
+motion_header = '<BHHHHH'
+watch_xfers = ['raw', 'luma', 'jpeg', 'delta', 'lz', 'thumb', 'stats', 'history']
+
+# History record, and the frame of the image that follows
+# KEEP IN SYNC WITH C CODE
+history_record = '<IQBBBBHHI'
+history_record_lz = 0x01
+history_modes = ['off', 'frame', 'thumb']
+history_seq = None
+
+# Compressed packet header, and the block being decoded
+# KEEP IN SYNC WITH C CODE
+lz_header = '<BBI'
+lz_minmatch = 4
+lz_pending = b''
+lz_out = bytearray()
+
+# Trace dump being received
+trace_header = None
+trace_data = b''
+
 # Error definitions
 # KEEP IN SYNC WITH C CODE
 INFO = 0
@@ -66,6 +173,7 @@ log_status = {
         ERR:    'LOG_ERR_DATASIZE',
         ERR+1:  'LOG_ERR_MSGSIZE',
         ERR+2:  'LOG_ERR_LOGOFF',
+        ERR+3:  'LOG_ERR_TIMEOUT',
         END-1:  'LOG_ERR_UNKNOWN' 
     },
     'CMD': {
@@ -83,6 +191,7 @@ log_status = {
         ERR+5:  'CMD_ERR_DATA',
         ERR+6:  'CMD_ERR_NOFUNC',
         ERR+7:  'CMD_ERR_NOMOD',
+        ERR+8:  'CMD_ERR_SCHED',
         END-1:  'CMD_ERR_UNKNOWN'
     },
     'STDLIB': {
@@ -96,6 +205,14 @@ log_status = {
         WARN-1: 'SDRAM_INFO_UNKNOWN',
         WARN:   'SDRAM_WARN_ALINIT', 
         ERR-1:  'SDRAM_WARN_UNKNOWN',
+        ERR:    'SDRAM_ERR_NULLPTR',
+        ERR+1:  'SDRAM_ERR_FREED',
+        ERR+2:  'SDRAM_ERR_ARENA',
+        ERR+3:  'SDRAM_ERR_SIZE',
+        ERR+4:  'SDRAM_ERR_RANGE',
+        ERR+5:  'SDRAM_ERR_BUSY',
+        ERR+6:  'SDRAM_ERR_DMA',
+        ERR+7:  'SDRAM_ERR_TIMEOUT',
         END-1:  'SDRAM_ERR_UNKNOWN'
     },
     'OV5642': {
@@ -108,6 +225,7 @@ log_status = {
         ERR+1:  'OV5642_ERR_I2CREAD',
         ERR+2:  'OV5642_ERR_I2CWRITE',
         ERR+3:  'OV5642_ERR_I2CTIMEOUT',
+        ERR+4:  'OV5642_ERR_DMA',
         END-1:  'OV5642_ERR_UNKNOWN'
     },
     'OV7670': {
@@ -120,14 +238,22 @@ log_status = {
         ERR+1:  'OV7670_ERR_I2CREAD',
         ERR+2:  'OV7670_ERR_I2CWRITE',
         ERR+3:  'OV7670_ERR_I2CTIMEOUT',
+        ERR+4:  'OV7670_ERR_DMA',
         END-1:  'OV7670_ERR_UNKNOWN'
     },
     'PROF': {
         INFO:   'PROF_INFO_OK',
         INFO+1: 'PROF_INFO_RESULTS',
+        INFO+2: 'PROF_INFO_EMPTY',
+        INFO+3: 'PROF_INFO_STATS',
+        INFO+4: 'PROF_INFO_PCSAMPLES',
         WARN-1: 'PROF_INFO_UNKNOWN',
         WARN:   'PROF_WARN_ALINIT',
+        WARN+1: 'PROF_WARN_DROPPED',
         ERR-1:  'PROF_WARN_UNKNOWN',
+        ERR:    'PROF_ERR_DEPTH',
+        ERR+1:  'PROF_ERR_UNDERFLOW',
+        ERR+2:  'PROF_ERR_PROBE',
         END-1:  'PROF_ERR_UNKNOWN'
         
     },
@@ -135,14 +261,25 @@ log_status = {
         INFO:   'TEST_INFO_OK',
         INFO+1: 'TEST_INFO_PASSED',
         INFO+2: 'TEST_INFO_CONFIRM',
+        INFO+3: 'TEST_INFO_BENCH',
+        INFO+4: 'TEST_INFO_FILLER',
         WARN-1: 'TEST_INFO_UNKNOWN',
         WARN:   'TEST_WARN_FAILED',
+        WARN+1: 'TEST_WARN_SKIPPED',
         ERR-1:  'TEST_WARN_UNKNOWN',
         END-1:  'TEST_ERR_UNKNOWN'
     },
     'CAM': {
         INFO:   'CAM_INFO_OK',
         INFO+1: 'CAM_INFO_IMAGE',
+        INFO+2: 'CAM_INFO_QUEUED',
+        INFO+3: 'CAM_INFO_LUMA',
+        INFO+4: 'CAM_INFO_JPEG',
+        INFO+5: 'CAM_INFO_DELTA',
+        INFO+6: 'CAM_INFO_THUMB',
+        INFO+7: 'CAM_INFO_STATS',
+        INFO+8: 'CAM_INFO_MOTION',
+        INFO+9: 'CAM_INFO_HISTORY',
         WARN-1: 'CAM_INFO_UNKNOWN',
         WARN:   'CAM_WARN_ALINIT',
         WARN+1:   'CAM_WARN_ALCONF',
@@ -151,12 +288,21 @@ log_status = {
         ERR+1:  'CAM_ERR_CONFIG',
         ERR+2:  'CAM_ERR_CAPTURE',
         ERR+3:  'CAM_ERR_TRANSFER',
+        ERR+4:  'CAM_ERR_TIMEOUT',
+        ERR+5:  'CAM_ERR_NOFRAME',
+        ERR+6:  'CAM_ERR_ENCODE',
+        ERR+7:  'CAM_ERR_QUALITY',
+        ERR+8:  'CAM_ERR_LEVEL',
+        ERR+9:  'CAM_ERR_REGION',
+        ERR+10: 'CAM_ERR_MODE',
+        ERR+11: 'CAM_ERR_BUSY',
         END-1:  'CAM_ERR_UNKNOWN',
     },
     'ESP8266': {
         INFO:   'ESP8266_INFO_OK',
         WARN-1: 'ESP8266_INFO_UNKNOWN',
         ERR-1:  'ESP8266_WARN_UNKNOWN',
+        ERR:    'ESP8266_ERR_TIMEOUT',
         END-1:  'ESP8266_ERR_UNKNOWN'
     },
     'WIFI': {
@@ -170,6 +316,109 @@ log_status = {
         ERR+3:  'WIFI_ERR_INIT',
         END-1:  'ESP8266_ERR_UNKNOWN'
     },
+    'SCHED': {
+        INFO:   'SCHED_INFO_OK',
+        INFO+1: 'SCHED_INFO_IDLE',
+        WARN-1: 'SCHED_INFO_UNKNOWN',
+        WARN:   'SCHED_WARN_ALINIT',
+        ERR-1:  'SCHED_WARN_UNKNOWN',
+        ERR:    'SCHED_ERR_QUEUEFULL',
+        ERR+1:  'SCHED_ERR_NULLPTR',
+        ERR+2:  'SCHED_ERR_PRIO',
+        END-1:  'SCHED_ERR_UNKNOWN'
+    },
+    'KERN': {
+        INFO:   'KERN_INFO_OK',
+        WARN-1: 'KERN_INFO_UNKNOWN',
+        WARN:   'KERN_WARN_ALINIT',
+        WARN+1: 'KERN_WARN_SEMFULL',
+        ERR-1:  'KERN_WARN_UNKNOWN',
+        ERR:    'KERN_ERR_INIT',
+        ERR+1:  'KERN_ERR_NULLPTR',
+        ERR+2:  'KERN_ERR_PRIO',
+        ERR+3:  'KERN_ERR_STACK',
+        ERR+4:  'KERN_ERR_TIMEOUT',
+        ERR+5:  'KERN_ERR_OWNER',
+        ERR+6:  'KERN_ERR_QUEUEFULL',
+        ERR+7:  'KERN_ERR_CONTEXT',
+        END-1:  'KERN_ERR_UNKNOWN'
+    },
+    'TICK': {
+        INFO:   'TICK_INFO_OK',
+        WARN-1: 'TICK_INFO_UNKNOWN',
+        WARN:   'TICK_WARN_ALINIT',
+        ERR-1:  'TICK_WARN_UNKNOWN',
+        END-1:  'TICK_ERR_UNKNOWN'
+    },
+    'TRACE': {
+        INFO:   'TRACE_INFO_OK',
+        INFO+1: 'TRACE_INFO_HEADER',
+        INFO+2: 'TRACE_INFO_DATA',
+        INFO+3: 'TRACE_INFO_END',
+        WARN-1: 'TRACE_INFO_UNKNOWN',
+        WARN:   'TRACE_WARN_ALINIT',
+        ERR-1:  'TRACE_WARN_UNKNOWN',
+        ERR:    'TRACE_ERR_INIT',
+        END-1:  'TRACE_ERR_UNKNOWN'
+    },
+    'MON': {
+        INFO:   'MON_INFO_OK',
+        INFO+1: 'MON_INFO_STATS',
+        INFO+2: 'MON_INFO_TELEMETRY',
+        WARN-1: 'MON_INFO_UNKNOWN',
+        WARN:   'MON_WARN_ALINIT',
+        ERR-1:  'MON_WARN_UNKNOWN',
+        ERR:    'MON_ERR_INIT',
+        ERR+1:  'MON_ERR_NULLPTR',
+        END-1:  'MON_ERR_UNKNOWN'
+    },
+    'MEM': {
+        INFO:   'MEM_INFO_OK',
+        INFO+1: 'MEM_INFO_REPORT',
+        WARN-1: 'MEM_INFO_UNKNOWN',
+        WARN:   'MEM_WARN_ALINIT',
+        WARN+1: 'MEM_WARN_STACK',
+        ERR-1:  'MEM_WARN_UNKNOWN',
+        ERR:    'MEM_ERR_NULLPTR',
+        END-1:  'MEM_ERR_UNKNOWN'
+    },
+    'IMG': {
+        INFO:   'IMG_INFO_OK',
+        WARN-1: 'IMG_INFO_UNKNOWN',
+        WARN:   'IMG_WARN_ALINIT',
+        ERR-1:  'IMG_WARN_UNKNOWN',
+        ERR:    'IMG_ERR_NULLPTR',
+        ERR+1:  'IMG_ERR_FORMAT',
+        ERR+2:  'IMG_ERR_SIZE',
+        ERR+3:  'IMG_ERR_ALIGN',
+        ERR+4:  'IMG_ERR_RANGE',
+        ERR+5:  'IMG_ERR_BUSY',
+        ERR+6:  'IMG_ERR_DMA',
+        ERR+7:  'IMG_ERR_TIMEOUT',
+        ERR+8:  'IMG_ERR_FULL',
+        END-1:  'IMG_ERR_UNKNOWN'
+    },
+    'JPEG': {
+        INFO:   'JPEG_INFO_OK',
+        WARN-1: 'JPEG_INFO_UNKNOWN',
+        ERR-1:  'JPEG_WARN_UNKNOWN',
+        ERR:    'JPEG_ERR_NULLPTR',
+        ERR+1:  'JPEG_ERR_SIZE',
+        ERR+2:  'JPEG_ERR_QUALITY',
+        ERR+3:  'JPEG_ERR_FULL',
+        END-1:  'JPEG_ERR_UNKNOWN'
+    },
+    'LZ': {
+        INFO:   'LZ_INFO_OK',
+        INFO+1: 'LZ_INFO_PACKET',
+        INFO+2: 'LZ_INFO_RATIO',
+        WARN-1: 'LZ_INFO_UNKNOWN',
+        WARN:   'LZ_WARN_RAW',
+        ERR-1:  'LZ_WARN_UNKNOWN',
+        ERR:    'LZ_ERR_NULLPTR',
+        ERR+1:  'LZ_ERR_FULL',
+        END-1:  'LZ_ERR_UNKNOWN'
+    },
 
 }
 
@@ -194,21 +443,71 @@ cmd_functions = {
     },
     'PROF': {
         'PROF_FUNC_INIT': 0,
+        'PROF_FUNC_FLUSH': 1,
+        'PROF_FUNC_DUMP':  2,
+        'PROF_FUNC_RESET': 3,
+        'PROF_FUNC_SAMPLE_START': 4,
+        'PROF_FUNC_SAMPLE_STOP':  5,
+        'PROF_FUNC_SAMPLE_DUMP':  6,
     },
     'TEST': {
         'TEST_FUNC_DUMMY': 0,
+        'TEST_FUNC_BENCH': 1,
     },
     'CAM': {
         'CAM_FUNC_INIT':     0,
         'CAM_FUNC_CONFIG':   1,
         'CAM_FUNC_CAPTURE':  2,
         'CAM_FUNC_TRANSFER': 3,
+        'CAM_FUNC_TRANSFER_LUMA': 4,
+        'CAM_FUNC_TRANSFER_JPEG': 5,
+        'CAM_FUNC_TRANSFER_DELTA': 6,
+        'CAM_FUNC_TRANSFER_LZ': 7,
+        'CAM_FUNC_TRANSFER_THUMB': 8,
+        'CAM_FUNC_TRANSFER_STATS': 9,
+        'CAM_FUNC_WATCH_START': 10,
+        'CAM_FUNC_WATCH_STOP': 11,
+        'CAM_FUNC_WATCH_REGION': 12,
+        'CAM_FUNC_HISTORY': 13,
+        'CAM_FUNC_DUMP_HISTORY': 14,
     },
     'ESP8266': {
         'ESP8266_FUNC_DUMMY': 0,
     },
     'WIFI': {
         'WIFI_FUNC_DUMMY': 0,
+    },
+    'SCHED': {
+        'SCHED_FUNC_DUMMY': 0,
+    },
+    'KERN': {
+        'KERN_FUNC_DUMMY': 0,
+    },
+    'TICK': {
+        'TICK_FUNC_NOW': 0,
+    },
+    'TRACE': {
+        'TRACE_FUNC_START': 0,
+        'TRACE_FUNC_STOP':  1,
+        'TRACE_FUNC_DUMP':  2,
+    },
+    'MON': {
+        'MON_FUNC_STATS':           0,
+        'MON_FUNC_RESET':           1,
+        'MON_FUNC_TELEMETRY_START': 2,
+        'MON_FUNC_TELEMETRY_STOP':  3,
+    },
+    'MEM': {
+        'MEM_FUNC_REPORT': 0,
+    },
+    'IMG': {
+        'IMG_FUNC_DUMMY': 0,
+    },
+    'JPEG': {
+        'JPEG_FUNC_DUMMY': 0,
+    },
+    'LZ': {
+        'LZ_FUNC_DUMMY': 0,
     }
 }
 
@@ -314,8 +613,15 @@ def init():
 
     print_info("Ready for commands. Type 'help' to view a list of commands.")
 
-def open_com():
+def open_com(port=None):
     global ser
+
+    # A named port is the host build, there's no board
+    if port != None:
+        ser = serial.Serial(port, BAUD_RATE, timeout=1.0)
+        print_info("Serial port " + ser.name + " opened at " + str(BAUD_RATE) + " Baud.")
+        return
+
     ports = glob.glob('/dev/tty[A-Za-z]*')
     com_list = []
     for port in ports:
@@ -502,6 +808,114 @@ def cmd_parse_input(cmd):
         cmd_send("CAM", "CAM_FUNC_CAPTURE", 0, 0)
     elif cmd == "cam transfer":
         cmd_send("CAM", "CAM_FUNC_TRANSFER", 0, 0)
+    elif cmd == "cam transfer luma":
+        cmd_send("CAM", "CAM_FUNC_TRANSFER_LUMA", 0, 0)
+    elif cmd == "cam transfer jpeg":
+        cmd_send("CAM", "CAM_FUNC_TRANSFER_JPEG", 0, 0)
+    elif cmd.startswith("cam transfer jpeg "):
+        # Quality sticks for later transfers
+        try:
+            q = int(cmd.split()[3])
+        except ValueError:
+            q = 0
+        if q < 1 or q > 100:
+            print_warning("JPEG quality must be 1 to 100.")
+        else:
+            cmd_send("CAM", "CAM_FUNC_TRANSFER_JPEG", 1, q)
+    elif cmd == "cam transfer delta":
+        cmd_send("CAM", "CAM_FUNC_TRANSFER_DELTA", 0, 0)
+    elif cmd == "cam transfer delta key":
+        cmd_send("CAM", "CAM_FUNC_TRANSFER_DELTA", 1, 1)
+    elif cmd == "cam transfer lz":
+        cmd_send("CAM", "CAM_FUNC_TRANSFER_LZ", 0, 0)
+    elif cmd == "cam transfer stats":
+        cmd_send("CAM", "CAM_FUNC_TRANSFER_STATS", 0, 0)
+    elif cmd == "cam transfer thumb":
+        cmd_send("CAM", "CAM_FUNC_TRANSFER_THUMB", 0, 0)
+    elif cmd.startswith("cam transfer thumb "):
+        # Level sticks for later transfers
+        try:
+            level = int(cmd.split()[3])
+        except ValueError:
+            level = 0
+        if level < 1 or level > 3:
+            print_warning("Thumbnail level must be 1 to 3.")
+        else:
+            cmd_send("CAM", "CAM_FUNC_TRANSFER_THUMB", 1, level)
+    elif cmd.startswith("cam watch start"):
+        # What to send for a frame that fired, then the
+        # threshold
+        args = cmd.split()[3:]
+        xfer = watch_xfers.index(args[0]) if len(args) > 0 and args[0] in watch_xfers else -1
+        try:
+            threshold = int(args[1]) if len(args) > 1 else 24
+        except ValueError:
+            threshold = -1
+        if len(args) > 0 and xfer < 0:
+            print_warning("Watch transfer must be one of " + ", ".join(watch_xfers) + ".")
+        elif threshold < 0 or threshold > 255:
+            print_warning("Watch threshold must be 0 to 255.")
+        elif len(args) == 0:
+            cmd_send("CAM", "CAM_FUNC_WATCH_START", 0, 0)
+        else:
+            cmd_send("CAM", "CAM_FUNC_WATCH_START", 2, xfer | threshold << 8)
+    elif cmd == "cam watch stop":
+        cmd_send("CAM", "CAM_FUNC_WATCH_STOP", 0, 0)
+    elif cmd.startswith("cam watch region "):
+        # Index, x, y, width, height, changed pixels
+        try:
+            i, x, y, w, h, count = [int(a) for a in cmd.split()[3:]]
+        except ValueError:
+            i = -1
+        if i < 0 or i > 3:
+            print_warning("Usage: cam watch region <0-3> <x> <y> <w> <h> <count>")
+        elif max(x, y, w, h) > 255 or count > 0xFFFF or min(x, y, w, h, count) < 0:
+            print_warning("Region is in pixels of the 1/8 size frame, up to 255.")
+        else:
+            cmd_send("CAM", "CAM_FUNC_WATCH_REGION", 7,
+                     i | x << 8 | y << 16 | w << 24 | h << 32 | count << 40)
+    elif cmd.startswith("cam history "):
+        mode = cmd.split()[2]
+        if mode not in history_modes:
+            print_warning("History mode must be one of " + ", ".join(history_modes) + ".")
+        else:
+            cmd_send("CAM", "CAM_FUNC_HISTORY", 1, history_modes.index(mode))
+    elif cmd == "cam dump history":
+        cmd_send("CAM", "CAM_FUNC_DUMP_HISTORY", 0, 0)
+    elif cmd == "prof flush":
+        cmd_send("PROF", "PROF_FUNC_FLUSH", 0, 0)
+    elif cmd == "prof dump":
+        cmd_send("PROF", "PROF_FUNC_DUMP", 0, 0)
+    elif cmd == "prof reset":
+        cmd_send("PROF", "PROF_FUNC_RESET", 0, 0)
+    elif cmd == "prof sample start":
+        cmd_send("PROF", "PROF_FUNC_SAMPLE_START", 0, 0)
+    elif cmd == "prof sample stop":
+        cmd_send("PROF", "PROF_FUNC_SAMPLE_STOP", 0, 0)
+    elif cmd == "prof sample dump":
+        cmd_send("PROF", "PROF_FUNC_SAMPLE_DUMP", 0, 0)
+    elif cmd == "test bench":
+        cmd_send("TEST", "TEST_FUNC_BENCH", 0, 0)
+    elif cmd == "test bench baseline":
+        bench_save_baseline()
+    elif cmd == "tick now":
+        cmd_send("TICK", "TICK_FUNC_NOW", 0, 0)
+    elif cmd == "trace start":
+        cmd_send("TRACE", "TRACE_FUNC_START", 0, 0)
+    elif cmd == "trace stop":
+        cmd_send("TRACE", "TRACE_FUNC_STOP", 0, 0)
+    elif cmd == "trace dump":
+        cmd_send("TRACE", "TRACE_FUNC_DUMP", 0, 0)
+    elif cmd == "mon stats":
+        cmd_send("MON", "MON_FUNC_STATS", 0, 0)
+    elif cmd == "mon reset":
+        cmd_send("MON", "MON_FUNC_RESET", 0, 0)
+    elif cmd == "mon telemetry start":
+        cmd_send("MON", "MON_FUNC_TELEMETRY_START", 0, 0)
+    elif cmd == "mon telemetry stop":
+        cmd_send("MON", "MON_FUNC_TELEMETRY_STOP", 0, 0)
+    elif cmd == "mem report":
+        cmd_send("MEM", "MEM_FUNC_REPORT", 0, 0)
     else:
         print_warning("Invalid command. Type 'help' to view a list of commands")
 
@@ -518,7 +932,36 @@ def cmd_help():
           "\tcam\tinit:\t\tinitialize the camera module\n" +
           "\tcam\tconfig:\t\tconfigure the camera module to take an image\n" +
           "\tcam\tcapture:\tcapture an image with the camera module\n" +
-          "\tcam\ttransfer:\ttransfer an image to the debug interface")
+          "\tcam\ttransfer:\ttransfer an image to the debug interface\n" +
+          "\t\ttransfer luma:\ttransfer only the luma, half the bytes\n" +
+          "\t\ttransfer jpeg [q]:\ttransfer as a JPEG, quality 1 to 100\n" +
+          "\t\ttransfer delta:\ttransfer the tiles changed since the last delta\n" +
+          "\t\ttransfer delta key:\ttransfer every tile as a keyframe\n" +
+          "\t\ttransfer lz:\ttransfer compressed, lossless\n" +
+          "\t\ttransfer thumb [l]:\ttransfer a thumbnail, 1/2, 1/4 or 1/8 size\n" +
+          "\t\ttransfer stats:\ttransfer brightness, focus and motion only\n" +
+          "\t\twatch start [x] [t]:\tsend frames that change, as transfer x\n" +
+          "\t\twatch stop:\tstop watching for change\n" +
+          "\t\twatch region i x y w h n:\tfire on n changed pixels in a 1/8 size box\n" +
+          "\t\thistory off|frame|thumb:\tkeep recent frames, whole or as thumbnails\n" +
+          "\t\tdump history:\ttransfer the recent frames, oldest first\n" +
+          "\tprof\tflush:\t\tsend buffered profiler samples\n" +
+          "\t\tdump:\t\tshow profiler probe statistics\n" +
+          "\t\treset:\t\tclear profiler probe statistics\n" +
+          "\t\tsample start:\tstart PC sampling\n" +
+          "\t\tsample stop:\tstop PC sampling\n" +
+          "\t\tsample dump:\tshow a flat profile of PC samples\n" +
+          "\ttest\tbench:\t\trun benchmarks and compare to the baseline\n" +
+          "\t\tbench baseline:\tuse the last benchmark run as the baseline\n" +
+          "\ttick\tnow:\t\tread the device uptime\n" +
+          "\ttrace\tstart:\t\tclear the trace buffer and start recording\n" +
+          "\t\tstop:\t\tstop trace recording\n" +
+          "\t\tdump:\t\tsave the trace as Chrome trace JSON\n" +
+          "\tmon\tstats:\t\tshow interrupt and DMA statistics\n" +
+          "\t\treset:\t\tclear interrupt and DMA statistics\n" +
+          "\t\ttelemetry start:\tsend statistics periodically\n" +
+          "\t\ttelemetry stop:\tstop periodic statistics\n" +
+          "\tmem\treport:\t\tshow heap and stack use")
 
 def cmd_stlink_restart():
     global p
@@ -603,8 +1046,18 @@ def serial_handle_image(l):
     
     print_info(string)
 
-    if data_size != 0:
-        filename = 'data/output_' + time.strftime("%Y%m%d_%H%M%S", time.gmtime()) + '.raw'
+    global history_seq
+    if data_size != 0 and history_seq is not None:
+        # Part of a history, saved but not shown
+        filename = 'data/history_%08d.raw' % history_seq
+        history_seq = None
+        with open(filename, "wb") as f:
+            f.write(bytes(l[l[2]+7:]))
+        print_info("\tSaved history frame to data folder.")
+    elif data_size != 0:
+        jpeg = log_status[log_modules[l[0]]][l[1]] == "CAM_INFO_JPEG"
+        filename = 'data/output_' + time.strftime("%Y%m%d_%H%M%S", time.gmtime()) + \
+                   ('.jpg' if jpeg else '.raw')
         with open(filename, "wb") as f:
             f.write(bytes(l[l[2]+7:]))
 
@@ -613,9 +1066,16 @@ def serial_handle_image(l):
 
         f.close()
 
-        g = b''
-        for i in range(1,len(l[l[2]+7:]),2):
-            g += bytes([l[l[2]+7+i]])
+        # JPEGs decode themselves, luma only frames are
+        # packed on the device
+        if jpeg:
+            print_info("\tDisplaying image.")
+            Image.open(io.BytesIO(bytes(l[l[2]+7:]))).show()
+            return
+        elif log_status[log_modules[l[0]]][l[1]] == "CAM_INFO_LUMA":
+            g = bytes(l[l[2]+7:])
+        else:
+            g = bytes(l[l[2]+8::2])
 
         print_info("\tDisplaying image.")
         im = Image.frombytes("L", (320,240), g)
@@ -624,6 +1084,590 @@ def serial_handle_image(l):
     else:
         print_error("\tImage sent without data packet!")
 
+def serial_handle_thumb(l):
+    string = log_modules[l[0]] + ":\t" + log_status[log_modules[l[0]]][l[1]]
+    print_info(string)
+
+    data = bytes(l[l[2]+7:])
+    hsize = struct.calcsize(thumb_header)
+    if len(data) < hsize:
+        print_error("CAM:\tThumbnail without a header!")
+        return
+    width, height = struct.unpack(thumb_header, data[0:hsize])
+    if len(data) - hsize != width*height*2:
+        print_error("CAM:\tThumbnail is %d bytes, expected %d." % (len(data) - hsize, width*height*2))
+        return
+
+    # Part of a history, saved but not shown
+    global history_seq
+    if history_seq is not None:
+        filename = 'data/history_%08d_%dx%d.raw' % (history_seq, width, height)
+        history_seq = None
+        with open(filename, "wb") as f:
+            f.write(data[hsize:])
+        print_info("\tSaved %dx%d history thumbnail to data folder." % (width, height))
+        return
+
+    filename = 'data/thumb_' + time.strftime("%Y%m%d_%H%M%S", time.gmtime()) + \
+               '_%dx%d.raw' % (width, height)
+    with open(filename, "wb") as f:
+        f.write(data[hsize:])
+    print_info("\tSaved %dx%d thumbnail to data folder." % (width, height))
+
+    print_info("\tDisplaying image.")
+    im = Image.frombytes("L", (width, height), data[hsize+1::2])
+    im.show()
+
+def serial_handle_stats(l):
+    data = bytes(l[l[2]+7:])
+    hsize = struct.calcsize(stats_header)
+    if len(data) < hsize:
+        print_error("CAM:\tStatistics without a header!")
+        return
+    width, height, flags, bins, mean, var, focus, motion = struct.unpack(stats_header, data[0:hsize])
+    if len(data) != hsize + 4*bins:
+        print_error("CAM:\tStatistics are %d bytes, expected %d." % (len(data), hsize + 4*bins))
+        return
+    hist = struct.unpack('<%dI' % bins, data[hsize:])
+
+    string = log_modules[l[0]] + ":\t" + log_status[log_modules[l[0]]][l[1]]
+    string += "\n\t%dx%d, mean %.1f, std dev %.1f, focus %.1f" % \
+              (width, height, mean/256.0, (var/256.0)**0.5, focus/256.0)
+    if flags & stats_motion:
+        string += ", motion %.1f" % (motion/256.0)
+
+    # One character a bin, scaled to the fullest
+    bars = " .:-=+*#%@"
+    top = max(max(hist), 1)
+    string += "\n\t|" + "".join(bars[(h*(len(bars)-1) + top - 1)//top] for h in hist) + "|"
+    print_info(string)
+
+def serial_handle_motion(l):
+    data = bytes(l[l[2]+7:])
+    if len(data) != struct.calcsize(motion_header):
+        print_error("CAM:\tMotion is %d bytes, expected %d." %
+                    (len(data), struct.calcsize(motion_header)))
+        return
+    region, count, x0, y0, x1, y1 = struct.unpack(motion_header, data)
+
+    string = log_modules[l[0]] + ":\t" + log_status[log_modules[l[0]]][l[1]]
+    string += "\n\tRegion %d, %d changed pixels from (%d, %d) to (%d, %d) at 1/8 size" % \
+              (region, count, x0, y0, x1, y1)
+    print_info(string)
+
+def serial_handle_history(l):
+    # The image follows in its own packet
+    global history_seq
+    data = bytes(l[l[2]+7:])
+    if len(data) != struct.calcsize(history_record):
+        print_error("CAM:\tHistory record is %d bytes, expected %d." %
+                    (len(data), struct.calcsize(history_record)))
+        return
+    seq, us, index, count, level, flags, width, height, size = struct.unpack(history_record, data)
+    history_seq = seq
+
+    string = log_modules[l[0]] + ":\t" + log_status[log_modules[l[0]]][l[1]]
+    string += "\n\t%d of %d, frame %d at %.3f s, %dx%d" % \
+              (index + 1, count, seq, us/1000000.0, width, height)
+    if level != 0:
+        string += " at 1/%d size" % (1 << level)
+    if flags & history_record_lz:
+        string += ", compressed"
+    print_info(string)
+
+def delta_apply(data):
+    # img_delta_t, then each tile after its coordinates
+    global delta_frame
+    global delta_size
+
+    hsize = struct.calcsize(delta_header)
+    if len(data) < hsize:
+        print_error("CAM:\tDelta without a header!")
+        return False
+    width, height, tile, key, count = struct.unpack(delta_header, data[0:hsize])
+
+    if key:
+        delta_frame = bytearray(width*height*2)
+        delta_size = (width, height)
+    elif delta_frame is None or delta_size != (width, height):
+        print_warning("CAM:\tDelta without a keyframe, try 'cam transfer delta key'.")
+        return False
+
+    line = tile*2
+    stride = width*2
+    pos = hsize
+    for i in range(count):
+        tx, ty = data[pos], data[pos+1]
+        pos += 2
+        off = ty*tile*stride + tx*line
+        for y in range(tile):
+            delta_frame[off:off+line] = data[pos:pos+line]
+            pos += line
+            off += stride
+
+    print_info("\t%s, %d of %d tiles, %d bytes." % ("Keyframe" if key else "Delta", count,
+               (width//tile)*(height//tile), len(data)))
+    return True
+
+def serial_handle_delta(l):
+    string = log_modules[l[0]] + ":\t" + log_status[log_modules[l[0]]][l[1]]
+    print_info(string)
+
+    if not delta_apply(bytes(l[l[2]+7:])):
+        return
+
+    filename = 'data/output_' + time.strftime("%Y%m%d_%H%M%S", time.gmtime()) + '.raw'
+    with open(filename, "wb") as f:
+        f.write(bytes(delta_frame))
+    print_info("\tSaved rebuilt image to data folder.")
+
+    print_info("\tDisplaying image.")
+    im = Image.frombytes("L", delta_size, bytes(delta_frame[1::2]))
+    im.show()
+
+def lz_length(data, pos, n):
+    # Length past the 15 in the token, or None if it isn't
+    # all here yet
+    while True:
+        if pos >= len(data):
+            return None, pos
+        n += data[pos]
+        pos += 1
+        if data[pos-1] != 255:
+            return n, pos
+
+def lz_feed(chunk):
+    # Decode every whole sequence, a partial one waits for
+    # the next chunk
+    global lz_pending
+
+    data = lz_pending + chunk
+    pos = 0
+    while pos < len(data):
+        start = pos
+        token = data[pos]
+        pos += 1
+        lit = token >> 4
+        if lit == 15:
+            lit, pos = lz_length(data, pos, lit)
+        if lit is None or pos + lit + 2 > len(data):
+            pos = start
+            break
+        lit_at = pos
+        pos += lit
+        dist = data[pos] | (data[pos+1] << 8)
+        pos += 2
+        mlen = token & 0x0F
+        if mlen == 15:
+            mlen, pos = lz_length(data, pos, mlen)
+            if mlen is None:
+                pos = start
+                break
+        mlen += lz_minmatch
+        if dist == 0 or dist > len(lz_out) + lit:
+            raise ValueError("match before the start of the block")
+        lz_out.extend(data[lit_at:lit_at+lit])
+        # Overlapping matches repeat what they copy
+        for i in range(mlen):
+            lz_out.append(lz_out[-dist])
+    lz_pending = data[pos:]
+
+def lz_finish():
+    # The last sequence is literals alone
+    global lz_pending
+    global lz_out
+
+    data = lz_pending
+    lz_pending = b''
+    if len(data) > 0:
+        lit = data[0] >> 4
+        pos = 1
+        if lit == 15:
+            lit, pos = lz_length(data, pos, lit)
+        if lit is None or pos + lit != len(data):
+            raise ValueError("block ends mid sequence")
+        lz_out.extend(data[pos:])
+
+    out = bytes(lz_out)
+    lz_out = bytearray()
+    return out
+
+def serial_handle_lz(l):
+    global lz_pending
+    global lz_out
+
+    data = bytes(l[l[2]+7:])
+    hsize = struct.calcsize(lz_header)
+    if len(data) < hsize:
+        print_error("LZ:\tCompressed packet without a header!")
+        return
+    module, status, size = struct.unpack(lz_header, data[0:hsize])
+
+    lz_pending = b''
+    lz_out = bytearray()
+    try:
+        for i in range(hsize, len(data), 4096):
+            lz_feed(data[i:i+4096])
+        payload = lz_finish()
+    except (ValueError, IndexError) as e:
+        print_error("LZ:\tBad compressed packet, " + str(e) + ".")
+        return
+    if len(payload) != size:
+        print_error("LZ:\tDecoded %d bytes, expected %d." % (len(payload), size))
+        return
+
+    print_info("LZ:\t%d bytes from %d, %.1f:1." % (size, len(data), size/max(len(data), 1)))
+
+    # Stand in for the packet it was
+    serial_print_log(bytes([module, status, 0]) + struct.pack('<I', size) + payload)
+
+def serial_handle_lz_ratio(l):
+    raw, packed = struct.unpack('<II', bytes(l[l[2]+7:l[2]+15]))
+    print_info("LZ:\tFrame %d bytes to %d, %.2f:1." % (raw, packed, raw/max(packed, 1)))
+
+def serial_handle_prof(l):
+    # prof_result_t, cycles then nesting depth
+    name = ""
+    for char in l[3:3+l[2]]:
+        name += chr(char)
+    data = l[l[2]+7:]
+    if len(data) < 5:
+        print_error("PROF:\tProfiler result without data packet!")
+        return
+
+    cycles, depth = struct.unpack("<IB", bytes(data[0:5]))
+    us = cycles * 1000000.0 / prof_core_hz
+    print_info("PROF:\t" + "  " * depth + name + "\t" + str(cycles) +
+               " cycles\t{:.3f} us".format(us))
+
+def prof_percentile(hist, count, fraction):
+    # Upper edge of the log2 bin holding the percentile
+    target = count * fraction
+    seen = 0
+    for b in range(len(hist)):
+        seen += hist[b]
+        if seen >= target:
+            return (1 << (b + 1)) - 1
+    return 0
+
+def serial_handle_prof_stats(l):
+    # prof_dumpHeader_t then one prof_stats_t per probe
+    data = bytes(l[l[2]+7:])
+    if len(data) < 10:
+        print_error("PROF:\tProfiler statistics without data packet!")
+        return
+
+    core_hz, overhead, probes, bins = struct.unpack("<IIBB", data[0:10])
+    stats_fmt = "<IIIQQ" + str(bins) + "I"
+    stats_size = struct.calcsize(stats_fmt)
+
+    def us(cycles):
+        return "{:.2f}".format(cycles * 1000000.0 / core_hz)
+
+    string = "PROF:\tProbe statistics, times in us, overhead " + str(overhead) + " cycles\n"
+    string += "\t{:<14}{:>9}{:>11}{:>11}{:>11}{:>11}{:>11}{:>11}\n".format(
+              "probe", "count", "min", "mean", "max", "std", "p50", "p99")
+    for p in range(probes):
+        offset = 10 + p * stats_size
+        fields = struct.unpack(stats_fmt, data[offset:offset+stats_size])
+        count, cmin, cmax, csum, csumsq = fields[0:5]
+        hist = fields[5:]
+        name = prof_probes[p] if p < len(prof_probes) else "PROBE" + str(p)
+
+        if count == 0:
+            string += "\t{:<14}{:>9}\n".format(name, 0)
+            continue
+
+        mean = csum / count
+        if csumsq == 0xFFFFFFFFFFFFFFFF:
+            std = "n/a"
+        else:
+            std = us(max(csumsq / count - mean * mean, 0) ** 0.5)
+        string += "\t{:<14}{:>9}{:>11}{:>11}{:>11}{:>11}{:>11}{:>11}\n".format(
+                  name, count, us(cmin), us(mean), us(cmax), std,
+                  us(prof_percentile(hist, count, 0.5)), us(prof_percentile(hist, count, 0.99)))
+
+    print_info(string.rstrip("\n"))
+
+def trace_event_name(cat, ident):
+    if cat == 'probe':
+        return prof_probes[ident] if ident < len(prof_probes) else "PROBE" + str(ident)
+    elif cat == 'irq':
+        return trace_irqs.get(ident, "IRQ" + str(ident))
+    elif cat == 'cmd':
+        module = log_modules.get(ident >> 8, str(ident >> 8))
+        for name, value in cmd_functions.get(module, {}).items():
+            if value == ident & 0xff:
+                return name
+        return module + " " + str(ident & 0xff)
+    elif cat == 'frame':
+        return "frame"
+    return "mark" + str(ident)
+
+def trace_export(core_hz, data, filename):
+    # trace_event_t is cycles, type, category, id
+    events = []
+    lanes = {}
+    last = None
+    high = 0
+    for i in range(0, len(data) - 7, 8):
+        cycles, etype, ecat, ident = struct.unpack("<IBBH", data[i:i+8])
+
+        # Unwrap the 32-bit cycle counter
+        if last is not None and cycles < last:
+            high += 1 << 32
+        last = cycles
+        ts = (high + cycles) * 1000000.0 / core_hz
+
+        cat = trace_cats[ecat] if ecat < len(trace_cats) else "cat" + str(ecat)
+        name = trace_event_name(cat, ident)
+
+        # One lane per interrupt and probe so slices nest
+        if cat == 'irq' or cat == 'probe':
+            lane = cat + " " + name
+        else:
+            lane = cat
+        if lane not in lanes:
+            lanes[lane] = len(lanes)
+            events.append({'name': 'thread_name', 'ph': 'M', 'pid': 0,
+                           'tid': lanes[lane], 'args': {'name': lane}})
+        tid = lanes[lane]
+
+        event = {'name': name, 'cat': cat, 'ts': ts, 'pid': 0, 'tid': tid}
+        if etype == 0:
+            event['ph'] = 'B'
+        elif etype == 1:
+            event['ph'] = 'E'
+        else:
+            event['ph'] = 'i'
+            event['s'] = 't'
+        events.append(event)
+
+    with open(filename, "w") as f:
+        json.dump({'traceEvents': events, 'displayTimeUnit': 'ns'}, f)
+
+    return len(events) - len(lanes)
+
+def serial_handle_trace(l, status):
+    global trace_header
+    global trace_data
+
+    data = bytes(l[l[2]+7:])
+    if status == "TRACE_INFO_HEADER":
+        trace_header = struct.unpack("<III", data[0:12])
+        trace_data = b''
+        print_info("TRACE:\tReceiving " + str(trace_header[1]) + " events, " +
+                   str(trace_header[2]) + " lost to wrap.")
+    elif status == "TRACE_INFO_DATA":
+        trace_data += data
+    elif trace_header is None:
+        print_error("TRACE:\tTrace ended without a header!")
+    else:
+        filename = 'data/trace_' + time.strftime("%Y%m%d_%H%M%S", time.gmtime()) + '.json'
+        n = trace_export(trace_header[0], trace_data, filename)
+        print_info("TRACE:\tSaved " + str(n) + " events to " + filename)
+        trace_header = None
+        trace_data = b''
+
+def serial_handle_mon(l, telemetry):
+    global mon_last
+
+    # mon_report_t header, then irq and dma statistics
+    data = bytes(l[l[2]+7:])
+    if len(data) < 14:
+        print_error("MON:\tMonitor report without data packet!")
+        return
+
+    core_hz, uptime, irqs, dmas = struct.unpack("<IQBB", data[0:14])
+    irq_fmt = "<IQIB"
+    dma_fmt = "<QIIII"
+    irq_size = struct.calcsize(irq_fmt)
+    dma_size = struct.calcsize(dma_fmt)
+
+    def us(cycles):
+        return "{:.2f}".format(cycles * 1000000.0 / core_hz)
+
+    string = "MON:\t" + ("Telemetry" if telemetry else "Statistics") + \
+             " at {:.3f} s, times in us\n".format(uptime / 1000000.0)
+    string += "\t{:<14}{:>10}{:>11}{:>11}{:>11}{:>9}\n".format(
+              "irq", "count", "mean", "max", "load", "nesting")
+    for i in range(irqs):
+        offset = 14 + i * irq_size
+        count, total, cmax, nesting = struct.unpack(irq_fmt, data[offset:offset+irq_size])
+        name = mon_irqs[i] if i < len(mon_irqs) else "IRQ" + str(i)
+        mean = total / count if count else 0
+        load = 100.0 * total * 1000000.0 / core_hz / uptime if uptime else 0
+        string += "\t{:<14}{:>10}{:>11}{:>11}{:>10.3f}%{:>9}\n".format(
+                  name, count, us(mean), us(cmax), load, nesting)
+
+    # Rates need the previous telemetry report
+    previous = mon_last if telemetry else None
+    string += "\t{:<14}{:>14}{:>10}{:>12}{:>9}{:>9}{:>9}\n".format(
+              "dma", "bytes", "transfers", "KiB/s", "err te", "err fe", "err dme")
+    dma_stats = []
+    for d in range(dmas):
+        offset = 14 + irqs * irq_size + d * dma_size
+        fields = struct.unpack(dma_fmt, data[offset:offset+dma_size])
+        dma_stats.append(fields)
+        name = mon_dmas[d] if d < len(mon_dmas) else "DMA" + str(d)
+        rate = "n/a"
+        if previous is not None and d < len(previous[1]) and uptime > previous[0]:
+            rate = "{:.1f}".format((fields[0] - previous[1][d][0]) / 1024.0 /
+                                   ((uptime - previous[0]) / 1000000.0))
+        string += "\t{:<14}{:>14}{:>10}{:>12}{:>9}{:>9}{:>9}\n".format(
+                  name, fields[0], fields[1], rate, fields[2], fields[3], fields[4])
+
+    if telemetry:
+        mon_last = (uptime, dma_stats)
+
+    print_info(string.rstrip("\n"))
+
+def serial_handle_mem(l):
+    # mem_report_t
+    data = bytes(l[l[2]+7:])
+    if len(data) < 36:
+        print_error("MEM:\tMemory report without data packet!")
+        return
+
+    current, peak, heap_reserved, arena, allocs, frees, failures, stack_used, \
+        stack_reserved = struct.unpack("<9I", data[0:36])
+
+    def percent(used, reserved):
+        return "{:.1f}%".format(100.0 * used / reserved) if reserved else "n/a"
+
+    string = "MEM:\tMemory use in bytes\n"
+    string += "\theap\tcurrent {}, peak {} ({} of {} reserved), arena {}\n".format(
+              current, peak, percent(peak, heap_reserved), heap_reserved, arena)
+    string += "\t\t{} allocations, {} frees, {} failures\n".format(allocs, frees, failures)
+    string += "\tstack\tpeak {} ({} of {} reserved), headroom {}".format(
+              stack_used, percent(stack_used, stack_reserved), stack_reserved,
+              stack_reserved - stack_used)
+
+    print_info(string)
+
+def bench_save_baseline():
+    if bench_last is None:
+        print_warning("No benchmark results yet. Run 'test bench' first.")
+        return
+    with open(bench_baseline_file, "w") as f:
+        json.dump(bench_last, f, indent=2)
+    print_info("TEST:\tSaved benchmark baseline to " + bench_baseline_file)
+
+def serial_handle_bench(l):
+    global bench_last
+
+    # bench_header_t then bench_result_t per benchmark
+    data = bytes(l[l[2]+7:])
+    if len(data) < 5:
+        print_error("TEST:\tBenchmark results without data packet!")
+        return
+
+    core_hz, count = struct.unpack("<IB", data[0:5])
+    result_fmt = "<16sBBIIIIQ"
+    result_size = struct.calcsize(result_fmt)
+
+    results = {}
+    for b in range(count):
+        offset = 5 + b * result_size
+        name, unit, skipped, work, reps, cmin, cmax, csum = \
+            struct.unpack(result_fmt, data[offset:offset+result_size])
+        name = name.split(b'\0')[0].decode()
+        results[name] = {'unit': bench_units[unit] if unit < len(bench_units) else str(unit),
+                         'skipped': skipped, 'work': work, 'reps': reps,
+                         'min': cmin, 'max': cmax, 'mean': csum / reps if reps else 0}
+    bench_last = {'core_hz': core_hz, 'results': results}
+
+    filename = 'data/bench_' + time.strftime("%Y%m%d_%H%M%S", time.gmtime()) + '.json'
+    with open(filename, "w") as f:
+        json.dump(bench_last, f, indent=2)
+
+    baseline = {}
+    if os.path.exists(bench_baseline_file):
+        with open(bench_baseline_file) as f:
+            baseline = json.load(f).get('results', {})
+
+    string = "TEST:\tBenchmarks, saved to " + filename + "\n"
+    string += "\t{:<16}{:>12}{:>12}{:>12}{:>14}{:>10}\n".format(
+              "benchmark", "min cyc", "mean cyc", "max cyc", "rate", "vs base")
+    regressions = 0
+    for name, r in results.items():
+        if r['skipped']:
+            string += "\t{:<16}{:>12}\n".format(name, "skipped")
+            continue
+
+        # Rate from the best run, per second
+        rate = r['work'] * core_hz / r['min'] if r['min'] else 0
+        if r['unit'] == 'B':
+            rate = "{:.1f} KiB/s".format(rate / 1024.0)
+        else:
+            rate = "{:.0f} op/s".format(rate)
+
+        delta = ""
+        base = baseline.get(name)
+        if base and not base['skipped'] and base['min']:
+            change = (r['min'] - base['min']) / base['min']
+            delta = "{:+.1f}%".format(100.0 * change)
+            if change > bench_threshold:
+                delta += " !"
+                regressions += 1
+
+        string += "\t{:<16}{:>12}{:>12.0f}{:>12}{:>14}{:>10}\n".format(
+                  name, r['min'], r['mean'], r['max'], rate, delta)
+
+    print_info(string.rstrip("\n"))
+    if regressions:
+        print_warning("TEST:\t" + str(regressions) + " benchmarks slower than the baseline by more than " +
+                      "{:.0f}%".format(100.0 * bench_threshold))
+
+def prof_load_symbols(elf):
+    # Function symbols sorted by address, from nm
+    out = subprocess.run(['arm-none-eabi-nm', '-n', '-S', '--defined-only', elf],
+                         stdout=subprocess.PIPE, stderr=subprocess.DEVNULL).stdout.decode()
+    symbols = []
+    for line in out.splitlines():
+        fields = line.split()
+        if len(fields) == 4 and fields[2] in ('T', 't', 'W', 'w'):
+            # Clear the thumb bit
+            symbols.append((int(fields[0], 16) & ~1, int(fields[1], 16), fields[3]))
+    return symbols
+
+def prof_symbolize(symbols, pc):
+    starts = [sym[0] for sym in symbols]
+    i = bisect.bisect_right(starts, pc) - 1
+    if i >= 0 and pc < symbols[i][0] + max(symbols[i][1], 1):
+        return symbols[i][2]
+    return "0x{:08x}".format(pc)
+
+def serial_handle_prof_pc(l, elf="bin/firmware_poc.elf", top=30):
+    # prof_pcHeader_t then prof_pcBucket_t array
+    data = bytes(l[l[2]+7:])
+    if len(data) < 14:
+        print_error("PROF:\tPC samples without data packet!")
+        return
+
+    hz, total, dropped, buckets = struct.unpack("<IIIH", data[0:14])
+    try:
+        symbols = prof_load_symbols(elf)
+    except OSError:
+        symbols = []
+        print_warning("PROF:\tCould not run arm-none-eabi-nm, showing raw addresses.")
+
+    functions = {}
+    for b in range(buckets):
+        pc, count = struct.unpack("<II", data[14+8*b:22+8*b])
+        if count != 0:
+            name = prof_symbolize(symbols, pc) if symbols else "0x{:08x}".format(pc)
+            functions[name] = functions.get(name, 0) + count
+
+    string = "PROF:\tFlat profile, " + str(total) + " samples at " + str(hz) + " Hz, " + \
+             str(dropped) + " dropped\n"
+    string += "\t{:>8}{:>9}  {}\n".format("samples", "percent", "function")
+    for name, count in sorted(functions.items(), key=lambda f: -f[1])[0:top]:
+        percent = 100.0 * count / total if total else 0
+        string += "\t{:>8}{:>8.2f}%  {}\n".format(count, percent, name)
+
+    print_info(string.rstrip("\n"))
+
 def serial_print_log(l):
     serial_reset()
     string = ""
@@ -633,9 +1677,58 @@ def serial_print_log(l):
             # Handle image differently
             if log_status[log_modules[l[0]]][l[1]] == "OV5642_INFO_IMAGE" or \
                log_status[log_modules[l[0]]][l[1]] == "OV7670_INFO_IMAGE" or \
-               log_status[log_modules[l[0]]][l[1]] == "CAM_INFO_IMAGE":
+               log_status[log_modules[l[0]]][l[1]] == "CAM_INFO_IMAGE" or \
+               log_status[log_modules[l[0]]][l[1]] == "CAM_INFO_LUMA" or \
+               log_status[log_modules[l[0]]][l[1]] == "CAM_INFO_JPEG":
                 serial_handle_image(l)
                 return
+            if log_status[log_modules[l[0]]][l[1]] == "CAM_INFO_DELTA":
+                serial_handle_delta(l)
+                return
+            if log_status[log_modules[l[0]]][l[1]] == "CAM_INFO_STATS":
+                serial_handle_stats(l)
+                return
+            if log_status[log_modules[l[0]]][l[1]] == "CAM_INFO_THUMB":
+                serial_handle_thumb(l)
+                return
+            if log_status[log_modules[l[0]]][l[1]] == "CAM_INFO_MOTION":
+                serial_handle_motion(l)
+                return
+            if log_status[log_modules[l[0]]][l[1]] == "CAM_INFO_HISTORY":
+                serial_handle_history(l)
+                return
+            if log_status[log_modules[l[0]]][l[1]] == "LZ_INFO_PACKET":
+                serial_handle_lz(l)
+                return
+            if log_status[log_modules[l[0]]][l[1]] == "LZ_INFO_RATIO":
+                serial_handle_lz_ratio(l)
+                return
+            if log_status[log_modules[l[0]]][l[1]] == "PROF_INFO_RESULTS":
+                serial_handle_prof(l)
+                return
+            if log_status[log_modules[l[0]]][l[1]] == "PROF_INFO_STATS":
+                serial_handle_prof_stats(l)
+                return
+            if log_status[log_modules[l[0]]][l[1]] == "PROF_INFO_PCSAMPLES":
+                serial_handle_prof_pc(l)
+                return
+            if log_status[log_modules[l[0]]][l[1]] == "TEST_INFO_BENCH":
+                serial_handle_bench(l)
+                return
+            if log_status[log_modules[l[0]]][l[1]] == "TEST_INFO_FILLER":
+                return
+            if log_status[log_modules[l[0]]][l[1]] == "MEM_INFO_REPORT":
+                serial_handle_mem(l)
+                return
+            if log_status[log_modules[l[0]]][l[1]] in ("MON_INFO_STATS",
+                                                      "MON_INFO_TELEMETRY"):
+                serial_handle_mon(l, log_status[log_modules[l[0]]][l[1]] == "MON_INFO_TELEMETRY")
+                return
+            if log_status[log_modules[l[0]]][l[1]] in ("TRACE_INFO_HEADER",
+                                                      "TRACE_INFO_DATA",
+                                                      "TRACE_INFO_END"):
+                serial_handle_trace(l, log_status[log_modules[l[0]]][l[1]])
+                return
             string += log_status[log_modules[l[0]]][l[1]]
         elif l[1] >= INFO and l[1] < WARN:
             string += log_status[log_modules[l[0]]][WARN-1]
@@ -651,7 +1744,7 @@ def serial_print_log(l):
                 substring += chr(char)
             string += substring
 
-        data_size = l[l[2]+3] + l[l[2]+4] << 8 + l[l[2]+5] << 16 + l[l[2]+6] << 24
+        data_size = l[l[2]+3] + (l[l[2]+4] << 8) + (l[l[2]+5] << 16) + (l[l[2]+6] << 24)
 
         if data_size != 0:
             string += "\n\tSent with data packet:\n\t\t"
@@ -735,7 +1828,8 @@ def serial_parse_log(d):
 
 def main():
     print_welcome()
-    open_com()
+    # Optional port, for example the one 'make host' prints
+    open_com(sys.argv[1] if len(sys.argv) > 1 else None)
     open_socket()
     if ser == None:
         return
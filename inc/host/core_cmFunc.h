@@ -0,0 +1,57 @@
+/** @file core_cmFunc.h
+ *  @brief Host stand-ins for the CMSIS core functions.
+ *
+ *  Shadows inc/startup/core_cmFunc.h in the host build.
+ *  PRIMASK is emulated with a lock shared with the
+ *  simulated interrupt handlers, see host.h. The main
+ *  stack pointer points into a static array so the memory
+ *  monitor has a stack to paint.
+ *
+ *  @author Ben Heberlein
+ *  @bug No known bugs.
+ */
+
+#ifndef __CORE_CMFUNC_H
+#define __CORE_CMFUNC_H
+
+/*************************************
+ * @name Includes and definitions
+ */
+
+#include "host.h"
+#include <stdint.h>
+
+#define __enable_irq() host_IrqEnable()
+#define __disable_irq() host_IrqDisable()
+#define __enable_fault_irq() host_IrqEnable()
+#define __disable_fault_irq() host_IrqDisable()
+
+static inline uint32_t __get_PRIMASK(void) {
+    return host_PrimaskGet();
+}
+
+static inline void __set_PRIMASK(uint32_t priMask) {
+    host_PrimaskSet(priMask);
+}
+
+static inline uint32_t __get_IPSR(void) {
+    return host_IpsrGet();
+}
+
+static inline uint32_t __get_MSP(void) {
+    return host_MspGet();
+}
+
+static inline uint32_t __get_CONTROL(void) {
+    return 0;
+}
+
+static inline uint32_t __get_BASEPRI(void) {
+    return 0;
+}
+
+static inline uint32_t __get_FPSCR(void) {
+    return 0;
+}
+
+# endif /* __CORE_CMFUNC_H */
@@ -0,0 +1,89 @@
+/** @file core_cmInstr.h
+ *  @brief Host stand-ins for the CMSIS core instructions.
+ *
+ *  Shadows inc/startup/core_cmInstr.h in the host build.
+ *  core_cm4.h includes it with angle brackets, so putting
+ *  inc/host first on the include path picks this one up.
+ *  Barriers do nothing, WFI sleeps until the next
+ *  simulated interrupt, and the bit instructions use
+ *  compiler builtins.
+ *
+ *  @author Ben Heberlein
+ *  @bug No known bugs.
+ */
+
+#ifndef __CORE_CMINSTR_H
+#define __CORE_CMINSTR_H
+
+/*************************************
+ * @name Includes and definitions
+ */
+
+#include "host.h"
+#include <stdint.h>
+
+#define __NOP() do {} while (0)
+#define __ISB() __sync_synchronize()
+#define __DSB() __sync_synchronize()
+#define __DMB() __sync_synchronize()
+#define __WFI() host_Wfi()
+#define __WFE() host_Wfi()
+#define __SEV() do {} while (0)
+#define __BKPT(value) __builtin_trap()
+
+static inline uint32_t __REV(uint32_t value) {
+    return __builtin_bswap32(value);
+}
+
+static inline uint32_t __REV16(uint32_t value) {
+    return ((value & 0xFF00FF00) >> 8) | ((value & 0x00FF00FF) << 8);
+}
+
+static inline int32_t __REVSH(int32_t value) {
+    return (int16_t) __builtin_bswap16((uint16_t) value);
+}
+
+static inline uint32_t __ROR(uint32_t op1, uint32_t op2) {
+    op2 &= 31;
+    return op2 == 0 ? op1 : (op1 >> op2) | (op1 << (32 - op2));
+}
+
+static inline uint32_t __RBIT(uint32_t value) {
+    uint32_t result = 0;
+    for (uint8_t i = 0; i < 32; i++) {
+        result = (result << 1) | (value & 1);
+        value >>= 1;
+    }
+    return result;
+}
+
+/* CLZ of zero is 32 on the core, undefined for the builtin */
+static inline uint8_t __CLZ(uint32_t value) {
+    return value == 0 ? 32 : __builtin_clz(value);
+}
+
+static inline int32_t __host_ssat(int32_t value, uint32_t bits) {
+    int32_t max = (1 << (bits - 1)) - 1;
+    int32_t min = -max - 1;
+    return value > max ? max : (value < min ? min : value);
+}
+
+static inline uint32_t __host_usat(int32_t value, uint32_t bits) {
+    int32_t max = (1 << bits) - 1;
+    return value > max ? max : (value < 0 ? 0 : value);
+}
+
+#define __SSAT(ARG1, ARG2) __host_ssat((ARG1), (ARG2))
+#define __USAT(ARG1, ARG2) __host_usat((ARG1), (ARG2))
+
+/* Exclusive access always succeeds, shared data is
+ * guarded with the PRIMASK stand-in instead */
+#define __LDREXB(ptr) (*(volatile uint8_t *) (ptr))
+#define __LDREXH(ptr) (*(volatile uint16_t *) (ptr))
+#define __LDREXW(ptr) (*(volatile uint32_t *) (ptr))
+#define __STREXB(value, ptr) (*(volatile uint8_t *) (ptr) = (value), 0)
+#define __STREXH(value, ptr) (*(volatile uint16_t *) (ptr) = (value), 0)
+#define __STREXW(value, ptr) (*(volatile uint32_t *) (ptr) = (value), 0)
+#define __CLREX() do {} while (0)
+
+# endif /* __CORE_CMINSTR_H */
@@ -0,0 +1,73 @@
+/** @file core_cmSimd.h
+ *  @brief Host stand-in for the CMSIS SIMD intrinsics.
+ *
+ *  Shadows inc/startup/core_cmSimd.h in the host build.
+ *  Each intrinsic the firmware uses is written out in C
+ *  with the same result as the instruction.
+ *
+ *  @author Ben Heberlein
+ *  @bug Only the intrinsics the firmware uses are here.
+ */
+
+#ifndef __CORE_CMSIMD_H
+#define __CORE_CMSIMD_H
+
+/*************************************
+ * @name Includes and definitions
+ */
+
+#include <stdint.h>
+
+/* Zero extend bytes 0 and 2 into the two halfwords */
+static inline uint32_t __UXTB16(uint32_t op1) {
+    return op1 & 0x00FF00FF;
+}
+
+/* Halfword at a time adds and subtracts, wrapping */
+static inline uint32_t __SADD16(uint32_t op1, uint32_t op2) {
+    return ((op1 + op2) & 0x0000FFFF) | (((op1 >> 16) + (op2 >> 16)) << 16);
+}
+
+static inline uint32_t __SSUB16(uint32_t op1, uint32_t op2) {
+    return ((op1 - op2) & 0x0000FFFF) | (((op1 >> 16) - (op2 >> 16)) << 16);
+}
+
+/* Byte at a time unsigned average, rounded down */
+static inline uint32_t __UHADD8(uint32_t op1, uint32_t op2) {
+    return (op1 & op2) + (((op1 ^ op2) >> 1) & 0x7F7F7F7F);
+}
+
+/* Sum of the byte at a time absolute differences,
+ * added to op3 */
+static inline uint32_t __USADA8(uint32_t op1, uint32_t op2, uint32_t op3) {
+    for (uint8_t i = 0; i < 32; i += 8) {
+        int32_t d = (int32_t) (op1 >> i & 0xFF) - (int32_t) (op2 >> i & 0xFF);
+        op3 += d < 0 ? -d : d;
+    }
+    return op3;
+}
+
+/* Both signed halfword products added to op3 */
+static inline uint32_t __SMLAD(uint32_t op1, uint32_t op2, uint32_t op3) {
+    return op3 + (int32_t) (int16_t) op1*(int16_t) op2 +
+           (int32_t) (int16_t) (op1 >> 16)*(int16_t) (op2 >> 16);
+}
+
+/* Each signed halfword clamped to 0 through 2^sat - 1 */
+static inline uint32_t host_usat(int16_t val, uint32_t sat) {
+    int32_t max = (1 << sat) - 1;
+    return val < 0 ? 0 : (val > max ? max : val);
+}
+
+#define __USAT16(ARG1,ARG2) \
+    (host_usat((int16_t) (ARG1), (ARG2)) | host_usat((int16_t) ((uint32_t) (ARG1) >> 16), (ARG2)) << 16)
+
+/* Bottom halfword of op1, top of op2 shifted left */
+#define __PKHBT(ARG1,ARG2,ARG3) \
+    ((((uint32_t) (ARG1)) & 0x0000FFFF) | ((((uint32_t) (ARG2)) << (ARG3)) & 0xFFFF0000))
+
+/* Top halfword of op1, bottom of op2 shifted right */
+#define __PKHTB(ARG1,ARG2,ARG3) \
+    ((((uint32_t) (ARG1)) & 0xFFFF0000) | ((((uint32_t) (ARG2)) >> (ARG3)) & 0x0000FFFF))
+
+# endif /* __CORE_CMSIMD_H */
@@ -0,0 +1,235 @@
+/** @file host.h
+ *  @brief Function prototypes for the host build.
+ *
+ *  This contains the prototypes, macros, and constants
+ *  for running the firmware as a Linux process with
+ *  'make host'. The peripheral registers, core registers,
+ *  and SDRAM are mapped at their real addresses, so the
+ *  firmware and most StdPeriph drivers run unchanged.
+ *
+ *  Simulated interrupt handlers run on host threads.
+ *  PRIMASK is a lock the handlers take, so masking
+ *  interrupts keeps them out the same way it does on the
+ *  board. Handlers never nest.
+ *
+ *  The stand-ins are
+ *
+ *  - USART: a pseudo terminal, the path is printed at
+ *    startup and linked to $HOST_UART if it is set.
+ *    host.py can open it directly.
+ *  - I2C: fake OV5642 and OV7670 sensors behind the SCCB
+ *    protocol the camera drivers speak. Frames come from
+ *    the .raw files in $HOST_FRAMES, or a test pattern.
+ *  - TIM5, TIM6, TIM7: update interrupts at the rate
+ *    programmed in PSC and ARR.
+ *  - Heap: malloc() from the firmware fails past
+ *    HOST_RAM_SIZE in use, like sbrk() running into the
+ *    stack.
+ *  - DCMI and DMA2 stream 1: the sensor frame written
+ *    through the stream into SDRAM at $HOST_FPS frames
+ *    per second, with the half, transfer complete,
+ *    transfer error, overrun, and frame interrupts.
+ *  - DMA2 stream 0: memory to memory copies, done at
+ *    once, with an error for core coupled RAM.
+ *  - DMA2D: lookup table loads and conversions between
+ *    ARGB8888, RGB888, RGB565, and L8, done at once, with
+ *    the same error for core coupled RAM.
+ *  - NVIC: the enable bits, set and cleared one bit at a
+ *    time like the write one registers on the part.
+ *
+ *  @author Ben Heberlein
+ *  @bug The main stack is a static array, so the memory
+ *  monitor only sees the stack use of mem_Init().
+ */
+
+#ifndef __HOST_H
+#define __HOST_H
+
+/*************************************
+ * @name Includes and definitions
+ */
+
+#include <stdint.h>
+
+/* @brief Simulated core and APB1 timer clocks
+ */
+#define HOST_CORE_HZ 168000000
+#define HOST_TIMCLK_HZ 84000000
+
+/* @brief Main stack size, set from the linker script
+ */
+#ifndef HOST_STACK_SIZE
+#define HOST_STACK_SIZE 0x2000
+#endif
+
+/* @brief Internal RAM, the heap can't grow past it
+ */
+#define HOST_RAM_SIZE 0x30000
+
+/* @brief Main stack in use when mem_Init() runs
+ */
+#define HOST_STACK_USED 256
+
+/* @brief Longest sleep in __WFI(), in microseconds
+ */
+#define HOST_WFI_US 1000
+
+/* @brief Simulator poll period, in microseconds
+ */
+#define HOST_SIM_US 50
+
+/* @brief Default frame rate
+ */
+#define HOST_FPS 30
+
+/* @brief Largest sensor frame, 2592 x 1944 at two bytes
+ * a pixel
+ */
+#define HOST_FRAME_MAX (2592*1944*2)
+
+/* @brief Interrupt handler type
+ */
+typedef void (*host_handler_t)(void);
+
+/**************************************
+ * @name Public functions
+ */
+
+/** @brief Mask simulated interrupts
+ *
+ *  Stands in for __disable_irq(). Does nothing if they
+ *  are already masked or we are in a handler.
+ */
+void host_IrqDisable();
+
+/** @brief Unmask simulated interrupts
+ *
+ *  Stands in for __enable_irq(). Does nothing in a
+ *  handler, the handler unmasks when it returns.
+ */
+void host_IrqEnable();
+
+/** @brief Get the emulated PRIMASK
+ *
+ *  @return 1 if interrupts are masked, otherwise 0
+ */
+uint32_t host_PrimaskGet();
+
+/** @brief Set the emulated PRIMASK
+ *
+ *  @param primask 1 to mask interrupts, 0 to unmask
+ */
+void host_PrimaskSet(uint32_t primask);
+
+/** @brief Get the emulated IPSR
+ *
+ *  @return nonzero in a simulated handler, otherwise 0
+ */
+uint32_t host_IpsrGet();
+
+/** @brief Get the emulated main stack pointer
+ *
+ *  @return an address in the static main stack
+ */
+uint32_t host_MspGet();
+
+/** @brief Wait for an interrupt
+ *
+ *  Stands in for __WFI(). Returns after the next
+ *  simulated handler, or after HOST_WFI_US. Masked
+ *  interrupts still wake it, like on the core.
+ */
+void host_Wfi();
+
+/** @brief Run a simulated interrupt handler
+ *
+ *  Waits until interrupts are unmasked, then runs the
+ *  handler with them masked. Called from the simulator
+ *  threads only.
+ *
+ *  @param handler the handler, NULL is ignored
+ */
+void host_Irq(host_handler_t handler);
+
+/** @brief Get the time since the process started
+ *
+ *  @return the time in nanoseconds
+ */
+uint64_t host_Nanos();
+
+/** @brief Get the emulated cycle counter
+ *
+ *  Stands in for DWT->CYCCNT, counting at HOST_CORE_HZ.
+ *
+ *  @return the cycle count
+ */
+uint32_t host_Cycles();
+
+/** @brief Get the TIM5 counter
+ *
+ *  Stands in for TIM5->CNT. Sets the update flag when the
+ *  counter wraps, like the timer does.
+ *
+ *  @return the counter value
+ */
+uint32_t host_TickCount();
+
+/** @brief Start the USART stand-in
+ *
+ *  Opens the pseudo terminal and starts its receive
+ *  thread.
+ */
+void host_UsartInit();
+
+/** @brief Check for a sensor on the SCCB bus
+ *
+ *  @param addr the bus address, the read bit is ignored
+ *  @return the register address width in bytes, 0 if
+ *  nothing answers
+ */
+uint8_t host_SensorRegBytes(uint8_t addr);
+
+/** @brief Read a sensor register
+ *
+ *  @param addr the bus address
+ *  @param reg the register
+ *  @return the register value, 0xFF if nothing answers
+ */
+uint8_t host_SensorRead(uint8_t addr, uint16_t reg);
+
+/** @brief Write a sensor register
+ *
+ *  Acts on the soft reset bits, and makes this sensor
+ *  the one that feeds the DCMI.
+ *
+ *  @param addr the bus address
+ *  @param reg the register
+ *  @param val the value
+ */
+void host_SensorWrite(uint8_t addr, uint16_t reg, uint8_t val);
+
+/** @brief Produce the next sensor frame
+ *
+ *  The size follows the output size and format
+ *  registers. A sleeping sensor sends nothing.
+ *
+ *  @param dst where to put the frame, NULL to drop it
+ *  @param max the most bytes to produce
+ *  @return the frame size in bytes, 0 if asleep
+ */
+uint32_t host_SensorFrame(uint8_t *dst, uint32_t max);
+
+/** @brief Start the timer and camera simulator
+ */
+void host_SimInit();
+
+/** @brief Collect NVIC enable and disable writes
+ *
+ *  ISER and ICER are plain memory here, so a second
+ *  write would hide the first. This folds them into the
+ *  enable bits and clears them. NVIC_Init() calls it
+ *  right away, the simulator thread on every poll.
+ */
+void host_NvicUpdate();
+
+# endif /* __HOST_H */
@@ -0,0 +1,20 @@
+/** @file host_conf.h
+ *  @brief Overrides for the host build.
+ *
+ *  'make host' includes this ahead of every source file.
+ *  It points the cycle counter and time base reads at the
+ *  host clock.
+ *
+ *  @author Ben Heberlein
+ *  @bug No known bugs.
+ */
+
+#ifndef __HOST_CONF_H
+#define __HOST_CONF_H
+
+#include "host.h"
+
+#define TICK_CYCLES() host_Cycles()
+#define TICK_COUNT() host_TickCount()
+
+# endif /* __HOST_CONF_H */
@@ -16,12 +16,239 @@
  */
 
 #include "err.h"
+#include "mod.h"
+#include "sdram.h"
+#include "img.h"
 #include <stdint.h>
 
+/* @brief Kernel task priorities and stack sizes in words.
+ * Capture runs above the command task so frame events
+ * are handled promptly, transfer runs below it so bulk
+ * transfers don't hold up commands.
+ */
+#define CAM_CAPTURE_PRIO 3
+#define CAM_TRANSFER_PRIO 1
+#define CAM_CAPTURE_STACKSIZE 512
+#define CAM_TRANSFER_STACKSIZE 512
+
+/* @brief Frame complete timeout in kernel ticks
+ */
+#define CAM_FRAME_TIMEOUT 2000
+
+/* @brief Pixels in a line, both sensors are set up for
+ * QVGA
+ */
+#define CAM_WIDTH 320
+#define CAM_HEIGHT 240
+
+/* @brief Delta transfers between keyframes, and the
+ * largest tile difference not sent, two levels a byte
+ * over a tile
+ */
+#define CAM_DELTA_KEYFRAME 30
+#define CAM_DELTA_THRESHOLD 1024
+
+/* @brief Pyramid level a thumbnail transfer starts at,
+ * 80 by 60
+ */
+#define CAM_THUMB_DEFAULT 2
+
+/* @brief Change detection defaults. It runs on the
+ * smallest pyramid level, 40 by 30. A pixel has changed
+ * when it is more than the threshold from the background,
+ * which moves 1/2^rate of the way to each frame. The
+ * first region covers the frame and fires on count
+ * changed pixels.
+ */
+#define CAM_WATCH_THRESHOLD 24
+#define CAM_WATCH_RATE 4
+#define CAM_WATCH_COUNT 12
+#define CAM_WATCH_REGIONS 4
+#define CAM_WATCH_CELLS ((CAM_WIDTH >> IMG_PYRAMID_LEVELS)*(CAM_HEIGHT >> IMG_PYRAMID_LEVELS))
+
+/* @brief History depth. Whole frames each hold a slot,
+ * thumbnails share one slot of CAM_HISTORY_SIZE bytes,
+ * compressed where that helps, as many as fit.
+ */
+#define CAM_HISTORY_FRAMES 3
+#define CAM_HISTORY_THUMBS 32
+#define CAM_HISTORY_SIZE SDRAM_MEDIUM_SIZE
+
+/* @brief History record flag, the image follows as an
+ * LZ_INFO_PACKET
+ */
+#define CAM_RECORD_LZ 0x01
+
+/* @brief What a transfer sends
+ */
+typedef enum cam_xfer_e {
+    CAM_XFER_RAW,
+    CAM_XFER_LUMA,
+    CAM_XFER_JPEG,
+    CAM_XFER_DELTA,
+    CAM_XFER_LZ,
+    CAM_XFER_THUMB,
+    CAM_XFER_STATS,
+    CAM_XFER_HISTORY,
+} cam_xfer_t;
+
+/* @brief What the history keeps of each frame
+ */
+typedef enum cam_history_e {
+    CAM_HISTORY_OFF,
+    CAM_HISTORY_FRAME,
+    CAM_HISTORY_THUMB,
+} cam_history_t;
+
+/* @brief History record, little endian. Sent before each
+ * image in a history transfer, the oldest at index 0.
+ * Sequence counts frames from boot and the time is in
+ * microseconds from tick_Init(), both from when the
+ * frame completed. Level is 0 for a whole frame, size is
+ * the bytes in the image as the host gets it.
+ */
+typedef struct __attribute__ ((packed)) cam_record_s {
+    uint32_t cam_record_seq;
+    uint64_t cam_record_time;
+    uint8_t cam_record_index;
+    uint8_t cam_record_count;
+    uint8_t cam_record_level;
+    uint8_t cam_record_flags;
+    uint16_t cam_record_width;
+    uint16_t cam_record_height;
+    uint32_t cam_record_size;
+} cam_record_t;
+
+/* @brief A frame in the history, its own slot or where
+ * it is in the thumbnail slot
+ */
+typedef struct cam_entry_s {
+    cam_record_t cam_entry_record;
+    sdram_frame_t *cam_entry_frame;
+    uint32_t cam_entry_offset;
+    uint32_t cam_entry_len;
+} cam_entry_t;
+
 /**************************************
  * @name Private functions
  */
 
+/** @brief Capture an image with the selected sensor
+ *
+ *  Starts a snapshot capture into a new SDRAM frame slot.
+ *  The frame replaces the newest one when it completes.
+ *
+ *  @return a status of type cam_status_t
+ */
+cam_status_t cam_capture();
+
+/** @brief Send the newest frame to the host
+ *
+ *  Holds a reference to the frame while it is sent, so
+ *  captures can go on at the same time. For a luma,
+ *  JPEG, delta, or statistics transfer the frame is
+ *  packed, encoded or measured into a frame slot of its
+ *  own first.
+ *
+ *  @param xfer what to send
+ *  @return a status of type cam_status_t
+ */
+cam_status_t cam_transfer(cam_xfer_t xfer);
+
+/** @brief Take a reference to the pyramid of a frame
+ *
+ *  Builds the pyramid into a frame slot of its own the
+ *  first time. It is kept while the frame is the newest,
+ *  so later thumbnails are only sent.
+ *
+ *  @param frame the frame, held by the caller
+ *  @param pyramid set to the pyramid, release it with
+ *  sdram_FrameRelease()
+ *  @return a status of type cam_status_t
+ */
+cam_status_t cam_pyramidAcquire(sdram_frame_t *frame, sdram_frame_t **pyramid);
+
+/** @brief Packet status for a transfer
+ *
+ *  @param xfer what is sent
+ *  @return the status that tells the host how to read
+ *  the data
+ */
+cam_status_t cam_xferStatus(cam_xfer_t xfer);
+
+/** @brief Watch task
+ *
+ *  Posted to the scheduler for each frame while watching.
+ *  Checks the frame for change, sends it if a region
+ *  fired, then starts the next capture. Under the kernel
+ *  it waits for a send in the transfer task to finish.
+ *
+ *  @param arg unused
+ */
+void cam_watchTask(void *arg);
+
+/** @brief Send a packet over WiFi or the logger
+ *
+ *  @param module the module it is from
+ *  @param status its status
+ *  @param len bytes of data
+ *  @param data the data
+ */
+void cam_send(mod_t module, gen_status_t status, uint32_t len, uint8_t *data);
+
+/** @brief Add the newest frame to a whole frame history
+ *
+ *  Called from the frame complete interrupt, the oldest
+ *  frame is dropped when the history is full.
+ *
+ *  @param frame the frame
+ */
+void cam_historyPush(sdram_frame_t *frame);
+
+/** @brief Drop the oldest frame from the history
+ */
+void cam_historyDrop();
+
+/** @brief History task
+ *
+ *  Posted to the scheduler for each frame while the
+ *  history keeps thumbnails. Compresses the thumbnail
+ *  into the history slot, over the oldest ones as
+ *  needed.
+ *
+ *  @param arg unused
+ */
+void cam_historyTask(void *arg);
+
+/** @brief Send the history to the host, oldest first
+ *
+ *  Each image goes after a CAM_INFO_HISTORY packet with
+ *  its cam_record_t.
+ *
+ *  @return a status of type cam_status_t
+ */
+cam_status_t cam_historySend();
+
+#ifdef __KERN
+/** @brief Capture task
+ *
+ *  Waits for capture requests, starts a capture, and
+ *  waits for the DCMI frame complete interrupt.
+ *
+ *  @param arg unused
+ */
+void cam_captureTask(void *arg);
+
+/** @brief Transfer task
+ *
+ *  Waits for transfer requests and sends the image to
+ *  the host.
+ *
+ *  @param arg unused
+ */
+void cam_transferTask(void *arg);
+#endif
+
 /**************************************
  * @name Public functions
  */
@@ -48,7 +275,9 @@ cam_status_t cam_Configure();
 /** @brief Capture an image
  *
  *  This function should capture and store an image in 
- *  the SDRAM.
+ *  the SDRAM. When the kernel is running the request is
+ *  handed to the capture task and CAM_INFO_QUEUED is
+ *  returned.
  *
  *  @return a status of type cam_status_t
  */
@@ -58,10 +287,133 @@ cam_status_t cam_Capture();
  *
  *  This function transfers an image from SDRAM to the 
  *  debug host interface. The logger must be enabled for
- *  this function to work.
+ *  this function to work. When the kernel is running the
+ *  request is handed to the transfer task and 
+ *  CAM_INFO_QUEUED is returned.
+ *
+ *  CAM_XFER_RAW sends the frame as captured in a
+ *  CAM_INFO_IMAGE packet. CAM_XFER_LUMA sends only the Y
+ *  byte of each YUV422 pixel, half the size, in a
+ *  CAM_INFO_LUMA packet. CAM_XFER_JPEG sends the whole 16
+ *  line strips of the frame as a JPEG in a CAM_INFO_JPEG
+ *  packet, at the quality from cam_JpegQuality().
+ *  CAM_XFER_DELTA sends the whole tiles of the frame that
+ *  changed since the last delta transfer in a
+ *  CAM_INFO_DELTA packet, every tile for a keyframe.
+ *  CAM_XFER_LZ sends the raw frame compressed with
+ *  lz_Send(). CAM_XFER_THUMB sends the level of the
+ *  frame pyramid from cam_ThumbLevel() in a
+ *  CAM_INFO_THUMB packet, its img_thumb_t header then
+ *  its pixels. CAM_XFER_STATS sends only an img_stats_t
+ *  in a CAM_INFO_STATS packet, with the motion since the
+ *  last statistics transfer. CAM_XFER_HISTORY sends the
+ *  history, see cam_historySend().
+ *
+ *  @param xfer what to send
+ *  @return a status of type cam_status_t
+ */
+cam_status_t cam_Transfer(cam_xfer_t xfer);
+
+/** @brief Set the JPEG transfer quality
+ *
+ *  Starts at JPEG_QUALITY_DEFAULT. Takes effect from the
+ *  next JPEG transfer.
+ *
+ *  @param quality the quality, 1 to 100
+ *  @return a status of type cam_status_t
+ */
+cam_status_t cam_JpegQuality(uint8_t quality);
+
+/** @brief Set the thumbnail transfer level
+ *
+ *  Starts at CAM_THUMB_DEFAULT. Takes effect from the
+ *  next thumbnail transfer.
+ *
+ *  @param level 1 for half size through
+ *  IMG_PYRAMID_LEVELS
+ *  @return a status of type cam_status_t
+ */
+cam_status_t cam_ThumbLevel(uint8_t level);
+
+/** @brief Start watching for change
+ *
+ *  Captures one frame after another and sends only those
+ *  where a region from cam_WatchRegion() fired, each
+ *  after a CAM_INFO_MOTION packet with its img_motion_t.
+ *  The first frame only sets the background. While
+ *  watching, a call changes the settings.
+ *
+ *  @param xfer what to send for a frame that fired
+ *  @param threshold largest unchanged luma difference
+ *  @return a status of type cam_status_t
+ */
+cam_status_t cam_WatchStart(cam_xfer_t xfer, uint8_t threshold);
+
+/** @brief Stop watching for change
+ *
+ *  A capture under way still completes, but isn't
+ *  checked.
+ *
+ *  @return a status of type cam_status_t
+ */
+cam_status_t cam_WatchStop();
+
+/** @brief Set a change detection region
+ *
+ *  In pixels of the smallest pyramid level. A region
+ *  with no width is off. Only region 0 is on at first,
+ *  over the whole frame.
+ *
+ *  @param index the region, below CAM_WATCH_REGIONS
+ *  @param region the region
+ *  @return a status of type cam_status_t
+ */
+cam_status_t cam_WatchRegion(uint8_t index, const img_region_t *region);
+
+/** @brief Choose what the history keeps
+ *
+ *  Starts at CAM_HISTORY_THUMB. Every frame captured goes
+ *  in, so while watching it holds the frames before the
+ *  change. Thumbnails are at the level from
+ *  cam_ThumbLevel(). A new mode starts an empty history.
+ *
+ *  @param mode what to keep
+ *  @return a status of type cam_status_t
+ */
+cam_status_t cam_HistoryMode(cam_history_t mode);
+
+/** @brief Take a reference to the newest frame
+ *
+ *  Release it with sdram_FrameRelease() when done. A new
+ *  capture can replace the frame meanwhile.
+ *
+ *  @return the frame, or NULL if none was captured yet
+ */
+sdram_frame_t *cam_FrameAcquire();
+
+/** @brief Make the next delta transfer a keyframe
+ *
+ *  For a host that missed the last keyframe. Keyframes
+ *  also go out every CAM_DELTA_KEYFRAME delta transfers.
+ */
+void cam_DeltaKeyframe();
+
+/** @brief Signal that a frame has been captured
+ *
+ *  Called by the sensor driver from the DCMI frame
+ *  complete interrupt.
+ */
+void cam_FrameComplete();
+
+#ifdef __KERN
+/** @brief Create the capture and transfer tasks
+ *
+ *  Must be called after kern_Init() and before
+ *  kern_Start().
  *
  *  @return a status of type cam_status_t
  */
-cam_status_t cam_Transfer();
+cam_status_t cam_TaskCreate();
+#endif
 
 # endif /* __CAM_H */
@@ -68,12 +68,19 @@ typedef enum ov7670_func_e {
  */
 typedef enum prof_func_e {
     PROF_FUNC_INIT,   
+    PROF_FUNC_FLUSH,
+    PROF_FUNC_DUMP,
+    PROF_FUNC_RESET,
+    PROF_FUNC_SAMPLE_START,
+    PROF_FUNC_SAMPLE_STOP,
+    PROF_FUNC_SAMPLE_DUMP,
 } prof_func_t;
 
 /* @brief test functions
  */
 typedef enum test_func_e {
     TEST_FUNC_DUMMY,   
+    TEST_FUNC_BENCH,
 } test_func_t;
 
 /* @brief camera functions
@@ -83,8 +90,78 @@ typedef enum cam_func_e {
     CAM_FUNC_CONFIG,
     CAM_FUNC_CAPTURE,
     CAM_FUNC_TRANSFER,   
+    CAM_FUNC_TRANSFER_LUMA,
+    CAM_FUNC_TRANSFER_JPEG,
+    CAM_FUNC_TRANSFER_DELTA,
+    CAM_FUNC_TRANSFER_LZ,
+    CAM_FUNC_TRANSFER_THUMB,
+    CAM_FUNC_TRANSFER_STATS,
+    CAM_FUNC_WATCH_START,
+    CAM_FUNC_WATCH_STOP,
+    CAM_FUNC_WATCH_REGION,
+    CAM_FUNC_HISTORY,
+    CAM_FUNC_DUMP_HISTORY,
 } cam_func_t;
 
+/* @brief scheduler functions
+ */
+typedef enum sched_func_e {
+    SCHED_FUNC_DUMMY,
+} sched_func_t;
+
+/* @brief kernel functions
+ */
+typedef enum kern_func_e {
+    KERN_FUNC_DUMMY,
+} kern_func_t;
+
+/* @brief Time base functions
+ */
+typedef enum tick_func_e {
+    TICK_FUNC_NOW,
+} tick_func_t;
+
+/* @brief Trace recorder functions
+ */
+typedef enum trace_func_e {
+    TRACE_FUNC_START,
+    TRACE_FUNC_STOP,
+    TRACE_FUNC_DUMP,
+} trace_func_t;
+
+/* @brief Interrupt and DMA monitor functions
+ */
+typedef enum mon_func_e {
+    MON_FUNC_STATS,
+    MON_FUNC_RESET,
+    MON_FUNC_TELEMETRY_START,
+    MON_FUNC_TELEMETRY_STOP,
+} mon_func_t;
+
+/* @brief Memory monitor functions
+ */
+typedef enum mem_func_e {
+    MEM_FUNC_REPORT,
+} mem_func_t;
+
+/* @brief Image processing functions
+ */
+typedef enum img_func_e {
+    IMG_FUNC_DUMMY,
+} img_func_t;
+
+/* @brief JPEG encoder functions
+ */
+typedef enum jpeg_func_e {
+    JPEG_FUNC_DUMMY,
+} jpeg_func_t;
+
+/* @brief LZ compressor functions
+ */
+typedef enum lz_func_e {
+    LZ_FUNC_DUMMY,
+} lz_func_t;
+
 /* @brief command structure
  */
 typedef struct __attribute__ ((packed)) cmd_cmd_s {
@@ -129,6 +206,18 @@ typedef struct __attribute__ ((packed)) cmd_queue_s {
  */
 cmd_status_t cmd_queueInit();
 
+/** @brief Command task
+ *
+ *  This is the scheduler task that executes commands.
+ *  It takes one command from the command queue, executes
+ *  it, and frees the command memory. If more commands are
+ *  waiting, the task posts itself again so that higher
+ *  priority tasks can run between commands.
+ *
+ *  @param arg unused
+ */
+void cmd_task(void *arg);
+
 #ifdef __CMD
 /** @brief This function initializes the UART Rx
  *
@@ -144,8 +233,8 @@ cmd_status_t cmd_uartInit();
  *  buffer, checking if we have recieved the correct 
  *  number of bytes. It keeps track of the total, adjusting
  *  based on the data length parameter. When a full command
- *  is recieved, it is put into the command queue to be 
- *  executed.
+ *  is recieved, it is put into the command queue and the
+ *  command task is posted to the scheduler.
  */
 void USART2_IRQHandler(void);
 #endif
@@ -200,7 +289,7 @@ cmd_status_t cmd_QueueGetStatus();
  *  NOTE: For the command to get executed correctly, the
  *  caller must allocate space on the heap for both the 
  *  command and the command data! If the command passed in
- *  is not allocated, the command loop will try to execute
+ *  is not allocated, the command task will try to execute
  *  on garbage memory!
  *
  *  Example call:
@@ -247,7 +336,7 @@ cmd_status_t cmd_QueueGet(cmd_cmd_t **cmd);
  *  if the compiler directive __CMD is set, initalizes
  *  UART2 for Rx mode to receive commands from the debug
  *  interface. It should be noted that the command queue
- *  and loop will still function without the __CMD
+ *  and task will still function without the __CMD
  *  directive. The directive only turns off the UART module
  *  and the connection to the debug interface.
  *
@@ -255,15 +344,15 @@ cmd_status_t cmd_QueueGet(cmd_cmd_t **cmd);
  */
 cmd_status_t cmd_Init();
 
-/** @brief The main command loop
+/** @brief Execute a command
  * 
- *  This function checks the main command queue for pending
- *  commands and executes them if there are any. It also 
- *  calls cmd_Deallocate to free the memory associated with
- *  commands.
+ *  This function routes a command to the module function
+ *  it names and logs the result. It does not free the
+ *  command memory.
  *
+ *  @param cmd the command to execute
  *  @return a status value of the type cmd_status_t
  */
-cmd_status_t cmd_Loop();
+cmd_status_t cmd_Execute(cmd_cmd_t *cmd);
 
 # endif /* __CMD_H */
@@ -49,6 +49,7 @@ typedef enum log_status_e {
     LOG_ERR_DATASIZE = ERR,
     LOG_ERR_MSGSIZE = ERR+1,
     LOG_ERR_LOGOFF = ERR+2,
+    LOG_ERR_TIMEOUT = ERR+3,
     LOG_ERR_UNKNOWN = END-1
 } log_status_t;
 
@@ -74,6 +75,7 @@ typedef enum cmd_status_e {
     CMD_ERR_DATA = ERR+5,
     CMD_ERR_NOFUNC = ERR+6,
     CMD_ERR_NOMOD = ERR+7,
+    CMD_ERR_SCHED = ERR+8,
     CMD_ERR_UNKNOWN = END-1,
 } cmd_status_t;
 
@@ -97,6 +99,14 @@ typedef enum sdram_status_e {
     SDRAM_WARN_ALINIT = WARN,
     SDRAM_WARN_UNKNOWN = ERR-1,
 
+    SDRAM_ERR_NULLPTR = ERR,
+    SDRAM_ERR_FREED = ERR+1,
+    SDRAM_ERR_ARENA = ERR+2,
+    SDRAM_ERR_SIZE = ERR+3,
+    SDRAM_ERR_RANGE = ERR+4,
+    SDRAM_ERR_BUSY = ERR+5,
+    SDRAM_ERR_DMA = ERR+6,
+    SDRAM_ERR_TIMEOUT = ERR+7,
     SDRAM_ERR_UNKNOWN = END-1,
 } sdram_status_t;
 
@@ -114,6 +124,7 @@ typedef enum ov5642_status_e {
     OV5642_ERR_I2CREAD = ERR+1,
     OV5642_ERR_I2CWRITE = ERR+2,
     OV5642_ERR_I2CTIMEOUT = ERR+3,
+    OV5642_ERR_DMA = ERR+4,
     OV5642_ERR_UNKNOWN = END-1,
 } ov5642_status_t;
 
@@ -131,6 +142,7 @@ typedef enum ov7670_status_e {
     OV7670_ERR_I2CREAD = ERR+1,
     OV7670_ERR_I2CWRITE = ERR+2,
     OV7670_ERR_I2CTIMEOUT = ERR+3,
+    OV7670_ERR_DMA = ERR+4,
     OV7670_ERR_UNKNOWN = END-1,
 } ov7670_status_t;
 
@@ -139,11 +151,18 @@ typedef enum ov7670_status_e {
 typedef enum prof_status_e {
     PROF_INFO_OK = INFO,
     PROF_INFO_RESULTS = INFO+1,
+    PROF_INFO_EMPTY = INFO+2,
+    PROF_INFO_STATS = INFO+3,
+    PROF_INFO_PCSAMPLES = INFO+4,
     PROF_INFO_UNKNOWN = WARN-1,
 
     PROF_WARN_ALINIT = WARN,
+    PROF_WARN_DROPPED = WARN+1,
     PROF_WARN_UNKNOWN = ERR-1,
 
+    PROF_ERR_DEPTH = ERR,
+    PROF_ERR_UNDERFLOW = ERR+1,
+    PROF_ERR_PROBE = ERR+2,
     PROF_ERR_UNKNOWN = END-1,
 } prof_status_t;
 
@@ -153,9 +172,12 @@ typedef enum test_status_e {
     TEST_INFO_OK = INFO,
     TEST_INFO_PASSED = INFO+1,
     TEST_INFO_CONFIRM = INFO+2,
+    TEST_INFO_BENCH = INFO+3,
+    TEST_INFO_FILLER = INFO+4,
     TEST_INFO_UNKNOWN = WARN-1,
 
     TEST_WARN_FAILED = WARN,
+    TEST_WARN_SKIPPED = WARN+1,
     TEST_WARN_UNKNOWN = ERR-1,
 
     TEST_ERR_UNKNOWN = END-1,
@@ -166,6 +188,14 @@ typedef enum test_status_e {
 typedef enum cam_status_e {
     CAM_INFO_OK = INFO,
     CAM_INFO_IMAGE = INFO+1,
+    CAM_INFO_QUEUED = INFO+2,
+    CAM_INFO_LUMA = INFO+3,
+    CAM_INFO_JPEG = INFO+4,
+    CAM_INFO_DELTA = INFO+5,
+    CAM_INFO_THUMB = INFO+6,
+    CAM_INFO_STATS = INFO+7,
+    CAM_INFO_MOTION = INFO+8,
+    CAM_INFO_HISTORY = INFO+9,
 
     CAM_INFO_UNKNOWN = WARN-1,
 
@@ -177,6 +207,14 @@ typedef enum cam_status_e {
     CAM_ERR_CONFIG = ERR+1,
     CAM_ERR_CAPTURE = ERR+2,
     CAM_ERR_TRANSFER = ERR+3,
+    CAM_ERR_TIMEOUT = ERR+4,
+    CAM_ERR_NOFRAME = ERR+5,
+    CAM_ERR_ENCODE = ERR+6,
+    CAM_ERR_QUALITY = ERR+7,
+    CAM_ERR_LEVEL = ERR+8,
+    CAM_ERR_REGION = ERR+9,
+    CAM_ERR_MODE = ERR+10,
+    CAM_ERR_BUSY = ERR+11,
     CAM_ERR_UNKNOWN = END-1,
 } cam_status_t;
 
@@ -188,6 +226,7 @@ typedef enum esp8266_status_e {
 
     ESP8266_WARN_UNKNOWN = ERR-1,
 
+    ESP8266_ERR_TIMEOUT = ERR,
     ESP8266_ERR_UNKNOWN = END-1,
 } esp8266_status_t;
 
@@ -207,6 +246,154 @@ typedef enum wifi_status_e {
     WIFI_ERR_UNKNOWN = END-1,
 } wifi_status_t;
 
+/* @brief Scheduler status
+ */
+typedef enum sched_status_e {
+    SCHED_INFO_OK = INFO,
+    SCHED_INFO_IDLE = INFO+1,
+    SCHED_INFO_UNKNOWN = WARN-1,
+
+    SCHED_WARN_ALINIT = WARN,
+    SCHED_WARN_UNKNOWN = ERR-1,
+
+    SCHED_ERR_QUEUEFULL = ERR,
+    SCHED_ERR_NULLPTR = ERR+1,
+    SCHED_ERR_PRIO = ERR+2,
+    SCHED_ERR_UNKNOWN = END-1,
+} sched_status_t;
+
+/* @brief Kernel status
+ */
+typedef enum kern_status_e {
+    KERN_INFO_OK = INFO,
+    KERN_INFO_UNKNOWN = WARN-1,
+
+    KERN_WARN_ALINIT = WARN,
+    KERN_WARN_SEMFULL = WARN+1,
+    KERN_WARN_UNKNOWN = ERR-1,
+
+    KERN_ERR_INIT = ERR,
+    KERN_ERR_NULLPTR = ERR+1,
+    KERN_ERR_PRIO = ERR+2,
+    KERN_ERR_STACK = ERR+3,
+    KERN_ERR_TIMEOUT = ERR+4,
+    KERN_ERR_OWNER = ERR+5,
+    KERN_ERR_QUEUEFULL = ERR+6,
+    KERN_ERR_CONTEXT = ERR+7,
+    KERN_ERR_UNKNOWN = END-1,
+} kern_status_t;
+
+/* @brief Time base status
+ */
+typedef enum tick_status_e {
+    TICK_INFO_OK = INFO,
+    TICK_INFO_UNKNOWN = WARN-1,
+
+    TICK_WARN_ALINIT = WARN,
+    TICK_WARN_UNKNOWN = ERR-1,
+
+    TICK_ERR_UNKNOWN = END-1,
+} tick_status_t;
+
+/* @brief Trace recorder status
+ */
+typedef enum trace_status_e {
+    TRACE_INFO_OK = INFO,
+    TRACE_INFO_HEADER = INFO+1,
+    TRACE_INFO_DATA = INFO+2,
+    TRACE_INFO_END = INFO+3,
+    TRACE_INFO_UNKNOWN = WARN-1,
+
+    TRACE_WARN_ALINIT = WARN,
+    TRACE_WARN_UNKNOWN = ERR-1,
+
+    TRACE_ERR_INIT = ERR,
+    TRACE_ERR_UNKNOWN = END-1,
+} trace_status_t;
+
+/* @brief Interrupt and DMA monitor status
+ */
+typedef enum mon_status_e {
+    MON_INFO_OK = INFO,
+    MON_INFO_STATS = INFO+1,
+    MON_INFO_TELEMETRY = INFO+2,
+    MON_INFO_UNKNOWN = WARN-1,
+
+    MON_WARN_ALINIT = WARN,
+    MON_WARN_UNKNOWN = ERR-1,
+
+    MON_ERR_INIT = ERR,
+    MON_ERR_NULLPTR = ERR+1,
+    MON_ERR_UNKNOWN = END-1,
+} mon_status_t;
+
+/* @brief Memory monitor status
+ */
+typedef enum mem_status_e {
+    MEM_INFO_OK = INFO,
+    MEM_INFO_REPORT = INFO+1,
+    MEM_INFO_UNKNOWN = WARN-1,
+
+    MEM_WARN_ALINIT = WARN,
+    MEM_WARN_STACK = WARN+1,
+    MEM_WARN_UNKNOWN = ERR-1,
+
+    MEM_ERR_NULLPTR = ERR,
+    MEM_ERR_UNKNOWN = END-1,
+} mem_status_t;
+
+/* @brief Image processing status
+ */
+typedef enum img_status_e {
+    IMG_INFO_OK = INFO,
+    IMG_INFO_UNKNOWN = WARN-1,
+
+    IMG_WARN_ALINIT = WARN,
+    IMG_WARN_UNKNOWN = ERR-1,
+
+    IMG_ERR_NULLPTR = ERR,
+    IMG_ERR_FORMAT = ERR+1,
+    IMG_ERR_SIZE = ERR+2,
+    IMG_ERR_ALIGN = ERR+3,
+    IMG_ERR_RANGE = ERR+4,
+    IMG_ERR_BUSY = ERR+5,
+    IMG_ERR_DMA = ERR+6,
+    IMG_ERR_TIMEOUT = ERR+7,
+    IMG_ERR_FULL = ERR+8,
+    IMG_ERR_UNKNOWN = END-1,
+} img_status_t;
+
+/* @brief JPEG encoder status
+ */
+typedef enum jpeg_status_e {
+    JPEG_INFO_OK = INFO,
+    JPEG_INFO_UNKNOWN = WARN-1,
+
+    JPEG_WARN_UNKNOWN = ERR-1,
+
+    JPEG_ERR_NULLPTR = ERR,
+    JPEG_ERR_SIZE = ERR+1,
+    JPEG_ERR_QUALITY = ERR+2,
+    JPEG_ERR_FULL = ERR+3,
+    JPEG_ERR_UNKNOWN = END-1,
+} jpeg_status_t;
+
+/* @brief LZ compressor status
+ */
+typedef enum lz_status_e {
+    LZ_INFO_OK = INFO,
+    LZ_INFO_PACKET = INFO+1,
+    LZ_INFO_RATIO = INFO+2,
+    LZ_INFO_UNKNOWN = WARN-1,
+
+    LZ_WARN_RAW = WARN,
+    LZ_WARN_UNKNOWN = ERR-1,
+
+    LZ_ERR_NULLPTR = ERR,
+    LZ_ERR_FULL = ERR+1,
+    LZ_ERR_UNKNOWN = END-1,
+} lz_status_t;
+
 /**************************************
  * @name Public functions
  */
@@ -22,10 +22,26 @@
 
 #define ESP8266_BAUDRATE 9600
 
+/* @brief Timeout for one byte to leave the UART, in
+ * microseconds, and the gap inserted every 100 data bytes
+ */
+#define ESP8266_TX_TIMEOUT_US 5000
+#define ESP8266_DATA_GAP_US 50
+
 /**************************************
  * @name Private functions
  */
 
+/** @brief Send one byte to the ESP8266
+ *
+ *  Waits for the transmit register to empty, up to
+ *  ESP8266_TX_TIMEOUT_US.
+ *
+ *  @param byte the byte to send
+ *  @return ESP8266_INFO_OK or ESP8266_ERR_TIMEOUT
+ */
+esp8266_status_t esp8266_sendByte(uint8_t byte);
+
 /**************************************
  * @name Public functions
  */
@@ -0,0 +1,591 @@
+/** @file img.h
+ *  @brief Function prototypes for the image processing.
+ *
+ *  This contains the prototypes, macros, constants,
+ *  and global variables for the image processing stages
+ *  that run on frames in SDRAM before they are sent.
+ *
+ *  Frames are YUV422 in UYVY order, as both sensors are
+ *  set up, so every second byte is luma.
+ *
+ *  Color comes out of the YUV frames on the CPU, two
+ *  pixels at a time through the SIMD unit. Tiles of the
+ *  frame are staged in core coupled RAM, so the SDRAM
+ *  sees block reads and writes instead of switching rows
+ *  between the two on every pixel.
+ *
+ *  Pixel format conversions go through a queue on the
+ *  DMA2D. It has no YUV input and no L8 output, so a
+ *  frame becomes L8 through img_Luma() first, and L8
+ *  converts out through a grayscale lookup table.
+ *
+ *  The delta encoder sends only the 16 by 16 tiles of a
+ *  frame that differ from a reference, the frame as the
+ *  host last saw it. The tiles are compared by their sum
+ *  of absolute differences, four bytes at a time.
+ *
+ *  The pyramid is the frame at a half, a quarter and an
+ *  eighth of its size, each pixel the mean of a box of
+ *  the level above. Every level comes out of one pass
+ *  over the frame, two source lines at a time.
+ *
+ *  Frame statistics also come out of one pass, the
+ *  lines staged through core coupled RAM three at a
+ *  time so each neighbourhood is at hand for the focus
+ *  measure.
+ *
+ *  The change detector compares a small frame, a level of
+ *  the pyramid, to a background that follows it slowly,
+ *  and counts the changed pixels in each region.
+ *
+ *  @author Ben Heberlein
+ *  @bug No known bugs.
+ */
+
+#ifndef __IMG_H
+#define __IMG_H
+
+/*************************************
+ * @name Includes and definitions
+ */
+
+#include "err.h"
+#include <stdint.h>
+
+/* @brief Bytes per YUV422 pixel, and where the luma sits
+ * in each pixel
+ */
+#define IMG_YUV_BPP 2
+#define IMG_YUV_LUMA 1
+
+/* @brief Full range BT.601 chroma weights, in 1/256ths,
+ * the same as JPEG
+ */
+#define IMG_YUV_RV 359
+#define IMG_YUV_GU -88
+#define IMG_YUV_GV -183
+#define IMG_YUV_BU 454
+
+/* @brief Pixels in a core coupled RAM tile, even
+ */
+#define IMG_TILE_PIXELS 1024
+
+/* @brief DMA2D conversion queue and interrupt priority,
+ * the same as the copy engine
+ */
+#define IMG_CONVERT_QUEUE 4
+#define IMG_CONVERT_NVIC_PRIO 2
+
+/* @brief Widest conversion, from the DMA2D pixel
+ * counter
+ */
+#define IMG_CONVERT_MAXWIDTH 0x3FFF
+
+/* @brief img_ConvertWait() and lookup table load
+ * timeout, a VGA frame with time to spare
+ */
+#define IMG_CONVERT_TIMEOUT_US 100000
+
+/* @brief Pixels on a side of a delta tile, and bytes in
+ * a tile of YUV422
+ */
+#define IMG_DELTA_TILE 16
+#define IMG_DELTA_TILEBYTES (IMG_DELTA_TILE*IMG_DELTA_TILE*IMG_YUV_BPP)
+
+/* @brief Delta encoder output size with every tile sent,
+ * a header then each tile after its coordinates
+ */
+#define IMG_DELTA_MAXSIZE(w, h) (sizeof(img_delta_t) + \
+                                 ((w)/IMG_DELTA_TILE)*((h)/IMG_DELTA_TILE)*(2 + IMG_DELTA_TILEBYTES))
+
+/* @brief Pyramid levels, each half the size of the one
+ * before. A frame must divide into whole pixel pairs at
+ * the smallest.
+ */
+#define IMG_PYRAMID_LEVELS 3
+#define IMG_PYRAMID_XALIGN (2 << IMG_PYRAMID_LEVELS)
+#define IMG_PYRAMID_YALIGN (1 << IMG_PYRAMID_LEVELS)
+
+/* @brief Pyramid size, each level is a header then its
+ * lines of YUV422
+ */
+#define IMG_PYRAMID_SIZE(w, h) (IMG_PYRAMID_LEVELS*sizeof(img_thumb_t) + \
+                                ((w)*(h)/4 + (w)*(h)/16 + (w)*(h)/64)*IMG_YUV_BPP)
+
+/* @brief Luma histogram bins, and the widest frame the
+ * statistics line buffers hold
+ */
+#define IMG_STATS_BINS 64
+#define IMG_STATS_BINSHIFT 2
+#define IMG_STATS_MAXWIDTH 640
+
+/* @brief Statistics flags, set when there was a previous
+ * frame to measure motion against
+ */
+#define IMG_STATS_MOTION 0x01
+
+/* @brief Most change detector regions, and the region
+ * reported when none fired
+ */
+#define IMG_MOTION_REGIONS 8
+#define IMG_MOTION_NONE 0xFF
+
+/* @brief Pixel formats, the values are the DMA2D color
+ * modes. L8 is only an input.
+ */
+typedef enum img_fmt_e {
+    IMG_FMT_ARGB8888 = 0,
+    IMG_FMT_RGB888 = 1,
+    IMG_FMT_RGB565 = 2,
+    IMG_FMT_L8 = 5,
+} img_fmt_t;
+
+/* @brief Conversion completion callback, called from the
+ * DMA2D interrupt
+ */
+typedef void (*img_callback_t)(img_status_t status, void *arg);
+
+/* @brief A queued conversion
+ */
+typedef struct img_convert_s {
+    uint32_t img_convert_dst;
+    uint32_t img_convert_src;
+    img_fmt_t img_convert_dstFmt;
+    img_fmt_t img_convert_srcFmt;
+    uint16_t img_convert_width;
+    uint16_t img_convert_height;
+    img_callback_t img_convert_callback;
+    void *img_convert_arg;
+} img_convert_t;
+
+/* @brief Delta encoder output header, little endian. Each
+ * tile follows as its column and row in tiles, then its
+ * lines.
+ */
+typedef struct __attribute__ ((packed)) img_delta_s {
+    uint16_t img_delta_width;
+    uint16_t img_delta_height;
+    uint8_t img_delta_tile;
+    uint8_t img_delta_key;
+    uint16_t img_delta_count;
+} img_delta_t;
+
+/* @brief Pyramid level header, little endian, followed
+ * by the level in YUV422. Four bytes, so the lines stay
+ * word aligned.
+ */
+typedef struct __attribute__ ((packed)) img_thumb_s {
+    uint16_t img_thumb_width;
+    uint16_t img_thumb_height;
+} img_thumb_t;
+
+/* @brief Frame statistics, little endian. Means and
+ * variances are in 1/256ths of a level. Focus is the
+ * variance of the Laplacian of the luma, motion the mean
+ * squared luma difference from the previous frame.
+ */
+typedef struct __attribute__ ((packed)) img_stats_s {
+    uint16_t img_stats_width;
+    uint16_t img_stats_height;
+    uint8_t img_stats_flags;
+    uint8_t img_stats_bins;
+    uint32_t img_stats_mean;
+    uint32_t img_stats_variance;
+    uint32_t img_stats_focus;
+    uint32_t img_stats_motion;
+    uint32_t img_stats_hist[IMG_STATS_BINS];
+} img_stats_t;
+
+/* @brief Change detector region, in pixels of the frame
+ * it checks. It fires with count or more changed pixels.
+ * A region with no width is off.
+ */
+typedef struct __attribute__ ((packed)) img_region_s {
+    uint16_t img_region_x;
+    uint16_t img_region_y;
+    uint16_t img_region_width;
+    uint16_t img_region_height;
+    uint16_t img_region_count;
+} img_region_t;
+
+/* @brief Change detector result, little endian. The box
+ * holds the changed pixels of the region that fired, its
+ * corners inclusive.
+ */
+typedef struct __attribute__ ((packed)) img_motion_s {
+    uint8_t img_motion_region;
+    uint16_t img_motion_count;
+    uint16_t img_motion_x0;
+    uint16_t img_motion_y0;
+    uint16_t img_motion_x1;
+    uint16_t img_motion_y1;
+} img_motion_t;
+
+/**************************************
+ * @name Private functions
+ */
+
+/** @brief Pack the luma of a YUV422 frame, a byte at a
+ *  time
+ *
+ *  The reference for img_Luma(), and its tail.
+ *
+ *  @param dst where to put the luma, one byte a pixel
+ *  @param src the YUV422 frame
+ *  @param pixels pixels in the frame
+ */
+void img_lumaRef(uint8_t *dst, const uint8_t *src, uint32_t pixels);
+
+/** @brief Convert YUV422 to RGB565, a pixel at a time
+ *
+ *  The reference for img_rgb565Tile().
+ *
+ *  @param dst where to put the RGB565 pixels
+ *  @param src the YUV422 pixels
+ *  @param pixels pixels to convert, even
+ */
+void img_rgb565Ref(uint16_t *dst, const uint8_t *src, uint32_t pixels);
+
+/** @brief Convert YUV422 to RGB888, a pixel at a time
+ *
+ *  The reference for img_rgb888Tile(). Bytes are blue,
+ *  green, red, the DMA2D order.
+ *
+ *  @param dst where to put the RGB888 pixels
+ *  @param src the YUV422 pixels
+ *  @param pixels pixels to convert, even
+ */
+void img_rgb888Ref(uint8_t *dst, const uint8_t *src, uint32_t pixels);
+
+/** @brief Convert a tile of YUV422 to RGB565
+ *
+ *  Two pixels, one word in and one word out, at a time
+ *  through the SIMD unit. Matches img_rgb565Ref().
+ *
+ *  @param dst where to put the RGB565 pixels
+ *  @param src the YUV422 pixels
+ *  @param pairs pixel pairs to convert
+ */
+void img_rgb565Tile(uint32_t *dst, const uint32_t *src, uint32_t pairs);
+
+/** @brief Convert a tile of YUV422 to RGB888
+ *
+ *  Two pixels at a time through the SIMD unit. Matches
+ *  img_rgb888Ref().
+ *
+ *  @param dst where to put the RGB888 pixels
+ *  @param src the YUV422 pixels
+ *  @param pairs pixel pairs to convert
+ */
+void img_rgb888Tile(uint8_t *dst, const uint32_t *src, uint32_t pairs);
+
+/** @brief Sum of absolute differences of two tiles
+ *
+ *  Four bytes at a time through the SIMD unit. Stops at
+ *  the end of a line once the sum passes the limit.
+ *
+ *  @param a the first tile, word aligned
+ *  @param b the second tile, word aligned
+ *  @param stride words from one line of a frame to the
+ *  next
+ *  @param limit sum to stop past
+ *  @return the sum, or a partial one past the limit
+ */
+uint32_t img_sadTile(const uint32_t *a, const uint32_t *b, uint32_t stride, uint32_t limit);
+
+/** @brief Halve two lines of YUV422 into one, a byte at
+ *  a time
+ *
+ *  The reference for img_halveRow(). Each output byte is
+ *  the mean of a two by two box, the lines averaged then
+ *  the columns, each rounded down.
+ *
+ *  @param dst where to put the line
+ *  @param a the upper line
+ *  @param b the lower line
+ *  @param pixels pixels out, even
+ */
+void img_halveRef(uint8_t *dst, const uint8_t *a, const uint8_t *b, uint32_t pixels);
+
+/** @brief Halve two lines of YUV422 into one
+ *
+ *  Two pixels out a word, from two words of each line,
+ *  through the SIMD halving adds. Matches img_halveRef().
+ *
+ *  @param dst where to put the line
+ *  @param a the upper line
+ *  @param b the lower line
+ *  @param pairs pixel pairs out
+ */
+void img_halveRow(uint32_t *dst, const uint32_t *a, const uint32_t *b, uint32_t pairs);
+
+/** @brief Measure a frame, a byte at a time
+ *
+ *  The reference for img_Stats().
+ *
+ *  @param stats where to put the statistics
+ *  @param src the YUV422 frame
+ *  @param prev the frame before, or NULL
+ *  @param width pixels in a line
+ *  @param height lines in the frame
+ */
+void img_statsRef(img_stats_t *stats, const uint8_t *src, const uint8_t *prev,
+                  uint16_t width, uint16_t height);
+
+/** @brief Fill in statistics from the frame sums
+ *
+ *  @param stats where to put the statistics
+ *  @param hist the histogram
+ *  @param sum sum of the lumas
+ *  @param sumSq sum of their squares
+ *  @param lapSum sum of the Laplacian
+ *  @param lapSq sum of its squares
+ *  @param diffSq sum of the squared differences from the
+ *  frame before
+ *  @param motion 1 if there was a frame before
+ *  @param width pixels in a line
+ *  @param height lines in the frame
+ */
+void img_statsFinish(img_stats_t *stats, const uint32_t *hist, uint64_t sum, uint64_t sumSq,
+                     int64_t lapSum, uint64_t lapSq, uint64_t diffSq, uint8_t motion,
+                     uint16_t width, uint16_t height);
+
+/** @brief Sum the Laplacian of a line of luma
+ *
+ *  Four times each pixel less its four neighbours, two
+ *  pixels at a time through the SIMD unit. The first and
+ *  last pixel pairs of the line are left out.
+ *
+ *  @param up the line above, YUV422
+ *  @param line the line
+ *  @param down the line below
+ *  @param words words in a line
+ *  @param sum added to with the sum
+ *  @param sumSq added to with the sum of squares
+ */
+void img_laplaceLine(const uint32_t *up, const uint32_t *line, const uint32_t *down,
+                     uint32_t words, int64_t *sum, uint64_t *sumSq);
+
+/** @brief Bytes per pixel of a format
+ *
+ *  @param fmt the format
+ *  @return the size, 0 for an unknown format
+ */
+uint8_t img_fmtBytes(img_fmt_t fmt);
+
+/** @brief Program the DMA2D for the conversion at the
+ *  head of the queue and start it
+ *
+ *  Call with interrupts masked.
+ */
+void img_convertStart();
+
+/** @brief Finish the conversion at the head of the queue
+ *
+ *  Calls its callback and starts the next conversion.
+ *
+ *  @param status the status passed to the callback
+ */
+void img_convertFinish(img_status_t status);
+
+/** @brief DMA2D interrupt handler
+ */
+void DMA2D_IRQHandler();
+
+/**************************************
+ * @name Public functions
+ */
+
+/** @brief Pack the luma of a YUV422 frame
+ *
+ *  Writes the Y byte of each pixel to dst, half the size
+ *  of the frame. With both buffers word aligned, four
+ *  pixels go through the SIMD unit at once. Runs from
+ *  SRAM.
+ *
+ *  @param dst where to put the luma, one byte a pixel
+ *  @param src the YUV422 frame
+ *  @param pixels pixels in the frame
+ *  @return a status code of the type img_status_t
+ */
+img_status_t img_Luma(uint8_t *dst, const uint8_t *src, uint32_t pixels);
+
+/** @brief Convert a YUV422 frame to RGB565
+ *
+ *  Copies the frame through core coupled RAM a tile at a
+ *  time, converting each tile there. One caller at a
+ *  time, the tiles are shared.
+ *
+ *  @param dst where to put the RGB565 frame
+ *  @param src the YUV422 frame
+ *  @param pixels pixels in the frame, even
+ *  @return a status code of the type img_status_t
+ */
+img_status_t img_Rgb565(void *dst, const void *src, uint32_t pixels);
+
+/** @brief Convert a YUV422 frame to RGB888
+ *
+ *  Like img_Rgb565(), three bytes a pixel out.
+ *
+ *  @param dst where to put the RGB888 frame
+ *  @param src the YUV422 frame
+ *  @param pixels pixels in the frame, even
+ *  @return a status code of the type img_status_t
+ */
+img_status_t img_Rgb888(void *dst, const void *src, uint32_t pixels);
+
+/** @brief Encode the tiles of a frame that changed
+ *
+ *  Compares each tile of src to the same tile of ref and
+ *  writes the ones whose sum of absolute differences is
+ *  over the threshold to dst, after an img_delta_t
+ *  header. Sent tiles are copied into ref, so it stays
+ *  what the receiver has. A keyframe sends every tile.
+ *
+ *  If this fails ref may be partly updated, so send a
+ *  keyframe next. A dst of IMG_DELTA_MAXSIZE() bytes
+ *  always fits.
+ *
+ *  @param dst where to put the tiles
+ *  @param max bytes at dst
+ *  @param len set to the bytes written
+ *  @param src the YUV422 frame, word aligned
+ *  @param ref the reference frame, word aligned
+ *  @param width pixels in a line, a multiple of
+ *  IMG_DELTA_TILE
+ *  @param height lines in the frame, a multiple of
+ *  IMG_DELTA_TILE
+ *  @param key 1 to send every tile
+ *  @param threshold largest tile difference not sent
+ *  @return a status code of the type img_status_t
+ */
+img_status_t img_DeltaEncode(void *dst, uint32_t max, uint32_t *len,
+                             const void *src, void *ref,
+                             uint16_t width, uint16_t height,
+                             uint8_t key, uint32_t threshold);
+
+/** @brief Build the pyramid of a frame
+ *
+ *  Writes the IMG_PYRAMID_LEVELS levels to dst, largest
+ *  first, each an img_thumb_t then its lines. A level
+ *  line is made as soon as the two lines above it are,
+ *  so the frame is read once. A dst of
+ *  IMG_PYRAMID_SIZE() bytes always fits.
+ *
+ *  @param dst where to put the pyramid, word aligned
+ *  @param max bytes at dst
+ *  @param len set to the bytes written
+ *  @param src the YUV422 frame, word aligned
+ *  @param width pixels in a line, a multiple of
+ *  IMG_PYRAMID_XALIGN
+ *  @param height lines in the frame, a multiple of
+ *  IMG_PYRAMID_YALIGN
+ *  @return a status code of the type img_status_t
+ */
+img_status_t img_Pyramid(void *dst, uint32_t max, uint32_t *len,
+                         const void *src, uint16_t width, uint16_t height);
+
+/** @brief Find a level of a pyramid
+ *
+ *  @param pyramid the pyramid from img_Pyramid()
+ *  @param level 1 for half size through
+ *  IMG_PYRAMID_LEVELS
+ *  @param len set to the bytes in the level, with its
+ *  header
+ *  @return the level header, or NULL for no such level
+ */
+const img_thumb_t *img_PyramidLevel(const void *pyramid, uint8_t level, uint32_t *len);
+
+/** @brief Measure a frame
+ *
+ *  Fills stats with the luma histogram, mean and
+ *  variance, the focus, and the motion since prev, in one
+ *  pass over the frame. One caller at a time, the line
+ *  buffers are shared.
+ *
+ *  @param stats where to put the statistics
+ *  @param src the YUV422 frame, word aligned
+ *  @param prev the frame before, word aligned, or NULL
+ *  for no motion
+ *  @param width pixels in a line, even, 6 up to
+ *  IMG_STATS_MAXWIDTH
+ *  @param height lines in the frame, at least 3
+ *  @return a status code of the type img_status_t
+ */
+img_status_t img_Stats(img_stats_t *stats, const void *src, const void *prev,
+                       uint16_t width, uint16_t height);
+
+/** @brief Look for change against a background
+ *
+ *  A pixel has changed when its luma is more than
+ *  threshold from the background. Each background pixel,
+ *  in 1/256ths of a level, then moves 1/2^rate of the way
+ *  to the frame, so a rate of 0 loads the frame. Of the
+ *  regions that fire, the one with the most changed
+ *  pixels is reported.
+ *
+ *  @param motion where to put the result
+ *  @param background width by height background pixels
+ *  @param src the YUV422 frame
+ *  @param width pixels in a line
+ *  @param height lines in the frame
+ *  @param threshold largest unchanged luma difference
+ *  @param rate how slowly the background follows, 0 to 8
+ *  @param regions the regions
+ *  @param count regions, up to IMG_MOTION_REGIONS
+ *  @return a status code of the type img_status_t
+ */
+img_status_t img_Motion(img_motion_t *motion, uint16_t *background, const void *src,
+                        uint16_t width, uint16_t height, uint8_t threshold, uint8_t rate,
+                        const img_region_t *regions, uint8_t count);
+
+/** @brief Initialize the DMA2D
+ *
+ *  Turns on its clock and interrupt, and loads the
+ *  grayscale lookup table for L8 input. Call after
+ *  sdram_Init().
+ *
+ *  @return a status code of the type img_status_t
+ */
+img_status_t img_Init();
+
+/** @brief Queue a pixel format conversion on the DMA2D
+ *
+ *  Converts a packed width by height image, in SDRAM or
+ *  SRAM, in the background. Conversions run in the order
+ *  they were queued. The callback gets IMG_INFO_OK, or
+ *  IMG_ERR_DMA if the DMA2D hit a bus or configuration
+ *  error. Formats may be the same, for a plain copy.
+ *
+ *  Each buffer must be aligned to its pixel size, and
+ *  neither can be in core coupled RAM. Don't touch either
+ *  buffer until the callback.
+ *
+ *  @param dst where to put the converted image
+ *  @param dstFmt its format, anything but IMG_FMT_L8
+ *  @param src the image to convert
+ *  @param srcFmt its format
+ *  @param width pixels in a line
+ *  @param height lines in the image
+ *  @param callback called when done, may be NULL
+ *  @param arg passed to the callback
+ *  @return a status code of the type img_status_t
+ */
+img_status_t img_ConvertAsync(void *dst, img_fmt_t dstFmt,
+                              const void *src, img_fmt_t srcFmt,
+                              uint16_t width, uint16_t height,
+                              img_callback_t callback, void *arg);
+
+/** @brief Check for queued conversions
+ *
+ *  @return the number of conversions not finished yet
+ */
+uint8_t img_ConvertBusy();
+
+/** @brief Wait for every queued conversion
+ *
+ *  @return a status code of the type img_status_t
+ */
+img_status_t img_ConvertWait();
+
+# endif /* __IMG_H */
@@ -0,0 +1,151 @@
+/** @file jpeg.h
+ *  @brief Function prototypes for the JPEG encoder.
+ *
+ *  This contains the prototypes, macros, constants,
+ *  and global variables for the baseline JPEG encoder,
+ *  for sensors that can't compress on their own.
+ *
+ *  Frames are YUV422 in UYVY order. The output is a
+ *  baseline JFIF with 4:2:0 chroma, so each minimum coded
+ *  unit is a 16 by 16 block of the frame: four luma
+ *  blocks and one of each chroma. The frame is encoded a
+ *  16 line strip at a time out of core coupled RAM.
+ *
+ *  @author Ben Heberlein
+ *  @bug No known bugs.
+ */
+
+#ifndef __JPEG_H
+#define __JPEG_H
+
+/*************************************
+ * @name Includes and definitions
+ */
+
+#include "err.h"
+#include <stdint.h>
+
+/* @brief Pixels on a side of a minimum coded unit, the
+ * frame size must be a multiple of it
+ */
+#define JPEG_MCU 16
+
+/* @brief Widest frame, sizes the strip buffer
+ */
+#define JPEG_MAXWIDTH 640
+
+/* @brief Quality, 1 to 100, and the default
+ */
+#define JPEG_QUALITY_MIN 1
+#define JPEG_QUALITY_MAX 100
+#define JPEG_QUALITY_DEFAULT 75
+
+/* @brief Fixed point bits of the quantizer reciprocals
+ */
+#define JPEG_RECIP_BITS 16
+
+/* @brief Derived Huffman table, the code and its length
+ * in bits for each symbol
+ */
+typedef struct jpeg_huff_s {
+    uint16_t jpeg_huff_code[256];
+    uint8_t jpeg_huff_size[256];
+} jpeg_huff_t;
+
+/* @brief Output and bit writer state of one encode, kept
+ * on the caller's stack
+ */
+typedef struct jpeg_writer_s {
+    uint8_t *jpeg_writer_out;
+    uint32_t jpeg_writer_len;
+    uint32_t jpeg_writer_max;
+    uint32_t jpeg_writer_bitBuf;
+    uint8_t jpeg_writer_bitCount;
+    int32_t jpeg_writer_dcPred[3];
+} jpeg_writer_t;
+
+/**************************************
+ * @name Private functions
+ */
+
+/** @brief Build the derived Huffman tables
+ *
+ *  Runs once, from the first encode.
+ */
+void jpeg_huffInit();
+
+/** @brief Build the quantization tables for a quality
+ *
+ *  Scales the standard tables like the IJG encoder, and
+ *  folds the AAN DCT scale factors into the reciprocals
+ *  the coefficients are multiplied by. Skipped when the
+ *  quality hasn't changed.
+ *
+ *  @param quality the quality, 1 to 100
+ */
+void jpeg_quantInit(uint8_t quality);
+
+/** @brief Forward DCT of an 8 by 8 block in place
+ *
+ *  The integer AAN DCT, rows then columns. The output is
+ *  scaled by the AAN factors, which the quantization
+ *  takes out.
+ *
+ *  @param blk the block, samples less 128
+ */
+void jpeg_fdct(int32_t *blk);
+
+/** @brief Write bits to the output
+ *
+ *  Byte stuffs any 0xFF that comes out.
+ *
+ *  @param w the writer
+ *  @param bits the bits, right aligned
+ *  @param n how many, up to 16
+ */
+void jpeg_putBits(jpeg_writer_t *w, uint32_t bits, uint8_t n);
+
+/** @brief Transform, quantize, and Huffman code a block
+ *
+ *  @param w the writer, which holds the DC predictions
+ *  @param blk the block, samples less 128
+ *  @param comp the component, 0 for luma, 1 and 2 for
+ *  chroma
+ */
+void jpeg_block(jpeg_writer_t *w, int32_t *blk, uint8_t comp);
+
+/** @brief Write the headers, up to the start of scan
+ *
+ *  @param w the writer
+ *  @param width pixels in a line
+ *  @param height lines in the frame
+ */
+void jpeg_headers(jpeg_writer_t *w, uint16_t width, uint16_t height);
+
+/**************************************
+ * @name Public functions
+ */
+
+/** @brief Encode a YUV422 frame as a baseline JPEG
+ *
+ *  Each 16 line strip of the frame is copied into core
+ *  coupled RAM and coded from there. The strip and
+ *  tables are shared, so under the kernel tasks take
+ *  turns on a mutex. Not reentrant otherwise, and never
+ *  call it from an interrupt handler.
+ *
+ *  @param dst where to put the JPEG
+ *  @param max bytes at dst
+ *  @param len set to the JPEG size
+ *  @param src the YUV422 frame
+ *  @param width pixels in a line, a multiple of 16 up to
+ *  JPEG_MAXWIDTH
+ *  @param height lines in the frame, a multiple of 16
+ *  @param quality the quality, 1 to 100
+ *  @return a status code of the type jpeg_status_t
+ */
+jpeg_status_t jpeg_Encode(uint8_t *dst, uint32_t max, uint32_t *len,
+                          const uint8_t *src, uint16_t width, uint16_t height,
+                          uint8_t quality);
+
+# endif /* __JPEG_H */
@@ -0,0 +1,341 @@
+/** @file kern.h
+ *  @brief Function prototypes for the preemptive kernel.
+ *
+ *  This contains the prototypes, macros, constants,
+ *  and global variables for the kernel. The kernel runs
+ *  a fixed set of tasks, each with its own stack and a
+ *  unique priority. The highest priority ready task always
+ *  runs. Context switches happen in PendSV, and SysTick
+ *  provides a 1 ms tick that is suppressed while the idle
+ *  task sleeps.
+ *
+ *  Tasks can block on semaphores, mutexes, and queues with
+ *  a timeout. Semaphores and queues can be signalled from
+ *  interrupt handlers with the Isr variants.
+ *
+ *  The kernel is enabled with the __KERN directive.
+ *
+ *  @author Ben Heberlein
+ *  @bug No known bugs.
+ */
+
+#ifndef __KERN_H
+#define __KERN_H
+
+/*************************************
+ * @name Includes and definitions
+ */
+
+#include "err.h"
+#include <stdint.h>
+
+/* @brief Tick rate in Hz
+ */
+#define KERN_TICK_HZ 1000
+
+/* @brief Maximum number of tasks, one per priority.
+ * Priority 0 is reserved for the idle task.
+ */
+#define KERN_TASK_MAX 8
+
+/* @brief Idle task stack size in words
+ */
+#define KERN_IDLE_STACKSIZE 128
+
+/* @brief Wait values for the timeout parameters
+ */
+#define KERN_WAIT_NONE 0
+#define KERN_WAIT_FOREVER 0xFFFFFFFF
+
+/* @brief Fill value for unused stack, used to find the
+ * stack high-water mark
+ */
+#define KERN_STACK_PAINT 0xDEADBEEF
+
+/* @brief Task entry point type
+ */
+typedef void (*kern_entry_t)(void *arg);
+
+/* @brief Task states
+ */
+typedef enum kern_state_e {
+    KERN_STATE_UNUSED,
+    KERN_STATE_READY,
+    KERN_STATE_BLOCKED,
+    KERN_STATE_DEAD,
+} kern_state_t;
+
+/* @brief Task control block. The saved stack pointer
+ * must stay the first member, PendSV depends on it.
+ */
+typedef struct kern_task_s {
+    uint32_t *kern_task_sp;
+    uint32_t *kern_task_stack;
+    uint32_t kern_task_stackSize;
+    uint32_t kern_task_wake;
+    uint8_t kern_task_prio;
+    uint8_t kern_task_timed;
+    uint8_t kern_task_timedOut;
+    kern_state_t kern_task_state;
+    const char *kern_task_name;
+} kern_task_t;
+
+/* @brief Counting semaphore
+ */
+typedef struct kern_sem_s {
+    uint32_t kern_sem_count;
+    uint32_t kern_sem_max;
+    uint32_t kern_sem_waiters;
+} kern_sem_t;
+
+/* @brief Mutex, not recursive
+ */
+typedef struct kern_mutex_s {
+    kern_task_t *kern_mutex_owner;
+    uint32_t kern_mutex_waiters;
+} kern_mutex_t;
+
+/* @brief Message queue with caller supplied storage
+ */
+typedef struct kern_queue_s {
+    uint8_t *kern_queue_buf;
+    uint16_t kern_queue_itemSize;
+    uint16_t kern_queue_capacity;
+    uint16_t kern_queue_head;
+    uint16_t kern_queue_tail;
+    uint16_t kern_queue_size;
+    uint32_t kern_queue_getWaiters;
+    uint32_t kern_queue_putWaiters;
+} kern_queue_t;
+
+/**************************************
+ * @name Private functions
+ */
+
+#ifdef __KERN
+/** @brief Choose the next task to run
+ *
+ *  Called from PendSV with interrupts masked. Sets the
+ *  current task to the highest priority ready task.
+ */
+void kern_switch();
+
+/** @brief Request a context switch if needed
+ *
+ *  Pends PendSV if a higher priority task than the
+ *  current task is ready. Safe to call from interrupts.
+ */
+void kern_yield();
+
+/** @brief Block the current task on a wait list
+ *
+ *  Must be called with interrupts masked. The task is
+ *  added to the wait mask and removed from the ready set.
+ *  Interrupts are briefly unmasked to let the switch
+ *  happen and are masked again on return.
+ *
+ *  @param waiters the wait mask of the object
+ *  @param timeout ticks to wait or KERN_WAIT_FOREVER
+ *  @return KERN_INFO_OK or KERN_ERR_TIMEOUT
+ */
+kern_status_t kern_block(uint32_t *waiters, uint32_t timeout);
+
+/** @brief Wake the highest priority task on a wait list
+ *
+ *  Must be called with interrupts masked.
+ *
+ *  @param waiters the wait mask of the object
+ *  @return 1 if a task was woken, 0 otherwise
+ */
+uint8_t kern_wake(uint32_t *waiters);
+
+/** @brief Task exit trampoline
+ *
+ *  Task entry functions return here. The task is marked
+ *  dead and never scheduled again.
+ */
+void kern_taskExit();
+
+/** @brief Idle task
+ *
+ *  Runs when no other task is ready. Stops the tick until
+ *  the next timed wakeup and sleeps with WFI.
+ *
+ *  @param arg unused
+ */
+void kern_idle(void *arg);
+
+/** @brief PendSV handler, performs the context switch
+ */
+void PendSV_Handler(void);
+#endif
+
+/**************************************
+ * @name Public functions
+ */
+
+#ifdef __KERN
+/** @brief Initialize the kernel
+ *
+ *  Creates the idle task. Tasks should be created after
+ *  this call and before kern_Start().
+ *
+ *  @return a status code of the type kern_status_t
+ */
+kern_status_t kern_Init();
+
+/** @brief Create a task
+ *
+ *  The stack must be 8 byte aligned and is painted with
+ *  KERN_STACK_PAINT so its high-water mark can be found.
+ *
+ *  @param task the task control block
+ *  @param name task name for debugging
+ *  @param entry the task entry function
+ *  @param arg argument passed to the entry function
+ *  @param prio unique priority, 1 to KERN_TASK_MAX-1
+ *  @param stack the stack memory
+ *  @param stackSize the stack size in words
+ *  @return a status code of the type kern_status_t
+ */
+kern_status_t kern_TaskCreate(kern_task_t *task, const char *name, kern_entry_t entry,
+                              void *arg, uint8_t prio, uint32_t *stack, uint32_t stackSize);
+
+/** @brief Start the kernel
+ *
+ *  Starts the tick and switches to the highest priority
+ *  task. Does not return on success.
+ *
+ *  @return a status code of the type kern_status_t
+ */
+kern_status_t kern_Start();
+
+/** @brief Check if the kernel is running
+ *
+ *  @return 1 once kern_Start() has switched to a task
+ */
+uint8_t kern_Running();
+
+/** @brief Kernel tick handler
+ *
+ *  Called from SysTick_Handler. Wakes tasks with expired
+ *  timeouts.
+ */
+void kern_Tick();
+
+/** @brief Get the tick count
+ *
+ *  @return ticks since kern_Start()
+ */
+uint32_t kern_Ticks();
+
+/** @brief Get the current task
+ *
+ *  @return the current task or NULL before kern_Start()
+ */
+kern_task_t *kern_TaskSelf();
+
+/** @brief Find the stack high-water mark of a task
+ *
+ *  @param task the task to check
+ *  @return the deepest stack use seen in bytes
+ */
+uint32_t kern_TaskStackUsed(kern_task_t *task);
+
+/** @brief Block the current task for a number of ticks
+ *
+ *  @param ticks ticks to sleep
+ */
+void kern_Sleep(uint32_t ticks);
+
+/** @brief Initialize a semaphore
+ *
+ *  @param sem the semaphore
+ *  @param count initial count
+ *  @param max maximum count, 1 for a binary semaphore
+ *  @return a status code of the type kern_status_t
+ */
+kern_status_t kern_SemInit(kern_sem_t *sem, uint32_t count, uint32_t max);
+
+/** @brief Take a semaphore
+ *
+ *  @param sem the semaphore
+ *  @param timeout ticks to wait or KERN_WAIT_FOREVER
+ *  @return KERN_INFO_OK or KERN_ERR_TIMEOUT
+ */
+kern_status_t kern_SemTake(kern_sem_t *sem, uint32_t timeout);
+
+/** @brief Give a semaphore
+ *
+ *  Safe to call from interrupt handlers.
+ *
+ *  @param sem the semaphore
+ *  @return KERN_INFO_OK or KERN_WARN_SEMFULL
+ */
+kern_status_t kern_SemGive(kern_sem_t *sem);
+
+/** @brief Initialize a mutex
+ *
+ *  @param mutex the mutex
+ *  @return a status code of the type kern_status_t
+ */
+kern_status_t kern_MutexInit(kern_mutex_t *mutex);
+
+/** @brief Lock a mutex
+ *
+ *  Must not be called from interrupt handlers.
+ *
+ *  @param mutex the mutex
+ *  @param timeout ticks to wait or KERN_WAIT_FOREVER
+ *  @return KERN_INFO_OK or KERN_ERR_TIMEOUT
+ */
+kern_status_t kern_MutexLock(kern_mutex_t *mutex, uint32_t timeout);
+
+/** @brief Unlock a mutex
+ *
+ *  Ownership passes directly to the highest priority
+ *  waiter.
+ *
+ *  @param mutex the mutex
+ *  @return KERN_INFO_OK or KERN_ERR_OWNER
+ */
+kern_status_t kern_MutexUnlock(kern_mutex_t *mutex);
+
+/** @brief Initialize a queue
+ *
+ *  @param queue the queue
+ *  @param buf storage for capacity items
+ *  @param itemSize item size in bytes
+ *  @param capacity number of items
+ *  @return a status code of the type kern_status_t
+ */
+kern_status_t kern_QueueInit(kern_queue_t *queue, void *buf, uint16_t itemSize, uint16_t capacity);
+
+/** @brief Put an item in a queue
+ *
+ *  @param queue the queue
+ *  @param item the item to copy in
+ *  @param timeout ticks to wait or KERN_WAIT_FOREVER
+ *  @return KERN_INFO_OK or KERN_ERR_TIMEOUT
+ */
+kern_status_t kern_QueuePut(kern_queue_t *queue, const void *item, uint32_t timeout);
+
+/** @brief Put an item in a queue from an interrupt
+ *
+ *  @param queue the queue
+ *  @param item the item to copy in
+ *  @return KERN_INFO_OK or KERN_ERR_QUEUEFULL
+ */
+kern_status_t kern_QueuePutIsr(kern_queue_t *queue, const void *item);
+
+/** @brief Get an item from a queue
+ *
+ *  @param queue the queue
+ *  @param item the location to copy the item to
+ *  @param timeout ticks to wait or KERN_WAIT_FOREVER
+ *  @return KERN_INFO_OK or KERN_ERR_TIMEOUT
+ */
+kern_status_t kern_QueueGet(kern_queue_t *queue, void *item, uint32_t timeout);
+#endif
+
+# endif /* __KERN_H */
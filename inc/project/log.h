@@ -27,6 +27,12 @@
 #define LOG_MAXDATASIZE 16777216
 #define LOG_BAUDRATE 115200//921600
 
+/* @brief Timeout for one byte to leave the UART, in
+ * microseconds, and the gap inserted every 100 data bytes
+ */
+#define LOG_TX_TIMEOUT_US 1000
+#define LOG_DATA_GAP_US 50
+
 /** @brief Type for log packets
  */
 typedef struct __attribute__ ((packed)) log_packet_s {
@@ -102,10 +108,21 @@ log_status_t log_log4(mod_t module, gen_status_t status, uint32_t len, uint8_t *
  */
 log_status_t log_log5(mod_t module, gen_status_t status, char *msg, uint32_t len, uint8_t *data);
 
+/** @brief Send one byte over the UART.
+ *
+ *  Waits for the transmit register to empty, up to
+ *  LOG_TX_TIMEOUT_US.
+ *
+ *  @param byte the byte to send
+ *  @return LOG_INFO_OK or LOG_ERR_TIMEOUT
+ */
+log_status_t log_sendByte(uint8_t byte);
+
 /** @brief Log send command.
  *
  *  This function sends the specified command packet with 
- *  the underlying UART configuration.
+ *  the underlying UART configuration. The rest of the
+ *  packet is dropped if the UART times out.
  *
  *  @param log_packet the log packet to send
  *  @return return code with type log_status_t
@@ -0,0 +1,112 @@
+/** @file lz.h
+ *  @brief Function prototypes for the LZ compressor.
+ *
+ *  This contains the prototypes, macros, constants,
+ *  and global variables for the lossless compressor used
+ *  on bulk payloads before they are sent.
+ *
+ *  The output is an LZ4 block: runs of literals, each
+ *  followed by a match of at least four bytes up to 64K
+ *  back. Matches are found through a hash table of recent
+ *  positions in core coupled RAM, one candidate a slot,
+ *  so it is fast rather than thorough.
+ *
+ *  @author Ben Heberlein
+ *  @bug No known bugs.
+ */
+
+#ifndef __LZ_H
+#define __LZ_H
+
+/*************************************
+ * @name Includes and definitions
+ */
+
+#include "err.h"
+#include "mod.h"
+#include <stdint.h>
+
+/* @brief Hash table size in bits, two bytes a slot
+ */
+#define LZ_HASH_BITS 12
+
+/* @brief Block format limits. The last match starts 12
+ * bytes before the end and the last 5 bytes are
+ * literals.
+ */
+#define LZ_MINMATCH 4
+#define LZ_LASTLITERALS 5
+#define LZ_MFLIMIT 12
+#define LZ_MAXDIST 0xFFFF
+
+/* @brief Largest output for an input size, when nothing
+ * matches
+ */
+#define LZ_BOUND(size) ((size) + (size)/255 + 16)
+
+/* @brief Compressed packet header, followed by the
+ * block. The host unpacks it into the packet it stands
+ * for.
+ */
+typedef struct __attribute__ ((packed)) lz_header_s {
+    uint8_t lz_header_module;
+    uint8_t lz_header_status;
+    uint32_t lz_header_size;
+} lz_header_t;
+
+/* @brief Sizes before and after, for the benchmark
+ */
+typedef struct __attribute__ ((packed)) lz_ratio_s {
+    uint32_t lz_ratio_raw;
+    uint32_t lz_ratio_packed;
+} lz_ratio_t;
+
+/**************************************
+ * @name Private functions
+ */
+
+/** @brief Write a literal or match length past the 15
+ *  that fits in the token
+ *
+ *  @param dst where to write
+ *  @param len the length less 15
+ *  @return the byte after the last one written
+ */
+uint8_t *lz_putLength(uint8_t *dst, uint32_t len);
+
+/**************************************
+ * @name Public functions
+ */
+
+/** @brief Compress a block
+ *
+ *  One caller at a time, the hash table is shared. A dst
+ *  of LZ_BOUND() bytes always fits.
+ *
+ *  @param dst where to put the LZ4 block
+ *  @param max bytes at dst
+ *  @param len set to the block size
+ *  @param src the data to compress
+ *  @param size bytes to compress
+ *  @return a status code of the type lz_status_t
+ */
+lz_status_t lz_Compress(void *dst, uint32_t max, uint32_t *len,
+                        const void *src, uint32_t size);
+
+/** @brief Send a payload compressed
+ *
+ *  Compresses the payload into an SDRAM frame slot and
+ *  sends it in an LZ_INFO_PACKET packet, which the host
+ *  turns back into a packet from module with status. If
+ *  there is no free slot or the payload doesn't shrink,
+ *  it is sent as it is and LZ_WARN_RAW is returned.
+ *
+ *  @param module the module the payload is from
+ *  @param status its status
+ *  @param len bytes in the payload
+ *  @param data the payload
+ *  @return a status code of the type lz_status_t
+ */
+lz_status_t lz_Send(mod_t module, gen_status_t status, uint32_t len, uint8_t *data);
+
+# endif /* __LZ_H */
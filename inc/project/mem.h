@@ -0,0 +1,139 @@
+/** @file mem.h
+ *  @brief Function prototypes for the memory monitor.
+ *
+ *  This contains the prototypes, macros, constants,
+ *  and global variables for the memory monitor. The
+ *  reserved main stack is painted at startup so its
+ *  high-water mark can be measured. Heap allocations go
+ *  through mem_Malloc() and mem_Free(), which keep the
+ *  current and peak heap use and count failures.
+ *
+ *  Kernel task stacks are painted by the kernel and
+ *  measured with kern_TaskStackUsed().
+ *
+ *  @author Ben Heberlein
+ *  @bug Allocations made directly with malloc(), for
+ *  example inside newlib, are not counted.
+ */
+
+#ifndef __MEM_H
+#define __MEM_H
+
+/*************************************
+ * @name Includes and definitions
+ */
+
+#include "err.h"
+#include <stdint.h>
+#include <stddef.h>
+
+/* @brief Fill value for the unused main stack
+ */
+#define MEM_STACK_PAINT 0xC0DEC0DE
+
+/* @brief Bytes below the stack pointer left unpainted,
+ * covers the frame of mem_Init() itself
+ */
+#define MEM_STACK_MARGIN 64
+
+/* @brief Allocation header, keeps 8 byte alignment
+ */
+#define MEM_HEADER_SIZE 8
+
+/* @brief Placement in the linker script sections.
+ *
+ * CCM RAM is zero wait and no DMA or SDRAM traffic
+ * contends for it, but the DMA can't reach it either, so
+ * it only holds hot data no stream touches. MEM_CCM is
+ * zeroed at startup, MEM_CCMDATA keeps its initializer.
+ *
+ * MEM_SDRAM is zeroed by sdram_Init(), it is unusable
+ * before that.
+ *
+ * MEM_RAMFUNC code is copied to SRAM at startup and runs
+ * clear of the flash wait states. Calls between it and
+ * flash go through linker veneers, so keep what it calls
+ * small or in SRAM too.
+ */
+#define MEM_CCM __attribute__ ((section (".ccmram_bss")))
+#define MEM_CCMDATA __attribute__ ((section (".ccmram")))
+#define MEM_SDRAM __attribute__ ((section (".sdram_bss")))
+#define MEM_RAMFUNC __attribute__ ((section (".ramfunc"), noinline))
+
+/* @brief Memory report, also the wire format
+ */
+typedef struct __attribute__ ((packed)) mem_report_s {
+    uint32_t mem_report_heapCurrent;
+    uint32_t mem_report_heapPeak;
+    uint32_t mem_report_heapReserved;
+    uint32_t mem_report_heapArena;
+    uint32_t mem_report_allocs;
+    uint32_t mem_report_frees;
+    uint32_t mem_report_failures;
+    uint32_t mem_report_stackUsed;
+    uint32_t mem_report_stackReserved;
+} mem_report_t;
+
+/**************************************
+ * @name Private functions
+ */
+
+/** @brief Measure the main stack high-water mark
+ *
+ *  Scans up from the bottom of the reserved stack for
+ *  the first word that isn't paint.
+ *
+ *  @return the deepest stack use seen in bytes
+ */
+uint32_t mem_stackUsed();
+
+/**************************************
+ * @name Public functions
+ */
+
+/** @brief Initialize the memory monitor
+ *
+ *  Paints the reserved main stack below the current
+ *  stack pointer. Call this first in main().
+ *
+ *  @return a status code of the type mem_status_t
+ */
+mem_status_t mem_Init();
+
+/** @brief Allocate memory
+ *
+ *  A counting wrapper for malloc(). Safe to call from
+ *  interrupt handlers, the allocator runs with
+ *  interrupts masked.
+ *
+ *  @param size bytes to allocate
+ *  @return the memory or NULL on failure
+ */
+void *mem_Malloc(size_t size);
+
+/** @brief Free memory from mem_Malloc()
+ *
+ *  Safe to call from interrupt handlers. NULL is
+ *  ignored.
+ *
+ *  @param ptr the memory to free
+ */
+void mem_Free(void *ptr);
+
+/** @brief Get a copy of the memory statistics
+ *
+ *  @param report the report to fill
+ *  @return MEM_INFO_OK, or MEM_WARN_STACK if the stack
+ *  has grown past its reservation
+ */
+mem_status_t mem_ReportGet(mem_report_t *report);
+
+/** @brief Send the memory statistics to the host
+ *
+ *  Logs a MEM_INFO_REPORT packet with a mem_report_t.
+ *
+ *  @return a status code of the type mem_status_t
+ */
+mem_status_t mem_Report();
+
+# endif /* __MEM_H */
@@ -29,6 +29,15 @@ typedef enum mod_e {
     CAM,
     ESP8266,
     WIFI,
+    SCHED,
+    KERN,
+    TICK,
+    TRACE,
+    MON,
+    MEM,
+    IMG,
+    JPEG,
+    LZ,
 } mod_t;
 
 # endif /* __MOD_H */
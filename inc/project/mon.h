@@ -0,0 +1,236 @@
+/** @file mon.h
+ *  @brief Function prototypes for the interrupt and DMA monitor.
+ *
+ *  This contains the prototypes, macros, constants,
+ *  and global variables for the monitor. Instrumented
+ *  interrupt handlers count their entries and time
+ *  themselves with the DWT cycle counter, and the
+ *  deepest interrupt nesting seen on entry is kept per
+ *  handler. DMA streams count completed bytes and
+ *  transfer, FIFO, and direct mode errors.
+ *
+ *  The statistics are sent on request, or periodically
+ *  as telemetry paced by TIM6. Times include any nested
+ *  interrupts that preempted the handler.
+ *
+ *  The monitor is compiled in with the __MON directive.
+ *
+ *  @author Ben Heberlein
+ *  @bug No known bugs.
+ */
+
+#ifndef __MON_H
+#define __MON_H
+
+/*************************************
+ * @name Includes and definitions
+ */
+
+#include "err.h"
+#include <stdint.h>
+
+#ifdef __MON
+#include "stm32f4xx.h"
+
+/* @brief Telemetry period in milliseconds, at most 6553
+ */
+#define MON_TELEMETRY_MS 1000
+
+/* @brief Telemetry timer priority, below the camera and
+ * command interrupts
+ */
+#define MON_NVIC_PRIO 3
+#endif
+
+/* @brief Monitored interrupt handlers
+ * KEEP IN SYNC WITH host.py
+ */
+typedef enum mon_irq_e {
+    MON_IRQ_USART2,
+    MON_IRQ_DCMI,
+    MON_IRQ_DMA2_STREAM1,
+    MON_IRQ_TIM5,
+    MON_IRQ_DMA2_STREAM0,
+    MON_IRQ_DMA2D,
+    MON_IRQ_NUM,
+} mon_irq_t;
+
+/* @brief Monitored DMA streams
+ * KEEP IN SYNC WITH host.py
+ */
+typedef enum mon_dma_e {
+    MON_DMA_DCMI,
+    MON_DMA_COPY,
+    MON_DMA_DMA2D,
+    MON_DMA_NUM,
+} mon_dma_t;
+
+/* @brief DMA error types
+ */
+typedef enum mon_dmaErr_e {
+    MON_DMAERR_TRANSFER,
+    MON_DMAERR_FIFO,
+    MON_DMAERR_DIRECT,
+} mon_dmaErr_t;
+
+/* @brief Interrupt handler statistics
+ */
+typedef struct __attribute__ ((packed)) mon_irqStats_s {
+    uint32_t mon_irqStats_count;
+    uint64_t mon_irqStats_total;
+    uint32_t mon_irqStats_max;
+    uint8_t mon_irqStats_nesting;
+} mon_irqStats_t;
+
+/* @brief DMA stream statistics
+ */
+typedef struct __attribute__ ((packed)) mon_dmaStats_s {
+    uint64_t mon_dmaStats_bytes;
+    uint32_t mon_dmaStats_transfers;
+    uint32_t mon_dmaStats_errTransfer;
+    uint32_t mon_dmaStats_errFifo;
+    uint32_t mon_dmaStats_errDirect;
+} mon_dmaStats_t;
+
+/* @brief Statistics packet, header followed by every
+ * interrupt and then every DMA stream
+ */
+typedef struct __attribute__ ((packed)) mon_report_s {
+    uint32_t mon_report_coreHz;
+    uint64_t mon_report_uptime;
+    uint8_t mon_report_irqs;
+    uint8_t mon_report_dmas;
+    mon_irqStats_t mon_report_irq[MON_IRQ_NUM];
+    mon_dmaStats_t mon_report_dma[MON_DMA_NUM];
+} mon_report_t;
+
+/**************************************
+ * @name Private functions
+ */
+
+#ifdef __MON
+/** @brief Count an interrupt handler entry
+ *
+ *  @param irq the handler being entered
+ *  @return the cycle count on entry
+ */
+uint32_t mon_irqEnter(mon_irq_t irq);
+
+/** @brief Time an interrupt handler on exit
+ *
+ *  @param irq the handler being left
+ *  @param start the cycle count returned on entry
+ */
+void mon_irqExit(mon_irq_t irq, uint32_t start);
+
+/** @brief Copy the statistics into a report
+ *
+ *  @param report the report to fill
+ */
+void mon_snapshot(mon_report_t *report);
+
+/** @brief Telemetry task, sends one report
+ *
+ *  @param arg unused
+ */
+void mon_telemetryTask(void *arg);
+
+/** @brief TIM6 handler, posts the telemetry task
+ */
+void TIM6_DAC_IRQHandler(void);
+#endif
+
+/**************************************
+ * @name Public functions
+ */
+
+#ifdef __MON
+/** @brief Initialize the monitor
+ *
+ *  Starts the DWT cycle counter if the profiler hasn't
+ *  and sets up TIM6 for telemetry.
+ *
+ *  @return a status code of the type mon_status_t
+ */
+mon_status_t mon_Init();
+
+/** @brief Count bytes moved by a DMA stream
+ *
+ *  Safe to call from interrupt handlers.
+ *
+ *  @param dma the stream
+ *  @param bytes bytes moved by the completed transfer
+ */
+void mon_DmaComplete(mon_dma_t dma, uint32_t bytes);
+
+/** @brief Count a DMA stream error
+ *
+ *  Safe to call from interrupt handlers.
+ *
+ *  @param dma the stream
+ *  @param err the error type
+ */
+void mon_DmaError(mon_dma_t dma, mon_dmaErr_t err);
+
+/** @brief Get a copy of the statistics
+ *
+ *  @param report the report to fill
+ *  @return a status code of the type mon_status_t
+ */
+mon_status_t mon_StatsGet(mon_report_t *report);
+
+/** @brief Send the statistics to the host
+ *
+ *  Logs a MON_INFO_STATS packet with a mon_report_t.
+ *
+ *  @return a status code of the type mon_status_t
+ */
+mon_status_t mon_Stats();
+
+/** @brief Clear the statistics
+ *
+ *  @return a status code of the type mon_status_t
+ */
+mon_status_t mon_Reset();
+
+/** @brief Start periodic telemetry
+ *
+ *  A MON_INFO_TELEMETRY packet with a mon_report_t is
+ *  sent every MON_TELEMETRY_MS from a background task.
+ *
+ *  @return a status code of the type mon_status_t
+ */
+mon_status_t mon_TelemetryStart();
+
+/** @brief Stop periodic telemetry
+ *
+ *  @return a status code of the type mon_status_t
+ */
+mon_status_t mon_TelemetryStop();
+#endif
+
+/** @brief Interrupt handler macros
+ *
+ *  Put mon_IrqEnter() at the top of a handler and
+ *  mon_IrqExit() before it returns. The entry cycle count
+ *  is kept in a local. These compile to nothing without
+ *  __MON.
+ *
+ *  Example usage:
+ *      void DCMI_IRQHandler() {
+ *          mon_IrqEnter(MON_IRQ_DCMI);
+ *          ...
+ *          mon_IrqExit(MON_IRQ_DCMI);
+ *      }
+ *
+ *  @param irq a mon_irq_t value
+ */
+#ifdef __MON
+#define mon_IrqEnter(irq) uint32_t mon_irqStart = mon_irqEnter(irq)
+#define mon_IrqExit(irq) mon_irqExit(irq, mon_irqStart)
+#else
+#define mon_IrqEnter(irq)
+#define mon_IrqExit(irq)
+#endif
+
+# endif /* __MON_H */
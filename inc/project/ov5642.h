@@ -30,6 +30,11 @@
  */
 #define OV5642_IMAGE_BUFSIZE 65535
 
+/* @brief DMA buffer size in words, DCMI data is read a
+ * word at a time
+ */
+#define OV5642_DMA_BUFSIZE ((OV5642_IMAGE_BUFSIZE)/4)
+
 /* @brief I2C clock speed
  */
 #define OV5642_I2C2_SPEED 100000
@@ -39,9 +44,15 @@
 #define OV5642_I2C2_ACK 1
 #define OV5642_I2C2_NACK 0
 
-/* @brief I2C timeout
+/* @brief I2C timeout in microseconds, several byte times
+ * at the I2C clock speed
+ */
+#define OV5642_I2C2_TIMEOUT_US 2000
+
+/* @brief DMA stream disable timeout in microseconds, the
+ * stream finishes its current burst first
  */
-#define OV5642_I2C2_TIMEOUT 0x4000
+#define OV5642_DMA_TIMEOUT_US 100
 
 /* @brief OV5642 read and write addresses
  */
@@ -75,6 +86,18 @@ ov5642_status_t ov5642_clockInit();
  */
 ov5642_status_t ov5642_dmaInit();
 
+/** @brief Point the DMA stream at a new buffer
+ *
+ *  The stream has to be off to take a new memory
+ *  address, so this turns it off, sets the address and
+ *  count, and turns it back on.
+ *
+ *  @param addr the buffer, at least OV5642_IMAGE_BUFSIZE
+ *  bytes
+ *  @return a status code of the type ov5642_status_t
+ */
+ov5642_status_t ov5642_dmaTarget(uint32_t addr);
+
 /** @brief Initialize the DCMI module
  *
  *  This function initializes and configures DCMI. The 
@@ -201,6 +224,15 @@ ov5642_status_t ov5642_regWriteArray(const ov5642_reg_t *reg);
  */ 
 void DCMI_IRQHandler();
 
+#ifdef __MON
+/** @brief DCMI DMA stream interrupt handler
+ *
+ *  Counts bytes for each completed buffer and counts
+ *  stream errors for the monitor.
+ */
+void DMA2_Stream1_IRQHandler();
+#endif
+
 /**************************************
  * @name Public functions
  */
@@ -231,9 +263,10 @@ ov5642_status_t ov5642_Configure();
  *  image, and transfers the image to SDRAM using DMA and 
  *  DCMI functionality.
  *
+ *  @param addr the SDRAM buffer for the image
  *  @return a status code of the type ov5642_status_t
  */
-ov5642_status_t ov5642_Capture();
+ov5642_status_t ov5642_Capture(uint32_t addr);
 
 /** @brief Transfer an image from SDRAM to the host.
  *
@@ -242,8 +275,9 @@ ov5642_status_t ov5642_Capture();
  *  will not work if the logger is disabled (directive 
  *  __LOG needs to be on).
  *
+ *  @param addr the SDRAM buffer holding the image
  *  @return a status code of the type ov5642_status_t
  */
-ov5642_status_t ov5642_Transfer();
+ov5642_status_t ov5642_Transfer(uint32_t addr);
 
 # endif /* __OV5642_H */
@@ -30,6 +30,11 @@
  */
 #define OV7670_IMAGE_BUFSIZE 320*240*2
 
+/* @brief DMA buffer size in words, DCMI data is read a
+ * word at a time
+ */
+#define OV7670_DMA_BUFSIZE ((OV7670_IMAGE_BUFSIZE)/4)
+
 /* @brief I2C clock speed
  */
 #define OV7670_I2C2_SPEED 100000
@@ -39,9 +44,19 @@
 #define OV7670_I2C2_ACK 1
 #define OV7670_I2C2_NACK 0
 
-/* @brief I2C timeout
+/* @brief I2C timeout in microseconds, several byte times
+ * at the I2C clock speed
+ */
+#define OV7670_I2C2_TIMEOUT_US 2000
+
+/* @brief DMA stream disable timeout in microseconds, the
+ * stream finishes its current burst first
  */
-#define OV7670_I2C2_TIMEOUT 0x4000
+#define OV7670_DMA_TIMEOUT_US 100
+
+/* @brief Delay between register writes in microseconds
+ */
+#define OV7670_REG_DELAY_US 400
 
 /* @brief OV7670 read and write addresses
  */
@@ -75,6 +90,18 @@ ov7670_status_t ov7670_clockInit();
  */
 ov7670_status_t ov7670_dmaInit();
 
+/** @brief Point the DMA stream at a new buffer
+ *
+ *  The stream has to be off to take a new memory
+ *  address, so this turns it off, sets the address and
+ *  count, and turns it back on.
+ *
+ *  @param addr the buffer, at least OV7670_IMAGE_BUFSIZE
+ *  bytes
+ *  @return a status code of the type ov7670_status_t
+ */
+ov7670_status_t ov7670_dmaTarget(uint32_t addr);
+
 /** @brief Initialize the DCMI module
  *
  *  This function initializes and configures DCMI. The 
@@ -201,6 +228,15 @@ ov7670_status_t ov7670_regWriteArray(const ov7670_reg_t *reg);
  */ 
 void DCMI_IRQHandler();
 
+#ifdef __MON
+/** @brief DCMI DMA stream interrupt handler
+ *
+ *  Counts bytes for each completed buffer and counts
+ *  stream errors for the monitor.
+ */
+void DMA2_Stream1_IRQHandler();
+#endif
+
 /**************************************
  * @name Public functions
  */
@@ -231,9 +267,10 @@ ov7670_status_t ov7670_Configure();
  *  image, and transfers the image to SDRAM using DMA and 
  *  DCMI functionality.
  *
+ *  @param addr the SDRAM buffer for the image
  *  @return a status code of the type ov7670_status_t
  */
-ov7670_status_t ov7670_Capture();
+ov7670_status_t ov7670_Capture(uint32_t addr);
 
 /** @brief Transfer an image from SDRAM to the host.
  *
@@ -242,8 +279,9 @@ ov7670_status_t ov7670_Capture();
  *  will not work if the logger is disabled (directive 
  *  __LOG needs to be on).
  *
+ *  @param addr the SDRAM buffer holding the image
  *  @return a status code of the type ov7670_status_t
  */
-ov7670_status_t ov7670_Transfer();
+ov7670_status_t ov7670_Transfer(uint32_t addr);
 
 # endif /* __OV7670_H */
@@ -18,8 +18,8 @@
  *  @bug No known bugs.
  */
 
-#ifndef __OV5642_REGS_H
-#define __OV5642_REGS_H
+#ifndef __OV7670_REGS_H
+#define __OV7670_REGS_H
 /*************************************
  * @name Includes and definitions
  */
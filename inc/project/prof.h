@@ -2,10 +2,26 @@
  *  @brief Function prototypes for the profiler.
  *
  *  This contains the prototypes and macros for the
- *  profiler module.
+ *  profiler module. The profiler counts core cycles with
+ *  the DWT cycle counter. Profiled regions can nest up to
+ *  PROF_SCOPE_DEPTH deep, and each finished region is
+ *  stored as a raw sample in a RAM buffer. Samples are
+ *  only sent to the host by prof_Flush(), so profiling
+ *  does not touch the UART.
+ *
+ *  Named probes keep running statistics instead of raw
+ *  samples: count, min, max, sum, sum of squares, and a
+ *  log2 histogram of cycles. prof_Dump() sends every
+ *  probe to the host in one packet.
+ *
+ *  The sampling profiler reads the interrupted PC from
+ *  the exception frame at PROF_PC_HZ and counts each
+ *  address in a hash table. The host resolves addresses
+ *  against the ELF file to get a flat profile.
  *   
  *  @author Ben Heberlein
- *  @bug No known bugs.
+ *  @bug Under the kernel, a profiled region must not
+ *  block, since the scope stack is shared by all tasks.
  */
 
 #ifndef __PROF_H
@@ -18,57 +34,162 @@
 #include "err.h"
 #include <stdint.h>
 
+#ifdef __PROF
+#include "stm32f4xx.h"
+#include "tick.h"
+#include "trace.h"
+
+/* @brief Maximum nesting of profiled regions
+ */
+#define PROF_SCOPE_DEPTH 8
+
+/* @brief Number of samples kept until the next flush
+ */
+#define PROF_SAMPLE_CAP 256
+
+/* @brief Number of empty regions timed to find the
+ * profiler overhead
+ */
+#define PROF_CALIBRATE_RUNS 8
+
+/* @brief Number of log2 histogram bins. Bin n counts
+ * samples of 2^n to 2^(n+1)-1 cycles, bin 0 also counts 0.
+ */
+#define PROF_HIST_BINS 32
+
+/* @brief PC sampling rate in Hz and hash table size,
+ * which must be a power of two
+ */
+#define PROF_PC_HZ 10000
+#define PROF_PC_BUCKETS 512
+#define PROF_PC_BUCKETBITS 9
+
+/* @brief Slots tried before a sample is dropped
+ */
+#define PROF_PC_PROBES 8
+
+/* @brief PC sampling interrupt priority, highest so
+ * interrupt handlers are sampled too
+ */
+#define PROF_PC_NVIC_PRIO 0
+
+/* @brief Named probes
+ * KEEP IN SYNC WITH host.py
+ */
+typedef enum prof_probe_e {
+    PROF_PROBE_CAM_CAPTURE,
+    PROF_PROBE_CAM_TRANSFER,
+    PROF_PROBE_CMD_EXECUTE,
+    PROF_PROBE_SCCB_WRITE,
+    PROF_PROBE_LOG_SEND,
+    PROF_PROBE_USER0,
+    PROF_PROBE_USER1,
+    PROF_PROBE_NUM,
+} prof_probe_t;
+
+/* @brief Probe statistics, also the wire format
+ */
+typedef struct __attribute__ ((packed)) prof_stats_s {
+    uint32_t prof_stats_count;
+    uint32_t prof_stats_min;
+    uint32_t prof_stats_max;
+    uint64_t prof_stats_sum;
+    uint64_t prof_stats_sumsq;
+    uint32_t prof_stats_hist[PROF_HIST_BINS];
+} prof_stats_t;
+
+/* @brief Probe dump packet header
+ */
+typedef struct __attribute__ ((packed)) prof_dumpHeader_s {
+    uint32_t prof_dumpHeader_coreHz;
+    uint32_t prof_dumpHeader_overhead;
+    uint8_t prof_dumpHeader_probes;
+    uint8_t prof_dumpHeader_bins;
+} prof_dumpHeader_t;
+
+/* @brief PC histogram bucket, count 0 is empty
+ */
+typedef struct __attribute__ ((packed)) prof_pcBucket_s {
+    uint32_t prof_pcBucket_pc;
+    uint32_t prof_pcBucket_count;
+} prof_pcBucket_t;
+
+/* @brief PC histogram packet header
+ */
+typedef struct __attribute__ ((packed)) prof_pcHeader_s {
+    uint32_t prof_pcHeader_hz;
+    uint32_t prof_pcHeader_total;
+    uint32_t prof_pcHeader_dropped;
+    uint16_t prof_pcHeader_buckets;
+} prof_pcHeader_t;
+
+/* @brief Raw profiler sample
+ */
+typedef struct prof_sample_s {
+    const char *prof_sample_msg;
+    uint32_t prof_sample_cycles;
+    uint8_t prof_sample_depth;
+} prof_sample_t;
+
+/* @brief Sample data as sent to the host
+ */
+typedef struct __attribute__ ((packed)) prof_result_s {
+    uint32_t prof_result_cycles;
+    uint8_t prof_result_depth;
+} prof_result_t;
+#endif
+
 /**************************************
  * @name Private functions
  */
 
 #ifdef __PROF
-/** @brief Convert an integer to an ASCII representation
+/** @brief Begin a profiled region
  *
- *  Converts a positive integer to its ASCII string
- *  representation. Returns the string at the memory
- *  address str. The memory should be allocated on the 
- *  stack or heap before calling this function. A 
- *  maximum of 5 characters can be outputted (66535).
+ *  Pushes the current cycle count on the scope stack.
+ *  This is used by the main profiler macro. The counter
+ *  is read as the last step so bookkeeping isn't timed.
  *
- *  @param the string location to put the result.
- *  @param the integer to convert
- *  @return a status code of type prof_status_t.
+ *  @return PROF_INFO_OK or PROF_ERR_DEPTH if the scope
+ *  stack is full
  */
-prof_status_t prof_itoa(uint8_t *str, uint32_t data);
+prof_status_t prof_start();
 
-/** @brief Concatenate two null terminated strings.
- *
- *  The output buffer needs to be big enough to fit the
- *  concatenation with a null terminated string.
+/** @brief End a profiled region
  *
- *  The concatenation order is str1 + str2.
+ *  Pops the scope stack and stores a sample with the
+ *  elapsed cycles, minus the profiler overhead. The 
+ *  message is stored by pointer, so it must be a string
+ *  literal terminated with "\0" like the log messages.
  *
- *  @param buf the output buffer
- *  @param str1 the first string
- *  @param str2 the second string
+ *  @param msg the region name
+ *  @return a status code of type prof_status_t.
  */
-prof_status_t prof_concat(uint8_t *buf, uint8_t *str1, uint8_t *str2);
+prof_status_t prof_stop(char *msg);
 
-/** @brief Begin profiler
+/** @brief Reset the statistics of one probe
  *
- *  This function sets up the timer before profiling.
- *  This is used by the main profiler macro.
+ *  Interrupts must be masked by the caller.
  *
- *  @return a status code of type prof_status_t.
+ *  @param stats the probe statistics
  */
-prof_status_t prof_start();
+void prof_statsReset(prof_stats_t *stats);
 
-/** @brief End profiler.
+/** @brief Count one PC sample
  *
- *  This function stops the profiler timer and reports 
- *  the time taken. This can be called with a message
- *  that will be passed to the logger. This needs to
- *  be terminated with "\0" like the log messages.
+ *  Called from the TIM7 handler with the stack pointer
+ *  at the time of the interrupt.
  *
- *  @return a status code of type prof_status_t.
+ *  @param frame the exception frame, the PC is word 6
  */
-prof_status_t prof_stop();
+void prof_pcSample(uint32_t *frame);
+
+/** @brief TIM7 interrupt handler
+ *
+ *  Finds the active stack and passes the exception frame
+ *  to prof_pcSample().
+ */
+void TIM7_IRQHandler(void);
 #endif
 
 /**************************************
@@ -79,12 +200,90 @@ prof_status_t prof_stop();
 /** @brief Initialize profiler
  *
  *  This function initializes the profiler. It should
- *  be called before any profiler functions. The underlying
- *  timer is initialized in this function.
+ *  be called before any profiler functions. The DWT
+ *  cycle counter is started and the overheads of an
+ *  empty region and an empty probe are measured.
  *
  *  @return a status code of type prof_status_t
  */
 prof_status_t prof_Init();
+
+/** @brief Take the oldest sample from the buffer
+ *
+ *  @param sample the location to put the sample
+ *  @return PROF_INFO_OK or PROF_INFO_EMPTY
+ */
+prof_status_t prof_SampleGet(prof_sample_t *sample);
+
+/** @brief Send all buffered samples to the host
+ *
+ *  Each sample is logged as PROF_INFO_RESULTS with the
+ *  region name as the message and a prof_result_t as
+ *  data. Dropped samples are reported afterwards.
+ *
+ *  @return a status code of type prof_status_t
+ */
+prof_status_t prof_Flush();
+
+/** @brief Add a measurement to a probe
+ *
+ *  Safe to call from interrupt handlers. Use this
+ *  directly for regions that start and end in different
+ *  functions, like a capture that ends in an interrupt.
+ *  The overhead of an empty prof_Probe() is subtracted,
+ *  so the cycles should come from two TICK_CYCLES() reads.
+ *
+ *  @param probe the probe
+ *  @param cycles the measured cycles
+ *  @return PROF_INFO_OK or PROF_ERR_PROBE
+ */
+prof_status_t prof_Record(prof_probe_t probe, uint32_t cycles);
+
+/** @brief Get a copy of the statistics of a probe
+ *
+ *  @param probe the probe
+ *  @param stats the location to put the statistics
+ *  @return PROF_INFO_OK or PROF_ERR_PROBE
+ */
+prof_status_t prof_StatsGet(prof_probe_t probe, prof_stats_t *stats);
+
+/** @brief Send every probe to the host
+ *
+ *  Logs one PROF_INFO_STATS packet holding a
+ *  prof_dumpHeader_t followed by one prof_stats_t per
+ *  probe, in prof_probe_t order.
+ *
+ *  @return a status code of type prof_status_t
+ */
+prof_status_t prof_Dump();
+
+/** @brief Clear the statistics of every probe
+ *
+ *  @return a status code of type prof_status_t
+ */
+prof_status_t prof_Reset();
+
+/** @brief Clear the PC histogram and start sampling
+ *
+ *  @return a status code of type prof_status_t
+ */
+prof_status_t prof_SampleStart();
+
+/** @brief Stop PC sampling
+ *
+ *  @return a status code of type prof_status_t
+ */
+prof_status_t prof_SampleStop();
+
+/** @brief Send the PC histogram to the host
+ *
+ *  Logs one PROF_INFO_PCSAMPLES packet holding a
+ *  prof_pcHeader_t followed by every bucket. Sampling is
+ *  paused while sending.
+ *
+ *  @return a status code of type prof_status_t
+ */
+prof_status_t prof_SampleDump();
 #endif
 
 /** @brief The main profile function
@@ -96,7 +295,7 @@ prof_status_t prof_Init();
  *
  *  The macro just wraps the code segment under test with
  *  the prof_start() and prof_stop() function defined 
- *  earlier.
+ *  earlier. Calls may be nested.
  *
  *  Example usage:
  *      For a single function or statement
@@ -105,7 +304,7 @@ prof_status_t prof_Init();
  *      Several statements or functions
  *      prof_Profile(
  *          xxx_functionToProfile1();
- *          xxx_functionToProfile2();
+ *          prof_Profile(xxx_functionToProfile2(), "Inner\0");
  *          uint32_t someVariable = 100;
  *          // ...etc
  *          , "Benchmark identifier\0"
@@ -124,4 +323,32 @@ prof_status_t prof_Init();
 #define prof_Profile(x, msg) x;
 #endif
 
+/** @brief Profile code into a named probe
+ *
+ *  Like prof_Profile(), but the time is added to the
+ *  statistics of a probe instead of stored as a sample.
+ *  The start time is kept in a local variable, so this
+ *  may nest and may block under the kernel. The code runs
+ *  in its own block, so declarations in x are not visible
+ *  afterwards. With __TRACE the region is also recorded
+ *  as begin and end events.
+ *
+ *  Example usage:
+ *      prof_Probe(ret = xxx_regWrite(reg, val), PROF_PROBE_SCCB_WRITE);
+ *
+ *  @param x statements to execute
+ *  @param probe a prof_probe_t value
+ */
+#ifdef __PROF
+#define prof_Probe(x, probe) { \
+    trace_Begin(TRACE_CAT_PROBE, probe); \
+    uint32_t prof_probeStart = TICK_CYCLES(); \
+    x; \
+    prof_Record(probe, TICK_CYCLES() - prof_probeStart); \
+    trace_End(TRACE_CAT_PROBE, probe); \
+}
+#else
+#define prof_Probe(x, probe) { x; }
+#endif
+
 #endif /* __PROF_H */
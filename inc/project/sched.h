@@ -0,0 +1,140 @@
+/** @file sched.h
+ *  @brief Function prototypes for the task scheduler.
+ *
+ *  This contains the prototypes, macros, constants,
+ *  and global variables for the scheduler. The scheduler
+ *  is a cooperative, run-to-completion scheduler with one
+ *  ready queue per priority level. Host commands, deferred
+ *  interrupt work, and background jobs are all posted as
+ *  tasks. When every queue is empty the core sleeps with
+ *  WFI until the next interrupt.
+ *
+ *  @author Ben Heberlein
+ *  @bug No known bugs.
+ */
+
+#ifndef __SCHED_H
+#define __SCHED_H
+
+/*************************************
+ * @name Includes and definitions
+ */
+
+#include "err.h"
+#include <stdint.h>
+
+/* @brief Capacity of each ready queue
+ */
+#define SCHED_QUEUE_CAP 32
+
+/* @brief Task handler type, called with the argument
+ * given to sched_Post()
+ */
+typedef void (*sched_handler_t)(void *arg);
+
+/* @brief Task priorities, highest priority first
+ */
+typedef enum sched_prio_e {
+    SCHED_PRIO_ISR,
+    SCHED_PRIO_CMD,
+    SCHED_PRIO_BACKGROUND,
+    SCHED_PRIO_NUM,
+} sched_prio_t;
+
+/* @brief Task structure
+ */
+typedef struct sched_task_s {
+    sched_handler_t sched_task_handler;
+    void *sched_task_arg;
+} sched_task_t;
+
+/* @brief Ready queue structure
+ */
+typedef struct sched_queue_s {
+    sched_task_t sched_queue_buf[SCHED_QUEUE_CAP];
+    uint16_t sched_queue_head;
+    uint16_t sched_queue_tail;
+    uint16_t sched_queue_size;
+} sched_queue_t;
+
+/**************************************
+ * @name Private functions
+ */
+
+/** @brief Put a task in a ready queue
+ *
+ *  Interrupts must be masked by the caller.
+ *
+ *  @param queue the ready queue
+ *  @param handler the task handler
+ *  @param arg the task argument
+ *  @return a status code of the type sched_status_t
+ */
+sched_status_t sched_queuePut(sched_queue_t *queue, sched_handler_t handler, void *arg);
+
+/** @brief Get a task from the highest priority ready queue
+ *
+ *  Interrupts must be masked by the caller.
+ *
+ *  @param task the location to put the task
+ *  @return SCHED_INFO_OK or SCHED_INFO_IDLE if all
+ *  queues are empty
+ */
+sched_status_t sched_queueGet(sched_task_t *task);
+
+/** @brief Sleep until the next interrupt
+ *
+ *  Interrupts are masked while the queues are checked, so
+ *  a task posted by an interrupt just before the WFI
+ *  instruction still wakes the core. When the kernel is
+ *  running the scheduler is a kernel task, and it blocks
+ *  on a semaphore given by sched_Post() instead.
+ */
+void sched_idle();
+
+/**************************************
+ * @name Public functions
+ */
+
+/** @brief Initialize the scheduler
+ *
+ *  Empties every ready queue. The queues are statically
+ *  allocated, so tasks may be posted before this call.
+ *
+ *  @return a status code of the type sched_status_t
+ */
+sched_status_t sched_Init();
+
+/** @brief Post a task to a ready queue
+ *
+ *  This function is safe to call from interrupt handlers.
+ *  The handler will be called once from the main loop
+ *  with the given argument.
+ *
+ *  @param prio the priority of the task
+ *  @param handler the task handler
+ *  @param arg the argument passed to the handler
+ *  @return a status code of the type sched_status_t
+ */
+sched_status_t sched_Post(sched_prio_t prio, sched_handler_t handler, void *arg);
+
+/** @brief Run ready tasks until all queues are empty
+ *
+ *  Tasks are always taken from the highest priority
+ *  non-empty queue, so a high priority task posted while
+ *  a background task runs is executed next.
+ *
+ *  @return a status code of the type sched_status_t
+ */
+sched_status_t sched_Run();
+
+/** @brief The main scheduler loop
+ *
+ *  This function runs ready tasks and sleeps when there
+ *  is nothing to do. It only returns on error.
+ *
+ *  @return a status code of the type sched_status_t
+ */
+sched_status_t sched_Loop();
+
+# endif /* __SCHED_H */
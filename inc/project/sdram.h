@@ -22,15 +22,154 @@
 #include <stdint.h>
 #include "err.h"
 
-/* @brief SDRAM addresses
+/* @brief SDRAM addresses. The bank is the whole chip,
+ * the linker region starts a megabyte in.
  */
+#define SDRAM_BANKADDR 0xD0000000
+#define SDRAM_BANKSIZE 0x00800000
 #define SDRAM_BASEADDR 0xD0100000
-#define SDRAM_IMAGEADDR SDRAM_BASEADDR
+
+/* @brief Frame pool, the 4 MB SDRAM region in the linker
+ * script. Frame slots come first, then the scratch
+ * arenas.
+ */
+#define SDRAM_POOLADDR SDRAM_BASEADDR
+#define SDRAM_POOLSIZE 0x00400000
+
+/* @brief Frame slot classes. Small slots hold compressed
+ * frames and thumbnails, medium ones QVGA and large ones
+ * VGA at two bytes a pixel.
+ */
+#define SDRAM_SMALL_SIZE 0x00010000
+#define SDRAM_SMALL_NUM 8
+#define SDRAM_MEDIUM_SIZE 0x00028000
+#define SDRAM_MEDIUM_NUM 8
+#define SDRAM_LARGE_SIZE 0x00096000
+#define SDRAM_LARGE_NUM 2
+#define SDRAM_CLASS_NUM 3
+#define SDRAM_FRAME_NUM (SDRAM_SMALL_NUM + SDRAM_MEDIUM_NUM + SDRAM_LARGE_NUM)
+#define SDRAM_FRAMESIZE (SDRAM_SMALL_SIZE*SDRAM_SMALL_NUM + \
+                         SDRAM_MEDIUM_SIZE*SDRAM_MEDIUM_NUM + \
+                         SDRAM_LARGE_SIZE*SDRAM_LARGE_NUM)
+
+/* @brief Scratch arenas for processing, after the frames
+ */
+#define SDRAM_ARENAADDR (SDRAM_POOLADDR + SDRAM_FRAMESIZE)
+#define SDRAM_ARENA_SIZE 0x00080000
+#define SDRAM_ARENA_NUM 2
+
+/* @brief Frame and arena alignment, a DMA burst
+ */
+#define SDRAM_ALIGN 32
+
+/* @brief MEM_SDRAM data, the SDRAM_BSS region in the
+ * linker script. Zeroed by sdram_Init().
+ */
+#define SDRAM_BSSADDR 0xD0500000
+#define SDRAM_BSSSIZE 0x00100000
+
+/* @brief Scratch space for benchmarks and tests
+ */
+#define SDRAM_SCRATCHADDR 0xD0600000
+#define SDRAM_SCRATCHSIZE 0x00100000
+
+/* @brief Trace buffer, the last megabyte of SDRAM
+ */
+#define SDRAM_TRACEADDR 0xD0700000
+#define SDRAM_TRACESIZE 0x00100000
+
+/* @brief Copy engine, DMA2 stream 0 in memory to memory
+ * mode. The DCMI has stream 1.
+ */
+#define SDRAM_COPY_QUEUE 8
+#define SDRAM_COPY_NVIC_PRIO 2
+
+/* @brief Longest copy in one stream run, in items
+ */
+#define SDRAM_COPY_MAXITEMS 0xFFFF
+
+/* @brief sdram_CopyWait() timeout, a 4 MB copy with time
+ * to spare
+ */
+#define SDRAM_COPY_TIMEOUT_US 100000
+
+/* @brief Core coupled RAM, the DMA can't reach it
+ */
+#define SDRAM_CCMADDR CCMDATARAM_BASE
+#define SDRAM_CCMSIZE 0x00010000
+
+/* @brief Copy completion callback, called from the DMA
+ * interrupt
+ */
+typedef void (*sdram_callback_t)(sdram_status_t status, void *arg);
+
+/* @brief A queued copy
+ */
+typedef struct sdram_copy_s {
+    uint32_t sdram_copy_dst;
+    uint32_t sdram_copy_src;
+    uint32_t sdram_copy_size;
+    sdram_callback_t sdram_copy_callback;
+    void *sdram_copy_arg;
+} sdram_copy_t;
+
+/* @brief A frame slot handle. A slot is free when its
+ * count drops to zero.
+ */
+typedef struct sdram_frame_s {
+    uint32_t sdram_frame_addr;
+    uint32_t sdram_frame_size;
+    uint32_t sdram_frame_len;
+    uint8_t sdram_frame_class;
+    volatile uint8_t sdram_frame_refs;
+} sdram_frame_t;
 
 /**************************************
  * Private functions
  */
 
+/** @brief Set up the frame slots and arenas
+ *
+ *  Runs once, from the first pool call.
+ */
+void sdram_poolInit();
+
+/** @brief Set up DMA2 stream 0 for copies
+ *
+ *  @return a status code of the type sdram_status_t
+ */
+sdram_status_t sdram_copyInit();
+
+/** @brief Program the stream for the next piece of the
+ *  copy at the head of the queue
+ *
+ *  Words with four beat bursts when the addresses and
+ *  size allow, otherwise words or bytes. Call with
+ *  interrupts masked.
+ */
+void sdram_copyStart();
+
+/** @brief Finish the copy at the head of the queue
+ *
+ *  Calls its callback and starts the next copy.
+ *
+ *  @param status the status passed to the callback
+ */
+void sdram_copyFinish(sdram_status_t status);
+
+/** @brief Copy engine interrupt handler
+ */
+void DMA2_Stream0_IRQHandler();
+
+/** @brief Check for core coupled RAM
+ *
+ *  @param addr start of the block
+ *  @param size bytes in the block
+ *
+ *  @return 1 if any of the block is in core coupled RAM
+ */
+uint8_t sdram_inCcm(uint32_t addr, uint32_t size);
+
 /**************************************
  * Public functions
  */
@@ -50,9 +189,12 @@ sdram_status_t sdram_Init();
  *  This will write to the sdram at a specified address
  *  using the supplied buffer, address, and transfer size.
  *
+ *  The CPU copies a word at a time, use
+ *  sdram_CopyAsync() for large blocks.
+ *
  *  @param buf the buffer to read from
- *  @param addr the address to write to
- *  @param size size in bytes to write
+ *  @param addr the SDRAM address to write to
+ *  @param size size in bytes to write, a multiple of 4
  *  @return a status code of the type sdram_status_t
  */
 sdram_status_t sdram_write(uint32_t *buf, uint32_t addr, uint32_t size);
@@ -62,11 +204,109 @@ sdram_status_t sdram_write(uint32_t *buf, uint32_t addr, uint32_t size);
  *  This will read fram the sdram at a specified address
  *  with the supplied buffer, address, and transfer size.
  * 
+ *  The CPU copies a word at a time, use
+ *  sdram_CopyAsync() for large blocks.
+ *
  *  @param buf the buffer to write to
- *  @param addr the address to read from
- *  @param size size in bytes to read
+ *  @param addr the SDRAM address to read from
+ *  @param size size in bytes to read, a multiple of 4
  *  @return a status code of the type sdram_status_t
  */
 sdram_status_t sdram_read(uint32_t *buf, uint32_t addr, uint32_t size);
 
+/** @brief Queue a copy on the DMA
+ *
+ *  Copies between SDRAM and SRAM, or within either, in
+ *  the background. Copies run in the order they were
+ *  queued. The callback gets SDRAM_INFO_OK, or
+ *  SDRAM_ERR_DMA if the stream hit a bus error.
+ *
+ *  The DMA can't reach core coupled RAM, so a copy to or
+ *  from it is done by the CPU before this returns, and
+ *  its callback is called right away.
+ *
+ *  Don't touch either buffer until the callback.
+ *
+ *  @param dst where to copy to
+ *  @param src where to copy from
+ *  @param size bytes to copy
+ *  @param callback called when done, may be NULL
+ *  @param arg passed to the callback
+ *  @return a status code of the type sdram_status_t
+ */
+sdram_status_t sdram_CopyAsync(void *dst, const void *src, uint32_t size,
+                               sdram_callback_t callback, void *arg);
+
+/** @brief Check for queued copies
+ *
+ *  @return the number of copies not finished yet
+ */
+uint8_t sdram_CopyBusy();
+
+/** @brief Wait for every queued copy
+ *
+ *  @return a status code of the type sdram_status_t
+ */
+sdram_status_t sdram_CopyWait();
+
+/** @brief Allocate a frame slot
+ *
+ *  Takes a free slot from the smallest class that holds
+ *  the size. The handle starts with one reference. Safe
+ *  to call from an interrupt.
+ *
+ *  @param size bytes the frame needs
+ *  @return the handle, or NULL if no slot is free
+ */
+sdram_frame_t *sdram_FrameAlloc(uint32_t size);
+
+/** @brief Take another reference to a frame
+ *
+ *  Each holder, for example capture, processing, and
+ *  transfer, takes its own reference and releases it
+ *  when it is done.
+ *
+ *  @param frame the handle
+ *  @return a status code of the type sdram_status_t
+ */
+sdram_status_t sdram_FrameRetain(sdram_frame_t *frame);
+
+/** @brief Drop a reference to a frame
+ *
+ *  The slot goes back to the pool with the last
+ *  reference. Safe to call from an interrupt.
+ *
+ *  @param frame the handle
+ *  @return a status code of the type sdram_status_t
+ */
+sdram_status_t sdram_FrameRelease(sdram_frame_t *frame);
+
+/** @brief Count the free slots that hold a size
+ *
+ *  @param size bytes the frame needs
+ *  @return free slots in the class sdram_FrameAlloc()
+ *  would use, 0 if the size is too big
+ */
+uint8_t sdram_FrameAvailable(uint32_t size);
+
+/** @brief Allocate from a scratch arena
+ *
+ *  Arenas hand out memory in order and free it all at
+ *  once with sdram_ArenaReset(). Each arena belongs to
+ *  one user at a time.
+ *
+ *  @param arena the arena, less than SDRAM_ARENA_NUM
+ *  @param size bytes to allocate
+ *  @return SDRAM_ALIGN aligned memory, or NULL if the
+ *  arena is full
+ */
+void *sdram_ArenaAlloc(uint8_t arena, uint32_t size);
+
+/** @brief Free everything in a scratch arena
+ *
+ *  @param arena the arena, less than SDRAM_ARENA_NUM
+ *  @return a status code of the type sdram_status_t
+ */
+sdram_status_t sdram_ArenaReset(uint8_t arena);
+
 # endif /* __SDRAM_H */
@@ -0,0 +1,128 @@
+/** @file tick.h
+ *  @brief Function prototypes for the system time base.
+ *
+ *  This contains the prototypes, macros, constants,
+ *  and global variables for the time base. TIM5 is a
+ *  free running 32-bit counter at 1 MHz, and its update
+ *  interrupt extends it to a 64-bit microsecond count
+ *  that never wraps. TIM5 keeps counting while the core
+ *  sleeps in WFI.
+ *
+ *  Driver waits use deadlines from this module, so
+ *  timeouts do not change with compiler flags or clock
+ *  speed.
+ *
+ *  @author Ben Heberlein
+ *  @bug No known bugs.
+ */
+
+#ifndef __TICK_H
+#define __TICK_H
+
+/*************************************
+ * @name Includes and definitions
+ */
+
+#include "err.h"
+#include <stdint.h>
+
+/* @brief Time base frequency in Hz
+ */
+#define TICK_HZ 1000000
+
+/* @brief Time base interrupt priority
+ */
+#define TICK_NVIC_PRIO 1
+
+/* @brief Time base counter read
+ */
+#ifndef TICK_COUNT
+#define TICK_COUNT() (TIM5->CNT)
+#endif
+
+/* @brief Core cycle counter read, shared by the profiler,
+ * trace recorder, monitor and benchmarks
+ */
+#ifndef TICK_CYCLES
+#define TICK_CYCLES() (DWT->CYCCNT)
+#endif
+
+/**************************************
+ * @name Private functions
+ */
+
+/** @brief TIM5 interrupt handler
+ *
+ *  Counts TIM5 overflows for the upper 32 bits of the
+ *  time base.
+ */
+void TIM5_IRQHandler();
+
+/**************************************
+ * @name Public functions
+ */
+
+/** @brief Initialize the time base
+ *
+ *  This should be called before any other module, since
+ *  driver waits depend on it. Before initialization every
+ *  deadline has already expired, so waits fail instead of
+ *  hanging.
+ *
+ *  @return a status code of the type tick_status_t
+ */
+tick_status_t tick_Init();
+
+/** @brief Start the core cycle counter
+ *
+ *  Safe to call more than once. The counter is only
+ *  cleared the first time, so running deltas stay valid.
+ */
+void tick_CycleInit();
+
+/** @brief Get the APB1 timer clock
+ *
+ *  APB1 timers run at twice PCLK1 when APB1 is divided.
+ *
+ *  @return the timer clock in Hz
+ */
+uint32_t tick_TimerClock();
+
+/** @brief Get the time since tick_Init()
+ *
+ *  Safe to call from interrupt handlers.
+ *
+ *  @return the time in microseconds
+ */
+uint64_t tick_Now();
+
+/** @brief Make a deadline
+ *
+ *  @param us microseconds from now
+ *  @return the deadline for tick_Expired()
+ */
+uint64_t tick_Deadline(uint32_t us);
+
+/** @brief Check a deadline
+ *
+ *  @param deadline a deadline from tick_Deadline()
+ *  @return 1 if the deadline has passed, 0 otherwise
+ */
+uint8_t tick_Expired(uint64_t deadline);
+
+/** @brief Busy wait for a number of microseconds
+ *
+ *  @param us microseconds to wait
+ */
+void tick_DelayUs(uint32_t us);
+
+/** @brief Wait for a number of milliseconds
+ *
+ *  When the kernel is running a task sleeps instead of
+ *  busy waiting.
+ *
+ *  @param ms milliseconds to wait
+ */
+void tick_DelayMs(uint32_t ms);
+
+# endif /* __TICK_H */
@@ -0,0 +1,159 @@
+/** @file trace.h
+ *  @brief Function prototypes for the trace recorder.
+ *
+ *  This contains the prototypes, macros, constants,
+ *  and global variables for the trace recorder. Begin,
+ *  end, and instant events are stamped with the DWT cycle
+ *  counter and kept in a ring buffer in SDRAM, so the
+ *  newest events are always available. trace_Dump()
+ *  streams the buffer to the host, which converts it to
+ *  Chrome trace JSON.
+ *
+ *  Recording is compiled in with the __TRACE directive
+ *  and is off until trace_Start() is called.
+ *
+ *  @author Ben Heberlein
+ *  @bug The host unwraps the 32-bit cycle stamps, so gaps
+ *  of more than one counter period between events are
+ *  not timed correctly.
+ */
+
+#ifndef __TRACE_H
+#define __TRACE_H
+
+/*************************************
+ * @name Includes and definitions
+ */
+
+#include "err.h"
+#include "sdram.h"
+#include <stdint.h>
+
+#ifdef __TRACE
+#include "stm32f4xx.h"
+
+/* @brief Trace buffer location in SDRAM
+ */
+#define TRACE_ADDR SDRAM_TRACEADDR
+#define TRACE_CAP (SDRAM_TRACESIZE/sizeof(trace_event_t))
+
+/* @brief Events per data packet when dumping
+ */
+#define TRACE_DUMP_CHUNK 1024
+#endif
+
+/* @brief Event types
+ */
+typedef enum trace_type_e {
+    TRACE_TYPE_BEGIN,
+    TRACE_TYPE_END,
+    TRACE_TYPE_INSTANT,
+} trace_type_t;
+
+/* @brief Event categories, the id meaning depends on
+ * the category
+ * KEEP IN SYNC WITH host.py
+ */
+typedef enum trace_cat_e {
+    TRACE_CAT_PROBE,    // id is a prof_probe_t
+    TRACE_CAT_IRQ,      // id is an IRQn_Type
+    TRACE_CAT_CMD,      // id is module << 8 | function
+    TRACE_CAT_FRAME,    // id is 0
+    TRACE_CAT_MARK,     // id is user defined
+} trace_cat_t;
+
+/* @brief Trace event, also the wire format
+ */
+typedef struct __attribute__ ((packed)) trace_event_s {
+    uint32_t trace_event_cycles;
+    uint8_t trace_event_type;
+    uint8_t trace_event_cat;
+    uint16_t trace_event_id;
+} trace_event_t;
+
+/* @brief Trace dump header
+ */
+typedef struct __attribute__ ((packed)) trace_header_s {
+    uint32_t trace_header_coreHz;
+    uint32_t trace_header_count;
+    uint32_t trace_header_lost;
+} trace_header_t;
+
+/**************************************
+ * @name Private functions
+ */
+
+#ifdef __TRACE
+/** @brief Record an event
+ *
+ *  Safe to call from interrupt handlers. Does nothing
+ *  while recording is stopped.
+ *
+ *  @param type the event type
+ *  @param cat the event category
+ *  @param id the event id
+ */
+void trace_event(trace_type_t type, trace_cat_t cat, uint16_t id);
+#endif
+
+/**************************************
+ * @name Public functions
+ */
+
+#ifdef __TRACE
+/** @brief Initialize the trace recorder
+ *
+ *  SDRAM must be initialized first. Starts the DWT
+ *  cycle counter if the profiler hasn't.
+ *
+ *  @return a status code of the type trace_status_t
+ */
+trace_status_t trace_Init();
+
+/** @brief Clear the buffer and start recording
+ *
+ *  @return a status code of the type trace_status_t
+ */
+trace_status_t trace_Start();
+
+/** @brief Stop recording
+ *
+ *  @return a status code of the type trace_status_t
+ */
+trace_status_t trace_Stop();
+
+/** @brief Send the buffer to the host
+ *
+ *  Recording is paused while dumping. Logs a
+ *  TRACE_INFO_HEADER packet with a trace_header_t, then
+ *  TRACE_INFO_DATA packets of trace_event_t, oldest first,
+ *  then TRACE_INFO_END.
+ *
+ *  @return a status code of the type trace_status_t
+ */
+trace_status_t trace_Dump();
+#endif
+
+/** @brief Event macros
+ *
+ *  These compile to nothing without __TRACE.
+ *
+ *  Example usage:
+ *      trace_Begin(TRACE_CAT_IRQ, DCMI_IRQn);
+ *      ...
+ *      trace_End(TRACE_CAT_IRQ, DCMI_IRQn);
+ *
+ *  @param cat a trace_cat_t value
+ *  @param id the event id
+ */
+#ifdef __TRACE
+#define trace_Begin(cat, id) trace_event(TRACE_TYPE_BEGIN, cat, id)
+#define trace_End(cat, id) trace_event(TRACE_TYPE_END, cat, id)
+#define trace_Instant(cat, id) trace_event(TRACE_TYPE_INSTANT, cat, id)
+#else
+#define trace_Begin(cat, id)
+#define trace_End(cat, id)
+#define trace_Instant(cat, id)
+#endif
+
+# endif /* __TRACE_H */
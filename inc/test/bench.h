@@ -0,0 +1,129 @@
+/** @file bench.h
+ *  @brief Declarations for the benchmark framework.
+ *
+ *  Benchmarks are registered in the bench_suite table in
+ *  bench.c. Each one has a name, a function doing one run
+ *  of work, an optional setup function, and the amount of
+ *  work one run does in bytes or operations.
+ *
+ *  bench_Run() runs every benchmark a few times to warm
+ *  up, then times each repetition with the DWT cycle
+ *  counter. The minimum, maximum, and total cycles go back
+ *  to the host in one TEST_INFO_BENCH packet, which
+ *  host.py saves and compares against a baseline.
+ *
+ *  Make sure both __TEST and __LOG are defined in the
+ *  build system before using these functions.
+ *
+ *  @author Ben Heberlein
+ *  @bug No known bugs.
+ */
+
+#ifndef __BENCH_H
+#define __BENCH_H
+
+/*************************************
+ * Includes and definitions
+ */
+
+#include "err.h"
+#include <stdint.h>
+
+/* @brief Maximum name length, including the terminator
+ */
+#define BENCH_NAME_LEN 16
+
+/* @brief Default warmup runs and timed repetitions
+ */
+#define BENCH_WARMUP 2
+#define BENCH_REPS 16
+
+/* @brief SDRAM bandwidth buffer, in the scratch region
+ */
+#define BENCH_SDRAM_SIZE 0x00010000
+
+/* @brief Frame for the encoder benchmarks, the QVGA
+ * strips that fit in the SDRAM buffer
+ */
+#define BENCH_FRAME_WIDTH 320
+#define BENCH_FRAME_HEIGHT 96
+
+/* @brief Payload of one UART throughput run
+ */
+#define BENCH_UART_SIZE 256
+
+/* @brief Benchmark run and setup function type.
+ * Returns 0 on success, anything else skips the
+ * benchmark.
+ */
+typedef uint8_t (*bench_func_t)();
+
+/* @brief Units of work
+ * KEEP IN SYNC WITH host.py
+ */
+typedef enum bench_unit_e {
+    BENCH_UNIT_BYTES,
+    BENCH_UNIT_OPS,
+} bench_unit_t;
+
+/* @brief Registered benchmark
+ */
+typedef struct bench_bench_s {
+    const char *bench_name;
+    bench_func_t bench_setup;
+    bench_func_t bench_run;
+    bench_unit_t bench_unit;
+    uint32_t bench_work;
+    uint16_t bench_warmup;
+    uint16_t bench_reps;
+} bench_bench_t;
+
+/* @brief Benchmark result, also the wire format
+ */
+typedef struct __attribute__ ((packed)) bench_result_s {
+    char bench_result_name[BENCH_NAME_LEN];
+    uint8_t bench_result_unit;
+    uint8_t bench_result_skipped;
+    uint32_t bench_result_work;
+    uint32_t bench_result_reps;
+    uint32_t bench_result_min;
+    uint32_t bench_result_max;
+    uint64_t bench_result_sum;
+} bench_result_t;
+
+/* @brief Benchmark packet header, followed by count
+ * bench_result_t
+ */
+typedef struct __attribute__ ((packed)) bench_header_s {
+    uint32_t bench_header_coreHz;
+    uint8_t bench_header_count;
+} bench_header_t;
+
+/**************************************
+ * Private functions
+ */
+
+/** @brief Run one benchmark
+ *
+ *  @param bench the benchmark
+ *  @param result the location to put the result
+ *  @return TEST_INFO_OK, or TEST_WARN_SKIPPED if setup
+ *  or a run failed
+ */
+test_status_t bench_run(const bench_bench_t *bench, bench_result_t *result);
+
+/**************************************
+ * Public functions
+ */
+
+/** @brief Run every benchmark and send the results
+ *
+ *  Logs one TEST_INFO_BENCH packet with a bench_header_t
+ *  and a bench_result_t per benchmark. Skipped benchmarks
+ *  are still reported.
+ *
+ *  @return a status code of the type test_status_t
+ */
+test_status_t bench_Run();
+
+# endif /* __BENCH_H */
@@ -61,6 +61,62 @@ char *test_log_Log();
 test_status_t test_prof();
 char *test_prof_Init();
 char *test_prof_Profile();
+char *test_prof_Record();
+
+/** @brief scheduler functions
+ */
+test_status_t test_sched();
+char *test_sched_Post();
+char *test_sched_Run();
+
+/** @brief time base functions
+ */
+test_status_t test_tick();
+char *test_tick_Now();
+char *test_tick_Deadline();
+
+/** @brief memory monitor functions
+ */
+test_status_t test_mem();
+char *test_mem_Malloc();
+char *test_mem_Stack();
+char *test_mem_Sections();
+
+/** @brief monitor functions
+ */
+test_status_t test_mon();
+char *test_mon_Irq();
+char *test_mon_Dma();
+
+/** @brief SDRAM frame pool functions
+ */
+test_status_t test_sdram();
+char *test_sdram_Frame();
+char *test_sdram_Arena();
+char *test_sdram_Copy();
+
+/** @brief image processing functions
+ */
+test_status_t test_img();
+char *test_img_Luma();
+char *test_img_Rgb();
+char *test_img_Convert();
+char *test_img_Delta();
+char *test_img_Pyramid();
+char *test_img_Stats();
+char *test_img_Motion();
+
+/** @brief JPEG encoder functions
+ */
+test_status_t test_jpeg();
+char *test_jpeg_Encode();
+char *test_jpeg_Args();
+
+/** @brief LZ compressor functions
+ */
+test_status_t test_lz();
+char *test_lz_Compress();
+char *test_lz_Args();
 
 #ifdef __TEST
 /** @brief Asserts a condition within a test
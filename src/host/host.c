@@ -0,0 +1,218 @@
+/** @file host.c
+ *  @brief Implementation of the host build core.
+ *
+ *  This maps the register and SDRAM regions, presets the
+ *  clock registers, and emulates PRIMASK, WFI, and the
+ *  cycle counter for the host build.
+ *
+ *  @author Ben Heberlein
+ *  @bug No known bugs.
+ */
+
+/*************************************
+ * Includes and definitions
+ */
+
+#include "host.h"
+#include "stm32f4xx.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0x100000
+#endif
+
+/* @brief Memory regions the firmware expects at fixed
+ * addresses
+ */
+static const struct {
+    uintptr_t base;
+    size_t size;
+} host_regions[] = {
+    {0x40000000, 0x00080000},   // APB1, APB2, AHB1 peripherals
+    {0x42000000, 0x02000000},   // Bit-band alias, writes are lost
+    {0x50000000, 0x00070000},   // AHB2 peripherals, DCMI
+    {0xA0000000, 0x00001000},   // FMC registers
+    {0xD0000000, 0x00800000},   // SDRAM bank 2
+    {0xE0000000, 0x00100000},   // Core peripherals, DWT, NVIC
+};
+
+/* @brief Core clock, normally set by system_stm32f4xx.c
+ */
+uint32_t SystemCoreClock = HOST_CORE_HZ;
+
+/* @brief Main stack, _estack points at its end
+ */
+uint8_t host_stack[HOST_STACK_SIZE] __attribute__ ((aligned (8)));
+
+/* @brief PRIMASK lock, held while interrupts are masked
+ * or a handler runs
+ */
+static pthread_mutex_t host_irqLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t host_irqDone = PTHREAD_COND_INITIALIZER;
+
+/* @brief Per thread PRIMASK and handler flag
+ */
+static __thread uint32_t host_primask = 0;
+static __thread uint8_t host_inHandler = 0;
+
+/* @brief Heap the firmware holds, with allocator overhead
+ */
+static size_t host_heapUsed = 0;
+
+/* @brief Process start time
+ */
+static struct timespec host_start;
+
+/**************************************
+ * Private functions
+ */
+
+void host_mapRegions() {
+    for (uint8_t r = 0; r < sizeof(host_regions)/sizeof(host_regions[0]); r++) {
+        void *p = mmap((void *) host_regions[r].base, host_regions[r].size,
+                       PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+        if (p != (void *) host_regions[r].base) {
+            fprintf(stderr, "host: could not map 0x%08lx\n", (unsigned long) host_regions[r].base);
+            exit(1);
+        }
+    }
+}
+
+void host_clockInit() {
+    // 8 MHz HSE, PLL to 168 MHz, APB1 /4, APB2 /2
+    RCC->PLLCFGR = RCC_PLLCFGR_PLLSRC_HSE | (336 << 6) | 8;
+    RCC->CFGR = RCC_CFGR_SWS_PLL | RCC_CFGR_PPRE1_DIV4 | RCC_CFGR_PPRE2_DIV2;
+    RCC->CR = RCC_CR_HSERDY | RCC_CR_HSIRDY | RCC_CR_PLLRDY;
+}
+
+/* Runs before main(), the firmware touches registers
+ * from its first line */
+__attribute__ ((constructor)) void host_init() {
+    clock_gettime(CLOCK_MONOTONIC, &host_start);
+
+    // Stream the log as it is written
+    setvbuf(stdout, NULL, _IONBF, 0);
+
+    host_mapRegions();
+    host_clockInit();
+    host_UsartInit();
+    host_SimInit();
+}
+
+/**************************************
+ * Public functions
+ */
+
+void host_IrqDisable() {
+    if (host_primask == 0) {
+        pthread_mutex_lock(&host_irqLock);
+        host_primask = 1;
+    }
+}
+
+void host_IrqEnable() {
+    if (host_primask == 1 && host_inHandler == 0) {
+        host_primask = 0;
+        pthread_mutex_unlock(&host_irqLock);
+    }
+}
+
+uint32_t host_PrimaskGet() {
+    return host_primask;
+}
+
+void host_PrimaskSet(uint32_t primask) {
+    if (primask & 1) {
+        host_IrqDisable();
+    } else {
+        host_IrqEnable();
+    }
+}
+
+uint32_t host_IpsrGet() {
+    return host_inHandler;
+}
+
+uint32_t host_MspGet() {
+    return (uint32_t) (uintptr_t) (host_stack + HOST_STACK_SIZE - HOST_STACK_USED);
+}
+
+void host_Wfi() {
+    struct timespec until;
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_nsec += HOST_WFI_US*1000;
+    if (until.tv_nsec >= 1000000000) {
+        until.tv_sec++;
+        until.tv_nsec -= 1000000000;
+    }
+
+    // Waiting drops the lock, so handlers run while masked
+    if (host_primask == 1) {
+        pthread_cond_timedwait(&host_irqDone, &host_irqLock, &until);
+    } else {
+        pthread_mutex_lock(&host_irqLock);
+        pthread_cond_timedwait(&host_irqDone, &host_irqLock, &until);
+        pthread_mutex_unlock(&host_irqLock);
+    }
+}
+
+void host_Irq(host_handler_t handler) {
+    if (handler == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&host_irqLock);
+    host_primask = 1;
+    host_inHandler = 1;
+
+    handler();
+
+    host_inHandler = 0;
+    host_primask = 0;
+    pthread_cond_broadcast(&host_irqDone);
+    pthread_mutex_unlock(&host_irqLock);
+}
+
+/* The firmware's malloc() and free() land here, the rest
+ * of the process keeps glibc's own */
+void *__real_malloc(size_t size);
+void __real_free(void *ptr);
+
+void *__wrap_malloc(size_t size) {
+    if (size > HOST_RAM_SIZE - host_heapUsed) {
+        return NULL;
+    }
+
+    void *ptr = __real_malloc(size);
+    if (ptr != NULL) {
+        host_heapUsed += malloc_usable_size(ptr);
+    }
+    return ptr;
+}
+
+void __wrap_free(void *ptr) {
+    if (ptr != NULL) {
+        host_heapUsed -= malloc_usable_size(ptr);
+    }
+    __real_free(ptr);
+}
+
+uint64_t host_Nanos() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) (now.tv_sec - host_start.tv_sec)*1000000000 +
+           now.tv_nsec - host_start.tv_nsec;
+}
+
+uint32_t host_Cycles() {
+    return (uint32_t) (host_Nanos()*(HOST_CORE_HZ/1000000)/1000);
+}
@@ -0,0 +1,184 @@
+/** @file host_i2c.c
+ *  @brief I2C stand-in for the host build.
+ *
+ *  This replaces stm32f4xx_i2c.c with a bus model behind
+ *  the same functions. The sensors in host_sensor.c
+ *  answer at their addresses, other addresses are not
+ *  acknowledged. Each byte takes as long as it would at
+ *  the clock speed the firmware asked for.
+ *
+ *  @author Ben Heberlein
+ *  @bug Only the functions the firmware uses are here.
+ */
+
+/*************************************
+ * Includes and definitions
+ */
+
+#include "host.h"
+#include "stm32f4xx.h"
+#include "stm32f4xx_i2c.h"
+#include <stdint.h>
+#include <stddef.h>
+
+/* @brief SR1 bits of an I2C_FLAG_x, SR2 flags already
+ * sit in the upper half like in I2C_CheckEvent()
+ */
+#define HOST_I2C_SR1(flag) ((flag) & 0x0000FFFF)
+
+/* @brief Bits per byte on the bus, including the ack
+ */
+#define HOST_I2C_BITS 9
+
+/* @brief Bus state
+ */
+static uint8_t host_i2cAddr = 0;
+static uint8_t host_i2cRegBytes = 0;
+static uint32_t host_i2cEvent = 0;
+static uint64_t host_i2cReady = 0;
+static uint64_t host_i2cByteNs = 90000;
+static uint8_t host_i2cAddrCount = 0;
+static uint16_t host_i2cReg = 0;
+
+/**************************************
+ * Private functions
+ */
+
+void host_i2cBusy(uint8_t bytes) {
+    host_i2cReady = host_Nanos() + bytes*host_i2cByteNs;
+}
+
+uint32_t host_i2cFlags() {
+    if (host_Nanos() < host_i2cReady) {
+        // Mid byte, only the bus state shows
+        return host_i2cEvent & (I2C_FLAG_BUSY | I2C_FLAG_MSL | I2C_FLAG_TRA);
+    }
+
+    return host_i2cEvent;
+}
+
+/**************************************
+ * Public functions
+ */
+
+void I2C_DeInit(I2C_TypeDef *I2Cx) {
+    host_i2cRegBytes = 0;
+    host_i2cEvent = 0;
+}
+
+void I2C_Init(I2C_TypeDef *I2Cx, I2C_InitTypeDef *I2C_InitStruct) {
+    if (I2C_InitStruct->I2C_ClockSpeed != 0) {
+        host_i2cByteNs = (uint64_t) HOST_I2C_BITS*1000000000/I2C_InitStruct->I2C_ClockSpeed;
+    }
+    I2Cx->CR1 = (I2Cx->CR1 & ~I2C_CR1_ACK) | I2C_InitStruct->I2C_Ack;
+}
+
+void I2C_Cmd(I2C_TypeDef *I2Cx, FunctionalState NewState) {
+    if (NewState != DISABLE) {
+        I2Cx->CR1 |= I2C_CR1_PE;
+    } else {
+        I2Cx->CR1 &= ~I2C_CR1_PE;
+    }
+}
+
+void I2C_GenerateSTART(I2C_TypeDef *I2Cx, FunctionalState NewState) {
+    if (NewState == DISABLE || !(I2Cx->CR1 & I2C_CR1_PE)) {
+        return;
+    }
+
+    host_i2cEvent = I2C_EVENT_MASTER_MODE_SELECT;
+    host_i2cBusy(1);
+}
+
+void I2C_GenerateSTOP(I2C_TypeDef *I2Cx, FunctionalState NewState) {
+    if (NewState == DISABLE) {
+        return;
+    }
+
+    host_i2cRegBytes = 0;
+    host_i2cEvent = 0;
+}
+
+void I2C_Send7bitAddress(I2C_TypeDef *I2Cx, uint8_t Address, uint8_t I2C_Direction) {
+    host_i2cAddr = Address;
+    host_i2cRegBytes = host_SensorRegBytes(Address);
+
+    if (host_i2cRegBytes == 0) {
+        // Nobody acknowledged
+        host_i2cEvent = I2C_FLAG_BUSY | I2C_FLAG_MSL | HOST_I2C_SR1(I2C_FLAG_AF);
+        host_i2cBusy(1);
+        return;
+    }
+
+    if (I2C_Direction == I2C_Direction_Transmitter) {
+        host_i2cAddrCount = 0;
+        host_i2cEvent = I2C_EVENT_MASTER_TRANSMITTER_MODE_SELECTED;
+        host_i2cBusy(1);
+    } else {
+        // The first byte follows the address right away
+        host_i2cEvent = I2C_EVENT_MASTER_RECEIVER_MODE_SELECTED | I2C_EVENT_MASTER_BYTE_RECEIVED;
+        host_i2cBusy(2);
+    }
+}
+
+void I2C_SendData(I2C_TypeDef *I2Cx, uint8_t Data) {
+    if (host_i2cRegBytes == 0) {
+        return;
+    }
+
+    if (host_i2cAddrCount < host_i2cRegBytes) {
+        // Register address, high byte first
+        host_i2cReg = (host_i2cAddrCount == 0) ? Data : (host_i2cReg << 8) | Data;
+        host_i2cAddrCount++;
+    } else {
+        host_SensorWrite(host_i2cAddr, host_i2cReg, Data);
+        host_i2cReg++;
+    }
+
+    host_i2cEvent = I2C_EVENT_MASTER_BYTE_TRANSMITTED;
+    host_i2cBusy(1);
+}
+
+uint8_t I2C_ReceiveData(I2C_TypeDef *I2Cx) {
+    if (host_i2cRegBytes == 0) {
+        return 0xFF;
+    }
+
+    uint8_t data = host_SensorRead(host_i2cAddr, host_i2cReg);
+    host_i2cReg++;
+
+    // The next byte only comes if we acknowledged this one
+    if (I2Cx->CR1 & I2C_CR1_ACK) {
+        host_i2cBusy(1);
+    } else {
+        host_i2cEvent &= ~HOST_I2C_SR1(I2C_FLAG_RXNE);
+    }
+
+    return data;
+}
+
+void I2C_AcknowledgeConfig(I2C_TypeDef *I2Cx, FunctionalState NewState) {
+    if (NewState != DISABLE) {
+        I2Cx->CR1 |= I2C_CR1_ACK;
+    } else {
+        I2Cx->CR1 &= ~I2C_CR1_ACK;
+    }
+}
+
+ErrorStatus I2C_CheckEvent(I2C_TypeDef *I2Cx, uint32_t I2C_EVENT) {
+    return ((host_i2cFlags() & I2C_EVENT) == I2C_EVENT) ? SUCCESS : ERROR;
+}
+
+uint32_t I2C_GetLastEvent(I2C_TypeDef *I2Cx) {
+    return host_i2cFlags();
+}
+
+FlagStatus I2C_GetFlagStatus(I2C_TypeDef *I2Cx, uint32_t I2C_FLAG) {
+    uint32_t flags = host_i2cFlags();
+
+    // SR1 flags are tagged with bit 28
+    if (I2C_FLAG & 0x10000000) {
+        return (flags & HOST_I2C_SR1(I2C_FLAG)) ? SET : RESET;
+    }
+    return (flags & I2C_FLAG) ? SET : RESET;
+}
@@ -0,0 +1,282 @@
+/** @file host_sensor.c
+ *  @brief Fake OV5642 and OV7670 for the host build.
+ *
+ *  Both sensors sit on the simulated SCCB bus behind
+ *  host_i2c.c. Each has a register map with the reset
+ *  values the drivers check, and reacts to the registers
+ *  that decide the frame: soft reset, sleep, output size,
+ *  and output format. Whichever sensor was written last
+ *  feeds the DCMI.
+ *
+ *  Frames come from the .raw files in $HOST_FRAMES, in
+ *  name order and repeating. A file shorter than the
+ *  frame is padded with zeros, a longer one is cut. With
+ *  no directory the sensor sends a moving test pattern.
+ *
+ *  @author Ben Heberlein
+ *  @bug Windowing, scaling, and JPEG output are ignored,
+ *  only the output size registers set the frame size.
+ */
+
+/*************************************
+ * Includes and definitions
+ */
+
+#include "host.h"
+#include "ov5642_regs.h"
+#include "ov7670_regs.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+
+/* @brief OV5642 registers the model acts on
+ */
+#define HOST_OV5642_CTRL00 0x3008
+#define HOST_OV5642_CTRL00_RESET 0x80
+#define HOST_OV5642_CTRL00_SLEEP 0x40
+#define HOST_OV5642_DVPHO 0x3808
+#define HOST_OV5642_DVPVO 0x380A
+#define HOST_OV5642_FMT 0x4300
+
+/* @brief Bus addresses, without the read bit
+ */
+#define HOST_OV5642_ADDR 0x78
+#define HOST_OV7670_ADDR 0x42
+
+/* @brief A register and its reset value
+ */
+typedef struct host_sensorReg_s {
+    uint16_t host_sensorReg_reg;
+    uint8_t host_sensorReg_val;
+} host_sensorReg_t;
+
+/* @brief A sensor on the bus
+ */
+typedef struct host_sensor_s {
+    uint8_t host_sensor_addr;
+    uint8_t host_sensor_regBytes;
+    uint8_t *host_sensor_regs;
+    uint32_t host_sensor_size;
+    const host_sensorReg_t *host_sensor_defaults;
+} host_sensor_t;
+
+/* @brief Reset values, the rest of each map is zero
+ */
+static const host_sensorReg_t host_ov5642Defaults[] = {
+    {OV5642_CHIPID_HIGH, 0x56},
+    {OV5642_CHIPID_LOW, 0x42},
+    {HOST_OV5642_CTRL00, 0x02},
+    {HOST_OV5642_DVPHO, 0x0A},      // 2592 x 1944
+    {HOST_OV5642_DVPHO + 1, 0x20},
+    {HOST_OV5642_DVPVO, 0x07},
+    {HOST_OV5642_DVPVO + 1, 0x98},
+    {HOST_OV5642_FMT, 0xF8},        // Bypass, raw bytes
+    {0xFFFF, 0xFF},
+};
+
+static const host_sensorReg_t host_ov7670Defaults[] = {
+    {REG_PID, 0x76},
+    {REG_VER, 0x73},
+    {REG_COM2, 0x01},
+    {REG_COM7, COM7_FMT_VGA | COM7_YUV},
+    {0xFFFF, 0xFF},
+};
+
+static uint8_t host_ov5642Regs[0x10000];
+static uint8_t host_ov7670Regs[0x100];
+
+static host_sensor_t host_sensors[] = {
+    {HOST_OV5642_ADDR, 2, host_ov5642Regs, sizeof(host_ov5642Regs), host_ov5642Defaults},
+    {HOST_OV7670_ADDR, 1, host_ov7670Regs, sizeof(host_ov7670Regs), host_ov7670Defaults},
+};
+
+#define HOST_SENSOR_NUM (sizeof(host_sensors)/sizeof(host_sensors[0]))
+
+/* @brief Sensor feeding the DCMI
+ */
+static host_sensor_t *host_sensorActive = &host_sensors[0];
+
+/* @brief Recorded frames
+ */
+static const char *host_sensorDir = NULL;
+static struct dirent **host_sensorFiles = NULL;
+static int host_sensorFileNum = 0;
+static int host_sensorFileNext = 0;
+static uint32_t host_sensorFrames = 0;
+
+/**************************************
+ * Private functions
+ */
+
+void host_sensorReset(host_sensor_t *sensor) {
+    memset(sensor->host_sensor_regs, 0, sensor->host_sensor_size);
+    for (const host_sensorReg_t *r = sensor->host_sensor_defaults; r->host_sensorReg_reg != 0xFFFF; r++) {
+        sensor->host_sensor_regs[r->host_sensorReg_reg] = r->host_sensorReg_val;
+    }
+}
+
+host_sensor_t *host_sensorFind(uint8_t addr) {
+    for (uint8_t s = 0; s < HOST_SENSOR_NUM; s++) {
+        if (host_sensors[s].host_sensor_addr == (addr & 0xFE)) {
+            return &host_sensors[s];
+        }
+    }
+
+    return NULL;
+}
+
+int host_sensorIsRaw(const struct dirent *entry) {
+    size_t len = strlen(entry->d_name);
+    return len > 4 && strcmp(entry->d_name + len - 4, ".raw") == 0;
+}
+
+/* Power on state, and the frame list if there is one */
+__attribute__ ((constructor)) void host_sensorInit() {
+    for (uint8_t s = 0; s < HOST_SENSOR_NUM; s++) {
+        host_sensorReset(&host_sensors[s]);
+    }
+
+    host_sensorDir = getenv("HOST_FRAMES");
+    if (host_sensorDir == NULL) {
+        return;
+    }
+
+    host_sensorFileNum = scandir(host_sensorDir, &host_sensorFiles, host_sensorIsRaw, alphasort);
+    if (host_sensorFileNum <= 0) {
+        fprintf(stderr, "host: no .raw frames in %s, using a test pattern\n", host_sensorDir);
+        host_sensorFileNum = 0;
+        return;
+    }
+    fprintf(stderr, "host: %d frames from %s\n", host_sensorFileNum, host_sensorDir);
+}
+
+uint8_t host_sensorAsleep(host_sensor_t *sensor) {
+    if (sensor->host_sensor_addr == HOST_OV5642_ADDR) {
+        return (sensor->host_sensor_regs[HOST_OV5642_CTRL00] & HOST_OV5642_CTRL00_SLEEP) != 0;
+    }
+    return (sensor->host_sensor_regs[REG_COM2] & COM2_SSLEEP) != 0;
+}
+
+uint32_t host_sensorFrameSize(host_sensor_t *sensor) {
+    uint8_t *regs = sensor->host_sensor_regs;
+
+    if (sensor->host_sensor_addr == HOST_OV5642_ADDR) {
+        uint32_t width = (regs[HOST_OV5642_DVPHO] & 0x0F) << 8 | regs[HOST_OV5642_DVPHO + 1];
+        uint32_t height = (regs[HOST_OV5642_DVPVO] & 0x07) << 8 | regs[HOST_OV5642_DVPVO + 1];
+
+        // Raw, Y8, and bypass are one byte a pixel, YUV and RGB two
+        uint8_t fmt = regs[HOST_OV5642_FMT] >> 4;
+        uint8_t bpp = (fmt == 0x0 || fmt == 0x1 || fmt == 0xF) ? 1 : 2;
+        return width*height*bpp;
+    }
+
+    uint32_t pixels;
+    switch (regs[REG_COM7] & COM7_FMT_MASK) {
+        case COM7_FMT_CIF:
+            pixels = 352*288;
+            break;
+        case COM7_FMT_QVGA:
+            pixels = 320*240;
+            break;
+        case COM7_FMT_QCIF:
+            pixels = 176*144;
+            break;
+        default:
+            pixels = 640*480;
+            break;
+    }
+
+    // Bayer is a byte a pixel, YUV and RGB two
+    return (regs[REG_COM7] & COM7_BAYER) ? pixels : pixels*2;
+}
+
+void host_sensorPattern(uint8_t *dst, uint32_t len) {
+    // Moving diagonal bars, each frame differs
+    for (uint32_t i = 0; i < len; i++) {
+        dst[i] = (uint8_t) (i + (i >> 8) + host_sensorFrames);
+    }
+}
+
+void host_sensorFile(uint8_t *dst, uint32_t len) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s", host_sensorDir,
+             host_sensorFiles[host_sensorFileNext]->d_name);
+
+    size_t got = 0;
+    FILE *f = fopen(path, "rb");
+    if (f != NULL) {
+        got = fread(dst, 1, len, f);
+        fclose(f);
+    }
+    memset(dst + got, 0, len - got);
+}
+
+/**************************************
+ * Public functions
+ */
+
+uint8_t host_SensorRegBytes(uint8_t addr) {
+    host_sensor_t *sensor = host_sensorFind(addr);
+    return (sensor != NULL) ? sensor->host_sensor_regBytes : 0;
+}
+
+uint8_t host_SensorRead(uint8_t addr, uint16_t reg) {
+    host_sensor_t *sensor = host_sensorFind(addr);
+    if (sensor == NULL) {
+        return 0xFF;
+    }
+
+    return sensor->host_sensor_regs[reg % sensor->host_sensor_size];
+}
+
+void host_SensorWrite(uint8_t addr, uint16_t reg, uint8_t val) {
+    host_sensor_t *sensor = host_sensorFind(addr);
+    if (sensor == NULL) {
+        return;
+    }
+    reg %= sensor->host_sensor_size;
+    host_sensorActive = sensor;
+
+    // The reset bits clear themselves along with the rest
+    if (sensor->host_sensor_addr == HOST_OV5642_ADDR && reg == HOST_OV5642_CTRL00 &&
+        (val & HOST_OV5642_CTRL00_RESET)) {
+        host_sensorReset(sensor);
+        return;
+    }
+    if (sensor->host_sensor_addr == HOST_OV7670_ADDR && reg == REG_COM7 && (val & COM7_RESET)) {
+        host_sensorReset(sensor);
+        return;
+    }
+
+    sensor->host_sensor_regs[reg] = val;
+}
+
+uint32_t host_SensorFrame(uint8_t *dst, uint32_t max) {
+    if (host_sensorAsleep(host_sensorActive)) {
+        return 0;
+    }
+
+    uint32_t len = host_sensorFrameSize(host_sensorActive);
+    if (len > max) {
+        len = max;
+    }
+
+    if (dst != NULL) {
+        if (host_sensorFileNum > 0) {
+            host_sensorFile(dst, len);
+        } else {
+            host_sensorPattern(dst, len);
+        }
+    }
+
+    // The sensor streams whether or not anyone captures
+    host_sensorFrames++;
+    if (host_sensorFileNum > 0) {
+        host_sensorFileNext = (host_sensorFileNext + 1) % host_sensorFileNum;
+    }
+
+    return len;
+}
@@ -0,0 +1,489 @@
+/** @file host_sim.c
+ *  @brief Timer and camera simulator for the host build.
+ *
+ *  This runs a thread that plays the part of the timers,
+ *  the DCMI, and the DCMI DMA stream. It watches the
+ *  registers the real drivers program and raises the
+ *  interrupts they would.
+ *
+ *  Each frame from host_sensor.c goes through DMA2 stream
+ *  1 into SDRAM. A normal mode stream that runs out, a
+ *  disabled stream, or a bus error leaves the rest of the
+ *  frame in the DCMI, which reports an overrun.
+ *
+ *  DMA2 stream 0 runs memory to memory copies in one go
+ *  the first poll after it is enabled. The DMA2D does the
+ *  same with conversions and lookup table loads.
+ *
+ *  @author Ben Heberlein
+ *  @bug Double buffer mode, the DCMI crop window, and
+ *  DMA2D blending and 16 bit alpha formats are not
+ *  modelled.
+ */
+
+/*************************************
+ * Includes and definitions
+ */
+
+#include "host.h"
+#include "stm32f4xx.h"
+#include "misc.h"
+#include "stm32f4xx_dma2d.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+/* @brief Handlers, absent ones are never raised
+ */
+extern void TIM5_IRQHandler(void) __attribute__ ((weak));
+extern void TIM6_DAC_IRQHandler(void) __attribute__ ((weak));
+extern void TIM7_IRQHandler(void) __attribute__ ((weak));
+extern void DCMI_IRQHandler(void) __attribute__ ((weak));
+extern void DMA2_Stream0_IRQHandler(void) __attribute__ ((weak));
+extern void DMA2_Stream1_IRQHandler(void) __attribute__ ((weak));
+extern void DMA2D_IRQHandler(void) __attribute__ ((weak));
+
+/* @brief Simulated SDRAM, DMA outside it is dropped
+ */
+#define HOST_SDRAM_BASE 0xD0000000
+#define HOST_SDRAM_SIZE 0x00800000
+
+/* @brief Core coupled RAM, out of reach of the DMA
+ */
+#define HOST_CCM_BASE 0x10000000
+#define HOST_CCM_SIZE 0x00010000
+
+/* @brief A simulated basic timer
+ */
+typedef struct host_timer_s {
+    TIM_TypeDef *host_timer_tim;
+    IRQn_Type host_timer_irq;
+    host_handler_t host_timer_handler;
+    uint8_t host_timer_running;
+    uint8_t host_timer_pending;
+    uint64_t host_timer_start;
+    uint64_t host_timer_periods;
+} host_timer_t;
+
+static host_timer_t host_timers[] = {
+    {TIM5, TIM5_IRQn, TIM5_IRQHandler},
+    {TIM6, TIM6_DAC_IRQn, TIM6_DAC_IRQHandler},
+    {TIM7, TIM7_IRQn, TIM7_IRQHandler},
+};
+
+#define HOST_TIMER_NUM (sizeof(host_timers)/sizeof(host_timers[0]))
+
+/* @brief Timer state is shared with host_TickCount()
+ */
+static pthread_mutex_t host_timerLock = PTHREAD_MUTEX_INITIALIZER;
+
+/* @brief Camera state, the sensor runs free and the
+ * DCMI takes the frames that end while it captures
+ */
+static uint64_t host_camPeriod;
+static uint64_t host_camNext;
+static uint32_t host_camSeen = 0;
+static uint8_t host_camFrame[HOST_FRAME_MAX];
+
+/* @brief DCMI stream state, latched when EN goes high
+ */
+static uint8_t host_dmaRunning = 0;
+static uint32_t host_dmaAddr = 0;
+static uint32_t host_dmaItems = 0;
+static uint32_t host_dmaPos = 0;
+
+/* @brief NVIC enable bits, ISER and ICER are folded in
+ */
+static uint32_t host_nvicEnable[8];
+static pthread_mutex_t host_nvicLock = PTHREAD_MUTEX_INITIALIZER;
+
+/**************************************
+ * Private functions
+ */
+
+uint8_t host_nvicEnabled(IRQn_Type irq) {
+    host_NvicUpdate();
+    return (host_nvicEnable[irq >> 5] >> (irq & 0x1F)) & 1;
+}
+
+/* Called with host_timerLock held */
+void host_timerUpdate(host_timer_t *timer) {
+    TIM_TypeDef *tim = timer->host_timer_tim;
+
+    if (!(tim->CR1 & TIM_CR1_CEN)) {
+        timer->host_timer_running = 0;
+        return;
+    }
+
+    uint64_t now = host_Nanos();
+    if (timer->host_timer_running == 0) {
+        timer->host_timer_running = 1;
+        timer->host_timer_start = now;
+        timer->host_timer_periods = 0;
+    }
+
+    uint64_t counterHz = HOST_TIMCLK_HZ/(tim->PSC + 1);
+    uint64_t ticks = (now - timer->host_timer_start)/1000*counterHz/1000000;
+    uint64_t reload = (uint64_t) tim->ARR + 1;
+    uint64_t periods = ticks/reload;
+
+    tim->CNT = ticks % reload;
+    if (periods > timer->host_timer_periods) {
+        timer->host_timer_periods = periods;
+        tim->SR |= TIM_SR_UIF;
+        if (tim->DIER & TIM_DIER_UIE) {
+            timer->host_timer_pending = 1;
+        }
+    }
+}
+
+void host_timerPoll() {
+    for (uint8_t t = 0; t < HOST_TIMER_NUM; t++) {
+        host_timer_t *timer = &host_timers[t];
+
+        pthread_mutex_lock(&host_timerLock);
+        host_timerUpdate(timer);
+        uint8_t pending = timer->host_timer_pending;
+        timer->host_timer_pending = 0;
+        pthread_mutex_unlock(&host_timerLock);
+
+        if (pending && host_nvicEnabled(timer->host_timer_irq)) {
+            host_Irq(timer->host_timer_handler);
+        }
+    }
+}
+
+void host_dmaIrq(uint32_t flags) {
+    DMA_Stream_TypeDef *stream = DMA2_Stream1;
+
+    uint32_t enable = 0;
+    enable |= (flags & DMA_LISR_TCIF1) ? DMA_SxCR_TCIE : 0;
+    enable |= (flags & DMA_LISR_HTIF1) ? DMA_SxCR_HTIE : 0;
+    enable |= (flags & DMA_LISR_TEIF1) ? DMA_SxCR_TEIE : 0;
+
+    // Handlers clear through LIFCR, which does nothing here
+    DMA2->LISR |= flags;
+    if ((stream->CR & enable) && host_nvicEnabled(DMA2_Stream1_IRQn)) {
+        host_Irq(DMA2_Stream1_IRQHandler);
+    }
+    DMA2->LISR &= ~flags;
+}
+
+void host_dcmiIrq(uint32_t ris) {
+    // RIS, IER, and MIS bits line up
+    DCMI->RISR |= ris;
+    if (DCMI->IER & ris) {
+        DCMI->MISR |= DCMI->IER & ris;
+        if (host_nvicEnabled(DCMI_IRQn)) {
+            host_Irq(DCMI_IRQHandler);
+        }
+    }
+    DCMI->MISR &= ~ris;
+    DCMI->RISR &= ~ris;
+}
+
+void host_dmaUpdate() {
+    DMA_Stream_TypeDef *stream = DMA2_Stream1;
+
+    // A quick off and on between polls shows as a new address
+    if (!(stream->CR & DMA_SxCR_EN)) {
+        host_dmaRunning = 0;
+    } else if (host_dmaRunning == 0 || stream->M0AR != host_dmaAddr) {
+        host_dmaRunning = 1;
+        host_dmaAddr = stream->M0AR;
+        host_dmaItems = stream->NDTR;
+        host_dmaPos = 0;
+    }
+}
+
+/* Returns the bytes the stream took, the DCMI overruns
+ * on the rest */
+uint32_t host_dmaWrite(const uint8_t *src, uint32_t len) {
+    DMA_Stream_TypeDef *stream = DMA2_Stream1;
+
+    // NDTR counts peripheral sized items
+    uint8_t shift = (stream->CR & DMA_SxCR_PSIZE) >> 11;
+    uint32_t size = host_dmaItems << shift;
+    uint32_t done = 0;
+
+    while (done < len && host_dmaRunning && size > 0) {
+        uint32_t n = size - host_dmaPos;
+        if (n > len - done) {
+            n = len - done;
+        }
+
+        uint32_t addr = stream->M0AR + host_dmaPos;
+        if (addr < HOST_SDRAM_BASE || addr + n > HOST_SDRAM_BASE + HOST_SDRAM_SIZE) {
+            // Bus error, the stream turns itself off
+            stream->CR &= ~DMA_SxCR_EN;
+            host_dmaRunning = 0;
+            host_dmaIrq(DMA_LISR_TEIF1);
+            break;
+        }
+        memcpy((uint8_t *) (uintptr_t) addr, src + done, n);
+
+        uint32_t flags = 0;
+        if (host_dmaPos < size/2 && host_dmaPos + n >= size/2) {
+            flags |= DMA_LISR_HTIF1;
+        }
+        host_dmaPos += n;
+        done += n;
+        stream->NDTR = (size - host_dmaPos) >> shift;
+
+        if (host_dmaPos == size) {
+            flags |= DMA_LISR_TCIF1;
+            if (stream->CR & DMA_SxCR_CIRC) {
+                host_dmaPos = 0;
+                stream->NDTR = host_dmaItems;
+            } else {
+                stream->CR &= ~DMA_SxCR_EN;
+                host_dmaRunning = 0;
+            }
+        }
+        if (flags != 0) {
+            host_dmaIrq(flags);
+        }
+    }
+
+    return done;
+}
+
+uint8_t host_ccm(uint32_t addr, uint32_t size) {
+    return addr + size > HOST_CCM_BASE && addr < HOST_CCM_BASE + HOST_CCM_SIZE;
+}
+
+/* Bursts and the FIFO only change the timing, which the
+ * copy doesn't model */
+void host_copyPoll() {
+    DMA_Stream_TypeDef *stream = DMA2_Stream0;
+
+    if (!(stream->CR & DMA_SxCR_EN) || (stream->CR & DMA_SxCR_DIR) != DMA_SxCR_DIR_1) {
+        return;
+    }
+
+    uint8_t shift = (stream->CR & DMA_SxCR_PSIZE) >> 11;
+    uint32_t size = stream->NDTR << shift;
+    uint32_t flags = DMA_LISR_TCIF0;
+    if (host_ccm(stream->PAR, size) || host_ccm(stream->M0AR, size)) {
+        // The DMA has no path to core coupled RAM
+        flags = DMA_LISR_TEIF0;
+    } else {
+        memmove((uint8_t *) (uintptr_t) stream->M0AR, (uint8_t *) (uintptr_t) stream->PAR, size);
+        stream->NDTR = 0;
+    }
+    stream->CR &= ~DMA_SxCR_EN;
+
+    uint32_t enable = (flags & DMA_LISR_TCIF0) ? DMA_SxCR_TCIE : DMA_SxCR_TEIE;
+    DMA2->LISR |= flags;
+    if ((stream->CR & enable) && host_nvicEnabled(DMA2_Stream0_IRQn)) {
+        host_Irq(DMA2_Stream0_IRQHandler);
+    }
+    DMA2->LISR &= ~flags;
+}
+
+void host_dma2dIrq(uint32_t flag) {
+    // Interrupt enables sit 8 bits above their flags
+    DMA2D->ISR |= flag;
+    if ((DMA2D->CR & flag << 8) && host_nvicEnabled(DMA2D_IRQn)) {
+        host_Irq(DMA2D_IRQHandler);
+    }
+}
+
+/* Expands to ARGB8888, RGB565 repeats its top bits */
+uint32_t host_dma2dRead(const uint8_t *p, uint32_t cm) {
+    uint32_t v;
+    switch (cm) {
+        case 0:
+            return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t) p[3] << 24;
+        case 1:
+            return 0xFF000000 | p[0] | p[1] << 8 | p[2] << 16;
+        case 2:
+            v = p[0] | p[1] << 8;
+            return 0xFF000000 |
+                   ((v >> 11 & 0x1F) << 3 | (v >> 13 & 0x07)) << 16 |
+                   ((v >> 5 & 0x3F) << 2 | (v >> 9 & 0x03)) << 8 |
+                   ((v & 0x1F) << 3 | (v >> 2 & 0x07));
+        default:
+            return DMA2D->FGCLUT[p[0]];
+    }
+}
+
+void host_dma2dWrite(uint8_t *p, uint32_t cm, uint32_t argb) {
+    switch (cm) {
+        case 0:
+            p[3] = argb >> 24;
+            // Fall through
+        case 1:
+            p[0] = argb;
+            p[1] = argb >> 8;
+            p[2] = argb >> 16;
+            break;
+        default: {
+            uint16_t v = (argb >> 8 & 0xF800) | (argb >> 5 & 0x07E0) | (argb >> 3 & 0x001F);
+            p[0] = v;
+            p[1] = v >> 8;
+            break;
+        }
+    }
+}
+
+void host_dma2dPoll() {
+    // IFCR is plain memory, fold it in first
+    DMA2D->ISR &= ~__atomic_exchange_n(&DMA2D->IFCR, 0, __ATOMIC_SEQ_CST);
+
+    if (DMA2D->FGPFCCR & DMA2D_FGPFCCR_START) {
+        uint32_t n = ((DMA2D->FGPFCCR & DMA2D_FGPFCCR_CS) >> 8) + 1;
+        uint8_t rgb = (DMA2D->FGPFCCR & DMA2D_FGPFCCR_CCM) != 0;
+        const uint8_t *lut = (const uint8_t *) (uintptr_t) DMA2D->FGCMAR;
+        for (uint32_t i = 0; i < n; i++) {
+            DMA2D->FGCLUT[i] = host_dma2dRead(lut + i*(rgb ? 3 : 4), rgb ? 1 : 0);
+        }
+        DMA2D->FGPFCCR &= ~DMA2D_FGPFCCR_START;
+        host_dma2dIrq(DMA2D_ISR_CTCIF);
+    }
+
+    if (!(DMA2D->CR & DMA2D_CR_START)) {
+        return;
+    }
+
+    static const uint8_t bytes[] = {4, 3, 2, 0, 0, 1};
+    uint32_t mode = DMA2D->CR & DMA2D_CR_MODE;
+    uint32_t inCm = DMA2D->FGPFCCR & DMA2D_FGPFCCR_CM;
+    uint32_t outCm = DMA2D->OPFCCR & DMA2D_OPFCCR_CM;
+    uint32_t pl = (DMA2D->NLR & DMA2D_NLR_PL) >> 16;
+    uint32_t nl = DMA2D->NLR & DMA2D_NLR_NL;
+    uint32_t flag = DMA2D_ISR_TCIF;
+
+    if ((mode != DMA2D_M2M && mode != DMA2D_M2M_PFC) || inCm > 5 || bytes[inCm] == 0 ||
+        outCm > 2 || pl == 0 || nl == 0) {
+        flag = DMA2D_ISR_CEIF;
+    } else {
+        // Plain memory to memory keeps the input format
+        if (mode == DMA2D_M2M) {
+            outCm = inCm;
+        }
+        uint32_t inLine = (pl + (DMA2D->FGOR & DMA2D_FGOR_LO))*bytes[inCm];
+        uint32_t outLine = (pl + (DMA2D->OOR & DMA2D_OOR_LO))*bytes[outCm];
+        if (host_ccm(DMA2D->FGMAR, inLine*nl) || host_ccm(DMA2D->OMAR, outLine*nl)) {
+            // The DMA2D has no path to core coupled RAM
+            flag = DMA2D_ISR_TEIF;
+        } else {
+            const uint8_t *in = (const uint8_t *) (uintptr_t) DMA2D->FGMAR;
+            uint8_t *out = (uint8_t *) (uintptr_t) DMA2D->OMAR;
+            for (uint32_t y = 0; y < nl; y++) {
+                for (uint32_t x = 0; x < pl; x++) {
+                    if (mode == DMA2D_M2M) {
+                        memcpy(out + y*outLine + x*bytes[outCm], in + y*inLine + x*bytes[inCm],
+                               bytes[inCm]);
+                    } else {
+                        host_dma2dWrite(out + y*outLine + x*bytes[outCm], outCm,
+                                        host_dma2dRead(in + y*inLine + x*bytes[inCm], inCm));
+                    }
+                }
+            }
+        }
+    }
+    DMA2D->CR &= ~DMA2D_CR_START;
+
+    host_dma2dIrq(flag);
+}
+
+void host_camPoll() {
+    host_dmaUpdate();
+
+    uint64_t now = host_Nanos();
+    if (now < host_camNext) {
+        return;
+    }
+    host_camNext += host_camPeriod;
+    if (host_camNext <= now) {
+        // We fell behind, the sensor doesn't
+        host_camNext = now + host_camPeriod;
+    }
+
+    uint8_t capture = (DCMI->CR & DCMI_CR_ENABLE) && (DCMI->CR & DCMI_CR_CAPTURE);
+    if (capture) {
+        // Every frame, one in two, or one in four
+        uint8_t rate = (DCMI->CR & (DCMI_CR_FCRC_0 | DCMI_CR_FCRC_1)) >> 8;
+        capture = (host_camSeen++ & ((1 << rate) - 1)) == 0;
+    }
+
+    uint32_t len = host_SensorFrame(capture ? host_camFrame : NULL, sizeof(host_camFrame));
+    if (capture == 0 || len == 0) {
+        return;
+    }
+
+    // Snapshot mode takes one frame, the capture bit
+    // clears before the interrupt so it can start another
+    if (DCMI->CR & DCMI_CR_CM) {
+        DCMI->CR &= ~DCMI_CR_CAPTURE;
+    }
+
+    // Whatever the stream can't take is lost
+    if (host_dmaWrite(host_camFrame, len) < len) {
+        host_dcmiIrq(DCMI_RISR_OVR_RIS);
+    }
+    host_dcmiIrq(DCMI_RISR_FRAME_RIS);
+}
+
+void *host_simThread(void *arg) {
+    while (1) {
+        host_NvicUpdate();
+        host_timerPoll();
+        host_camPoll();
+        host_copyPoll();
+        host_dma2dPoll();
+        usleep(HOST_SIM_US);
+    }
+
+    return NULL;
+}
+
+/**************************************
+ * Public functions
+ */
+
+void host_SimInit() {
+    uint32_t fps = HOST_FPS;
+    const char *env = getenv("HOST_FPS");
+    if (env != NULL && atoi(env) > 0) {
+        fps = atoi(env);
+    }
+    host_camPeriod = 1000000000ULL/fps;
+    host_camNext = host_Nanos() + host_camPeriod;
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, host_simThread, NULL);
+}
+
+/* Clears first, so a quick disable and enable ends up
+ * enabled */
+void host_NvicUpdate() {
+    pthread_mutex_lock(&host_nvicLock);
+    for (uint8_t n = 0; n < 8; n++) {
+        uint32_t clear = __atomic_exchange_n(&NVIC->ICER[n], 0, __ATOMIC_SEQ_CST);
+        uint32_t set = __atomic_exchange_n(&NVIC->ISER[n], 0, __ATOMIC_SEQ_CST);
+        host_nvicEnable[n] = (host_nvicEnable[n] & ~clear) | set;
+    }
+    pthread_mutex_unlock(&host_nvicLock);
+}
+
+/* The firmware's NVIC_Init() calls land here */
+void __real_NVIC_Init(NVIC_InitTypeDef *NVIC_InitStruct);
+
+void __wrap_NVIC_Init(NVIC_InitTypeDef *NVIC_InitStruct) {
+    __real_NVIC_Init(NVIC_InitStruct);
+    host_NvicUpdate();
+}
+
+uint32_t host_TickCount() {
+    pthread_mutex_lock(&host_timerLock);
+    host_timerUpdate(&host_timers[0]);
+    uint32_t count = TIM5->CNT;
+    pthread_mutex_unlock(&host_timerLock);
+
+    return count;
+}
@@ -0,0 +1,245 @@
+/** @file host_usart.c
+ *  @brief USART stand-in for the host build.
+ *
+ *  This replaces stm32f4xx_usart.c. USART2 is connected
+ *  to a pseudo terminal. Bytes are paced at the baud rate
+ *  the firmware asked for, unless $HOST_UART_PACE is 0.
+ *  With nothing attached to the terminal, sent bytes are
+ *  buffered by the kernel and then dropped, like a UART
+ *  with no listener.
+ *
+ *  @author Ben Heberlein
+ *  @bug Only the functions the firmware uses are here.
+ */
+
+/*************************************
+ * Includes and definitions
+ */
+
+#include "host.h"
+#include "stm32f4xx.h"
+#include "stm32f4xx_usart.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <termios.h>
+#include <unistd.h>
+
+// termios.h delay masks collide with the register names
+#undef CR1
+#undef CR2
+#undef CR3
+
+/* @brief Handler from cmd.c, absent without __CMD
+ */
+extern void USART2_IRQHandler(void) __attribute__ ((weak));
+
+/* @brief Pseudo terminal master
+ */
+static int host_usartFd = -1;
+
+/* @brief Nanoseconds per byte, 0 to not pace
+ */
+static uint64_t host_usartByteNs = 0;
+static uint8_t host_usartPace = 1;
+
+/* @brief Earliest time the next byte can go out
+ */
+static uint64_t host_usartTxReady = 0;
+
+/**************************************
+ * Private functions
+ */
+
+void host_usartRxByte(uint8_t byte) {
+    // Bytes arriving with the receiver off are lost
+    if (!(USART2->CR1 & USART_CR1_UE) || !(USART2->CR1 & USART_CR1_RE)) {
+        return;
+    }
+
+    USART2->DR = byte;
+    USART2->SR |= USART_SR_RXNE;
+    if (USART2->CR1 & USART_CR1_RXNEIE) {
+        host_Irq(USART2_IRQHandler);
+    }
+
+    // Reading DR clears RXNE on the part
+    USART2->SR &= ~USART_SR_RXNE;
+}
+
+void *host_usartRxThread(void *arg) {
+    uint8_t buf[256];
+
+    while (1) {
+        struct pollfd pfd = {host_usartFd, POLLIN, 0};
+        if (poll(&pfd, 1, -1) < 0 || !(pfd.revents & POLLIN)) {
+            // Nothing attached yet
+            usleep(10000);
+            continue;
+        }
+
+        ssize_t n = read(host_usartFd, buf, sizeof(buf));
+        for (ssize_t i = 0; i < n; i++) {
+            host_usartRxByte(buf[i]);
+        }
+    }
+
+    return NULL;
+}
+
+uint8_t host_usartWritable() {
+    struct pollfd pfd = {host_usartFd, POLLOUT, 0};
+    if (poll(&pfd, 1, 0) != 1) {
+        return 0;
+    }
+
+    // Hang up means no listener, bytes are dropped
+    return (pfd.revents & (POLLOUT | POLLHUP)) != 0;
+}
+
+/**************************************
+ * Public functions
+ */
+
+void host_UsartInit() {
+    host_usartFd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (host_usartFd < 0 || grantpt(host_usartFd) != 0 || unlockpt(host_usartFd) != 0) {
+        fprintf(stderr, "host: could not open a pseudo terminal\n");
+        exit(1);
+    }
+    const char *name = ptsname(host_usartFd);
+
+    // Raw mode sticks after we close the slave
+    int slave = open(name, O_RDWR | O_NOCTTY);
+    if (slave >= 0) {
+        struct termios tio;
+        tcgetattr(slave, &tio);
+        cfmakeraw(&tio);
+        tcsetattr(slave, TCSANOW, &tio);
+        close(slave);
+    }
+    fcntl(host_usartFd, F_SETFL, O_NONBLOCK);
+
+    const char *link = getenv("HOST_UART");
+    if (link != NULL) {
+        unlink(link);
+        if (symlink(name, link) != 0) {
+            fprintf(stderr, "host: could not link %s\n", link);
+        }
+    }
+    fprintf(stderr, "host: USART2 on %s\n", name);
+
+    const char *pace = getenv("HOST_UART_PACE");
+    host_usartPace = !(pace != NULL && strcmp(pace, "0") == 0);
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, host_usartRxThread, NULL);
+}
+
+void USART_DeInit(USART_TypeDef *USARTx) {
+    USARTx->CR1 = 0;
+    USARTx->CR2 = 0;
+    USARTx->CR3 = 0;
+}
+
+void USART_Init(USART_TypeDef *USARTx, USART_InitTypeDef *USART_InitStruct) {
+    USARTx->CR1 = (USARTx->CR1 & ~(USART_CR1_M | USART_CR1_PCE | USART_CR1_PS |
+                                   USART_CR1_TE | USART_CR1_RE)) |
+                  USART_InitStruct->USART_WordLength |
+                  USART_InitStruct->USART_Parity |
+                  USART_InitStruct->USART_Mode;
+
+    if (USARTx == USART2 && USART_InitStruct->USART_BaudRate != 0) {
+        // Start, eight data, and stop bits
+        host_usartByteNs = 10ULL*1000000000/USART_InitStruct->USART_BaudRate;
+    }
+}
+
+void USART_StructInit(USART_InitTypeDef *USART_InitStruct) {
+    USART_InitStruct->USART_BaudRate = 9600;
+    USART_InitStruct->USART_WordLength = USART_WordLength_8b;
+    USART_InitStruct->USART_StopBits = USART_StopBits_1;
+    USART_InitStruct->USART_Parity = USART_Parity_No;
+    USART_InitStruct->USART_Mode = USART_Mode_Rx | USART_Mode_Tx;
+    USART_InitStruct->USART_HardwareFlowControl = USART_HardwareFlowControl_None;
+}
+
+void USART_Cmd(USART_TypeDef *USARTx, FunctionalState NewState) {
+    if (NewState != DISABLE) {
+        USARTx->CR1 |= USART_CR1_UE;
+    } else {
+        USARTx->CR1 &= ~USART_CR1_UE;
+    }
+}
+
+void USART_ITConfig(USART_TypeDef *USARTx, uint16_t USART_IT, FunctionalState NewState) {
+    // Only the CR1 interrupts are modelled
+    if ((USART_IT >> 5 & 0x07) != 0x01) {
+        return;
+    }
+
+    uint32_t mask = 1 << (USART_IT & 0x1F);
+    if (NewState != DISABLE) {
+        USARTx->CR1 |= mask;
+    } else {
+        USARTx->CR1 &= ~mask;
+    }
+}
+
+void USART_SendData(USART_TypeDef *USARTx, uint16_t Data) {
+    if (USARTx != USART2) {
+        return;
+    }
+
+    uint8_t byte = Data & 0xFF;
+    if (write(host_usartFd, &byte, 1) != 1 && errno != EAGAIN && errno != EIO) {
+        fprintf(stderr, "host: USART2 write failed\n");
+    }
+
+    if (host_usartPace) {
+        host_usartTxReady = host_Nanos() + host_usartByteNs;
+    }
+}
+
+uint16_t USART_ReceiveData(USART_TypeDef *USARTx) {
+    return USARTx->DR & 0x1FF;
+}
+
+FlagStatus USART_GetFlagStatus(USART_TypeDef *USARTx, uint16_t USART_FLAG) {
+    if (USART_FLAG == USART_FLAG_TXE || USART_FLAG == USART_FLAG_TC) {
+        if (USARTx != USART2) {
+            return SET;
+        }
+        if (host_usartPace && host_Nanos() < host_usartTxReady) {
+            return RESET;
+        }
+        return host_usartWritable() ? SET : RESET;
+    }
+
+    return (USARTx->SR & USART_FLAG) ? SET : RESET;
+}
+
+void USART_ClearFlag(USART_TypeDef *USARTx, uint16_t USART_FLAG) {
+    USARTx->SR &= ~USART_FLAG;
+}
+
+ITStatus USART_GetITStatus(USART_TypeDef *USARTx, uint16_t USART_IT) {
+    uint32_t flag = 1 << (USART_IT >> 8);
+    uint32_t enable = 1 << (USART_IT & 0x1F);
+
+    if ((USART_IT >> 5 & 0x07) != 0x01 || !(USARTx->CR1 & enable)) {
+        return RESET;
+    }
+
+    return (USARTx->SR & flag) ? SET : RESET;
+}
+
+void USART_ClearITPendingBit(USART_TypeDef *USARTx, uint16_t USART_IT) {
+    USARTx->SR &= ~(1 << (USART_IT >> 8));
+}
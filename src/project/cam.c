@@ -17,6 +17,10 @@
 #include "err.h"
 #include "log.h"
 #include "sdram.h"
+#include "mem.h"
+#include "img.h"
+#include "jpeg.h"
+#include "lz.h"
 #ifdef __OV7670
 #include "ov7670.h"
 #endif
@@ -26,7 +30,26 @@
 #ifdef __WIFI
 #include "wifi.h"
 #endif
+#ifdef __KERN
+#include "kern.h"
+#endif
+#include "prof.h"
+#include "trace.h"
+#include "sched.h"
+#include "tick.h"
+#include "stm32f4xx.h"
 #include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/* @brief Frame slot size for the selected sensor
+ */
+#ifdef __OV7670
+#define CAM_FRAME_SIZE OV7670_IMAGE_BUFSIZE
+#endif
+#ifdef __OV5642
+#define CAM_FRAME_SIZE OV5642_IMAGE_BUFSIZE
+#endif
 
 /* @brief Initialization flag
  */
@@ -36,10 +59,687 @@ static uint8_t cam_initialized = 0;
  */
 static uint8_t cam_configured = 0;
 
+/* @brief Newest complete frame, and the frame being
+ * captured. Each holds a reference to its slot.
+ */
+static sdram_frame_t *volatile cam_frame = NULL;
+static sdram_frame_t *volatile cam_pending = NULL;
+
+#ifdef __KERN
+/* @brief Capture and transfer tasks
+ */
+static kern_task_t cam_captureTcb;
+static kern_task_t cam_transferTcb;
+static uint32_t cam_captureStack[CAM_CAPTURE_STACKSIZE] MEM_CCM __attribute__ ((aligned (8)));
+static uint32_t cam_transferStack[CAM_TRANSFER_STACKSIZE] MEM_CCM __attribute__ ((aligned (8)));
+
+/* @brief Task requests and frame complete signal
+ */
+static kern_sem_t cam_captureReq;
+static kern_sem_t cam_transferReq;
+static kern_sem_t cam_frameDone;
+
+/* @brief What the transfer task sends next
+ */
+static volatile cam_xfer_t cam_xferMode = CAM_XFER_RAW;
+
+/* @brief Keeps the transfer task and the watch task off
+ * each other's encoder state and buffers
+ */
+static kern_mutex_t cam_xferMutex;
+#endif
+
+/* @brief JPEG transfer quality
+ */
+static volatile uint8_t cam_jpegQuality = JPEG_QUALITY_DEFAULT;
+
+/* @brief Delta reference, the frame as the host has it,
+ * and delta transfers until the next keyframe. The
+ * reference slot is held from the first delta transfer.
+ */
+static sdram_frame_t *cam_deltaRef = NULL;
+static volatile uint8_t cam_deltaCount = 0;
+
+/* @brief Pyramid of the newest frame, dropped when the
+ * frame is replaced, and the level thumbnails send
+ */
+static sdram_frame_t *volatile cam_pyramid = NULL;
+static volatile uint8_t cam_thumbLevel = CAM_THUMB_DEFAULT;
+
+/* @brief Frame of the last statistics transfer, for the
+ * motion. Held until the next one.
+ */
+static sdram_frame_t *cam_statsRef = NULL;
+
+/* @brief Statistics being sent, too small for a slot
+ */
+static img_stats_t cam_stats;
+
+/* @brief Change detection state. The background is the
+ * smallest pyramid level's luma in 1/256ths of a level,
+ * set from the first frame watched.
+ */
+static volatile uint8_t cam_watching = 0;
+static volatile uint8_t cam_watchPending = 0;
+static uint8_t cam_watchLoaded = 0;
+static volatile cam_xfer_t cam_watchXfer = CAM_XFER_RAW;
+static volatile uint8_t cam_watchThreshold = CAM_WATCH_THRESHOLD;
+static img_region_t cam_watchRegions[CAM_WATCH_REGIONS] = {
+    {0, 0, 0xFFFF, 0xFFFF, CAM_WATCH_COUNT},
+};
+static uint16_t cam_watchBackground[CAM_WATCH_CELLS] MEM_CCM;
+
+/* @brief Frames completed, and when the newest did
+ */
+static volatile uint32_t cam_frameSeq = 0;
+static volatile uint64_t cam_frameTime = 0;
+
+/* @brief History, the oldest at cam_historyFirst. Whole
+ * frames are added from the interrupt, thumbnails by the
+ * history task into the ring slot, the next at
+ * cam_historyHead. Busy while the thumbnails are sent or
+ * changed.
+ */
+static volatile cam_history_t cam_historyMode = CAM_HISTORY_THUMB;
+static cam_entry_t cam_history[CAM_HISTORY_THUMBS];
+static volatile uint8_t cam_historyFirst = 0;
+static volatile uint8_t cam_historyCount = 0;
+static uint32_t cam_historyHead = 0;
+static sdram_frame_t *cam_historyRing = NULL;
+static volatile uint8_t cam_historyPending = 0;
+static volatile uint8_t cam_historyBusy = 0;
+
+#ifdef __PROF
+/* @brief Cycle count at the start of the last capture,
+ * only frames we asked for are timed
+ */
+static volatile uint32_t cam_captureStart;
+static volatile uint8_t cam_captureTimed = 0;
+#endif
+
 /**************************************
  * Private functions
  */
 
+cam_status_t cam_capture() {
+    // Reuse a frame that never arrived, the DMA may still
+    // be writing it
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (cam_pending == NULL) {
+        cam_pending = sdram_FrameAlloc(CAM_FRAME_SIZE);
+    }
+    sdram_frame_t *frame = cam_pending;
+    __set_PRIMASK(primask);
+
+    if (frame == NULL) {
+        log_Log(CAM, CAM_ERR_NOFRAME, "No free SDRAM frame slot.\0");
+        return CAM_ERR_NOFRAME;
+    }
+    uint32_t addr = frame->sdram_frame_addr;
+
+    trace_Begin(TRACE_CAT_FRAME, 0);
+
+    #ifdef __PROF
+    cam_captureStart = TICK_CYCLES();
+    cam_captureTimed = 1;
+    #endif
+
+    #ifdef __OV7670
+    ov7670_status_t st = ov7670_Capture(addr);
+    if (st == OV7670_INFO_OK) {
+        return CAM_INFO_OK;
+    } else {
+        return CAM_ERR_CAPTURE;
+    }
+    #endif
+
+    #ifdef __OV5642
+    ov5642_status_t st = ov5642_Capture(addr);
+    if (st == OV5642_INFO_OK) {
+        return CAM_INFO_OK;
+    } else {
+        return CAM_ERR_CAPTURE;
+    }
+    #endif
+}
+
+cam_status_t cam_transfer(cam_xfer_t xfer) {
+    // The history holds its own frames
+    if (xfer == CAM_XFER_HISTORY) {
+        return cam_historySend();
+    }
+
+    // Hold the frame, a new capture may replace it meanwhile
+    sdram_frame_t *frame = cam_FrameAcquire();
+    if (frame == NULL) {
+        log_Log(CAM, CAM_ERR_NOFRAME, "No image captured yet.\0");
+        return CAM_ERR_NOFRAME;
+    }
+
+    if (xfer == CAM_XFER_LUMA) {
+        // Pack the Y channel, then the capture is free to go
+        uint32_t pixels = frame->sdram_frame_len/IMG_YUV_BPP;
+        sdram_frame_t *luma = sdram_FrameAlloc(pixels);
+        if (luma == NULL) {
+            sdram_FrameRelease(frame);
+            log_Log(CAM, CAM_ERR_NOFRAME, "No free SDRAM frame slot for the luma.\0");
+            return CAM_ERR_NOFRAME;
+        }
+
+        img_Luma((uint8_t *) luma->sdram_frame_addr, (uint8_t *) frame->sdram_frame_addr, pixels);
+        luma->sdram_frame_len = pixels;
+        sdram_FrameRelease(frame);
+        frame = luma;
+    } else if (xfer == CAM_XFER_JPEG) {
+        // Whole strips only, the OV5642 buffer ends partway
+        // down the frame
+        uint16_t height = frame->sdram_frame_len/(CAM_WIDTH*IMG_YUV_BPP) & ~(JPEG_MCU - 1);
+        sdram_frame_t *jpeg = sdram_FrameAlloc(frame->sdram_frame_len);
+        if (jpeg == NULL) {
+            sdram_FrameRelease(frame);
+            log_Log(CAM, CAM_ERR_NOFRAME, "No free SDRAM frame slot for the JPEG.\0");
+            return CAM_ERR_NOFRAME;
+        }
+
+        uint32_t len = 0;
+        jpeg_status_t st = jpeg_Encode((uint8_t *) jpeg->sdram_frame_addr, jpeg->sdram_frame_size,
+                                       &len, (uint8_t *) frame->sdram_frame_addr,
+                                       CAM_WIDTH, height, cam_jpegQuality);
+        sdram_FrameRelease(frame);
+        if (st != JPEG_INFO_OK) {
+            sdram_FrameRelease(jpeg);
+            log_Log(JPEG, st, "Could not encode the frame.\0");
+            return CAM_ERR_ENCODE;
+        }
+        jpeg->sdram_frame_len = len;
+        frame = jpeg;
+    } else if (xfer == CAM_XFER_DELTA) {
+        uint16_t height = frame->sdram_frame_len/(CAM_WIDTH*IMG_YUV_BPP) & ~(IMG_DELTA_TILE - 1);
+        uint32_t size = IMG_DELTA_MAXSIZE(CAM_WIDTH, height);
+        if (cam_deltaRef == NULL) {
+            cam_deltaRef = sdram_FrameAlloc(CAM_FRAME_SIZE);
+            cam_deltaCount = 0;
+        }
+        sdram_frame_t *delta = sdram_FrameAlloc(size);
+        if (cam_deltaRef == NULL || delta == NULL) {
+            if (delta != NULL) {
+                sdram_FrameRelease(delta);
+            }
+            sdram_FrameRelease(frame);
+            log_Log(CAM, CAM_ERR_NOFRAME, "No free SDRAM frame slot for the delta.\0");
+            return CAM_ERR_NOFRAME;
+        }
+
+        uint32_t len = 0;
+        img_status_t st = img_DeltaEncode((uint8_t *) delta->sdram_frame_addr, size, &len,
+                                          (uint8_t *) frame->sdram_frame_addr,
+                                          (uint8_t *) cam_deltaRef->sdram_frame_addr,
+                                          CAM_WIDTH, height, cam_deltaCount == 0,
+                                          CAM_DELTA_THRESHOLD);
+        sdram_FrameRelease(frame);
+        if (st != IMG_INFO_OK) {
+            // The reference may be half updated
+            cam_deltaCount = 0;
+            sdram_FrameRelease(delta);
+            log_Log(IMG, st, "Could not encode the delta.\0");
+            return CAM_ERR_ENCODE;
+        }
+        cam_deltaCount = (cam_deltaCount + 1) % CAM_DELTA_KEYFRAME;
+        delta->sdram_frame_len = len;
+        frame = delta;
+    } else if (xfer == CAM_XFER_STATS) {
+        uint16_t height = frame->sdram_frame_len/(CAM_WIDTH*IMG_YUV_BPP);
+        img_status_t st = img_Stats(&cam_stats, (uint8_t *) frame->sdram_frame_addr,
+                                    cam_statsRef != NULL ?
+                                    (uint8_t *) cam_statsRef->sdram_frame_addr : NULL,
+                                    CAM_WIDTH, height);
+        if (st != IMG_INFO_OK) {
+            sdram_FrameRelease(frame);
+            log_Log(IMG, st, "Could not measure the frame.\0");
+            return CAM_ERR_ENCODE;
+        }
+
+        // Our reference to the frame moves to cam_statsRef
+        if (cam_statsRef != NULL) {
+            sdram_FrameRelease(cam_statsRef);
+        }
+        cam_statsRef = frame;
+        frame = NULL;
+    } else if (xfer == CAM_XFER_THUMB) {
+        sdram_frame_t *pyramid;
+        cam_status_t st = cam_pyramidAcquire(frame, &pyramid);
+        sdram_FrameRelease(frame);
+        if (st != CAM_INFO_OK) {
+            return st;
+        }
+        frame = pyramid;
+    }
+
+    // A thumbnail is one level of the pyramid, and the
+    // statistics aren't in a frame slot
+    uint8_t *data = (uint8_t *) &cam_stats;
+    uint32_t len = sizeof(cam_stats);
+    if (frame != NULL) {
+        data = (uint8_t *) frame->sdram_frame_addr;
+        len = frame->sdram_frame_len;
+    }
+    if (xfer == CAM_XFER_THUMB) {
+        data = (uint8_t *) img_PyramidLevel(data, cam_thumbLevel, &len);
+    }
+
+    log_Log(CAM, CAM_INFO_OK, "Beginning image transfer.\0");
+
+    // Compressed frames go out as LZ packets
+    if (xfer == CAM_XFER_LZ) {
+        lz_Send(CAM, CAM_INFO_IMAGE, len, data);
+        sdram_FrameRelease(frame);
+        return CAM_INFO_OK;
+    }
+
+    // The packet status tells the host how to read the data
+    #ifdef __WIFI
+    #ifdef __OV7670
+    wifi_Send(CAM, CAM_WARN_UNKNOWN, "abcdefghijuklmnopqrstuvwxyz\0", 0, 0);
+    #endif
+    wifi_Send(CAM, cam_xferStatus(xfer), '\0', len, data);
+    #else
+    log_Log(CAM, cam_xferStatus(xfer), "\0", len, data);
+    #endif
+
+    if (frame != NULL) {
+        sdram_FrameRelease(frame);
+    }
+
+    return CAM_INFO_OK;
+}
+
+cam_status_t cam_pyramidAcquire(sdram_frame_t *frame, sdram_frame_t **pyramid) {
+    // Already built for this frame
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    sdram_frame_t *p = cam_frame == frame ? cam_pyramid : NULL;
+    if (p != NULL) {
+        sdram_FrameRetain(p);
+    }
+    __set_PRIMASK(primask);
+
+    if (p != NULL) {
+        *pyramid = p;
+        return CAM_INFO_OK;
+    }
+
+    uint16_t height = frame->sdram_frame_len/(CAM_WIDTH*IMG_YUV_BPP) & ~(IMG_PYRAMID_YALIGN - 1);
+    uint32_t size = IMG_PYRAMID_SIZE(CAM_WIDTH, height);
+    p = sdram_FrameAlloc(size);
+    if (p == NULL) {
+        log_Log(CAM, CAM_ERR_NOFRAME, "No free SDRAM frame slot for the pyramid.\0");
+        return CAM_ERR_NOFRAME;
+    }
+
+    uint32_t len = 0;
+    img_status_t st = img_Pyramid((uint8_t *) p->sdram_frame_addr, size, &len,
+                                  (uint8_t *) frame->sdram_frame_addr, CAM_WIDTH, height);
+    if (st != IMG_INFO_OK) {
+        sdram_FrameRelease(p);
+        log_Log(IMG, st, "Could not build the pyramid.\0");
+        return CAM_ERR_ENCODE;
+    }
+    p->sdram_frame_len = len;
+
+    // Keep it, unless a new frame came in meanwhile
+    primask = __get_PRIMASK();
+    __disable_irq();
+    if (cam_frame == frame && cam_pyramid == NULL) {
+        sdram_FrameRetain(p);
+        cam_pyramid = p;
+    }
+    __set_PRIMASK(primask);
+
+    *pyramid = p;
+
+    return CAM_INFO_OK;
+}
+
+cam_status_t cam_xferStatus(cam_xfer_t xfer) {
+    switch (xfer) {
+        case CAM_XFER_LUMA:
+            return CAM_INFO_LUMA;
+        case CAM_XFER_JPEG:
+            return CAM_INFO_JPEG;
+        case CAM_XFER_DELTA:
+            return CAM_INFO_DELTA;
+        case CAM_XFER_THUMB:
+            return CAM_INFO_THUMB;
+        case CAM_XFER_STATS:
+            return CAM_INFO_STATS;
+        default:
+            return CAM_INFO_IMAGE;
+    }
+}
+
+void cam_watchTask(void *arg) {
+    cam_watchPending = 0;
+    if (cam_watching == 0) {
+        return;
+    }
+
+    #ifdef __KERN
+    // The transfer task runs below us and may be mid-send
+    uint8_t locked = 0;
+    if (kern_Running()) {
+        kern_MutexLock(&cam_xferMutex, KERN_WAIT_FOREVER);
+        locked = 1;
+    }
+    #endif
+
+    sdram_frame_t *frame = cam_FrameAcquire();
+    sdram_frame_t *pyramid = NULL;
+    cam_status_t st = CAM_ERR_NOFRAME;
+    if (frame != NULL) {
+        st = cam_pyramidAcquire(frame, &pyramid);
+        sdram_FrameRelease(frame);
+    }
+
+    img_motion_t motion;
+    motion.img_motion_region = IMG_MOTION_NONE;
+    if (st == CAM_INFO_OK) {
+        const img_thumb_t *thumb = img_PyramidLevel((uint8_t *) pyramid->sdram_frame_addr,
+                                                    IMG_PYRAMID_LEVELS, NULL);
+        uint16_t width = thumb->img_thumb_width;
+        uint16_t height = thumb->img_thumb_height;
+        if (width*height <= CAM_WATCH_CELLS) {
+            img_Motion(&motion, cam_watchBackground, thumb + 1, width, height,
+                       cam_watchThreshold, cam_watchLoaded ? CAM_WATCH_RATE : 0,
+                       cam_watchRegions, CAM_WATCH_REGIONS);
+            if (!cam_watchLoaded) {
+                motion.img_motion_region = IMG_MOTION_NONE;
+                cam_watchLoaded = 1;
+            }
+        } else {
+            st = CAM_ERR_ENCODE;
+        }
+        sdram_FrameRelease(pyramid);
+    }
+
+    // Send it before the next capture can replace it
+    if (motion.img_motion_region != IMG_MOTION_NONE) {
+        log_Log(CAM, CAM_INFO_MOTION, "\0", sizeof(motion), (uint8_t *) &motion);
+        cam_transfer(cam_watchXfer);
+    }
+
+    #ifdef __KERN
+    if (locked) {
+        kern_MutexUnlock(&cam_xferMutex);
+    }
+    #endif
+
+    if (st == CAM_INFO_OK && cam_watching) {
+        st = cam_capture();
+    }
+    if (st != CAM_INFO_OK) {
+        cam_watching = 0;
+        log_Log(CAM, st, "Stopped watching.\0");
+    }
+}
+
+void cam_send(mod_t module, gen_status_t status, uint32_t len, uint8_t *data) {
+    #ifdef __WIFI
+    wifi_Send(module, status, "\0", len, data);
+    #else
+    log_Log(module, status, "\0", len, data);
+    #endif
+}
+
+void cam_historyPush(sdram_frame_t *frame) {
+    if (cam_historyCount == CAM_HISTORY_FRAMES) {
+        cam_historyDrop();
+    }
+
+    cam_entry_t *e = &cam_history[(cam_historyFirst + cam_historyCount) % CAM_HISTORY_THUMBS];
+    sdram_FrameRetain(frame);
+    e->cam_entry_frame = frame;
+    e->cam_entry_offset = 0;
+    e->cam_entry_len = frame->sdram_frame_len;
+
+    cam_record_t *r = &e->cam_entry_record;
+    r->cam_record_seq = cam_frameSeq;
+    r->cam_record_time = cam_frameTime;
+    r->cam_record_level = 0;
+    r->cam_record_flags = 0;
+    r->cam_record_width = CAM_WIDTH;
+    r->cam_record_height = frame->sdram_frame_len/(CAM_WIDTH*IMG_YUV_BPP);
+    r->cam_record_size = frame->sdram_frame_len;
+
+    cam_historyCount++;
+}
+
+void cam_historyDrop() {
+    cam_entry_t *e = &cam_history[cam_historyFirst];
+    if (e->cam_entry_frame != NULL) {
+        sdram_FrameRelease(e->cam_entry_frame);
+        e->cam_entry_frame = NULL;
+    }
+    cam_historyFirst = (cam_historyFirst + 1) % CAM_HISTORY_THUMBS;
+    cam_historyCount--;
+}
+
+void cam_historyTask(void *arg) {
+    cam_historyPending = 0;
+
+    // The frame and when it completed, unless the
+    // thumbnails are in use
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    sdram_frame_t *frame = NULL;
+    if (cam_historyMode == CAM_HISTORY_THUMB && cam_historyBusy == 0) {
+        frame = cam_frame;
+    }
+    if (frame != NULL) {
+        sdram_FrameRetain(frame);
+        cam_historyBusy = 1;
+    }
+    uint32_t seq = cam_frameSeq;
+    uint64_t time = cam_frameTime;
+    __set_PRIMASK(primask);
+
+    if (frame == NULL) {
+        return;
+    }
+
+    sdram_frame_t *pyramid;
+    cam_status_t st = cam_pyramidAcquire(frame, &pyramid);
+    sdram_FrameRelease(frame);
+    if (st != CAM_INFO_OK) {
+        cam_historyBusy = 0;
+        return;
+    }
+
+    if (cam_historyRing == NULL) {
+        cam_historyRing = sdram_FrameAlloc(CAM_HISTORY_SIZE);
+        cam_historyHead = 0;
+        if (cam_historyRing == NULL) {
+            sdram_FrameRelease(pyramid);
+            cam_historyBusy = 0;
+            log_Log(CAM, CAM_ERR_NOFRAME, "No free SDRAM frame slot for the history.\0");
+            return;
+        }
+    }
+
+    uint8_t level = cam_thumbLevel;
+    uint32_t len = 0;
+    const img_thumb_t *thumb = img_PyramidLevel((uint8_t *) pyramid->sdram_frame_addr, level, &len);
+
+    // Room for it even if it doesn't compress. Past the
+    // end the oldest are those left after the head, then
+    // those it runs over from the start.
+    uint32_t bound = sizeof(lz_header_t) + LZ_BOUND(len);
+    if (cam_historyHead + bound > CAM_HISTORY_SIZE) {
+        while (cam_historyCount > 0 &&
+               cam_history[cam_historyFirst].cam_entry_offset >= cam_historyHead) {
+            cam_historyDrop();
+        }
+        cam_historyHead = 0;
+    }
+    while (cam_historyCount > 0 && (cam_historyCount == CAM_HISTORY_THUMBS ||
+           (cam_history[cam_historyFirst].cam_entry_offset >= cam_historyHead &&
+            cam_history[cam_historyFirst].cam_entry_offset < cam_historyHead + bound))) {
+        cam_historyDrop();
+    }
+
+    // Stored as the LZ packet it will go out as
+    uint8_t *dst = (uint8_t *) cam_historyRing->sdram_frame_addr + cam_historyHead;
+    lz_header_t *header = (lz_header_t *) dst;
+    uint32_t packed = 0;
+    uint8_t flags = 0;
+    if (lz_Compress(dst + sizeof(lz_header_t), bound - sizeof(lz_header_t), &packed,
+                    thumb, len) == LZ_INFO_OK && sizeof(lz_header_t) + packed < len) {
+        header->lz_header_module = CAM;
+        header->lz_header_status = CAM_INFO_THUMB;
+        header->lz_header_size = len;
+        packed += sizeof(lz_header_t);
+        flags = CAM_RECORD_LZ;
+    } else {
+        memcpy(dst, thumb, len);
+        packed = len;
+    }
+
+    cam_entry_t *e = &cam_history[(cam_historyFirst + cam_historyCount) % CAM_HISTORY_THUMBS];
+    e->cam_entry_frame = NULL;
+    e->cam_entry_offset = cam_historyHead;
+    e->cam_entry_len = packed;
+
+    cam_record_t *r = &e->cam_entry_record;
+    r->cam_record_seq = seq;
+    r->cam_record_time = time;
+    r->cam_record_level = level;
+    r->cam_record_flags = flags;
+    r->cam_record_width = thumb->img_thumb_width;
+    r->cam_record_height = thumb->img_thumb_height;
+    r->cam_record_size = len;
+
+    cam_historyCount++;
+    cam_historyHead += (packed + 3) & ~3;
+
+    sdram_FrameRelease(pyramid);
+    cam_historyBusy = 0;
+}
+
+cam_status_t cam_historySend() {
+    cam_entry_t frames[CAM_HISTORY_FRAMES];
+
+    // Whole frames come in from the interrupt, so take
+    // references to them. Thumbnails stay put while busy.
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (cam_historyBusy) {
+        __set_PRIMASK(primask);
+        return CAM_ERR_BUSY;
+    }
+    cam_historyBusy = 1;
+    uint8_t count = cam_historyCount;
+    uint8_t first = cam_historyFirst;
+    uint8_t whole = cam_historyMode == CAM_HISTORY_FRAME;
+    for (uint8_t i = 0; whole && i < count; i++) {
+        frames[i] = cam_history[(first + i) % CAM_HISTORY_THUMBS];
+        sdram_FrameRetain(frames[i].cam_entry_frame);
+    }
+    __set_PRIMASK(primask);
+
+    if (count == 0) {
+        cam_historyBusy = 0;
+        log_Log(CAM, CAM_ERR_NOFRAME, "The history is empty.\0");
+        return CAM_ERR_NOFRAME;
+    }
+
+    log_Log(CAM, CAM_INFO_OK, "Beginning history transfer.\0");
+
+    for (uint8_t i = 0; i < count; i++) {
+        cam_entry_t *e = whole ? &frames[i] : &cam_history[(first + i) % CAM_HISTORY_THUMBS];
+        cam_record_t record = e->cam_entry_record;
+        record.cam_record_index = i;
+        record.cam_record_count = count;
+
+        uint8_t *data;
+        mod_t module = CAM;
+        gen_status_t status;
+        if (whole) {
+            data = (uint8_t *) e->cam_entry_frame->sdram_frame_addr;
+            status = CAM_INFO_IMAGE;
+        } else {
+            data = (uint8_t *) cam_historyRing->sdram_frame_addr + e->cam_entry_offset;
+            status = CAM_INFO_THUMB;
+            if (record.cam_record_flags & CAM_RECORD_LZ) {
+                module = LZ;
+                status = LZ_INFO_PACKET;
+            }
+        }
+
+        cam_send(CAM, CAM_INFO_HISTORY, sizeof(record), (uint8_t *) &record);
+        cam_send(module, status, e->cam_entry_len, data);
+
+        if (whole) {
+            sdram_FrameRelease(e->cam_entry_frame);
+        }
+    }
+
+    cam_historyBusy = 0;
+
+    return CAM_INFO_OK;
+}
+
+#ifdef __KERN
+void cam_captureTask(void *arg) {
+    cam_status_t st;
+    while (1) {
+        kern_SemTake(&cam_captureReq, KERN_WAIT_FOREVER);
+
+        // Drop a stale frame signal from an earlier capture
+        kern_SemTake(&cam_frameDone, KERN_WAIT_NONE);
+        st = cam_capture();
+        if (st == CAM_INFO_OK &&
+            kern_SemTake(&cam_frameDone, CAM_FRAME_TIMEOUT) != KERN_INFO_OK) {
+            st = CAM_ERR_TIMEOUT;
+        }
+
+        if (st == CAM_INFO_OK) {
+            log_Log(CAM, CAM_INFO_OK, "Captured an image into SDRAM.\0");
+
+            // Build the pyramid now, so a thumbnail goes out
+            // as soon as it is asked for
+            sdram_frame_t *frame = cam_FrameAcquire();
+            sdram_frame_t *pyramid;
+            if (frame != NULL) {
+                if (cam_pyramidAcquire(frame, &pyramid) == CAM_INFO_OK) {
+                    sdram_FrameRelease(pyramid);
+                }
+                sdram_FrameRelease(frame);
+            }
+        } else {
+            log_Log(CAM, st, "Could not capture image.\0");
+        }
+    }
+}
+
+void cam_transferTask(void *arg) {
+    cam_status_t st;
+    while (1) {
+        kern_SemTake(&cam_transferReq, KERN_WAIT_FOREVER);
+
+        // Transfer holds its own frame, capture can go ahead
+        kern_MutexLock(&cam_xferMutex, KERN_WAIT_FOREVER);
+        prof_Probe(st = cam_transfer(cam_xferMode), PROF_PROBE_CAM_TRANSFER);
+        kern_MutexUnlock(&cam_xferMutex);
+
+        if (st == CAM_INFO_OK) {
+            log_Log(CAM, CAM_INFO_OK, "Successfully transferred image.\0");
+        } else {
+            log_Log(CAM, st, "Could not transfer image to debug interface.\0");
+        }
+    }
+}
+#endif
+
 /**************************************
  * Public functions
  */
@@ -109,27 +809,62 @@ cam_status_t cam_Capture() {
     if (cam_configured != 1) {
         return CAM_ERR_CONFIG;
     }
-    
-    #ifdef __OV7670
-    ov7670_status_t st = ov7670_Capture();
-    if (st == OV7670_INFO_OK) {
-        return CAM_INFO_OK;
-    } else {
-        return CAM_ERR_CAPTURE;
+
+    #ifdef __KERN
+    if (kern_Running()) {
+        kern_SemGive(&cam_captureReq);
+        return CAM_INFO_QUEUED;
     }
     #endif
 
-    #ifdef __OV5642
-    ov5642_status_t st = ov5642_Capture();
-    if (st == OV5642_INFO_OK) {
-        return CAM_INFO_OK;
-    } else {
-        return CAM_ERR_CAPTURE;
+    return cam_capture();
+}
+
+cam_status_t cam_Transfer(cam_xfer_t xfer) {
+    // Check if initialized
+    if (cam_initialized != 1) {
+        return CAM_ERR_INIT;
+    }
+
+    // Check if configured
+    if (cam_configured != 1) {
+        return CAM_ERR_CONFIG;
+    }
+
+    #ifdef __KERN
+    if (kern_Running()) {
+        cam_xferMode = xfer;
+        kern_SemGive(&cam_transferReq);
+        return CAM_INFO_QUEUED;
     }
     #endif
+
+    cam_status_t st;
+    prof_Probe(st = cam_transfer(xfer), PROF_PROBE_CAM_TRANSFER);
+    return st;
+}
+
+cam_status_t cam_JpegQuality(uint8_t quality) {
+    if (quality < JPEG_QUALITY_MIN || quality > JPEG_QUALITY_MAX) {
+        return CAM_ERR_QUALITY;
+    }
+
+    cam_jpegQuality = quality;
+
+    return CAM_INFO_OK;
+}
+
+cam_status_t cam_ThumbLevel(uint8_t level) {
+    if (level == 0 || level > IMG_PYRAMID_LEVELS) {
+        return CAM_ERR_LEVEL;
+    }
+
+    cam_thumbLevel = level;
+
+    return CAM_INFO_OK;
 }
 
-cam_status_t cam_Transfer() {
+cam_status_t cam_WatchStart(cam_xfer_t xfer, uint8_t threshold) {
     // Check if initialized
     if (cam_initialized != 1) {
         return CAM_ERR_INIT;
@@ -139,31 +874,157 @@ cam_status_t cam_Transfer() {
     if (cam_configured != 1) {
         return CAM_ERR_CONFIG;
     }
-    
-    log_Log(CAM, CAM_INFO_OK, "Beginning image transfer.\0");
 
-    #ifdef __WIFI
-    
-    #ifdef __OV7670
-    wifi_Send(CAM, CAM_WARN_UNKNOWN, "abcdefghijuklmnopqrstuvwxyz\0", 0, 0);
-    wifi_Send(CAM, CAM_INFO_IMAGE, '\0', OV7670_IMAGE_BUFSIZE, (uint8_t *) SDRAM_IMAGEADDR);
-    #endif
+    if (xfer > CAM_XFER_HISTORY) {
+        return CAM_ERR_TRANSFER;
+    }
 
-    #ifdef __OV5642
-    wifi_Send(CAM, CAM_INFO_IMAGE, '\0', OV5642_IMAGE_BUFSIZE, (uint8_t *) SDRAM_IMAGEADDR);
-    #endif
+    cam_watchXfer = xfer;
+    cam_watchThreshold = threshold;
+    if (cam_watching) {
+        return CAM_INFO_OK;
+    }
 
-    #else
+    cam_watchLoaded = 0;
+    cam_watching = 1;
+    cam_status_t st = cam_capture();
+    if (st != CAM_INFO_OK) {
+        cam_watching = 0;
+    }
 
-    #ifdef __OV7670    
-    log_Log(CAM, CAM_INFO_IMAGE, "\0", OV7670_IMAGE_BUFSIZE, (uint8_t *) SDRAM_IMAGEADDR);
-    #endif
+    return st;
+}
 
-    #ifdef __OV5642
-    log_Log(CAM, CAM_INFO_IMAGE, "\0", OV5642_IMAGE_BUFSIZE, (uint8_t *) SDRAM_IMAGEADDR);
+cam_status_t cam_WatchStop() {
+    cam_watching = 0;
+
+    return CAM_INFO_OK;
+}
+
+cam_status_t cam_WatchRegion(uint8_t index, const img_region_t *region) {
+    if (index >= CAM_WATCH_REGIONS || region == NULL) {
+        return CAM_ERR_REGION;
+    }
+
+    cam_watchRegions[index] = *region;
+
+    return CAM_INFO_OK;
+}
+
+cam_status_t cam_HistoryMode(cam_history_t mode) {
+    if (mode > CAM_HISTORY_THUMB) {
+        return CAM_ERR_MODE;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (cam_historyBusy) {
+        __set_PRIMASK(primask);
+        return CAM_ERR_BUSY;
+    }
+    cam_historyMode = mode;
+    while (cam_historyCount > 0) {
+        cam_historyDrop();
+    }
+    cam_historyHead = 0;
+    __set_PRIMASK(primask);
+
+    // Only thumbnails use the ring
+    if (cam_historyRing != NULL && mode != CAM_HISTORY_THUMB) {
+        sdram_FrameRelease(cam_historyRing);
+        cam_historyRing = NULL;
+    }
+
+    return CAM_INFO_OK;
+}
+
+sdram_frame_t *cam_FrameAcquire() {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    sdram_frame_t *frame = cam_frame;
+    if (frame != NULL) {
+        sdram_FrameRetain(frame);
+    }
+    __set_PRIMASK(primask);
+
+    return frame;
+}
+
+void cam_DeltaKeyframe() {
+    cam_deltaCount = 0;
+}
+
+void cam_FrameComplete() {
+    trace_End(TRACE_CAT_FRAME, 0);
+
+    // The new frame replaces the old one, which lives on
+    // as long as a transfer holds it
+    if (cam_pending != NULL) {
+        cam_pending->sdram_frame_len = CAM_FRAME_SIZE;
+        if (cam_frame != NULL) {
+            sdram_FrameRelease(cam_frame);
+        }
+        if (cam_pyramid != NULL) {
+            sdram_FrameRelease(cam_pyramid);
+            cam_pyramid = NULL;
+        }
+        cam_frame = cam_pending;
+        cam_pending = NULL;
+        cam_frameSeq++;
+        cam_frameTime = tick_Now();
+
+        // A thumbnail goes in before the watch task looks,
+        // so a history it sends ends with this frame
+        if (cam_historyMode == CAM_HISTORY_FRAME) {
+            cam_historyPush(cam_frame);
+        } else if (cam_historyMode == CAM_HISTORY_THUMB && cam_historyPending == 0) {
+            cam_historyPending = 1;
+            if (sched_Post(SCHED_PRIO_BACKGROUND, cam_historyTask, NULL) != SCHED_INFO_OK) {
+                cam_historyPending = 0;
+            }
+        }
+    }
+
+    #ifdef __PROF
+    if (cam_captureTimed) {
+        prof_Record(PROF_PROBE_CAM_CAPTURE, TICK_CYCLES() - cam_captureStart);
+        cam_captureTimed = 0;
+    }
     #endif
 
+    // Check it outside the interrupt. Pending is set first,
+    // the task may run before sched_Post() returns.
+    if (cam_watching && cam_watchPending == 0) {
+        cam_watchPending = 1;
+        if (sched_Post(SCHED_PRIO_BACKGROUND, cam_watchTask, NULL) != SCHED_INFO_OK) {
+            cam_watchPending = 0;
+        }
+    }
+
+    #ifdef __KERN
+    kern_SemGive(&cam_frameDone);
     #endif
+}
+
+#ifdef __KERN
+cam_status_t cam_TaskCreate() {
+    kern_SemInit(&cam_captureReq, 0, 1);
+    kern_SemInit(&cam_transferReq, 0, 1);
+    kern_SemInit(&cam_frameDone, 0, 1);
+    kern_MutexInit(&cam_xferMutex);
+
+    kern_status_t st = kern_TaskCreate(&cam_captureTcb, "capture", cam_captureTask, NULL,
+                                       CAM_CAPTURE_PRIO, cam_captureStack, CAM_CAPTURE_STACKSIZE);
+    if (st != KERN_INFO_OK) {
+        return CAM_ERR_INIT;
+    }
+
+    st = kern_TaskCreate(&cam_transferTcb, "transfer", cam_transferTask, NULL,
+                         CAM_TRANSFER_PRIO, cam_transferStack, CAM_TRANSFER_STACKSIZE);
+    if (st != KERN_INFO_OK) {
+        return CAM_ERR_INIT;
+    }
 
     return CAM_INFO_OK;
 }
+#endif
@@ -17,6 +17,14 @@
 #include "sdram.h"
 #include "cam.h"
 #include "prof.h"
+#include "sched.h"
+#include "tick.h"
+#include "trace.h"
+#include "mon.h"
+#include "mem.h"
+#if defined(__TEST) && defined(__LOG)
+#include "bench.h"
+#endif
 #include "stm32f4xx_gpio.h"
 #include "stm32f4xx_rcc.h"
 #include <stdint.h>
@@ -39,6 +47,10 @@ static cmd_queue_t *cmd_queue;
  */
 static uint8_t cmd_initialized;
 
+/* @brief command task posted flag
+ */
+static volatile uint8_t cmd_taskPending = 0;
+
 #ifdef __CMD
 /* @brief UART2 Rx cmd buffer
  */
@@ -73,7 +85,7 @@ cmd_status_t cmd_queueInit() {
 
     // Allocate space for queue
     cmd_queue = NULL;
-    cmd_queue = (cmd_queue_t *) malloc(sizeof(cmd_queue_t));
+    cmd_queue = (cmd_queue_t *) mem_Malloc(sizeof(cmd_queue_t));
 
     if (cmd_queue == NULL) {
         log_Log(CMD, CMD_ERR_MALLOC, "Couldn't initialize cmd_queue memory.\0");
@@ -81,7 +93,7 @@ cmd_status_t cmd_queueInit() {
     } 
 
     cmd_queue->cmd_queue_buf = NULL;
-    cmd_queue->cmd_queue_buf = (cmd_cmd_t **) malloc(sizeof(cmd_cmd_t *)*CMD_QUEUE_CAP);
+    cmd_queue->cmd_queue_buf = (cmd_cmd_t **) mem_Malloc(sizeof(cmd_cmd_t *)*CMD_QUEUE_CAP);
     if (cmd_queue->cmd_queue_buf == NULL) {
         log_Log(CMD, CMD_ERR_MALLOC, "Couldn't initialize cmd_queue_buf memory.\0");
         return CMD_ERR_MALLOC;
@@ -105,7 +117,7 @@ cmd_status_t cmd_uartInit() {
 
    // Initialize command buffer
     cmd_uartBuf = NULL;
-    cmd_uartBuf = (cmd_cmd_t *) malloc(sizeof(cmd_cmd_t));
+    cmd_uartBuf = (cmd_cmd_t *) mem_Malloc(sizeof(cmd_cmd_t));
     
     // Check for failure
     if (cmd_uartBuf == NULL) {
@@ -174,6 +186,9 @@ cmd_status_t cmd_uartInit() {
 }
 
 void USART2_IRQHandler(void) {
+    trace_Begin(TRACE_CAT_IRQ, USART2_IRQn);
+    mon_IrqEnter(MON_IRQ_USART2);
+
     if (USART_GetITStatus(USART2, USART_IT_RXNE)) {
         uint8_t ch = USART2->DR;      
 
@@ -192,7 +207,7 @@ void USART2_IRQHandler(void) {
             cmd_uartDataSize += ch << 8;
             // We're done if no data
             if (cmd_uartDataSize != 0) {
-                cmd_uartBuf->cmd_data = (uint8_t *) malloc(cmd_uartDataSize);
+                cmd_uartBuf->cmd_data = (uint8_t *) mem_Malloc(cmd_uartDataSize);
                 cmd_uartTotal += cmd_uartDataSize;
             }
         }
@@ -219,7 +234,7 @@ void USART2_IRQHandler(void) {
                 cmdCopy->cmd_dataLen = cmd_uartBuf->cmd_dataLen;
 
                 // Don't need the data that CmdAllocate made for this
-                free(cmdCopy->cmd_data);
+                mem_Free(cmdCopy->cmd_data);
                 cmdCopy->cmd_data = cmd_uartBuf->cmd_data;
               
                 // Add command to queue
@@ -228,6 +243,15 @@ void USART2_IRQHandler(void) {
                     log_Log(CMD, st, "Could not add command to queue.\0");
                 }
 
+                // Wake the command task
+                if (st == CMD_INFO_OK && cmd_taskPending == 0) {
+                    if (sched_Post(SCHED_PRIO_CMD, cmd_task, NULL) == SCHED_INFO_OK) {
+                        cmd_taskPending = 1;
+                    } else {
+                        log_Log(CMD, CMD_ERR_SCHED, "Could not post command task.\0");
+                    }
+                }
+
                 // Zero out cmd buffer
                 cmd_uartBuf->cmd_module = 0;
                 cmd_uartBuf->cmd_func = 0;
@@ -236,10 +260,65 @@ void USART2_IRQHandler(void) {
             }         
         }
     }
+
+    mon_IrqExit(MON_IRQ_USART2);
+    trace_End(TRACE_CAT_IRQ, USART2_IRQn);
 }
 
 #endif
 
+void cmd_task(void *arg) {
+    cmd_cmd_t *cmd;
+    cmd_status_t st;
+
+    // The UART interrupt also uses the queue
+    __disable_irq();
+    if (cmd_QueueGetStatus() == CMD_INFO_QUEUEEMPTY) {
+        cmd_taskPending = 0;
+        __enable_irq();
+        return;
+    }
+    st = cmd_QueueGet(&cmd);
+    if (st != CMD_INFO_OK) {
+        // Let the next command post us again
+        cmd_taskPending = 0;
+    }
+    __enable_irq();
+    if (st != CMD_INFO_OK) {
+        log_Log(CMD, st, "Command queue entered invalid state.\0");
+        return;
+    }
+
+    trace_Begin(TRACE_CAT_CMD, cmd->cmd_module << 8 | cmd->cmd_func);
+    prof_Probe(cmd_Execute(cmd), PROF_PROBE_CMD_EXECUTE);
+    trace_End(TRACE_CAT_CMD, cmd->cmd_module << 8 | cmd->cmd_func);
+
+    // Free memory, pass warning about freeing freed memory
+    st = cmd_CmdDeallocate(cmd);
+    if (st != CMD_INFO_OK && st != CMD_WARN_FREE) {
+        log_Log(CMD, st);
+    }
+
+    // Yield between commands, run again if there are more.
+    // Past a full command queue, try the background queue.
+    __disable_irq();
+    sched_status_t s_st = SCHED_INFO_OK;
+    if (cmd_QueueGetStatus() == CMD_INFO_QUEUEEMPTY) {
+        cmd_taskPending = 0;
+    } else if (sched_Post(SCHED_PRIO_CMD, cmd_task, NULL) != SCHED_INFO_OK) {
+        s_st = sched_Post(SCHED_PRIO_BACKGROUND, cmd_task, NULL);
+        if (s_st != SCHED_INFO_OK) {
+            cmd_taskPending = 0;
+        }
+    }
+    __enable_irq();
+
+    // The rest wait for the next command to post us
+    if (s_st != SCHED_INFO_OK) {
+        log_Log(CMD, CMD_ERR_SCHED, "Could not post command task, commands are waiting.\0");
+    }
+}
+
 /**************************************
  * Public functions
  */
@@ -251,14 +330,14 @@ cmd_status_t cmd_CmdDeallocate(cmd_cmd_t *cmd) {
         return CMD_WARN_FREE;
     }
     if (cmd->cmd_data == NULL) {
-        free(cmd);
+        mem_Free(cmd);
         // We don't log a warning here because this is expected on commands with no data
         return CMD_WARN_FREE;
     }
     
     // Free the data
-    free(cmd->cmd_data);
-    free(cmd);
+    mem_Free(cmd->cmd_data);
+    mem_Free(cmd);
 
     return CMD_INFO_OK;
 }
@@ -271,7 +350,7 @@ cmd_status_t cmd_CmdAllocate(cmd_cmd_t **cmd, uint16_t dataLen) {
 
     // Allocate struct
     *cmd = NULL;
-    *cmd = (cmd_cmd_t *) malloc(sizeof(cmd_cmd_t));
+    *cmd = (cmd_cmd_t *) mem_Malloc(sizeof(cmd_cmd_t));
     if (*cmd == NULL) {
         log_Log(CMD, CMD_ERR_MALLOC, "Could not allocate command structure.\0");
         return CMD_ERR_MALLOC;
@@ -280,7 +359,7 @@ cmd_status_t cmd_CmdAllocate(cmd_cmd_t **cmd, uint16_t dataLen) {
     // Allocate data in struct
     (*cmd)->cmd_data = NULL;
     if (dataLen != 0) {
-        (*cmd)->cmd_data = (uint8_t *) malloc(dataLen);
+        (*cmd)->cmd_data = (uint8_t *) mem_Malloc(dataLen);
         if ((*cmd)->cmd_data == NULL) {
             log_Log(CMD, CMD_ERR_MALLOC, "Could not allocate command data.\0");
             return CMD_ERR_MALLOC;
@@ -396,222 +475,564 @@ cmd_status_t cmd_Init() {
 
 }
 
-cmd_status_t cmd_Loop() {
-    cmd_cmd_t *cmd;
-    cmd_status_t st;
-    while(1) {
-        // Spin on empty queue
-        while (cmd_QueueGetStatus() == CMD_INFO_QUEUEEMPTY) {}
-        if (cmd_QueueGetStatus() == CMD_ERR_QUEUEINVALID) {
-            log_Log(CMD, CMD_ERR_QUEUEINVALID, "Command Queue entered invalid state.\0");
-            return CMD_ERR_QUEUEINVALID;
-        } 
-
-        // Get function
-        cmd_QueueGet(&cmd);
+cmd_status_t cmd_Execute(cmd_cmd_t *cmd) {
+    if (cmd == NULL) {
+        log_Log(CMD, CMD_ERR_NULLPTR, "cmd_Execute parameter cannot be NULL.\0");
+        return CMD_ERR_NULLPTR;
+    }
 
-        // Route function request
-        switch (cmd->cmd_module) {
-        case LOG:
-            switch (cmd->cmd_func) {
-                #ifdef __LOG
-                case LOG_FUNC_INIT:
-                    if (cmd->cmd_data != 0) {
-                        log_Log(CMD, CMD_ERR_DATA, "Initialization command should not have data.\0");
-                    }
-                    log_status_t log_st = log_Init();
-                    if (log_st == LOG_INFO_OK) {
-                        log_Log(LOG, LOG_INFO_OK, "Initialized Logger.\0");
-                    } else if (log_st == LOG_WARN_ALINIT){
-                        log_Log(LOG, LOG_WARN_ALINIT, "Logger is already initialized.\0");
-                    } else {                       
-                        log_Log(LOG, log_st, "Failed to initialize log.\0");
-                    }
-                    
-                    break;
-                #endif
-                default:
-                    log_Log(CMD, CMD_ERR_NOFUNC, "Tried to call a log function that doesn't exist.\0", 
-                            1, &(cmd->cmd_func));
-                    break;
+    // Route function request
+    switch (cmd->cmd_module) {
+    case LOG:
+        switch (cmd->cmd_func) {
+            #ifdef __LOG
+            case LOG_FUNC_INIT:
+                if (cmd->cmd_data != 0) {
+                    log_Log(CMD, CMD_ERR_DATA, "Initialization command should not have data.\0");
+                }
+                log_status_t log_st = log_Init();
+                if (log_st == LOG_INFO_OK) {
+                    log_Log(LOG, LOG_INFO_OK, "Initialized Logger.\0");
+                } else if (log_st == LOG_WARN_ALINIT){
+                    log_Log(LOG, LOG_WARN_ALINIT, "Logger is already initialized.\0");
+                } else {                       
+                    log_Log(LOG, log_st, "Failed to initialize log.\0");
+                }
+                
+                break;
+            #endif
+            default:
+                log_Log(CMD, CMD_ERR_NOFUNC, "Tried to call a log function that doesn't exist.\0", 
+                        1, &(cmd->cmd_func));
+                break;
  
+        }
+        break;
+    case CMD:
+        switch (cmd->cmd_func) {
+            case CMD_FUNC_INIT:
+                if (cmd->cmd_data != 0) {
+                    log_Log(CMD, CMD_ERR_DATA, "Initialization command should not have data.\0");
+                }
+                cmd_status_t cmd_st = cmd_Init();
+                if (cmd_st == CMD_INFO_OK) {
+                    log_Log(CMD, CMD_INFO_OK, "Initialized command module.\0");
+                } else if (cmd_st == CMD_WARN_ALINIT) {
+                    log_Log(CMD, CMD_WARN_ALINIT, "Command module already initialized.\0");
+                } else {
+                    log_Log(CMD, cmd_st, "Failed to initialize log\0");
+                }                    
+                break;
+            default:
+                log_Log(CMD, CMD_ERR_NOFUNC, "Tried to call a log function that doesn't exist.\0", 
+                        1, &(cmd->cmd_func));
+                break;
+        }
+        break;
+    case STDLIB:
+        switch (cmd->cmd_func) {
+            default:
+                log_Log(CMD, CMD_ERR_NOFUNC, "Tried to call a stdlib function that doesn't exist.\0", 
+                        1, &(cmd->cmd_func));        
             }
             break;
-        case CMD:
-            switch (cmd->cmd_func) {
-                case CMD_FUNC_INIT:
-                    if (cmd->cmd_data != 0) {
-                        log_Log(CMD, CMD_ERR_DATA, "Initialization command should not have data.\0");
+    case SDRAM:
+        switch (cmd->cmd_func) {
+            case SDRAM_FUNC_INIT:
+                if (cmd->cmd_data != 0) {
+                    log_Log(CMD, CMD_ERR_DATA, "Initialization command should not have data.\0");
+                }
+                sdram_status_t sd_st = sdram_Init();
+                if (sd_st == SDRAM_INFO_OK) {
+                    log_Log(SDRAM, SDRAM_INFO_OK, "Initialized SDRAM interface.\0");
+                } else if (sd_st == SDRAM_WARN_ALINIT) {
+                    log_Log(SDRAM, SDRAM_WARN_ALINIT, "SDRAM already initialized.\0");
+                } else {
+                    log_Log(SDRAM, sd_st, "Failed to initialize SDRAM.\0");
+                }                    
+                break;
+            default:
+                log_Log(CMD, CMD_ERR_NOFUNC, "Tried to call an SDRAM function that doesn't exist.\0", 
+                        1, &(cmd->cmd_func));
+                break;
+ 
+        }
+        break;
+    case PROF:
+        switch (cmd->cmd_func) {
+            #ifdef __PROF
+            case PROF_FUNC_INIT:
+                if (cmd->cmd_data != 0) {
+                    log_Log(CMD, CMD_ERR_DATA, "Initialization command should not have data.\0");
+                }
+                prof_status_t p_st = prof_Init();
+                if (p_st == PROF_INFO_OK) {
+                    log_Log(PROF, PROF_INFO_OK, "Initialized profiler.\0");
+                } else if (p_st == PROF_WARN_ALINIT) {
+                    log_Log(PROF, PROF_WARN_ALINIT, "Profiler already initialized.\0");
+                } else {
+                    log_Log(PROF, p_st, "Failed to initialize profiler.\0");
+                }                    
+                break;
+            case PROF_FUNC_FLUSH:
+                if (cmd->cmd_data != 0) {
+                    log_Log(CMD, CMD_ERR_DATA, "Flush command should not have data.\0");
+                }
+                prof_Flush();
+                break;
+            case PROF_FUNC_DUMP:
+                if (cmd->cmd_data != 0) {
+                    log_Log(CMD, CMD_ERR_DATA, "Dump command should not have data.\0");
+                }
+                prof_Dump();
+                break;
+            case PROF_FUNC_RESET:
+                if (cmd->cmd_data != 0) {
+                    log_Log(CMD, CMD_ERR_DATA, "Reset command should not have data.\0");
+                }
+                prof_Reset();
+                log_Log(PROF, PROF_INFO_OK, "Reset profiler probes.\0");
+                break;
+            case PROF_FUNC_SAMPLE_START:
+                if (cmd->cmd_data != 0) {
+                    log_Log(CMD, CMD_ERR_DATA, "Sample command should not have data.\0");
+                }
+                prof_SampleStart();
+                log_Log(PROF, PROF_INFO_OK, "Started PC sampling.\0");
+                break;
+            case PROF_FUNC_SAMPLE_STOP:
+                if (cmd->cmd_data != 0) {
+                    log_Log(CMD, CMD_ERR_DATA, "Sample command should not have data.\0");
+                }
+                prof_SampleStop();
+                log_Log(PROF, PROF_INFO_OK, "Stopped PC sampling.\0");
+                break;
+            case PROF_FUNC_SAMPLE_DUMP:
+                if (cmd->cmd_data != 0) {
+                    log_Log(CMD, CMD_ERR_DATA, "Sample command should not have data.\0");
+                }
+                prof_SampleDump();
+                break;
+            #endif
+            default:
+                log_Log(CMD, CMD_ERR_NOFUNC, "Tried to call a profiler function that doesn't exist.\0", 
+                        1, &(cmd->cmd_func));
+                break;
+        }
+        break;
+    case CAM:
+        switch (cmd->cmd_func) {
+            case CAM_FUNC_INIT:
+                if (cmd->cmd_data != 0) {
+                    log_Log(CMD, CMD_ERR_DATA, "Initialization command should not have data.\0");
+                }
+                cam_status_t c_st = cam_Init();
+                if (c_st == CAM_INFO_OK) {
+                    log_Log(CAM, CAM_INFO_OK, "Initialized camera module.\0");
+                } else if (c_st == CAM_WARN_ALINIT) {
+                    log_Log(CAM, CAM_WARN_ALINIT, "Camera module already initialized.\0");
+                } else {
+                    log_Log(CAM, c_st, "Failed to initialize camera.\0");
+                }                    
+                break;
+            case CAM_FUNC_CONFIG:
+                if (cmd->cmd_data != 0) {
+                    log_Log(CMD, CMD_ERR_DATA, "Configuration command should not have data.\0");
+                }
+                c_st = cam_Configure();
+                if (c_st == CAM_INFO_OK) {
+                    log_Log(CAM, CAM_INFO_OK, "Configured camera module.\0");
+                } else if (c_st == CAM_WARN_ALCONF) {
+                    log_Log(CAM, CAM_WARN_ALCONF, "Camera module already configured.\0");
+                } else {
+                    log_Log(CAM, c_st, "Failed to configure camera.\0");
+                }                    
+                break;
+            case CAM_FUNC_CAPTURE:
+                if (cmd->cmd_data != 0) {
+                    log_Log(CMD, CMD_ERR_DATA, "Camera capture command should not have data.\0");
+                }
+                c_st = cam_Capture();
+                if (c_st == CAM_INFO_OK) {
+                    log_Log(CAM, CAM_INFO_OK, "Captured an image into SDRAM.\0");
+                } else if (c_st == CAM_INFO_QUEUED) {
+                    log_Log(CAM, CAM_INFO_QUEUED, "Queued image capture.\0");
+                } else {
+                    log_Log(CAM, c_st, "Could not capture image.\0");
+                }                    
+                break;
+            case CAM_FUNC_TRANSFER:
+                if (cmd->cmd_data != 0) {
+                    log_Log(CMD, CMD_ERR_DATA, "Camera transfer command should not have data.\0");
+                }
+                c_st = cam_Transfer(CAM_XFER_RAW);
+                if (c_st == CAM_INFO_OK) {
+                    log_Log(CAM, CAM_INFO_OK, "Successfully transferred image.\0");
+                } else if (c_st == CAM_INFO_QUEUED) {
+                    log_Log(CAM, CAM_INFO_QUEUED, "Queued image transfer.\0");
+                } else {
+                    log_Log(CAM, c_st, "Could not transfer image to debug interface.\0");
+                }                    
+                break;
+            case CAM_FUNC_TRANSFER_LUMA:
+                if (cmd->cmd_data != 0) {
+                    log_Log(CMD, CMD_ERR_DATA, "Camera transfer command should not have data.\0");
+                }
+                c_st = cam_Transfer(CAM_XFER_LUMA);
+                if (c_st == CAM_INFO_OK) {
+                    log_Log(CAM, CAM_INFO_OK, "Successfully transferred luma.\0");
+                } else if (c_st == CAM_INFO_QUEUED) {
+                    log_Log(CAM, CAM_INFO_QUEUED, "Queued luma transfer.\0");
+                } else {
+                    log_Log(CAM, c_st, "Could not transfer luma to debug interface.\0");
+                }                    
+                break;
+            case CAM_FUNC_TRANSFER_JPEG:
+                // An optional quality byte, kept for later
+                // transfers
+                if (cmd->cmd_dataLen > 1) {
+                    log_Log(CMD, CMD_ERR_DATA, "JPEG transfer command takes one byte of data.\0");
+                    break;
+                }
+                if (cmd->cmd_dataLen == 1) {
+                    c_st = cam_JpegQuality(cmd->cmd_data[0]);
+                    if (c_st != CAM_INFO_OK) {
+                        log_Log(CAM, c_st, "JPEG quality must be 1 to 100.\0");
+                        break;
                     }
-                    cmd_status_t cmd_st = cmd_Init();
-                    if (cmd_st == CMD_INFO_OK) {
-                        log_Log(CMD, CMD_INFO_OK, "Initialized command module.\0");
-                    } else if (cmd_st == CMD_WARN_ALINIT) {
-                        log_Log(CMD, CMD_WARN_ALINIT, "Command module already initialized.\0");
-                    } else {
-                        log_Log(CMD, cmd_st, "Failed to initialize log\0");
-                    }                    
+                }
+                c_st = cam_Transfer(CAM_XFER_JPEG);
+                if (c_st == CAM_INFO_OK) {
+                    log_Log(CAM, CAM_INFO_OK, "Successfully transferred JPEG.\0");
+                } else if (c_st == CAM_INFO_QUEUED) {
+                    log_Log(CAM, CAM_INFO_QUEUED, "Queued JPEG transfer.\0");
+                } else {
+                    log_Log(CAM, c_st, "Could not transfer JPEG to debug interface.\0");
+                }                    
+                break;
+            case CAM_FUNC_TRANSFER_DELTA:
+                // An optional byte, 1 for a keyframe
+                if (cmd->cmd_dataLen > 1) {
+                    log_Log(CMD, CMD_ERR_DATA, "Delta transfer command takes one byte of data.\0");
                     break;
-                default:
-                    log_Log(CMD, CMD_ERR_NOFUNC, "Tried to call a log function that doesn't exist.\0", 
-                            1, &(cmd->cmd_func));
+                }
+                if (cmd->cmd_dataLen == 1 && cmd->cmd_data[0] != 0) {
+                    cam_DeltaKeyframe();
+                }
+                c_st = cam_Transfer(CAM_XFER_DELTA);
+                if (c_st == CAM_INFO_OK) {
+                    log_Log(CAM, CAM_INFO_OK, "Successfully transferred delta.\0");
+                } else if (c_st == CAM_INFO_QUEUED) {
+                    log_Log(CAM, CAM_INFO_QUEUED, "Queued delta transfer.\0");
+                } else {
+                    log_Log(CAM, c_st, "Could not transfer delta to debug interface.\0");
+                }                    
+                break;
+            case CAM_FUNC_TRANSFER_LZ:
+                if (cmd->cmd_data != 0) {
+                    log_Log(CMD, CMD_ERR_DATA, "Camera transfer command should not have data.\0");
+                }
+                c_st = cam_Transfer(CAM_XFER_LZ);
+                if (c_st == CAM_INFO_OK) {
+                    log_Log(CAM, CAM_INFO_OK, "Successfully transferred compressed image.\0");
+                } else if (c_st == CAM_INFO_QUEUED) {
+                    log_Log(CAM, CAM_INFO_QUEUED, "Queued compressed image transfer.\0");
+                } else {
+                    log_Log(CAM, c_st, "Could not transfer compressed image to debug interface.\0");
+                }                    
+                break;
+            case CAM_FUNC_TRANSFER_THUMB:
+                // An optional pyramid level, kept for later
+                // transfers
+                if (cmd->cmd_dataLen > 1) {
+                    log_Log(CMD, CMD_ERR_DATA, "Thumbnail transfer command takes one byte of data.\0");
                     break;
-            }
-            break;
-        case STDLIB:
-            switch (cmd->cmd_func) {
-                default:
-                    log_Log(CMD, CMD_ERR_NOFUNC, "Tried to call a stdlib function that doesn't exist.\0", 
-                            1, &(cmd->cmd_func));        
-                }
-                break;
-        case SDRAM:
-            switch (cmd->cmd_func) {
-                case SDRAM_FUNC_INIT:
-                    if (cmd->cmd_data != 0) {
-                        log_Log(CMD, CMD_ERR_DATA, "Initialization command should not have data.\0");
+                }
+                if (cmd->cmd_dataLen == 1) {
+                    c_st = cam_ThumbLevel(cmd->cmd_data[0]);
+                    if (c_st != CAM_INFO_OK) {
+                        log_Log(CAM, c_st, "Thumbnail level must be 1 to 3.\0");
+                        break;
                     }
-                    sdram_status_t sd_st = sdram_Init();
-                    if (sd_st == SDRAM_INFO_OK) {
-                        log_Log(SDRAM, SDRAM_INFO_OK, "Initialized SDRAM interface.\0");
-                    } else if (sd_st == SDRAM_WARN_ALINIT) {
-                        log_Log(SDRAM, SDRAM_WARN_ALINIT, "SDRAM already initialized.\0");
-                    } else {
-                        log_Log(SDRAM, sd_st, "Failed to initialize SDRAM.\0");
-                    }                    
+                }
+                c_st = cam_Transfer(CAM_XFER_THUMB);
+                if (c_st == CAM_INFO_OK) {
+                    log_Log(CAM, CAM_INFO_OK, "Successfully transferred thumbnail.\0");
+                } else if (c_st == CAM_INFO_QUEUED) {
+                    log_Log(CAM, CAM_INFO_QUEUED, "Queued thumbnail transfer.\0");
+                } else {
+                    log_Log(CAM, c_st, "Could not transfer thumbnail to debug interface.\0");
+                }                    
+                break;
+            case CAM_FUNC_TRANSFER_STATS:
+                if (cmd->cmd_data != 0) {
+                    log_Log(CMD, CMD_ERR_DATA, "Camera transfer command should not have data.\0");
+                }
+                c_st = cam_Transfer(CAM_XFER_STATS);
+                if (c_st == CAM_INFO_OK) {
+                    log_Log(CAM, CAM_INFO_OK, "Successfully transferred statistics.\0");
+                } else if (c_st == CAM_INFO_QUEUED) {
+                    log_Log(CAM, CAM_INFO_QUEUED, "Queued statistics transfer.\0");
+                } else {
+                    log_Log(CAM, c_st, "Could not transfer statistics to debug interface.\0");
+                }                    
+                break;
+            case CAM_FUNC_WATCH_START:
+                // An optional transfer for frames that fire,
+                // then an optional threshold
+                if (cmd->cmd_dataLen > 2) {
+                    log_Log(CMD, CMD_ERR_DATA, "Watch start command takes two bytes of data.\0");
+                    break;
+                }
+                c_st = cam_WatchStart(cmd->cmd_dataLen > 0 ? cmd->cmd_data[0] : CAM_XFER_RAW,
+                                      cmd->cmd_dataLen > 1 ? cmd->cmd_data[1] : CAM_WATCH_THRESHOLD);
+                if (c_st == CAM_INFO_OK) {
+                    log_Log(CAM, CAM_INFO_OK, "Watching for change.\0");
+                } else {
+                    log_Log(CAM, c_st, "Could not start watching.\0");
+                }
+                break;
+            case CAM_FUNC_WATCH_STOP:
+                if (cmd->cmd_data != 0) {
+                    log_Log(CMD, CMD_ERR_DATA, "Watch stop command should not have data.\0");
+                }
+                c_st = cam_WatchStop();
+                log_Log(CAM, c_st, "Stopped watching.\0");
+                break;
+            case CAM_FUNC_WATCH_REGION:
+                // Index, x, y, width, height, then the count
+                // little endian
+                if (cmd->cmd_dataLen != 7) {
+                    log_Log(CMD, CMD_ERR_DATA, "Watch region command takes seven bytes of data.\0");
                     break;
-                default:
-                    log_Log(CMD, CMD_ERR_NOFUNC, "Tried to call an SDRAM function that doesn't exist.\0", 
-                            1, &(cmd->cmd_func));
+                }
+                img_region_t region;
+                region.img_region_x = cmd->cmd_data[1];
+                region.img_region_y = cmd->cmd_data[2];
+                region.img_region_width = cmd->cmd_data[3];
+                region.img_region_height = cmd->cmd_data[4];
+                region.img_region_count = cmd->cmd_data[5] | cmd->cmd_data[6] << 8;
+                c_st = cam_WatchRegion(cmd->cmd_data[0], &region);
+                if (c_st == CAM_INFO_OK) {
+                    log_Log(CAM, CAM_INFO_OK, "Set watch region.\0");
+                } else {
+                    log_Log(CAM, c_st, "Watch region must be 0 to 3.\0");
+                }
+                break;
+            case CAM_FUNC_HISTORY:
+                if (cmd->cmd_dataLen != 1) {
+                    log_Log(CMD, CMD_ERR_DATA, "History command takes one byte of data.\0");
                     break;
- 
+                }
+                c_st = cam_HistoryMode(cmd->cmd_data[0]);
+                if (c_st == CAM_INFO_OK) {
+                    log_Log(CAM, CAM_INFO_OK, "Set history mode.\0");
+                } else {
+                    log_Log(CAM, c_st, "Could not set history mode.\0");
+                }
+                break;
+            case CAM_FUNC_DUMP_HISTORY:
+                if (cmd->cmd_data != 0) {
+                    log_Log(CMD, CMD_ERR_DATA, "Dump history command should not have data.\0");
+                }
+                c_st = cam_Transfer(CAM_XFER_HISTORY);
+                if (c_st == CAM_INFO_OK) {
+                    log_Log(CAM, CAM_INFO_OK, "Successfully transferred history.\0");
+                } else if (c_st == CAM_INFO_QUEUED) {
+                    log_Log(CAM, CAM_INFO_QUEUED, "Queued history transfer.\0");
+                } else {
+                    log_Log(CAM, c_st, "Could not transfer history to debug interface.\0");
+                }
+                break;
+            default:
+                log_Log(CMD, CMD_ERR_NOFUNC, "Tried to call a camera function that doesn't exist.\0", 
+                        1, &(cmd->cmd_func));
+                break;
+        }
+        break;
+    case ESP8266:
+        switch (cmd->cmd_func) {
+            default:
+                log_Log(CMD, CMD_ERR_NOFUNC, "Tried to call an ESP8266 function that doesn't exist.\0", 
+                        1, &(cmd->cmd_func));        
             }
             break;
-        case PROF:
-            switch (cmd->cmd_func) {
-                case PROF_FUNC_INIT:
-                    if (cmd->cmd_data != 0) {
-                        log_Log(CMD, CMD_ERR_DATA, "Initialization command should not have data.\0");
-                    }
-                    prof_status_t p_st = prof_Init();
-                    if (p_st == PROF_INFO_OK) {
-                        log_Log(PROF, PROF_INFO_OK, "Initialized profiler.\0");
-                    } else if (p_st == PROF_WARN_ALINIT) {
-                        log_Log(PROF, PROF_WARN_ALINIT, "Profiler already initialized.\0");
-                    } else {
-                        log_Log(PROF, p_st, "Failed to initialize profiler.\0");
-                    }                    
-                    break;
-                default:
-                    log_Log(CMD, CMD_ERR_NOFUNC, "Tried to call a profiler function that doesn't exist.\0", 
-                            1, &(cmd->cmd_func));
-                    break;
+    case WIFI:
+        switch (cmd->cmd_func) {
+            default:
+                log_Log(CMD, CMD_ERR_NOFUNC, "Tried to call a wifi function that doesn't exist.\0", 
+                        1, &(cmd->cmd_func));        
             }
             break;
-        case CAM:
-            switch (cmd->cmd_func) {
-                case CAM_FUNC_INIT:
-                    if (cmd->cmd_data != 0) {
-                        log_Log(CMD, CMD_ERR_DATA, "Initialization command should not have data.\0");
-                    }
-                    cam_status_t c_st = cam_Init();
-                    if (c_st == CAM_INFO_OK) {
-                        log_Log(CAM, CAM_INFO_OK, "Initialized camera module.\0");
-                    } else if (c_st == CAM_WARN_ALINIT) {
-                        log_Log(CAM, CAM_WARN_ALINIT, "Camera module already initialized.\0");
-                    } else {
-                        log_Log(CAM, c_st, "Failed to initialize camera.\0");
-                    }                    
-                    break;
-                case CAM_FUNC_CONFIG:
-                    if (cmd->cmd_data != 0) {
-                        log_Log(CMD, CMD_ERR_DATA, "Configuration command should not have data.\0");
-                    }
-                    c_st = cam_Configure();
-                    if (c_st == CAM_INFO_OK) {
-                        log_Log(CAM, CAM_INFO_OK, "Configured camera module.\0");
-                    } else if (c_st == CAM_WARN_ALCONF) {
-                        log_Log(CAM, CAM_WARN_ALCONF, "Camera module already configured.\0");
-                    } else {
-                        log_Log(CAM, c_st, "Failed to configure camera.\0");
-                    }                    
-                    break;
-                case CAM_FUNC_CAPTURE:
-                    if (cmd->cmd_data != 0) {
-                        log_Log(CMD, CMD_ERR_DATA, "Camera capture command should not have data.\0");
-                    }
-                    c_st = cam_Capture();
-                    if (c_st == CAM_INFO_OK) {
-                        log_Log(CAM, CAM_INFO_OK, "Captured an image into SDRAM.\0");
-                    } else {
-                        log_Log(CAM, c_st, "Could not capture image.\0");
-                    }                    
-                    break;
-                case CAM_FUNC_TRANSFER:
-                    if (cmd->cmd_data != 0) {
-                        log_Log(CMD, CMD_ERR_DATA, "Camera transfer command should not have data.\0");
-                    }
-                    c_st = cam_Transfer();
-                    if (c_st == CAM_INFO_OK) {
-                        log_Log(CAM, CAM_INFO_OK, "Successfully transferred image.\0");
-                    } else {
-                        log_Log(CAM, c_st, "Could not transfer image to debug interface.\0");
-                    }                    
-                    break;
-                default:
-                    log_Log(CMD, CMD_ERR_NOFUNC, "Tried to call a camera function that doesn't exist.\0", 
-                            1, &(cmd->cmd_func));
-                    break;
+    case TEST:
+        switch (cmd->cmd_func) {
+            #if defined(__TEST) && defined(__LOG)
+            case TEST_FUNC_BENCH:
+                if (cmd->cmd_data != 0) {
+                    log_Log(CMD, CMD_ERR_DATA, "Benchmark command should not have data.\0");
+                }
+                bench_Run();
+                break;
+            #endif
+            default:
+                log_Log(CMD, CMD_ERR_NOFUNC, "Tried to call a test function that doesn't exist.\0", 
+                        1, &(cmd->cmd_func));        
+            }
+            break;
+    case OV5642:
+        switch (cmd->cmd_func) {
+            default:
+                log_Log(CMD, CMD_ERR_NOFUNC, "Tried to call an ov5642 function that doesn't exist.\0", 
+                        1, &(cmd->cmd_func));        
+            }
+            break;
+     case OV7670:
+        switch (cmd->cmd_func) {
+            default:
+                log_Log(CMD, CMD_ERR_NOFUNC, "Tried to call an 0v7670 function that doesn't exist.\0", 
+                        1, &(cmd->cmd_func));        
+            }
+            break;
+    case SCHED:
+        switch (cmd->cmd_func) {
+            default:
+                log_Log(CMD, CMD_ERR_NOFUNC, "Tried to call a scheduler function that doesn't exist.\0", 
+                        1, &(cmd->cmd_func));        
+            }
+            break;
+    case KERN:
+        switch (cmd->cmd_func) {
+            default:
+                log_Log(CMD, CMD_ERR_NOFUNC, "Tried to call a kernel function that doesn't exist.\0", 
+                        1, &(cmd->cmd_func));        
             }
             break;
-        case ESP8266:
-            switch (cmd->cmd_func) {
-                default:
-                    log_Log(CMD, CMD_ERR_NOFUNC, "Tried to call an ESP8266 function that doesn't exist.\0", 
-                            1, &(cmd->cmd_func));        
+    case TRACE:
+        switch (cmd->cmd_func) {
+            #ifdef __TRACE
+            case TRACE_FUNC_START:
+                if (cmd->cmd_data != 0) {
+                    log_Log(CMD, CMD_ERR_DATA, "Start command should not have data.\0");
+                }
+                trace_status_t tr_st = trace_Start();
+                if (tr_st == TRACE_INFO_OK) {
+                    log_Log(TRACE, TRACE_INFO_OK, "Started trace recording.\0");
+                } else {
+                    log_Log(TRACE, tr_st, "Could not start trace recording.\0");
                 }
                 break;
-        case WIFI:
-            switch (cmd->cmd_func) {
-                default:
-                    log_Log(CMD, CMD_ERR_NOFUNC, "Tried to call a wifi function that doesn't exist.\0", 
-                            1, &(cmd->cmd_func));        
+            case TRACE_FUNC_STOP:
+                if (cmd->cmd_data != 0) {
+                    log_Log(CMD, CMD_ERR_DATA, "Stop command should not have data.\0");
+                }
+                tr_st = trace_Stop();
+                if (tr_st == TRACE_INFO_OK) {
+                    log_Log(TRACE, TRACE_INFO_OK, "Stopped trace recording.\0");
+                } else {
+                    log_Log(TRACE, tr_st, "Could not stop trace recording.\0");
                 }
                 break;
-        case TEST:
-            switch (cmd->cmd_func) {
-                default:
-                    log_Log(CMD, CMD_ERR_NOFUNC, "Tried to call a test function that doesn't exist.\0", 
-                            1, &(cmd->cmd_func));        
+            case TRACE_FUNC_DUMP:
+                if (cmd->cmd_data != 0) {
+                    log_Log(CMD, CMD_ERR_DATA, "Dump command should not have data.\0");
+                }
+                tr_st = trace_Dump();
+                if (tr_st != TRACE_INFO_OK) {
+                    log_Log(TRACE, tr_st, "Could not dump trace.\0");
                 }
                 break;
-        case OV5642:
-            switch (cmd->cmd_func) {
-                default:
-                    log_Log(CMD, CMD_ERR_NOFUNC, "Tried to call an ov5642 function that doesn't exist.\0", 
-                            1, &(cmd->cmd_func));        
+            #endif
+            default:
+                log_Log(CMD, CMD_ERR_NOFUNC, "Tried to call a trace function that doesn't exist.\0", 
+                        1, &(cmd->cmd_func));        
+            }
+            break;
+    case TICK:
+        switch (cmd->cmd_func) {
+            case TICK_FUNC_NOW:
+                if (cmd->cmd_data != 0) {
+                    log_Log(CMD, CMD_ERR_DATA, "Time command should not have data.\0");
                 }
+                #ifdef __LOG
+                uint64_t now = tick_Now();
+                log_Log(TICK, TICK_INFO_OK, "Uptime in microseconds.\0", sizeof(now), (uint8_t *) &now);
+                #endif
                 break;
-         case OV7670:
-            switch (cmd->cmd_func) {
-                default:
-                    log_Log(CMD, CMD_ERR_NOFUNC, "Tried to call an 0v7670 function that doesn't exist.\0", 
-                            1, &(cmd->cmd_func));        
+            default:
+                log_Log(CMD, CMD_ERR_NOFUNC, "Tried to call a time base function that doesn't exist.\0", 
+                        1, &(cmd->cmd_func));        
+            }
+            break;
+    case MON:
+        switch (cmd->cmd_func) {
+            #ifdef __MON
+            case MON_FUNC_STATS:
+                if (cmd->cmd_data != 0) {
+                    log_Log(CMD, CMD_ERR_DATA, "Stats command should not have data.\0");
+                }
+                mon_status_t mo_st = mon_Stats();
+                if (mo_st != MON_INFO_OK) {
+                    log_Log(MON, mo_st, "Could not send monitor statistics.\0");
                 }
                 break;
-
-
-        default:
-            log_Log(CMD, CMD_ERR_NOMOD, "Tried to send a command to an unknown module.\0");
+            case MON_FUNC_RESET:
+                if (cmd->cmd_data != 0) {
+                    log_Log(CMD, CMD_ERR_DATA, "Reset command should not have data.\0");
+                }
+                mo_st = mon_Reset();
+                if (mo_st == MON_INFO_OK) {
+                    log_Log(MON, MON_INFO_OK, "Cleared monitor statistics.\0");
+                } else {
+                    log_Log(MON, mo_st, "Could not clear monitor statistics.\0");
+                }
+                break;
+            case MON_FUNC_TELEMETRY_START:
+                if (cmd->cmd_data != 0) {
+                    log_Log(CMD, CMD_ERR_DATA, "Telemetry command should not have data.\0");
+                }
+                mo_st = mon_TelemetryStart();
+                if (mo_st == MON_INFO_OK) {
+                    log_Log(MON, MON_INFO_OK, "Started telemetry.\0");
+                } else {
+                    log_Log(MON, mo_st, "Could not start telemetry.\0");
+                }
+                break;
+            case MON_FUNC_TELEMETRY_STOP:
+                if (cmd->cmd_data != 0) {
+                    log_Log(CMD, CMD_ERR_DATA, "Telemetry command should not have data.\0");
+                }
+                mo_st = mon_TelemetryStop();
+                if (mo_st == MON_INFO_OK) {
+                    log_Log(MON, MON_INFO_OK, "Stopped telemetry.\0");
+                } else {
+                    log_Log(MON, mo_st, "Could not stop telemetry.\0");
+                }
+                break;
+            #endif
+            default:
+                log_Log(CMD, CMD_ERR_NOFUNC, "Tried to call a monitor function that doesn't exist.\0", 
+                        1, &(cmd->cmd_func));        
+            }
+            break;
+    case MEM:
+        switch (cmd->cmd_func) {
+            case MEM_FUNC_REPORT:
+                if (cmd->cmd_data != 0) {
+                    log_Log(CMD, CMD_ERR_DATA, "Report command should not have data.\0");
+                }
+                mem_Report();
+                break;
+            default:
+                log_Log(CMD, CMD_ERR_NOFUNC, "Tried to call a memory function that doesn't exist.\0", 
+                        1, &(cmd->cmd_func));        
+            }
             break;
-        }
 
-        // Free memory, pass warning about freeing freed memory
-        st = cmd_CmdDeallocate(cmd);
-        if (st != CMD_INFO_OK && st != CMD_WARN_FREE) {
-            log_Log(CMD, st);
-            return st;
-        }
+    default:
+        log_Log(CMD, CMD_ERR_NOMOD, "Tried to send a command to an unknown module.\0");
+        break;
     }
+
+    return CMD_INFO_OK;
 }
 
@@ -17,12 +17,25 @@
 #include "stm32f4xx_gpio.h"
 #include "stm32f4xx_usart.h"
 #include "wifi.h"
+#include "tick.h"
 #include <stdint.h>
 
 /**************************************
  * Private functions
  */
 
+esp8266_status_t esp8266_sendByte(uint8_t byte) {
+    uint64_t deadline = tick_Deadline(ESP8266_TX_TIMEOUT_US);
+    while (USART_GetFlagStatus(USART1, USART_FLAG_TXE) == RESET) {
+        if (tick_Expired(deadline)) {
+            return ESP8266_ERR_TIMEOUT;
+        }
+    }
+    USART_SendData(USART1, byte);
+
+    return ESP8266_INFO_OK;
+}
+
 /**************************************
  * Public functions
  */
@@ -37,36 +50,33 @@ esp8266_status_t esp8266_Send(wifi_packet_t *wifi_packet) {
                          sizeof(wifi_packet->wifi_packet_msg) +
                          firstSize;
     uint32_t fourthSize = wifi_packet->wifi_packet_dataLen;;
+    esp8266_status_t st = ESP8266_INFO_OK;
 
-    // Send data serially
-    while (i < firstSize) {
-        while (USART_GetFlagStatus(USART1, USART_FLAG_TXE) == RESET) {}
-        USART_SendData(USART1, *(((uint8_t *)wifi_packet)+i));
+    // Send data serially, stop on the first timeout
+    while (st == ESP8266_INFO_OK && i < firstSize) {
+        st = esp8266_sendByte(*(((uint8_t *)wifi_packet)+i));
         i++;
     }
     i = 0;
-    while (i < secondSize) {
-        while (USART_GetFlagStatus(USART1, USART_FLAG_TXE) == RESET) {}
-        USART_SendData(USART1, *(wifi_packet->wifi_packet_msg+i));
+    while (st == ESP8266_INFO_OK && i < secondSize) {
+        st = esp8266_sendByte(*(wifi_packet->wifi_packet_msg+i));
         i++;
     }
     i = firstSize + sizeof(wifi_packet->wifi_packet_msg);
-    while (i < thirdSize) {
-        while (USART_GetFlagStatus(USART1, USART_FLAG_TXE) == RESET) {}
-        USART_SendData(USART1, *(((uint8_t *)wifi_packet)+i));
+    while (st == ESP8266_INFO_OK && i < thirdSize) {
+        st = esp8266_sendByte(*(((uint8_t *)wifi_packet)+i));
         i++;
     }
     i = 0;
-    while (i < fourthSize) {
-        while (USART_GetFlagStatus(USART1, USART_FLAG_TXE) == RESET) {}
-        // Delay of 100 works for lab computers
+    while (st == ESP8266_INFO_OK && i < fourthSize) {
+        // Gap of 100 bytes works for lab computers
         if (i % 100 == 0) {        
-            for (uint32_t j = 0; j < 1000; j++) {}
+            tick_DelayUs(ESP8266_DATA_GAP_US);
         }
-        USART_SendData(USART1, *(wifi_packet->wifi_packet_data+i));
+        st = esp8266_sendByte(*(wifi_packet->wifi_packet_data+i));
         i++;
     }
-    return WIFI_INFO_OK;
+    return st;
 }
 
 esp8266_status_t esp8266_Init() {
@@ -0,0 +1,810 @@
+/** @file img.c
+ *  @brief Implemenation of the image processing.
+ *
+ *  This contains the implementations of the image
+ *  processing stages.
+ *
+ *  Conversions run one at a time on the DMA2D, in memory
+ *  to memory mode with pixel format conversion. The next
+ *  one starts from the interrupt of the last.
+ *
+ *  @author Ben Heberlein
+ *  @bug No known bugs.
+ */
+
+/*************************************
+ * Includes and definitions
+ */
+
+#include "img.h"
+#include "sdram.h"
+#include "tick.h"
+#include "trace.h"
+#include "mon.h"
+#include "err.h"
+#include "mem.h"
+#include "stm32f4xx.h"
+#include "stm32f4xx_rcc.h"
+#include "stm32f4xx_dma2d.h"
+#include "misc.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/* @ brief Initialization flag
+ */
+static uint8_t img_initialized = 0;
+
+/* @brief Grayscale lookup table for L8 input, the DMA2D
+ * loads it from here once
+ */
+static uint32_t img_grayLut[256];
+
+/* @brief Chroma weights for __SMLAD, U in the bottom
+ * halfword and V in the top
+ */
+#define IMG_SIMD_R ((uint32_t) IMG_YUV_RV << 16)
+#define IMG_SIMD_G ((uint32_t) IMG_YUV_GV << 16 | (uint16_t) IMG_YUV_GU)
+#define IMG_SIMD_B ((uint32_t) (uint16_t) IMG_YUV_BU)
+
+/* @brief Tiles for the color conversion, the output one
+ * fits RGB888
+ */
+static uint32_t img_tileIn[IMG_TILE_PIXELS*IMG_YUV_BPP/4] MEM_CCM;
+static uint32_t img_tileOut[IMG_TILE_PIXELS*3/4] MEM_CCM;
+
+/* @brief Lines for the statistics, the one being read
+ * and the two before it
+ */
+static uint32_t img_statsLines[3][IMG_STATS_MAXWIDTH*IMG_YUV_BPP/4] MEM_CCM;
+
+/* @brief Conversion queue, the head is on the DMA2D
+ */
+static img_convert_t img_convertQueue[IMG_CONVERT_QUEUE];
+static uint8_t img_convertHead = 0;
+static volatile uint8_t img_convertCount = 0;
+
+/**************************************
+ * Private functions
+ */
+
+void img_lumaRef(uint8_t *dst, const uint8_t *src, uint32_t pixels) {
+    for (uint32_t i = 0; i < pixels; i++) {
+        dst[i] = src[i*IMG_YUV_BPP + IMG_YUV_LUMA];
+    }
+}
+
+/* Chroma offsets for a pixel pair, rounded. The shifts
+ * are arithmetic, like the SIMD version. */
+void img_chroma(const uint8_t *uyvy, int32_t *rd, int32_t *gd, int32_t *bd) {
+    int32_t u = uyvy[0] - 128;
+    int32_t v = uyvy[2] - 128;
+    *rd = (IMG_YUV_RV*v + 128) >> 8;
+    *gd = (IMG_YUV_GU*u + IMG_YUV_GV*v + 128) >> 8;
+    *bd = (IMG_YUV_BU*u + 128) >> 8;
+}
+
+/* Saturate to a byte */
+uint8_t img_clamp(int32_t x) {
+    return x < 0 ? 0 : (x > 255 ? 255 : x);
+}
+
+void img_rgb565Ref(uint16_t *dst, const uint8_t *src, uint32_t pixels) {
+    int32_t rd, gd, bd;
+    for (uint32_t i = 0; i < pixels; i++) {
+        if ((i & 1) == 0) {
+            img_chroma(src + i*IMG_YUV_BPP, &rd, &gd, &bd);
+        }
+        int32_t y = src[i*IMG_YUV_BPP + IMG_YUV_LUMA];
+        dst[i] = (img_clamp(y + rd) & 0xF8) << 8 | (img_clamp(y + gd) & 0xFC) << 3 |
+                 img_clamp(y + bd) >> 3;
+    }
+}
+
+void img_rgb888Ref(uint8_t *dst, const uint8_t *src, uint32_t pixels) {
+    int32_t rd, gd, bd;
+    for (uint32_t i = 0; i < pixels; i++) {
+        if ((i & 1) == 0) {
+            img_chroma(src + i*IMG_YUV_BPP, &rd, &gd, &bd);
+        }
+        int32_t y = src[i*IMG_YUV_BPP + IMG_YUV_LUMA];
+        dst[i*3] = img_clamp(y + bd);
+        dst[i*3 + 1] = img_clamp(y + gd);
+        dst[i*3 + 2] = img_clamp(y + rd);
+    }
+}
+
+/* U0 Y0 V0 Y1 gives both lumas in y and the centered
+ * chroma in uv. Each offset is added to both lumas at
+ * once and clamped to a byte. */
+#define IMG_SIMD_PAIR(w, r, g, b) do { \
+    uint32_t uyvy = (w); \
+    uint32_t uv = __SSUB16(__UXTB16(uyvy), 0x00800080); \
+    uint32_t y = __UXTB16(uyvy >> 8); \
+    int32_t rd = (int32_t) __SMLAD(uv, IMG_SIMD_R, 128) >> 8; \
+    int32_t gd = (int32_t) __SMLAD(uv, IMG_SIMD_G, 128) >> 8; \
+    int32_t bd = (int32_t) __SMLAD(uv, IMG_SIMD_B, 128) >> 8; \
+    r = __USAT16(__SADD16(y, __PKHBT(rd, rd, 16)), 8); \
+    g = __USAT16(__SADD16(y, __PKHBT(gd, gd, 16)), 8); \
+    b = __USAT16(__SADD16(y, __PKHBT(bd, bd, 16)), 8); \
+} while (0)
+
+MEM_RAMFUNC void img_rgb565Tile(uint32_t *dst, const uint32_t *src, uint32_t pairs) {
+    uint32_t r, g, b;
+    while (pairs-- > 0) {
+        IMG_SIMD_PAIR(*src++, r, g, b);
+
+        // Both pixels pack at once, one per halfword
+        *dst++ = (r & 0x00F800F8) << 8 | (g & 0x00FC00FC) << 3 | (b & 0x00F800F8) >> 3;
+    }
+}
+
+MEM_RAMFUNC void img_rgb888Tile(uint8_t *dst, const uint32_t *src, uint32_t pairs) {
+    uint32_t r, g, b;
+    while (pairs-- > 0) {
+        IMG_SIMD_PAIR(*src++, r, g, b);
+
+        dst[0] = b;
+        dst[1] = g;
+        dst[2] = r;
+        dst[3] = b >> 16;
+        dst[4] = g >> 16;
+        dst[5] = r >> 16;
+        dst += 6;
+    }
+}
+
+/* Stages tiles through core coupled RAM for either
+ * kernel */
+img_status_t img_rgb(uint8_t *dst, const uint8_t *src, uint32_t pixels, uint8_t bytes) {
+    if (dst == NULL || src == NULL) {
+        return IMG_ERR_NULLPTR;
+    }
+    if ((pixels & 1) != 0) {
+        return IMG_ERR_SIZE;
+    }
+
+    while (pixels > 0) {
+        uint32_t n = pixels < IMG_TILE_PIXELS ? pixels : IMG_TILE_PIXELS;
+        memcpy(img_tileIn, src, n*IMG_YUV_BPP);
+        if (bytes == 2) {
+            img_rgb565Tile(img_tileOut, img_tileIn, n/2);
+        } else {
+            img_rgb888Tile((uint8_t *) img_tileOut, img_tileIn, n/2);
+        }
+        memcpy(dst, img_tileOut, n*bytes);
+
+        src += n*IMG_YUV_BPP;
+        dst += n*bytes;
+        pixels -= n;
+    }
+
+    return IMG_INFO_OK;
+}
+
+MEM_RAMFUNC uint32_t img_sadTile(const uint32_t *a, const uint32_t *b, uint32_t stride,
+                                 uint32_t limit) {
+    uint32_t sad = 0;
+    for (uint8_t y = 0; y < IMG_DELTA_TILE; y++) {
+        for (uint8_t i = 0; i < IMG_DELTA_TILE*IMG_YUV_BPP/4; i++) {
+            sad = __USADA8(a[i], b[i], sad);
+        }
+        if (sad > limit) {
+            break;
+        }
+        a += stride;
+        b += stride;
+    }
+
+    return sad;
+}
+
+void img_halveRef(uint8_t *dst, const uint8_t *a, const uint8_t *b, uint32_t pixels) {
+    // Lumas pair within a word, chroma across the two
+    for (uint32_t i = 0; i < pixels*IMG_YUV_BPP; i += 4) {
+        const uint8_t *p = a + 2*i;
+        const uint8_t *q = b + 2*i;
+        for (uint8_t c = 0; c < 4; c += 2) {
+            dst[i + c] = (((p[c] + q[c]) >> 1) + ((p[c + 4] + q[c + 4]) >> 1)) >> 1;
+        }
+        dst[i + 1] = (((p[1] + q[1]) >> 1) + ((p[3] + q[3]) >> 1)) >> 1;
+        dst[i + 3] = (((p[5] + q[5]) >> 1) + ((p[7] + q[7]) >> 1)) >> 1;
+    }
+}
+
+MEM_RAMFUNC void img_halveRow(uint32_t *dst, const uint32_t *a, const uint32_t *b, uint32_t pairs) {
+    while (pairs-- > 0) {
+        // U0 Y0 V0 Y1 and U1 Y2 V1 Y3, averaged down the
+        // column
+        uint32_t w0 = __UHADD8(a[0], b[0]);
+        uint32_t w1 = __UHADD8(a[1], b[1]);
+        a += 2;
+        b += 2;
+
+        // Chroma across the words, lumas within each
+        uint32_t uv = __UHADD8(w0, w1);
+        uint32_t y0 = __UHADD8(w0, w0 >> 16);
+        uint32_t y1 = __UHADD8(w1, w1 >> 16);
+        *dst++ = (uv & 0x00FF00FF) | (y0 & 0x0000FF00) | (y1 & 0x0000FF00) << 16;
+    }
+}
+
+void img_statsRef(img_stats_t *stats, const uint8_t *src, const uint8_t *prev,
+                  uint16_t width, uint16_t height) {
+    uint32_t hist[IMG_STATS_BINS];
+    memset(hist, 0, sizeof(hist));
+    uint64_t sum = 0;
+    uint64_t sumSq = 0;
+    uint64_t diffSq = 0;
+    for (uint32_t i = IMG_YUV_LUMA; i < (uint32_t) width*height*IMG_YUV_BPP; i += IMG_YUV_BPP) {
+        hist[src[i] >> IMG_STATS_BINSHIFT]++;
+        sum += src[i];
+        sumSq += src[i]*src[i];
+        if (prev != NULL) {
+            diffSq += (src[i] - prev[i])*(src[i] - prev[i]);
+        }
+    }
+
+    int64_t lapSum = 0;
+    uint64_t lapSq = 0;
+    int32_t stride = width*IMG_YUV_BPP;
+    for (uint16_t y = 1; y + 1 < height; y++) {
+        for (uint16_t x = 2; x + 2 < width; x++) {
+            const uint8_t *p = src + y*stride + x*IMG_YUV_BPP + IMG_YUV_LUMA;
+            int32_t lap = 4*p[0] - p[-IMG_YUV_BPP] - p[IMG_YUV_BPP] - p[-stride] - p[stride];
+            lapSum += lap;
+            lapSq += lap*lap;
+        }
+    }
+
+    img_statsFinish(stats, hist, sum, sumSq, lapSum, lapSq, diffSq, prev != NULL, width, height);
+}
+
+/* The Laplacian sums to its values along the edges, so
+ * its square stays small */
+void img_statsFinish(img_stats_t *stats, const uint32_t *hist, uint64_t sum, uint64_t sumSq,
+                     int64_t lapSum, uint64_t lapSq, uint64_t diffSq, uint8_t motion,
+                     uint16_t width, uint16_t height) {
+    uint32_t n = width*height;
+    uint32_t lapN = (width - 4)*(height - 2);
+    stats->img_stats_width = width;
+    stats->img_stats_height = height;
+    stats->img_stats_flags = motion ? IMG_STATS_MOTION : 0;
+    stats->img_stats_bins = IMG_STATS_BINS;
+    stats->img_stats_mean = (sum << 8)/n;
+    stats->img_stats_variance = ((sumSq << 8) - ((sum*sum) << 8)/n)/n;
+    stats->img_stats_focus = ((lapSq << 8) - ((uint64_t) (lapSum*lapSum) << 8)/lapN)/lapN;
+    stats->img_stats_motion = (diffSq << 8)/n;
+    memcpy(stats->img_stats_hist, hist, IMG_STATS_BINS*sizeof(uint32_t));
+}
+
+MEM_RAMFUNC void img_laplaceLine(const uint32_t *up, const uint32_t *line, const uint32_t *down,
+                                 uint32_t words, int64_t *sum, uint64_t *sumSq) {
+    // Lumas a halfword each, the neighbours to the sides
+    // straddle the words either side
+    int32_t s = 0;
+    uint32_t sq = 0;
+    uint32_t p = __UXTB16(line[0] >> 8);
+    uint32_t c = __UXTB16(line[1] >> 8);
+    for (uint32_t i = 1; i + 1 < words; i++) {
+        uint32_t n = __UXTB16(line[i + 1] >> 8);
+        uint32_t left = __PKHBT(p >> 16, c, 16);
+        uint32_t right = __PKHBT(c >> 16, n, 16);
+        uint32_t around = __SADD16(__SADD16(left, right),
+                                   __SADD16(__UXTB16(up[i] >> 8), __UXTB16(down[i] >> 8)));
+        uint32_t lap = __SSUB16(c << 2, around);
+        s = (int32_t) __SMLAD(lap, 0x00010001, s);
+        sq = __SMLAD(lap, lap, sq);
+        p = c;
+        c = n;
+    }
+
+    *sum += s;
+    *sumSq += sq;
+}
+
+uint8_t img_fmtBytes(img_fmt_t fmt) {
+    switch (fmt) {
+        case IMG_FMT_ARGB8888:
+            return 4;
+        case IMG_FMT_RGB888:
+            return 3;
+        case IMG_FMT_RGB565:
+            return 2;
+        case IMG_FMT_L8:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+void img_convertStart() {
+    img_convert_t *conv = &img_convertQueue[img_convertHead];
+
+    DMA2D_InitTypeDef dma2dInit;
+    DMA2D_StructInit(&dma2dInit);
+    dma2dInit.DMA2D_Mode = DMA2D_M2M_PFC;
+    dma2dInit.DMA2D_CMode = conv->img_convert_dstFmt;
+    dma2dInit.DMA2D_OutputMemoryAdd = conv->img_convert_dst;
+    dma2dInit.DMA2D_OutputOffset = 0;
+    dma2dInit.DMA2D_NumberOfLine = conv->img_convert_height;
+    dma2dInit.DMA2D_PixelPerLine = conv->img_convert_width;
+    DMA2D_Init(&dma2dInit);
+
+    // The lookup table is only read for L8
+    DMA2D_FG_InitTypeDef fgInit;
+    DMA2D_FG_StructInit(&fgInit);
+    fgInit.DMA2D_FGMA = conv->img_convert_src;
+    fgInit.DMA2D_FGO = 0;
+    fgInit.DMA2D_FGCM = conv->img_convert_srcFmt;
+    fgInit.DMA2D_FG_CLUT_CM = CLUT_CM_ARGB8888;
+    fgInit.DMA2D_FG_CLUT_SIZE = 255;
+    fgInit.DMA2D_FGCMAR = (uint32_t) img_grayLut;
+    DMA2D_FGConfig(&fgInit);
+
+    DMA2D_ClearFlag(DMA2D_FLAG_TC | DMA2D_FLAG_TE | DMA2D_FLAG_CE);
+    DMA2D_ITConfig(DMA2D_IT_TC | DMA2D_IT_TE | DMA2D_IT_CE, ENABLE);
+    DMA2D_StartTransfer();
+}
+
+void img_convertFinish(img_status_t status) {
+    img_convert_t conv = img_convertQueue[img_convertHead];
+    img_convertHead = (img_convertHead + 1) % IMG_CONVERT_QUEUE;
+    img_convertCount--;
+
+    // Next conversion first, the callback may queue more
+    if (img_convertCount > 0) {
+        img_convertStart();
+    }
+
+    if (conv.img_convert_callback != NULL) {
+        conv.img_convert_callback(status, conv.img_convert_arg);
+    }
+}
+
+MEM_RAMFUNC void DMA2D_IRQHandler() {
+    trace_Begin(TRACE_CAT_IRQ, DMA2D_IRQn);
+    mon_IrqEnter(MON_IRQ_DMA2D);
+
+    if (DMA2D_GetITStatus(DMA2D_IT_TE) != RESET || DMA2D_GetITStatus(DMA2D_IT_CE) != RESET) {
+        DMA2D_ClearITPendingBit(DMA2D_IT_TE | DMA2D_IT_CE);
+        #ifdef __MON
+        mon_DmaError(MON_DMA_DMA2D, MON_DMAERR_TRANSFER);
+        #endif
+
+        // The DMA2D stopped itself, or never started
+        img_convertFinish(IMG_ERR_DMA);
+    } else if (DMA2D_GetITStatus(DMA2D_IT_TC) != RESET) {
+        DMA2D_ClearITPendingBit(DMA2D_IT_TC);
+        #ifdef __MON
+        img_convert_t *conv = &img_convertQueue[img_convertHead];
+        mon_DmaComplete(MON_DMA_DMA2D, (uint32_t) conv->img_convert_width*conv->img_convert_height*
+                                       img_fmtBytes(conv->img_convert_dstFmt));
+        #endif
+
+        img_convertFinish(IMG_INFO_OK);
+    }
+
+    mon_IrqExit(MON_IRQ_DMA2D);
+    trace_End(TRACE_CAT_IRQ, DMA2D_IRQn);
+}
+
+/**************************************
+ * Public functions
+ */
+
+MEM_RAMFUNC img_status_t img_Luma(uint8_t *dst, const uint8_t *src, uint32_t pixels) {
+    if (dst == NULL || src == NULL) {
+        return IMG_ERR_NULLPTR;
+    }
+
+    uint32_t done = 0;
+    if ((((uint32_t) dst | (uint32_t) src) & 3) == 0) {
+        const uint32_t *in = (const uint32_t *) src;
+        uint32_t *out = (uint32_t *) dst;
+
+        // U0 Y0 V0 Y1 U2 Y2 V2 Y3 to Y0 Y1 Y2 Y3. Each word
+        // gives two lumas, one per halfword, which are
+        // squeezed into the low halfword and packed.
+        for (; done + 4 <= pixels; done += 4) {
+            uint32_t a = __UXTB16(*in++ >> 8);
+            uint32_t b = __UXTB16(*in++ >> 8);
+            a |= a >> 8;
+            b |= b >> 8;
+            *out++ = __PKHBT(a, b, 16);
+        }
+    }
+
+    img_lumaRef(dst + done, src + done*IMG_YUV_BPP, pixels - done);
+
+    return IMG_INFO_OK;
+}
+
+img_status_t img_Rgb565(void *dst, const void *src, uint32_t pixels) {
+    return img_rgb(dst, src, pixels, 2);
+}
+
+img_status_t img_Rgb888(void *dst, const void *src, uint32_t pixels) {
+    return img_rgb(dst, src, pixels, 3);
+}
+
+img_status_t img_DeltaEncode(void *dst, uint32_t max, uint32_t *len,
+                             const void *src, void *ref,
+                             uint16_t width, uint16_t height,
+                             uint8_t key, uint32_t threshold) {
+    if (dst == NULL || len == NULL || src == NULL || ref == NULL) {
+        return IMG_ERR_NULLPTR;
+    }
+
+    // Tile coordinates are a byte each
+    if (width == 0 || height == 0 || width % IMG_DELTA_TILE != 0 ||
+        height % IMG_DELTA_TILE != 0 || width/IMG_DELTA_TILE > 0xFF ||
+        height/IMG_DELTA_TILE > 0xFF) {
+        return IMG_ERR_SIZE;
+    }
+
+    if ((((uint32_t) src | (uint32_t) ref) & 3) != 0) {
+        return IMG_ERR_ALIGN;
+    }
+
+    if (max < sizeof(img_delta_t)) {
+        return IMG_ERR_FULL;
+    }
+
+    uint8_t *out = (uint8_t *) dst;
+    uint32_t stride = width*IMG_YUV_BPP;
+    uint32_t pos = sizeof(img_delta_t);
+    uint16_t count = 0;
+    for (uint8_t ty = 0; ty < height/IMG_DELTA_TILE; ty++) {
+        for (uint8_t tx = 0; tx < width/IMG_DELTA_TILE; tx++) {
+            uint32_t off = ty*IMG_DELTA_TILE*stride + tx*IMG_DELTA_TILE*IMG_YUV_BPP;
+            const uint8_t *s = (const uint8_t *) src + off;
+            uint8_t *r = (uint8_t *) ref + off;
+            if (!key && img_sadTile((const uint32_t *) s, (const uint32_t *) r, stride/4,
+                                    threshold) <= threshold) {
+                continue;
+            }
+
+            if (pos + 2 + IMG_DELTA_TILEBYTES > max) {
+                return IMG_ERR_FULL;
+            }
+            out[pos++] = tx;
+            out[pos++] = ty;
+            for (uint8_t y = 0; y < IMG_DELTA_TILE; y++) {
+                memcpy(out + pos, s, IMG_DELTA_TILE*IMG_YUV_BPP);
+                memcpy(r, s, IMG_DELTA_TILE*IMG_YUV_BPP);
+                pos += IMG_DELTA_TILE*IMG_YUV_BPP;
+                s += stride;
+                r += stride;
+            }
+            count++;
+        }
+    }
+
+    img_delta_t *hdr = (img_delta_t *) out;
+    hdr->img_delta_width = width;
+    hdr->img_delta_height = height;
+    hdr->img_delta_tile = IMG_DELTA_TILE;
+    hdr->img_delta_key = key != 0;
+    hdr->img_delta_count = count;
+    *len = pos;
+
+    return IMG_INFO_OK;
+}
+
+img_status_t img_Pyramid(void *dst, uint32_t max, uint32_t *len,
+                         const void *src, uint16_t width, uint16_t height) {
+    if (dst == NULL || len == NULL || src == NULL) {
+        return IMG_ERR_NULLPTR;
+    }
+
+    if (width == 0 || height == 0 || width % IMG_PYRAMID_XALIGN != 0 ||
+        height % IMG_PYRAMID_YALIGN != 0) {
+        return IMG_ERR_SIZE;
+    }
+
+    if ((((uint32_t) dst | (uint32_t) src) & 3) != 0) {
+        return IMG_ERR_ALIGN;
+    }
+
+    if (max < IMG_PYRAMID_SIZE(width, height)) {
+        return IMG_ERR_FULL;
+    }
+
+    // Lay out the levels, line strides in words
+    uint32_t *level[IMG_PYRAMID_LEVELS + 1];
+    uint32_t stride[IMG_PYRAMID_LEVELS + 1];
+    uint8_t *out = (uint8_t *) dst;
+    level[0] = (uint32_t *) src;
+    stride[0] = width*IMG_YUV_BPP/4;
+    for (uint8_t l = 1; l <= IMG_PYRAMID_LEVELS; l++) {
+        img_thumb_t *hdr = (img_thumb_t *) out;
+        hdr->img_thumb_width = width >> l;
+        hdr->img_thumb_height = height >> l;
+        level[l] = (uint32_t *) (out + sizeof(img_thumb_t));
+        stride[l] = stride[0] >> l;
+        out += sizeof(img_thumb_t) + (height >> l)*stride[l]*4;
+    }
+
+    // Each line of the first level, then the line of the
+    // next level it completes, if any
+    for (uint16_t y = 0; y < height/2; y++) {
+        uint16_t row = y;
+        for (uint8_t l = 1; l <= IMG_PYRAMID_LEVELS; l++) {
+            const uint32_t *a = level[l - 1] + 2*row*stride[l - 1];
+            img_halveRow(level[l] + row*stride[l], a, a + stride[l - 1], stride[l]);
+            if ((row & 1) == 0) {
+                break;
+            }
+            row >>= 1;
+        }
+    }
+
+    *len = out - (uint8_t *) dst;
+
+    return IMG_INFO_OK;
+}
+
+const img_thumb_t *img_PyramidLevel(const void *pyramid, uint8_t level, uint32_t *len) {
+    if (pyramid == NULL || level == 0 || level > IMG_PYRAMID_LEVELS) {
+        return NULL;
+    }
+
+    const uint8_t *p = (const uint8_t *) pyramid;
+    const img_thumb_t *hdr = NULL;
+    uint32_t size = 0;
+    for (uint8_t l = 1; l <= level; l++) {
+        hdr = (const img_thumb_t *) p;
+        size = sizeof(img_thumb_t) + hdr->img_thumb_width*hdr->img_thumb_height*IMG_YUV_BPP;
+        p += size;
+    }
+
+    if (len != NULL) {
+        *len = size;
+    }
+
+    return hdr;
+}
+
+MEM_RAMFUNC img_status_t img_Stats(img_stats_t *stats, const void *src, const void *prev,
+                                   uint16_t width, uint16_t height) {
+    if (stats == NULL || src == NULL) {
+        return IMG_ERR_NULLPTR;
+    }
+
+    if (width < 6 || width > IMG_STATS_MAXWIDTH || (width & 1) != 0 || height < 3) {
+        return IMG_ERR_SIZE;
+    }
+
+    if ((((uint32_t) src | (uint32_t) prev) & 3) != 0) {
+        return IMG_ERR_ALIGN;
+    }
+
+    uint32_t hist[IMG_STATS_BINS];
+    memset(hist, 0, sizeof(hist));
+    uint32_t words = width*IMG_YUV_BPP/4;
+    const uint32_t *in = (const uint32_t *) src;
+    const uint32_t *ref = (const uint32_t *) prev;
+    uint64_t sum = 0;
+    uint64_t sumSq = 0;
+    uint64_t diffSq = 0;
+    int64_t lapSum = 0;
+    uint64_t lapSq = 0;
+    for (uint16_t y = 0; y < height; y++) {
+        uint32_t *line = img_statsLines[y % 3];
+        memcpy(line, in, words*4);
+        in += words;
+
+        // A line's sums fit a word, even squared
+        uint32_t s = 0;
+        uint32_t sq = 0;
+        uint32_t d = 0;
+        for (uint32_t i = 0; i < words; i++) {
+            uint32_t w = line[i];
+            uint32_t luma = __UXTB16(w >> 8);
+            hist[(w >> (8 + IMG_STATS_BINSHIFT)) & (IMG_STATS_BINS - 1)]++;
+            hist[w >> (24 + IMG_STATS_BINSHIFT)]++;
+            s = __USADA8(w & 0xFF00FF00, 0, s);
+            sq = __SMLAD(luma, luma, sq);
+            if (ref != NULL) {
+                uint32_t diff = __SSUB16(luma, __UXTB16(ref[i] >> 8));
+                d = __SMLAD(diff, diff, d);
+            }
+        }
+        if (ref != NULL) {
+            ref += words;
+        }
+        sum += s;
+        sumSq += sq;
+        diffSq += d;
+
+        // The line before has both its neighbours now
+        if (y >= 2) {
+            img_laplaceLine(img_statsLines[(y - 2) % 3], img_statsLines[(y - 1) % 3], line,
+                            words, &lapSum, &lapSq);
+        }
+    }
+
+    img_statsFinish(stats, hist, sum, sumSq, lapSum, lapSq, diffSq, ref != NULL, width, height);
+
+    return IMG_INFO_OK;
+}
+
+img_status_t img_Motion(img_motion_t *motion, uint16_t *background, const void *src,
+                        uint16_t width, uint16_t height, uint8_t threshold, uint8_t rate,
+                        const img_region_t *regions, uint8_t count) {
+    if (motion == NULL || background == NULL || src == NULL || (regions == NULL && count > 0)) {
+        return IMG_ERR_NULLPTR;
+    }
+
+    if (count > IMG_MOTION_REGIONS || rate > 8) {
+        return IMG_ERR_RANGE;
+    }
+
+    uint16_t changed[IMG_MOTION_REGIONS];
+    img_motion_t box[IMG_MOTION_REGIONS];
+    memset(changed, 0, sizeof(changed));
+
+    const uint8_t *p = (const uint8_t *) src + IMG_YUV_LUMA;
+    for (uint16_t y = 0; y < height; y++) {
+        for (uint16_t x = 0; x < width; x++) {
+            int32_t luma = *p << 8;
+            int32_t diff = (luma - *background) >> 8;
+            *background += (luma - *background) >> rate;
+            p += IMG_YUV_BPP;
+            background++;
+
+            if (diff <= threshold && diff >= -threshold) {
+                continue;
+            }
+            for (uint8_t r = 0; r < count; r++) {
+                const img_region_t *reg = &regions[r];
+                if (x < reg->img_region_x || x - reg->img_region_x >= reg->img_region_width ||
+                    y < reg->img_region_y || y - reg->img_region_y >= reg->img_region_height) {
+                    continue;
+                }
+                if (changed[r]++ == 0) {
+                    box[r].img_motion_x0 = x;
+                    box[r].img_motion_y0 = y;
+                    box[r].img_motion_x1 = x;
+                    box[r].img_motion_y1 = y;
+                }
+                box[r].img_motion_x0 = x < box[r].img_motion_x0 ? x : box[r].img_motion_x0;
+                box[r].img_motion_x1 = x > box[r].img_motion_x1 ? x : box[r].img_motion_x1;
+                box[r].img_motion_y1 = y;
+            }
+        }
+    }
+
+    motion->img_motion_region = IMG_MOTION_NONE;
+    motion->img_motion_count = 0;
+    for (uint8_t r = 0; r < count; r++) {
+        if (regions[r].img_region_width == 0 || changed[r] < regions[r].img_region_count ||
+            changed[r] <= motion->img_motion_count) {
+            continue;
+        }
+        *motion = box[r];
+        motion->img_motion_region = r;
+        motion->img_motion_count = changed[r];
+    }
+
+    return IMG_INFO_OK;
+}
+
+img_status_t img_Init() {
+    if (img_initialized == 1) {
+        return IMG_WARN_ALINIT;
+    }
+
+    RCC_AHB1PeriphClockCmd(RCC_AHB1Periph_DMA2D, ENABLE);
+
+    for (uint16_t i = 0; i < 256; i++) {
+        img_grayLut[i] = 0xFF000000 | i*0x00010101;
+    }
+
+    // Load the table into the DMA2D, every L8 conversion
+    // uses it from there
+    DMA2D_FG_InitTypeDef fgInit;
+    DMA2D_FG_StructInit(&fgInit);
+    fgInit.DMA2D_FGCM = CM_L8;
+    fgInit.DMA2D_FG_CLUT_CM = CLUT_CM_ARGB8888;
+    fgInit.DMA2D_FG_CLUT_SIZE = 255;
+    fgInit.DMA2D_FGCMAR = (uint32_t) img_grayLut;
+    DMA2D_FGConfig(&fgInit);
+    DMA2D_ClearFlag(DMA2D_FLAG_CTC | DMA2D_FLAG_CAE);
+    DMA2D->FGPFCCR |= DMA2D_FGPFCCR_START;
+
+    uint64_t deadline = tick_Deadline(IMG_CONVERT_TIMEOUT_US);
+    while (DMA2D_GetFlagStatus(DMA2D_FLAG_CTC) == RESET) {
+        if (tick_Expired(deadline) || DMA2D_GetFlagStatus(DMA2D_FLAG_CAE) != RESET) {
+            return IMG_ERR_DMA;
+        }
+    }
+    DMA2D_ClearFlag(DMA2D_FLAG_CTC);
+
+    NVIC_InitTypeDef nvicInit;
+    nvicInit.NVIC_IRQChannel = DMA2D_IRQn;
+    nvicInit.NVIC_IRQChannelPreemptionPriority = IMG_CONVERT_NVIC_PRIO;
+    nvicInit.NVIC_IRQChannelSubPriority = 0;
+    nvicInit.NVIC_IRQChannelCmd = ENABLE;
+    NVIC_Init(&nvicInit);
+
+    img_initialized = 1;
+    return IMG_INFO_OK;
+}
+
+img_status_t img_ConvertAsync(void *dst, img_fmt_t dstFmt,
+                              const void *src, img_fmt_t srcFmt,
+                              uint16_t width, uint16_t height,
+                              img_callback_t callback, void *arg) {
+    if (dst == NULL || src == NULL) {
+        return IMG_ERR_NULLPTR;
+    }
+
+    uint8_t dstBytes = img_fmtBytes(dstFmt);
+    uint8_t srcBytes = img_fmtBytes(srcFmt);
+    if (dstBytes == 0 || srcBytes == 0 || dstFmt == IMG_FMT_L8) {
+        return IMG_ERR_FORMAT;
+    }
+    if (width == 0 || height == 0 || width > IMG_CONVERT_MAXWIDTH) {
+        return IMG_ERR_SIZE;
+    }
+
+    // Pixels can't straddle a bus word, RGB888 goes a byte
+    // at a time
+    uint8_t dstAlign = dstBytes == 3 ? 1 : dstBytes;
+    uint8_t srcAlign = srcBytes == 3 ? 1 : srcBytes;
+    if (((uint32_t) dst & (dstAlign - 1)) != 0 || ((uint32_t) src & (srcAlign - 1)) != 0) {
+        return IMG_ERR_ALIGN;
+    }
+
+    uint32_t pixels = (uint32_t) width*height;
+    if (sdram_inCcm((uint32_t) dst, pixels*dstBytes) ||
+        sdram_inCcm((uint32_t) src, pixels*srcBytes)) {
+        return IMG_ERR_RANGE;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if (img_convertCount == IMG_CONVERT_QUEUE) {
+        __set_PRIMASK(primask);
+        return IMG_ERR_BUSY;
+    }
+
+    img_convert_t *conv = &img_convertQueue[(img_convertHead + img_convertCount) % IMG_CONVERT_QUEUE];
+    conv->img_convert_dst = (uint32_t) dst;
+    conv->img_convert_src = (uint32_t) src;
+    conv->img_convert_dstFmt = dstFmt;
+    conv->img_convert_srcFmt = srcFmt;
+    conv->img_convert_width = width;
+    conv->img_convert_height = height;
+    conv->img_convert_callback = callback;
+    conv->img_convert_arg = arg;
+    img_convertCount++;
+
+    // An idle DMA2D starts now, otherwise the interrupt
+    // gets to it
+    if (img_convertCount == 1) {
+        img_convertStart();
+    }
+
+    __set_PRIMASK(primask);
+
+    return IMG_INFO_OK;
+}
+
+uint8_t img_ConvertBusy() {
+    return img_convertCount;
+}
+
+img_status_t img_ConvertWait() {
+    uint64_t deadline = tick_Deadline(IMG_CONVERT_TIMEOUT_US);
+    while (img_convertCount > 0) {
+        if (tick_Expired(deadline)) {
+            return IMG_ERR_TIMEOUT;
+        }
+    }
+
+    return IMG_INFO_OK;
+}
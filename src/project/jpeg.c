@@ -0,0 +1,515 @@
+/** @file jpeg.c
+ *  @brief Implemenation of the JPEG encoder.
+ *
+ *  This contains the implementations of the baseline
+ *  JPEG encoder.
+ *
+ *  The DCT is the integer AAN one from the IJG library,
+ *  eight bit constants and no multiplies by the scale
+ *  factors. Those go into the quantizer, which multiplies
+ *  by a reciprocal instead of dividing. The Huffman
+ *  tables are the standard ones from Annex K of the
+ *  specification.
+ *
+ *  @author Ben Heberlein
+ *  @bug No known bugs.
+ */
+
+/*************************************
+ * Includes and definitions
+ */
+
+#include "jpeg.h"
+#include "img.h"
+#include "err.h"
+#include "mem.h"
+#ifdef __KERN
+#include "kern.h"
+#endif
+#include "stm32f4xx.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/* @brief AAN constants, in 1/256ths
+ */
+#define JPEG_FIX_0_382683433 98
+#define JPEG_FIX_0_541196100 139
+#define JPEG_FIX_0_707106781 181
+#define JPEG_FIX_1_306562965 334
+#define JPEG_MULTIPLY(v, c) (((v)*(c)) >> 8)
+
+/* @brief Markers
+ */
+#define JPEG_SOI 0xFFD8
+#define JPEG_EOI 0xFFD9
+#define JPEG_APP0 0xFFE0
+#define JPEG_DQT 0xFFDB
+#define JPEG_SOF0 0xFFC0
+#define JPEG_DHT 0xFFC4
+#define JPEG_SOS 0xFFDA
+
+/* @brief Natural order index of each zigzag position
+ */
+static const uint8_t jpeg_zigzag[64] = {
+     0,  1,  8, 16,  9,  2,  3, 10, 17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+};
+
+/* @brief Standard quantization tables, natural order
+ */
+static const uint8_t jpeg_quantLuma[64] = {
+    16,  11,  10,  16,  24,  40,  51,  61,
+    12,  12,  14,  19,  26,  58,  60,  55,
+    14,  13,  16,  24,  40,  57,  69,  56,
+    14,  17,  22,  29,  51,  87,  80,  62,
+    18,  22,  37,  56,  68, 109, 103,  77,
+    24,  35,  55,  64,  81, 104, 113,  92,
+    49,  64,  78,  87, 103, 121, 120, 101,
+    72,  92,  95,  98, 112, 100, 103,  99,
+};
+
+static const uint8_t jpeg_quantChroma[64] = {
+    17,  18,  24,  47,  99,  99,  99,  99,
+    18,  21,  26,  66,  99,  99,  99,  99,
+    24,  26,  56,  99,  99,  99,  99,  99,
+    47,  66,  99,  99,  99,  99,  99,  99,
+    99,  99,  99,  99,  99,  99,  99,  99,
+    99,  99,  99,  99,  99,  99,  99,  99,
+    99,  99,  99,  99,  99,  99,  99,  99,
+    99,  99,  99,  99,  99,  99,  99,  99,
+};
+
+/* @brief AAN DCT output scale factors, in 1/16384ths,
+ * natural order
+ */
+static const uint16_t jpeg_aanScales[64] = {
+    16384, 22725, 21407, 19266, 16384, 12873,  8867,  4520,
+    22725, 31521, 29692, 26722, 22725, 17855, 12299,  6270,
+    21407, 29692, 27969, 25172, 21407, 16819, 11585,  5906,
+    19266, 26722, 25172, 22654, 19266, 15137, 10426,  5315,
+    16384, 22725, 21407, 19266, 16384, 12873,  8867,  4520,
+    12873, 17855, 16819, 15137, 12873, 10114,  6967,  3552,
+     8867, 12299, 11585, 10426,  8867,  6967,  4799,  2446,
+     4520,  6270,  5906,  5315,  4520,  3552,  2446,  1247,
+};
+
+/* @brief Standard Huffman tables, code counts for each
+ * length then the symbols
+ */
+static const uint8_t jpeg_dcLumaBits[16] = {0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0};
+static const uint8_t jpeg_dcLumaVals[12] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+static const uint8_t jpeg_dcChromaBits[16] = {0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0};
+static const uint8_t jpeg_dcChromaVals[12] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+
+static const uint8_t jpeg_acLumaBits[16] = {0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7D};
+static const uint8_t jpeg_acLumaVals[162] = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+    0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xA1, 0x08, 0x23, 0x42, 0xB1, 0xC1, 0x15, 0x52, 0xD1, 0xF0,
+    0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0A, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2A, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+    0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7,
+    0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3, 0xC4, 0xC5,
+    0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA, 0xE1, 0xE2,
+    0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+    0xF9, 0xFA,
+};
+
+static const uint8_t jpeg_acChromaBits[16] = {0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77};
+static const uint8_t jpeg_acChromaVals[162] = {
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+    0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xA1, 0xB1, 0xC1, 0x09, 0x23, 0x33, 0x52, 0xF0,
+    0x15, 0x62, 0x72, 0xD1, 0x0A, 0x16, 0x24, 0x34, 0xE1, 0x25, 0xF1, 0x17, 0x18, 0x19, 0x1A, 0x26,
+    0x27, 0x28, 0x29, 0x2A, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+    0x49, 0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+    0x69, 0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5,
+    0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3,
+    0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA,
+    0xE2, 0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+    0xF9, 0xFA,
+};
+
+/* @brief Derived Huffman tables, luma and chroma DC then
+ * AC
+ */
+static jpeg_huff_t jpeg_huffDc[2] MEM_CCM;
+static jpeg_huff_t jpeg_huffAc[2] MEM_CCM;
+static uint8_t jpeg_huffReady = 0;
+
+/* @brief Quantization tables for the headers, and the
+ * reciprocals with the DCT scale folded in, luma then
+ * chroma, zigzag order
+ */
+static uint8_t jpeg_quant[2][64] MEM_CCM;
+static uint32_t jpeg_recip[2][64] MEM_CCM;
+static uint8_t jpeg_quality = 0;
+
+/* @brief Strip of the frame being coded
+ */
+static uint32_t jpeg_strip[JPEG_MAXWIDTH*IMG_YUV_BPP*JPEG_MCU/4] MEM_CCM;
+
+#ifdef __KERN
+/* @brief Keeps tasks off each other's strip and tables,
+ * zeroed is unlocked
+ */
+static kern_mutex_t jpeg_mutex;
+#endif
+
+/**************************************
+ * Private functions
+ */
+
+/* Bytes past the end are counted but not written, the
+ * caller checks the length at the end */
+void jpeg_putByte(jpeg_writer_t *w, uint8_t byte) {
+    if (w->jpeg_writer_len < w->jpeg_writer_max) {
+        w->jpeg_writer_out[w->jpeg_writer_len] = byte;
+    }
+    w->jpeg_writer_len++;
+}
+
+void jpeg_putWord(jpeg_writer_t *w, uint16_t word) {
+    jpeg_putByte(w, word >> 8);
+    jpeg_putByte(w, word & 0xFF);
+}
+
+void jpeg_huffBuild(jpeg_huff_t *huff, const uint8_t *bits, const uint8_t *vals) {
+    uint16_t code = 0;
+    uint8_t k = 0;
+    for (uint8_t len = 1; len <= 16; len++) {
+        for (uint8_t i = 0; i < bits[len - 1]; i++) {
+            huff->jpeg_huff_code[vals[k]] = code++;
+            huff->jpeg_huff_size[vals[k]] = len;
+            k++;
+        }
+        code <<= 1;
+    }
+}
+
+void jpeg_huffInit() {
+    if (jpeg_huffReady) {
+        return;
+    }
+
+    jpeg_huffBuild(&jpeg_huffDc[0], jpeg_dcLumaBits, jpeg_dcLumaVals);
+    jpeg_huffBuild(&jpeg_huffDc[1], jpeg_dcChromaBits, jpeg_dcChromaVals);
+    jpeg_huffBuild(&jpeg_huffAc[0], jpeg_acLumaBits, jpeg_acLumaVals);
+    jpeg_huffBuild(&jpeg_huffAc[1], jpeg_acChromaBits, jpeg_acChromaVals);
+    jpeg_huffReady = 1;
+}
+
+void jpeg_quantInit(uint8_t quality) {
+    if (quality == jpeg_quality) {
+        return;
+    }
+
+    // IJG scaling, 100 is all ones
+    uint32_t scale = quality < 50 ? 5000/quality : 200 - quality*2;
+    for (uint8_t t = 0; t < 2; t++) {
+        const uint8_t *base = t == 0 ? jpeg_quantLuma : jpeg_quantChroma;
+        for (uint8_t k = 0; k < 64; k++) {
+            uint8_t i = jpeg_zigzag[k];
+            uint32_t q = (base[i]*scale + 50)/100;
+            q = q < 1 ? 1 : q > 255 ? 255 : q;
+            jpeg_quant[t][k] = q;
+
+            // The DCT leaves the AAN factor and 8 in each
+            // coefficient
+            uint32_t div = (q*jpeg_aanScales[i] + (1 << 10)) >> 11;
+            jpeg_recip[t][k] = ((1 << JPEG_RECIP_BITS) + div/2)/div;
+        }
+    }
+    jpeg_quality = quality;
+}
+
+MEM_RAMFUNC void jpeg_fdct(int32_t *blk) {
+    int32_t tmp0, tmp1, tmp2, tmp3, tmp4, tmp5, tmp6, tmp7;
+    int32_t tmp10, tmp11, tmp12, tmp13;
+    int32_t z1, z2, z3, z4, z5, z11, z13;
+
+    // Rows, then columns, the same butterflies
+    for (uint8_t pass = 0; pass < 2; pass++) {
+        uint8_t step = pass == 0 ? 1 : 8;
+        int32_t *d = blk;
+        for (uint8_t n = 0; n < 8; n++) {
+            tmp0 = d[0*step] + d[7*step];
+            tmp7 = d[0*step] - d[7*step];
+            tmp1 = d[1*step] + d[6*step];
+            tmp6 = d[1*step] - d[6*step];
+            tmp2 = d[2*step] + d[5*step];
+            tmp5 = d[2*step] - d[5*step];
+            tmp3 = d[3*step] + d[4*step];
+            tmp4 = d[3*step] - d[4*step];
+
+            // Even part
+            tmp10 = tmp0 + tmp3;
+            tmp13 = tmp0 - tmp3;
+            tmp11 = tmp1 + tmp2;
+            tmp12 = tmp1 - tmp2;
+
+            d[0*step] = tmp10 + tmp11;
+            d[4*step] = tmp10 - tmp11;
+
+            z1 = JPEG_MULTIPLY(tmp12 + tmp13, JPEG_FIX_0_707106781);
+            d[2*step] = tmp13 + z1;
+            d[6*step] = tmp13 - z1;
+
+            // Odd part
+            tmp10 = tmp4 + tmp5;
+            tmp11 = tmp5 + tmp6;
+            tmp12 = tmp6 + tmp7;
+
+            z5 = JPEG_MULTIPLY(tmp10 - tmp12, JPEG_FIX_0_382683433);
+            z2 = JPEG_MULTIPLY(tmp10, JPEG_FIX_0_541196100) + z5;
+            z4 = JPEG_MULTIPLY(tmp12, JPEG_FIX_1_306562965) + z5;
+            z3 = JPEG_MULTIPLY(tmp11, JPEG_FIX_0_707106781);
+
+            z11 = tmp7 + z3;
+            z13 = tmp7 - z3;
+
+            d[5*step] = z13 + z2;
+            d[3*step] = z13 - z2;
+            d[1*step] = z11 + z4;
+            d[7*step] = z11 - z4;
+
+            d += pass == 0 ? 8 : 1;
+        }
+    }
+}
+
+void jpeg_putBits(jpeg_writer_t *w, uint32_t bits, uint8_t n) {
+    w->jpeg_writer_bitBuf = w->jpeg_writer_bitBuf << n | (bits & ((1 << n) - 1));
+    w->jpeg_writer_bitCount += n;
+    while (w->jpeg_writer_bitCount >= 8) {
+        uint8_t byte = w->jpeg_writer_bitBuf >> (w->jpeg_writer_bitCount - 8);
+        jpeg_putByte(w, byte);
+        if (byte == 0xFF) {
+            jpeg_putByte(w, 0x00);
+        }
+        w->jpeg_writer_bitCount -= 8;
+    }
+}
+
+/* Magnitude category of a coefficient, and its bits,
+ * one less than the value for negatives */
+uint8_t jpeg_category(int32_t v, uint32_t *bits) {
+    uint32_t mag = v < 0 ? -v : v;
+    *bits = v < 0 ? v - 1 : v;
+    return mag == 0 ? 0 : 32 - __CLZ(mag);
+}
+
+MEM_RAMFUNC void jpeg_block(jpeg_writer_t *w, int32_t *blk, uint8_t comp) {
+    uint8_t t = comp == 0 ? 0 : 1;
+    const uint32_t *recip = jpeg_recip[t];
+    int32_t zz[64];
+    uint32_t bits;
+    uint8_t n;
+
+    jpeg_fdct(blk);
+
+    // Round to nearest, symmetric about zero
+    for (uint8_t k = 0; k < 64; k++) {
+        int32_t c = blk[jpeg_zigzag[k]];
+        int32_t q = (int32_t) (((uint32_t) (c < 0 ? -c : c)*recip[k] +
+                                (1 << (JPEG_RECIP_BITS - 1))) >> JPEG_RECIP_BITS);
+        zz[k] = c < 0 ? -q : q;
+    }
+
+    // DC is coded as the change from the last block
+    n = jpeg_category(zz[0] - w->jpeg_writer_dcPred[comp], &bits);
+    w->jpeg_writer_dcPred[comp] = zz[0];
+    jpeg_putBits(w, jpeg_huffDc[t].jpeg_huff_code[n], jpeg_huffDc[t].jpeg_huff_size[n]);
+    if (n != 0) {
+        jpeg_putBits(w, bits, n);
+    }
+
+    // AC as runs of zeros then a value, 0xF0 is sixteen
+    // zeros and 0x00 ends the block
+    const jpeg_huff_t *ac = &jpeg_huffAc[t];
+    uint8_t run = 0;
+    for (uint8_t k = 1; k < 64; k++) {
+        if (zz[k] == 0) {
+            run++;
+            continue;
+        }
+        while (run > 15) {
+            jpeg_putBits(w, ac->jpeg_huff_code[0xF0], ac->jpeg_huff_size[0xF0]);
+            run -= 16;
+        }
+        n = jpeg_category(zz[k], &bits);
+        uint8_t sym = run << 4 | n;
+        jpeg_putBits(w, ac->jpeg_huff_code[sym], ac->jpeg_huff_size[sym]);
+        jpeg_putBits(w, bits, n);
+        run = 0;
+    }
+    if (run != 0) {
+        jpeg_putBits(w, ac->jpeg_huff_code[0x00], ac->jpeg_huff_size[0x00]);
+    }
+}
+
+void jpeg_dht(jpeg_writer_t *w, uint8_t id, const uint8_t *bits, const uint8_t *vals) {
+    uint16_t count = 0;
+    jpeg_putByte(w, id);
+    for (uint8_t i = 0; i < 16; i++) {
+        jpeg_putByte(w, bits[i]);
+        count += bits[i];
+    }
+    for (uint16_t i = 0; i < count; i++) {
+        jpeg_putByte(w, vals[i]);
+    }
+}
+
+void jpeg_headers(jpeg_writer_t *w, uint16_t width, uint16_t height) {
+    jpeg_putWord(w, JPEG_SOI);
+
+    // JFIF 1.1, no density or thumbnail
+    static const uint8_t jfif[] = {'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0, 1, 0, 0};
+    jpeg_putWord(w, JPEG_APP0);
+    jpeg_putWord(w, 2 + sizeof(jfif));
+    for (uint8_t i = 0; i < sizeof(jfif); i++) {
+        jpeg_putByte(w, jfif[i]);
+    }
+
+    // Both quantization tables, eight bit
+    jpeg_putWord(w, JPEG_DQT);
+    jpeg_putWord(w, 2 + 2*65);
+    for (uint8_t t = 0; t < 2; t++) {
+        jpeg_putByte(w, t);
+        for (uint8_t k = 0; k < 64; k++) {
+            jpeg_putByte(w, jpeg_quant[t][k]);
+        }
+    }
+
+    // Three components, luma sampled twice each way
+    static const uint8_t comps[] = {1, 0x22, 0, 2, 0x11, 1, 3, 0x11, 1};
+    jpeg_putWord(w, JPEG_SOF0);
+    jpeg_putWord(w, 8 + sizeof(comps));
+    jpeg_putByte(w, 8);
+    jpeg_putWord(w, height);
+    jpeg_putWord(w, width);
+    jpeg_putByte(w, 3);
+    for (uint8_t i = 0; i < sizeof(comps); i++) {
+        jpeg_putByte(w, comps[i]);
+    }
+
+    // DC tables are class 0, AC class 1
+    jpeg_putWord(w, JPEG_DHT);
+    jpeg_putWord(w, 2 + 4*17 + 2*12 + 2*162);
+    jpeg_dht(w, 0x00, jpeg_dcLumaBits, jpeg_dcLumaVals);
+    jpeg_dht(w, 0x10, jpeg_acLumaBits, jpeg_acLumaVals);
+    jpeg_dht(w, 0x01, jpeg_dcChromaBits, jpeg_dcChromaVals);
+    jpeg_dht(w, 0x11, jpeg_acChromaBits, jpeg_acChromaVals);
+
+    // One interleaved scan of everything
+    static const uint8_t scan[] = {3, 1, 0x00, 2, 0x11, 3, 0x11, 0, 63, 0};
+    jpeg_putWord(w, JPEG_SOS);
+    jpeg_putWord(w, 2 + sizeof(scan));
+    for (uint8_t i = 0; i < sizeof(scan); i++) {
+        jpeg_putByte(w, scan[i]);
+    }
+}
+
+/**************************************
+ * Public functions
+ */
+
+jpeg_status_t jpeg_Encode(uint8_t *dst, uint32_t max, uint32_t *len,
+                          const uint8_t *src, uint16_t width, uint16_t height,
+                          uint8_t quality) {
+    if (dst == NULL || len == NULL || src == NULL) {
+        return JPEG_ERR_NULLPTR;
+    }
+
+    if (quality < JPEG_QUALITY_MIN || quality > JPEG_QUALITY_MAX) {
+        return JPEG_ERR_QUALITY;
+    }
+
+    if (width == 0 || height == 0 || width > JPEG_MAXWIDTH ||
+        width % JPEG_MCU != 0 || height % JPEG_MCU != 0) {
+        return JPEG_ERR_SIZE;
+    }
+
+    #ifdef __KERN
+    // Interrupts can't block, they must not encode
+    uint8_t locked = 0;
+    if (kern_Running() && __get_IPSR() == 0) {
+        kern_MutexLock(&jpeg_mutex, KERN_WAIT_FOREVER);
+        locked = 1;
+    }
+    #endif
+
+    jpeg_huffInit();
+    jpeg_quantInit(quality);
+
+    jpeg_writer_t writer;
+    writer.jpeg_writer_out = dst;
+    writer.jpeg_writer_len = 0;
+    writer.jpeg_writer_max = max;
+    writer.jpeg_writer_bitBuf = 0;
+    writer.jpeg_writer_bitCount = 0;
+    writer.jpeg_writer_dcPred[0] = 0;
+    writer.jpeg_writer_dcPred[1] = 0;
+    writer.jpeg_writer_dcPred[2] = 0;
+
+    jpeg_headers(&writer, width, height);
+
+    int32_t blk[64];
+    uint32_t stride = width*IMG_YUV_BPP;
+    const uint8_t *strip = (const uint8_t *) jpeg_strip;
+    for (uint16_t y = 0; y < height; y += JPEG_MCU) {
+        memcpy(jpeg_strip, src + y*stride, stride*JPEG_MCU);
+
+        for (uint16_t x = 0; x < width; x += JPEG_MCU) {
+            // Four luma blocks, left to right then down
+            for (uint8_t b = 0; b < 4; b++) {
+                const uint8_t *p = strip + (b >> 1)*8*stride + (x + (b & 1)*8)*IMG_YUV_BPP;
+                for (uint8_t r = 0; r < 8; r++) {
+                    for (uint8_t c = 0; c < 8; c++) {
+                        blk[r*8 + c] = p[c*IMG_YUV_BPP + IMG_YUV_LUMA] - 128;
+                    }
+                    p += stride;
+                }
+                jpeg_block(&writer, blk, 0);
+            }
+
+            // Each word is a pixel pair's chroma, averaged
+            // with the line below through the SIMD unit
+            int32_t cr[64];
+            const uint32_t *w = jpeg_strip + x*IMG_YUV_BPP/4;
+            for (uint8_t r = 0; r < 8; r++) {
+                for (uint8_t c = 0; c < 8; c++) {
+                    uint32_t uv = __UHADD8(w[c], w[c + stride/4]);
+                    blk[r*8 + c] = (int32_t) (uv & 0xFF) - 128;
+                    cr[r*8 + c] = (int32_t) (uv >> 16 & 0xFF) - 128;
+                }
+                w += stride/2;
+            }
+            jpeg_block(&writer, blk, 1);
+            jpeg_block(&writer, cr, 2);
+        }
+    }
+
+    // Pad the last byte with ones
+    jpeg_putBits(&writer, 0x7F, 7);
+    writer.jpeg_writer_bitCount = 0;
+    jpeg_putWord(&writer, JPEG_EOI);
+
+    #ifdef __KERN
+    if (locked) {
+        kern_MutexUnlock(&jpeg_mutex);
+    }
+    #endif
+
+    if (writer.jpeg_writer_len > max) {
+        return JPEG_ERR_FULL;
+    }
+
+    *len = writer.jpeg_writer_len;
+
+    return JPEG_INFO_OK;
+}
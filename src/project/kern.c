@@ -0,0 +1,658 @@
+/** @file kern.c
+ *  @brief Implemenation of the preemptive kernel.
+ *
+ *  This contains the implementations of the kernel
+ *  functions. Each task owns one priority, so the ready
+ *  set and every wait list is a 32 bit mask of priorities
+ *  and the highest priority task is found with CLZ.
+ *
+ *  Kernel critical sections mask all interrupts with
+ *  PRIMASK, so any interrupt handler may call the Isr
+ *  and Give functions. PendSV and SysTick run at the
+ *  lowest priority.
+ *
+ *  @author Ben Heberlein
+ *  @bug Mutexes do not implement priority inheritance, so
+ *  keep mutex sections short.
+ */
+
+/*************************************
+ * Includes and definitions
+ */
+
+#ifdef __KERN
+#include "kern.h"
+#include "err.h"
+#include "mem.h"
+#include "stm32f4xx.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/* @brief Priority bit in the ready and wait masks
+ */
+#define KERN_BIT(prio) (1UL << (prio))
+
+/* @brief Highest priority in a non-zero mask
+ */
+#define KERN_TOP(mask) (31 - __CLZ(mask))
+
+/* @brief Initial xPSR with the Thumb bit set
+ */
+#define KERN_XPSR_INIT 0x01000000
+
+/* @brief Exception return to thread mode on PSP, no FPU
+ */
+#define KERN_EXC_RETURN 0xFFFFFFFD
+
+/* @brief Currently running task, referenced from the
+ * PendSV assembly so it can't be static
+ */
+kern_task_t *kern_current = NULL;
+
+/* @brief Tasks indexed by priority
+ */
+static kern_task_t *kern_tasks[KERN_TASK_MAX];
+
+/* @brief Wait list each blocked task is on, NULL if
+ * the task is only sleeping
+ */
+static uint32_t *kern_waitLists[KERN_TASK_MAX];
+
+/* @brief Ready set
+ */
+static volatile uint32_t kern_ready = 0;
+
+/* @brief Tick counter
+ */
+static volatile uint32_t kern_ticks = 0;
+
+/* @brief Idle task
+ */
+static kern_task_t kern_idleTask;
+static uint32_t kern_idleStack[KERN_IDLE_STACKSIZE] MEM_CCM __attribute__ ((aligned (8)));
+
+/* @brief State flags
+ */
+static uint8_t kern_initialized = 0;
+static volatile uint8_t kern_running = 0;
+
+#endif
+
+/**************************************
+ * Private functions
+ */
+
+#ifdef __KERN
+/** @brief Wake tasks whose timeout has expired
+ *
+ *  Must be called with interrupts masked.
+ */
+static void kern_timeouts() {
+    for (uint8_t p = 1; p < KERN_TASK_MAX; p++) {
+        kern_task_t *task = kern_tasks[p];
+        if (task == NULL || task->kern_task_state != KERN_STATE_BLOCKED ||
+            task->kern_task_timed == 0) {
+            continue;
+        }
+        if ((int32_t)(kern_ticks - task->kern_task_wake) >= 0) {
+            if (kern_waitLists[p] != NULL) {
+                *kern_waitLists[p] &= ~KERN_BIT(p);
+                kern_waitLists[p] = NULL;
+            }
+            task->kern_task_timed = 0;
+            task->kern_task_timedOut = 1;
+            task->kern_task_state = KERN_STATE_READY;
+            kern_ready |= KERN_BIT(p);
+        }
+    }
+}
+
+/** @brief Ticks until the next timed wakeup
+ *
+ *  Must be called with interrupts masked.
+ *
+ *  @return ticks, or KERN_WAIT_FOREVER if no task is timed
+ */
+static uint32_t kern_nextWake() {
+    uint32_t next = KERN_WAIT_FOREVER;
+    for (uint8_t p = 1; p < KERN_TASK_MAX; p++) {
+        kern_task_t *task = kern_tasks[p];
+        if (task == NULL || task->kern_task_state != KERN_STATE_BLOCKED ||
+            task->kern_task_timed == 0) {
+            continue;
+        }
+        int32_t left = (int32_t)(task->kern_task_wake - kern_ticks);
+        if (left <= 0) {
+            return 0;
+        }
+        if ((uint32_t) left < next) {
+            next = (uint32_t) left;
+        }
+    }
+    return next;
+}
+
+/** @brief Stop the tick and sleep for up to n ticks
+ *
+ *  Must be called with interrupts masked. SysTick is
+ *  reprogrammed to fire at the end of the idle period and
+ *  the tick count is corrected on wakeup. The tick phase
+ *  restarts after every sleep.
+ *
+ *  @param n number of ticks to sleep
+ */
+static void kern_sleepTicks(uint32_t n) {
+    uint32_t perTick = SystemCoreClock / KERN_TICK_HZ;
+    uint32_t maxTicks = SysTick_LOAD_RELOAD_Msk / perTick;
+
+    if (n > maxTicks) {
+        n = maxTicks;
+    }
+
+    // Not worth stopping the tick
+    if (n < 2) {
+        __DSB();
+        __WFI();
+        __ISB();
+        return;
+    }
+
+    // Count out the rest of this tick plus n-1 more
+    SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+    uint32_t reload = SysTick->VAL + perTick * (n - 1);
+    SysTick->LOAD = reload;
+    SysTick->VAL = 0;
+    SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+
+    __DSB();
+    __WFI();
+    __ISB();
+
+    uint32_t ctrl = SysTick->CTRL;
+    SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+
+    uint32_t elapsed;
+    if (ctrl & SysTick_CTRL_COUNTFLAG_Msk) {
+        // Period completed, the pending tick adds the last one
+        elapsed = n - 1;
+    } else {
+        // Another interrupt woke us early
+        elapsed = (reload - SysTick->VAL) / perTick;
+    }
+
+    // Back to the normal tick
+    SysTick->LOAD = perTick - 1;
+    SysTick->VAL = 0;
+    SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+
+    kern_ticks += elapsed;
+    kern_timeouts();
+    kern_yield();
+}
+
+void kern_switch() {
+    kern_current = kern_tasks[KERN_TOP(kern_ready)];
+}
+
+void kern_yield() {
+    if (kern_running == 0) {
+        return;
+    }
+    if (kern_tasks[KERN_TOP(kern_ready)] != kern_current) {
+        SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+    }
+}
+
+kern_status_t kern_block(uint32_t *waiters, uint32_t timeout) {
+    // Can't block before start or from an interrupt
+    if (kern_running == 0 || __get_IPSR() != 0) {
+        return KERN_ERR_CONTEXT;
+    }
+    if (timeout == KERN_WAIT_NONE) {
+        return KERN_ERR_TIMEOUT;
+    }
+
+    kern_task_t *task = kern_current;
+    uint8_t p = task->kern_task_prio;
+
+    if (waiters != NULL) {
+        *waiters |= KERN_BIT(p);
+    }
+    kern_waitLists[p] = waiters;
+    kern_ready &= ~KERN_BIT(p);
+    task->kern_task_state = KERN_STATE_BLOCKED;
+    task->kern_task_timedOut = 0;
+    if (timeout == KERN_WAIT_FOREVER) {
+        task->kern_task_timed = 0;
+    } else {
+        task->kern_task_timed = 1;
+        task->kern_task_wake = kern_ticks + timeout;
+    }
+
+    // PendSV is taken as soon as interrupts are unmasked
+    kern_yield();
+    __enable_irq();
+    __ISB();
+    __disable_irq();
+
+    if (task->kern_task_timedOut) {
+        return KERN_ERR_TIMEOUT;
+    }
+    return KERN_INFO_OK;
+}
+
+uint8_t kern_wake(uint32_t *waiters) {
+    if (*waiters == 0) {
+        return 0;
+    }
+
+    uint8_t p = KERN_TOP(*waiters);
+    kern_task_t *task = kern_tasks[p];
+
+    *waiters &= ~KERN_BIT(p);
+    kern_waitLists[p] = NULL;
+    task->kern_task_timed = 0;
+    task->kern_task_state = KERN_STATE_READY;
+    kern_ready |= KERN_BIT(p);
+
+    kern_yield();
+
+    return 1;
+}
+
+void kern_taskExit() {
+    __disable_irq();
+    kern_current->kern_task_state = KERN_STATE_DEAD;
+    kern_ready &= ~KERN_BIT(kern_current->kern_task_prio);
+    kern_yield();
+    __enable_irq();
+
+    while (1) {}
+}
+
+void kern_idle(void *arg) {
+    while (1) {
+        __disable_irq();
+        // Only sleep when nothing else became ready
+        if (kern_ready == KERN_BIT(0)) {
+            uint32_t next = kern_nextWake();
+            if (next != 0) {
+                kern_sleepTicks(next);
+            }
+        }
+        __enable_irq();
+    }
+}
+
+__attribute__ ((naked)) void PendSV_Handler(void) {
+    __asm volatile (
+        "   cpsid i                     \n"
+        "   ldr r3, =kern_current       \n"
+        "   ldr r2, [r3]                \n"
+        "   cbz r2, 1f                  \n" // First switch, nothing to save
+        "   mrs r0, psp                 \n"
+        "   isb                         \n"
+        "   tst r14, #0x10              \n" // Save FPU registers if used
+        "   it eq                       \n"
+        "   vstmdbeq r0!, {s16-s31}     \n"
+        "   stmdb r0!, {r4-r11, r14}    \n"
+        "   str r0, [r2]                \n"
+        "1: bl kern_switch              \n"
+        "   ldr r3, =kern_current       \n"
+        "   ldr r1, [r3]                \n"
+        "   ldr r0, [r1]                \n"
+        "   ldmia r0!, {r4-r11, r14}    \n"
+        "   tst r14, #0x10              \n"
+        "   it eq                       \n"
+        "   vldmiaeq r0!, {s16-s31}     \n"
+        "   msr psp, r0                 \n"
+        "   isb                         \n"
+        "   cpsie i                     \n"
+        "   bx r14                      \n"
+        "   .ltorg                      \n"
+    );
+}
+#endif
+
+/**************************************
+ * Public functions
+ */
+
+#ifdef __KERN
+kern_status_t kern_Init() {
+    if (kern_initialized == 1) {
+        return KERN_WARN_ALINIT;
+    }
+
+    for (uint8_t p = 0; p < KERN_TASK_MAX; p++) {
+        kern_tasks[p] = NULL;
+        kern_waitLists[p] = NULL;
+    }
+    kern_ready = 0;
+    kern_ticks = 0;
+    kern_initialized = 1;
+
+    // Priority 0 is only used by the idle task
+    return kern_TaskCreate(&kern_idleTask, "idle", kern_idle, NULL, 0,
+                           kern_idleStack, KERN_IDLE_STACKSIZE);
+}
+
+kern_status_t kern_TaskCreate(kern_task_t *task, const char *name, kern_entry_t entry,
+                              void *arg, uint8_t prio, uint32_t *stack, uint32_t stackSize) {
+    if (kern_initialized != 1) {
+        return KERN_ERR_INIT;
+    }
+    if (task == NULL || entry == NULL || stack == NULL) {
+        return KERN_ERR_NULLPTR;
+    }
+    if (prio >= KERN_TASK_MAX || kern_tasks[prio] != NULL ||
+        (prio == 0 && task != &kern_idleTask)) {
+        return KERN_ERR_PRIO;
+    }
+    if (stackSize < 64 || ((uint32_t) stack & 0x7) != 0) {
+        return KERN_ERR_STACK;
+    }
+
+    // Paint the stack for the high-water mark
+    for (uint32_t i = 0; i < stackSize; i++) {
+        stack[i] = KERN_STACK_PAINT;
+    }
+
+    // Build the initial exception frame
+    uint32_t *sp = stack + stackSize;
+    sp = (uint32_t *)((uint32_t) sp & ~0x7);
+    *(--sp) = KERN_XPSR_INIT;                   // xPSR
+    *(--sp) = (uint32_t) entry & ~0x1;          // PC
+    *(--sp) = (uint32_t) kern_taskExit;         // LR
+    *(--sp) = 0;                                // R12
+    *(--sp) = 0;                                // R3
+    *(--sp) = 0;                                // R2
+    *(--sp) = 0;                                // R1
+    *(--sp) = (uint32_t) arg;                   // R0
+    *(--sp) = KERN_EXC_RETURN;                  // R14
+    for (uint8_t r = 0; r < 8; r++) {
+        *(--sp) = 0;                            // R11-R4
+    }
+
+    task->kern_task_sp = sp;
+    task->kern_task_stack = stack;
+    task->kern_task_stackSize = stackSize;
+    task->kern_task_wake = 0;
+    task->kern_task_prio = prio;
+    task->kern_task_timed = 0;
+    task->kern_task_timedOut = 0;
+    task->kern_task_name = name;
+
+    __disable_irq();
+    task->kern_task_state = KERN_STATE_READY;
+    kern_tasks[prio] = task;
+    kern_ready |= KERN_BIT(prio);
+    kern_yield();
+    __enable_irq();
+
+    return KERN_INFO_OK;
+}
+
+kern_status_t kern_Start() {
+    if (kern_initialized != 1) {
+        return KERN_ERR_INIT;
+    }
+    if (kern_running == 1) {
+        return KERN_WARN_ALINIT;
+    }
+
+    // Context switches and the tick must not preempt ISRs
+    NVIC_SetPriority(PendSV_IRQn, (1 << __NVIC_PRIO_BITS) - 1);
+    if (SysTick_Config(SystemCoreClock / KERN_TICK_HZ) != 0) {
+        return KERN_ERR_INIT;
+    }
+
+    __disable_irq();
+    kern_current = NULL;
+    kern_running = 1;
+    SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+    __DSB();
+    __ISB();
+    __enable_irq();
+
+    // PendSV switches to the first task and never comes back
+    while (1) {}
+
+    return KERN_ERR_UNKNOWN;
+}
+
+uint8_t kern_Running() {
+    return kern_running;
+}
+
+void kern_Tick() {
+    __disable_irq();
+    kern_ticks++;
+    kern_timeouts();
+    kern_yield();
+    __enable_irq();
+}
+
+uint32_t kern_Ticks() {
+    return kern_ticks;
+}
+
+kern_task_t *kern_TaskSelf() {
+    return kern_current;
+}
+
+uint32_t kern_TaskStackUsed(kern_task_t *task) {
+    if (task == NULL || task->kern_task_stack == NULL) {
+        return 0;
+    }
+
+    // Stack grows down, so paint survives at the bottom
+    uint32_t unused = 0;
+    while (unused < task->kern_task_stackSize &&
+           task->kern_task_stack[unused] == KERN_STACK_PAINT) {
+        unused++;
+    }
+
+    return (task->kern_task_stackSize - unused) * sizeof(uint32_t);
+}
+
+void kern_Sleep(uint32_t ticks) {
+    if (ticks == 0) {
+        return;
+    }
+    __disable_irq();
+    kern_block(NULL, ticks);
+    __enable_irq();
+}
+
+kern_status_t kern_SemInit(kern_sem_t *sem, uint32_t count, uint32_t max) {
+    if (sem == NULL) {
+        return KERN_ERR_NULLPTR;
+    }
+    sem->kern_sem_count = count;
+    sem->kern_sem_max = max;
+    sem->kern_sem_waiters = 0;
+    return KERN_INFO_OK;
+}
+
+kern_status_t kern_SemTake(kern_sem_t *sem, uint32_t timeout) {
+    kern_status_t st = KERN_INFO_OK;
+
+    __disable_irq();
+    if (sem->kern_sem_count > 0) {
+        sem->kern_sem_count--;
+    } else {
+        // The giver hands the count straight to us
+        st = kern_block(&sem->kern_sem_waiters, timeout);
+    }
+    __enable_irq();
+
+    return st;
+}
+
+kern_status_t kern_SemGive(kern_sem_t *sem) {
+    kern_status_t st = KERN_INFO_OK;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (kern_wake(&sem->kern_sem_waiters) == 0) {
+        if (sem->kern_sem_count < sem->kern_sem_max) {
+            sem->kern_sem_count++;
+        } else {
+            st = KERN_WARN_SEMFULL;
+        }
+    }
+    __set_PRIMASK(primask);
+
+    return st;
+}
+
+kern_status_t kern_MutexInit(kern_mutex_t *mutex) {
+    if (mutex == NULL) {
+        return KERN_ERR_NULLPTR;
+    }
+    mutex->kern_mutex_owner = NULL;
+    mutex->kern_mutex_waiters = 0;
+    return KERN_INFO_OK;
+}
+
+kern_status_t kern_MutexLock(kern_mutex_t *mutex, uint32_t timeout) {
+    kern_status_t st = KERN_INFO_OK;
+
+    __disable_irq();
+    if (mutex->kern_mutex_owner == NULL) {
+        mutex->kern_mutex_owner = kern_current;
+    } else if (mutex->kern_mutex_owner == kern_current) {
+        st = KERN_ERR_OWNER;
+    } else {
+        // Unlock passes ownership straight to us
+        st = kern_block(&mutex->kern_mutex_waiters, timeout);
+    }
+    __enable_irq();
+
+    return st;
+}
+
+kern_status_t kern_MutexUnlock(kern_mutex_t *mutex) {
+    __disable_irq();
+    if (mutex->kern_mutex_owner != kern_current) {
+        __enable_irq();
+        return KERN_ERR_OWNER;
+    }
+
+    if (mutex->kern_mutex_waiters != 0) {
+        mutex->kern_mutex_owner = kern_tasks[KERN_TOP(mutex->kern_mutex_waiters)];
+        kern_wake(&mutex->kern_mutex_waiters);
+    } else {
+        mutex->kern_mutex_owner = NULL;
+    }
+    __enable_irq();
+
+    return KERN_INFO_OK;
+}
+
+kern_status_t kern_QueueInit(kern_queue_t *queue, void *buf, uint16_t itemSize, uint16_t capacity) {
+    if (queue == NULL || buf == NULL) {
+        return KERN_ERR_NULLPTR;
+    }
+    queue->kern_queue_buf = (uint8_t *) buf;
+    queue->kern_queue_itemSize = itemSize;
+    queue->kern_queue_capacity = capacity;
+    queue->kern_queue_head = 0;
+    queue->kern_queue_tail = 0;
+    queue->kern_queue_size = 0;
+    queue->kern_queue_getWaiters = 0;
+    queue->kern_queue_putWaiters = 0;
+    return KERN_INFO_OK;
+}
+
+kern_status_t kern_QueuePutIsr(kern_queue_t *queue, const void *item) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (queue->kern_queue_size == queue->kern_queue_capacity) {
+        __set_PRIMASK(primask);
+        return KERN_ERR_QUEUEFULL;
+    }
+
+    memcpy(queue->kern_queue_buf + queue->kern_queue_head * queue->kern_queue_itemSize,
+           item, queue->kern_queue_itemSize);
+    queue->kern_queue_head++;
+    if (queue->kern_queue_head >= queue->kern_queue_capacity) {
+        queue->kern_queue_head = 0;
+    }
+    queue->kern_queue_size++;
+
+    kern_wake(&queue->kern_queue_getWaiters);
+    __set_PRIMASK(primask);
+
+    return KERN_INFO_OK;
+}
+
+kern_status_t kern_QueuePut(kern_queue_t *queue, const void *item, uint32_t timeout) {
+    kern_status_t st;
+
+    // Another task can take the slot before we run, so wait out one deadline
+    uint32_t deadline = kern_ticks + timeout;
+    uint32_t wait = timeout;
+
+    __disable_irq();
+    while (queue->kern_queue_size == queue->kern_queue_capacity) {
+        if (timeout != KERN_WAIT_NONE && timeout != KERN_WAIT_FOREVER) {
+            int32_t left = (int32_t)(deadline - kern_ticks);
+            if (left <= 0) {
+                __enable_irq();
+                return KERN_ERR_TIMEOUT;
+            }
+            wait = (uint32_t)left;
+        }
+        st = kern_block(&queue->kern_queue_putWaiters, wait);
+        if (st != KERN_INFO_OK) {
+            __enable_irq();
+            return st;
+        }
+    }
+    st = kern_QueuePutIsr(queue, item);
+    __enable_irq();
+
+    return st;
+}
+
+kern_status_t kern_QueueGet(kern_queue_t *queue, void *item, uint32_t timeout) {
+    kern_status_t st;
+
+    // Another task can take the item before we run, so wait out one deadline
+    uint32_t deadline = kern_ticks + timeout;
+    uint32_t wait = timeout;
+
+    __disable_irq();
+    while (queue->kern_queue_size == 0) {
+        if (timeout != KERN_WAIT_NONE && timeout != KERN_WAIT_FOREVER) {
+            int32_t left = (int32_t)(deadline - kern_ticks);
+            if (left <= 0) {
+                __enable_irq();
+                return KERN_ERR_TIMEOUT;
+            }
+            wait = (uint32_t)left;
+        }
+        st = kern_block(&queue->kern_queue_getWaiters, wait);
+        if (st != KERN_INFO_OK) {
+            __enable_irq();
+            return st;
+        }
+    }
+
+    memcpy(item, queue->kern_queue_buf + queue->kern_queue_tail * queue->kern_queue_itemSize,
+           queue->kern_queue_itemSize);
+    queue->kern_queue_tail++;
+    if (queue->kern_queue_tail >= queue->kern_queue_capacity) {
+        queue->kern_queue_tail = 0;
+    }
+    queue->kern_queue_size--;
+
+    kern_wake(&queue->kern_queue_putWaiters);
+    __enable_irq();
+
+    return KERN_INFO_OK;
+}
+#endif
@@ -23,11 +23,22 @@
 #include "stm32f4xx_usart.h"
 #include "stm32f4xx_rcc.h"
 #include "stm32f4xx_gpio.h"
+#include "tick.h"
+#include "prof.h"
+#ifdef __KERN
+#include "kern.h"
+#endif
 
 /* @brief Initialization flag for logger
  */
 static uint8_t log_initialized = 0;
 
+#ifdef __KERN
+/* @brief Keeps packets from different tasks apart
+ */
+static kern_mutex_t log_mutex;
+#endif
+
 #endif
 
 /**************************************
@@ -91,7 +102,21 @@ log_status_t log_log5(mod_t module, gen_status_t status, char *msg, uint32_t len
     log_packet.log_packet_dataLen = len;
     log_packet.log_packet_data = data;
 
-    return log_send(&log_packet);
+    log_status_t st;
+    prof_Probe(st = log_send(&log_packet), PROF_PROBE_LOG_SEND);
+    return st;
+}
+
+log_status_t log_sendByte(uint8_t byte) {
+    uint64_t deadline = tick_Deadline(LOG_TX_TIMEOUT_US);
+    while (USART_GetFlagStatus(USART2, USART_FLAG_TXE) == RESET) {
+        if (tick_Expired(deadline)) {
+            return LOG_ERR_TIMEOUT;
+        }
+    }
+    USART_SendData(USART2, byte);
+
+    return LOG_INFO_OK;
 }
 
 log_status_t log_send(log_packet_t *log_packet) {
@@ -106,38 +131,49 @@ log_status_t log_send(log_packet_t *log_packet) {
                           sizeof(log_packet->log_packet_msg) +
                           firstSize;
     uint32_t fourthSize = log_packet->log_packet_dataLen;;
+    log_status_t st = LOG_INFO_OK;
+
+    #ifdef __KERN
+    // Interrupts can't block, their packets may interleave
+    uint8_t locked = 0;
+    if (kern_Running() && __get_IPSR() == 0) {
+        kern_MutexLock(&log_mutex, KERN_WAIT_FOREVER);
+        locked = 1;
+    }
+    #endif
    
-    // Send data serially
-    while (i < firstSize) {
-        while (USART_GetFlagStatus(USART2, USART_FLAG_TXE) == RESET) {}
-        USART_SendData(USART2, *(((uint8_t *)log_packet)+i));
+    // Send data serially, stop on the first timeout
+    while (st == LOG_INFO_OK && i < firstSize) {
+        st = log_sendByte(*(((uint8_t *)log_packet)+i));
         i++;
     }
     i = 0;
-    while (i < secondSize) {
-        while (USART_GetFlagStatus(USART2, USART_FLAG_TXE) == RESET) {}
-        USART_SendData(USART2, *(log_packet->log_packet_msg+i));
+    while (st == LOG_INFO_OK && i < secondSize) {
+        st = log_sendByte(*(log_packet->log_packet_msg+i));
         i++;
     }
     i = firstSize + sizeof(log_packet->log_packet_msg);
-    while (i < thirdSize) {
-        while (USART_GetFlagStatus(USART2, USART_FLAG_TXE) == RESET) {}
-        USART_SendData(USART2, *(((uint8_t *)log_packet)+i));
+    while (st == LOG_INFO_OK && i < thirdSize) {
+        st = log_sendByte(*(((uint8_t *)log_packet)+i));
         i++;
     }
     i = 0;
-    while (i < fourthSize) {
-        while (USART_GetFlagStatus(USART2, USART_FLAG_TXE) == RESET) {}
-        // Delay
+    while (st == LOG_INFO_OK && i < fourthSize) {
+        // Gap so the host can keep up
         if (i % 100 == 0) {
-            // 100 cycles works fine for lab computer
-            for (uint32_t j = 0; j < 1000; j++) {}
+            tick_DelayUs(LOG_DATA_GAP_US);
         }
-        USART_SendData(USART2, *(log_packet->log_packet_data+i));
+        st = log_sendByte(*(log_packet->log_packet_data+i));
         i++;
     }
 
-    return LOG_INFO_OK;
+    #ifdef __KERN
+    if (locked) {
+        kern_MutexUnlock(&log_mutex);
+    }
+    #endif
+
+    return st;
 }
 #endif
 
@@ -185,6 +221,10 @@ log_status_t log_Init() {
     // Enable USART
     USART_Cmd(USART2, ENABLE);
 
+    #ifdef __KERN
+    kern_MutexInit(&log_mutex);
+    #endif
+
     log_initialized = 1;
 
     return LOG_INFO_OK;
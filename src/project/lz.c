@@ -0,0 +1,208 @@
+/** @file lz.c
+ *  @brief Implemenation of the LZ compressor.
+ *
+ *  This contains the implementations of the LZ4 block
+ *  compressor.
+ *
+ *  Hash table slots hold the low 16 bits of a position,
+ *  which is all a match 64K back needs. A slot left from
+ *  an earlier block only gives a bad candidate, and every
+ *  candidate is checked against the data.
+ *
+ *  @author Ben Heberlein
+ *  @bug No known bugs.
+ */
+
+/*************************************
+ * Includes and definitions
+ */
+
+#include "lz.h"
+#include "log.h"
+#include "sdram.h"
+#include "mem.h"
+#include "err.h"
+#ifdef __WIFI
+#include "wifi.h"
+#endif
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/* @brief Knuth's multiplicative hash of four bytes
+ */
+#define LZ_HASH(seq) ((uint32_t) ((seq)*2654435761U) >> (32 - LZ_HASH_BITS))
+
+/* @brief Bytes without a match before the search starts
+ * skipping, so data that won't compress goes quickly
+ */
+#define LZ_SKIP_BITS 6
+
+/* @brief Recent positions by hash
+ */
+static uint16_t lz_table[1 << LZ_HASH_BITS] MEM_CCM;
+
+/**************************************
+ * Private functions
+ */
+
+/* Unaligned loads are fine on the M4 */
+uint32_t lz_read32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+uint8_t *lz_putLength(uint8_t *dst, uint32_t len) {
+    while (len >= 255) {
+        *dst++ = 255;
+        len -= 255;
+    }
+    *dst++ = len;
+
+    return dst;
+}
+
+/**************************************
+ * Public functions
+ */
+
+MEM_RAMFUNC lz_status_t lz_Compress(void *dst, uint32_t max, uint32_t *len,
+                                    const void *src, uint32_t size) {
+    if (dst == NULL || len == NULL || src == NULL) {
+        return LZ_ERR_NULLPTR;
+    }
+
+    const uint8_t *in = (const uint8_t *) src;
+    uint8_t *out = (uint8_t *) dst;
+    uint8_t *op = out;
+    uint32_t ip = 0;
+    uint32_t anchor = 0;
+
+    // Same input, same output
+    memset(lz_table, 0, sizeof(lz_table));
+
+    if (size > LZ_MFLIMIT) {
+        uint32_t mflimit = size - LZ_MFLIMIT;
+        uint32_t matchlimit = size - LZ_LASTLITERALS;
+
+        while (ip < mflimit) {
+            uint32_t seq = lz_read32(in + ip);
+            uint32_t h = LZ_HASH(seq);
+            uint16_t dist = ip - lz_table[h];
+            lz_table[h] = ip;
+
+            if (dist == 0 || dist > ip || lz_read32(in + ip - dist) != seq) {
+                ip += 1 + ((ip - anchor) >> LZ_SKIP_BITS);
+                continue;
+            }
+
+            // Grow the match both ways
+            uint32_t m = ip - dist;
+            while (ip > anchor && m > 0 && in[ip - 1] == in[m - 1]) {
+                ip--;
+                m--;
+            }
+            uint32_t mlen = LZ_MINMATCH;
+            while (ip + mlen < matchlimit && in[ip + mlen] == in[m + mlen]) {
+                mlen++;
+            }
+
+            // Token, literals, offset, then the rest of the
+            // match length
+            uint32_t lit = ip - anchor;
+            if ((op - out) + 1 + lit + lit/255 + 1 + 2 + (mlen - LZ_MINMATCH)/255 + 1 > max) {
+                return LZ_ERR_FULL;
+            }
+            uint8_t *token = op++;
+            if (lit >= 15) {
+                *token = 15 << 4;
+                op = lz_putLength(op, lit - 15);
+            } else {
+                *token = lit << 4;
+            }
+            memcpy(op, in + anchor, lit);
+            op += lit;
+            *op++ = dist & 0xFF;
+            *op++ = dist >> 8;
+            if (mlen - LZ_MINMATCH >= 15) {
+                *token |= 15;
+                op = lz_putLength(op, mlen - LZ_MINMATCH - 15);
+            } else {
+                *token |= mlen - LZ_MINMATCH;
+            }
+
+            ip += mlen;
+            anchor = ip;
+
+            // Two back from the end often starts the next
+            // match
+            if (ip < mflimit) {
+                lz_table[LZ_HASH(lz_read32(in + ip - 2))] = ip - 2;
+            }
+        }
+    }
+
+    // The rest goes out as literals
+    uint32_t lit = size - anchor;
+    if ((op - out) + 1 + lit + lit/255 + 1 > max) {
+        return LZ_ERR_FULL;
+    }
+    if (lit >= 15) {
+        *op++ = 15 << 4;
+        op = lz_putLength(op, lit - 15);
+    } else {
+        *op++ = lit << 4;
+    }
+    memcpy(op, in + anchor, lit);
+    op += lit;
+
+    *len = op - out;
+
+    return LZ_INFO_OK;
+}
+
+lz_status_t lz_Send(mod_t module, gen_status_t status, uint32_t len, uint8_t *data) {
+    if (data == NULL) {
+        return LZ_ERR_NULLPTR;
+    }
+
+    uint32_t max = sizeof(lz_header_t) + LZ_BOUND(len);
+    sdram_frame_t *frame = sdram_FrameAlloc(max);
+    uint32_t packed = 0;
+    if (frame != NULL) {
+        uint8_t *buf = (uint8_t *) frame->sdram_frame_addr;
+        lz_header_t *header = (lz_header_t *) buf;
+        header->lz_header_module = module;
+        header->lz_header_status = status;
+        header->lz_header_size = len;
+        if (lz_Compress(buf + sizeof(lz_header_t), max - sizeof(lz_header_t), &packed,
+                        data, len) == LZ_INFO_OK) {
+            packed += sizeof(lz_header_t);
+        } else {
+            packed = 0;
+        }
+    }
+
+    // No room or no gain, send it as it is
+    if (packed == 0 || packed >= len) {
+        if (frame != NULL) {
+            sdram_FrameRelease(frame);
+        }
+        #ifdef __WIFI
+        wifi_Send(module, status, "\0", len, data);
+        #else
+        log_Log(module, status, "\0", len, data);
+        #endif
+        return LZ_WARN_RAW;
+    }
+
+    #ifdef __WIFI
+    wifi_Send(LZ, LZ_INFO_PACKET, "\0", packed, (uint8_t *) frame->sdram_frame_addr);
+    #else
+    log_Log(LZ, LZ_INFO_PACKET, "\0", packed, (uint8_t *) frame->sdram_frame_addr);
+    #endif
+    sdram_FrameRelease(frame);
+
+    return LZ_INFO_OK;
+}
@@ -2,7 +2,7 @@
  *  @brief This file contains the main routine.
  *
  *  This initializes the logger, command interface, 
- *  SDRAM, and starts the main command loop based on
+ *  SDRAM, and starts the scheduler loop based on
  *  compile-time flags.
  *
  *  @author Ben Heberlein
@@ -21,7 +21,18 @@
 #include "prof.h"
 #endif
 #include "cmd.h"
+#include "sched.h"
+#include "tick.h"
+#ifdef __KERN
+#include "kern.h"
+#endif
 #include "sdram.h"
+#ifdef __TRACE
+#include "trace.h"
+#endif
+#ifdef __MON
+#include "mon.h"
+#endif
 #ifdef __TEST
 #include "test.h"
 #endif
@@ -29,19 +40,50 @@
 #include "wifi.h"
 #endif
 #include "cam.h"
+#include "img.h"
+#include "mem.h"
 
 #include <stdint.h>
+#include <stddef.h>
+
+#ifdef __KERN
+/* @brief Control task priority and stack size in words
+ */
+#define MAIN_CONTROL_PRIO 2
+#define MAIN_CONTROL_STACKSIZE 1024
+
+/* @brief Control task, runs the scheduler loop
+ */
+static kern_task_t main_controlTcb;
+static uint32_t main_controlStack[MAIN_CONTROL_STACKSIZE] __attribute__ ((aligned (8)));
+#endif
 
 /**************************************
  * Private functions
  */
 
+#ifdef __KERN
+static void main_controlTask(void *arg) {
+    sched_status_t sc_st = sched_Loop();
+    log_Log(SCHED, sc_st, "Control task exiting.\0");
+}
+#endif
+
 /**************************************
  * Public functions
  */
 
 int main() {
 
+    // Paint the stack before anything else uses it
+    mem_Init();
+
+    // Time base next, every driver wait depends on it
+    tick_status_t t_st = tick_Init();
+    if (t_st != TICK_INFO_OK && t_st != TICK_WARN_ALINIT) {
+        return -6;
+    }
+
     // Run optional tests before initialization
     #ifdef __TEST
     #ifdef __LOG
@@ -51,6 +93,18 @@ int main() {
     #ifdef __PROF
         test_prof();
     #endif
+
+        test_sched();
+        test_tick();
+        test_mem();
+        test_sdram();
+        test_img();
+        test_jpeg();
+        test_lz();
+
+    #ifdef __MON
+        test_mon();
+    #endif
     #endif
 
     #ifdef __LOG
@@ -65,6 +119,16 @@ int main() {
     }
     #endif
 
+    // Scheduler runs commands and background tasks
+    sched_status_t sc_st = sched_Init();
+    if (sc_st == SCHED_INFO_OK) {
+        log_Log(SCHED, SCHED_INFO_OK, "Initialized scheduler.\0");
+    } else if (sc_st == SCHED_WARN_ALINIT) {
+        log_Log(SCHED, SCHED_WARN_ALINIT, "Already initialized scheduler.\0");
+    } else {
+        return -4;
+    }
+
     // Need command module for scheduling even without user commands
     cmd_status_t cm_st = cmd_Init();
     if (cm_st == CMD_INFO_OK) {
@@ -87,6 +151,18 @@ int main() {
     }
     #endif
 
+    #ifdef __MON
+    // Optional interrupt and DMA monitor
+    mon_status_t mo_st = mon_Init();
+    if (mo_st == MON_INFO_OK) {
+        log_Log(MON, MON_INFO_OK, "Initialized monitor.\0");
+    } else if (mo_st == MON_WARN_ALINIT) {
+        log_Log(MON, mo_st, "Monitor already initialized.\0");
+    } else {
+        log_Log(MON, mo_st, "Could not initialize monitor.\0");
+    }
+    #endif
+
     // Initialize SDRAM always
     sdram_status_t sd_st = sdram_Init();
     if (sd_st == SDRAM_INFO_OK) {
@@ -97,6 +173,28 @@ int main() {
         log_Log(SDRAM, sd_st, "Could not initialize SDRAM.\0");
     }
 
+    #ifdef __TRACE
+    // Optional trace recorder, buffer is in SDRAM
+    trace_status_t tr_st = trace_Init();
+    if (tr_st == TRACE_INFO_OK) {
+        log_Log(TRACE, TRACE_INFO_OK, "Initialized trace recorder.\0");
+    } else if (tr_st == TRACE_WARN_ALINIT) {
+        log_Log(TRACE, tr_st, "Trace recorder already initialized.\0");
+    } else {
+        log_Log(TRACE, tr_st, "Could not initialize trace recorder.\0");
+    }
+    #endif
+
+    // Pixel format conversion, after the SDRAM
+    img_status_t i_st = img_Init();
+    if (i_st == IMG_INFO_OK) {
+        log_Log(IMG, IMG_INFO_OK, "Initialized image processing.\0");
+    } else if (i_st == IMG_WARN_ALINIT) {
+        log_Log(IMG, i_st, "Image processing already initialized.\0");
+    } else {
+        log_Log(IMG, i_st, "Could not initialize image processing.\0");
+    }
+
     // Initialize camera always
     cam_status_t cam_st = cam_Init();
     if (cam_st == CAM_INFO_OK) {
@@ -118,10 +216,28 @@ int main() {
     }
     #endif
 
+    #ifdef __KERN
+    // Commands run in the control task, the camera has its own tasks
+    kern_status_t k_st = kern_Init();
+    if (k_st == KERN_INFO_OK) {
+        k_st = kern_TaskCreate(&main_controlTcb, "control", main_controlTask, NULL,
+                               MAIN_CONTROL_PRIO, main_controlStack, MAIN_CONTROL_STACKSIZE);
+    }
+    if (k_st != KERN_INFO_OK || cam_TaskCreate() != CAM_INFO_OK) {
+        log_Log(KERN, k_st, "Could not create kernel tasks.\0");
+        return -5;
+    }
+
+    // Does not return
+    k_st = kern_Start();
+    log_Log(KERN, k_st, "Could not start kernel.\0");
+    return -5;
+    #endif
+
     // Start main loop
-    cmd_status_t cmd_st = cmd_Loop();
-    if (cmd_st != CMD_INFO_OK) {
-        log_Log(CMD, cmd_st, "Exiting main.\0");   
+    sc_st = sched_Loop();
+    if (sc_st != SCHED_INFO_OK) {
+        log_Log(SCHED, sc_st, "Exiting main.\0");   
         return -3;
     }
 
@@ -0,0 +1,169 @@
+/** @file mem.c
+ *  @brief Implemenation of the memory monitor.
+ *
+ *  This contains the implementations of the memory
+ *  monitor functions.
+ *
+ *  @author Ben Heberlein
+ *  @bug No known bugs.
+ */
+
+/*************************************
+ * Includes and definitions
+ */
+
+#include "mem.h"
+#include "err.h"
+#include "log.h"
+#include "stm32f4xx.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <malloc.h>
+
+/* @brief Linker script symbols, only their addresses
+ * are meaningful
+ */
+extern uint32_t _estack;
+extern uint32_t _Min_Heap_Size;
+extern uint32_t _Min_Stack_Size;
+
+#define MEM_STACK_TOP ((uint32_t) &_estack)
+#define MEM_STACK_SIZE ((uint32_t) &_Min_Stack_Size)
+#define MEM_STACK_BOTTOM (MEM_STACK_TOP - MEM_STACK_SIZE)
+
+/* @brief Heap statistics
+ */
+static uint32_t mem_heapCurrent = 0;
+static uint32_t mem_heapPeak = 0;
+static uint32_t mem_allocs = 0;
+static uint32_t mem_frees = 0;
+static uint32_t mem_failures = 0;
+
+/* @brief Initialization flag
+ */
+static uint8_t mem_initialized = 0;
+
+/**************************************
+ * Private functions
+ */
+
+uint32_t mem_stackUsed() {
+    if (mem_initialized != 1) {
+        return 0;
+    }
+
+    uint32_t *p = (uint32_t *) MEM_STACK_BOTTOM;
+    while ((uint32_t) p < MEM_STACK_TOP && *p == MEM_STACK_PAINT) {
+        p++;
+    }
+
+    return MEM_STACK_TOP - (uint32_t) p;
+}
+
+/**************************************
+ * Public functions
+ */
+
+mem_status_t mem_Init() {
+    if (mem_initialized == 1) {
+        return MEM_WARN_ALINIT;
+    }
+
+    // Interrupts use the same stack, paint with them off
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    uint32_t *limit = (uint32_t *) (__get_MSP() - MEM_STACK_MARGIN);
+    for (uint32_t *p = (uint32_t *) MEM_STACK_BOTTOM; p < limit; p++) {
+        *p = MEM_STACK_PAINT;
+    }
+
+    mem_initialized = 1;
+
+    __set_PRIMASK(primask);
+
+    return MEM_INFO_OK;
+}
+
+void *mem_Malloc(size_t size) {
+    // newlib's allocator isn't reentrant
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    uint8_t *block = (uint8_t *) malloc(size + MEM_HEADER_SIZE);
+    if (block == NULL) {
+        mem_failures++;
+        __set_PRIMASK(primask);
+        return NULL;
+    }
+
+    // Remember the size for mem_Free()
+    *(uint32_t *) block = size;
+    mem_heapCurrent += size;
+    if (mem_heapCurrent > mem_heapPeak) {
+        mem_heapPeak = mem_heapCurrent;
+    }
+    mem_allocs++;
+
+    __set_PRIMASK(primask);
+
+    return block + MEM_HEADER_SIZE;
+}
+
+void mem_Free(void *ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+
+    uint8_t *block = (uint8_t *) ptr - MEM_HEADER_SIZE;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    mem_heapCurrent -= *(uint32_t *) block;
+    mem_frees++;
+    free(block);
+    __set_PRIMASK(primask);
+}
+
+mem_status_t mem_ReportGet(mem_report_t *report) {
+    if (report == NULL) {
+        return MEM_ERR_NULLPTR;
+    }
+
+    // Heap obtained from sbrk, including free blocks
+    struct mallinfo info = mallinfo();
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    report->mem_report_heapCurrent = mem_heapCurrent;
+    report->mem_report_heapPeak = mem_heapPeak;
+    report->mem_report_allocs = mem_allocs;
+    report->mem_report_frees = mem_frees;
+    report->mem_report_failures = mem_failures;
+    __set_PRIMASK(primask);
+
+    report->mem_report_heapReserved = (uint32_t) &_Min_Heap_Size;
+    report->mem_report_heapArena = info.arena;
+    report->mem_report_stackUsed = mem_stackUsed();
+    report->mem_report_stackReserved = MEM_STACK_SIZE;
+
+    // Paint at the very bottom is gone, we went past it
+    if (report->mem_report_stackUsed >= MEM_STACK_SIZE) {
+        return MEM_WARN_STACK;
+    }
+
+    return MEM_INFO_OK;
+}
+
+mem_status_t mem_Report() {
+    mem_report_t report;
+    mem_status_t st = mem_ReportGet(&report);
+
+    log_Log(MEM, MEM_INFO_REPORT, "\0", sizeof(report), (uint8_t *) &report);
+    if (st == MEM_WARN_STACK) {
+        log_Log(MEM, st, "Main stack grew past its reservation.\0");
+    }
+
+    return st;
+}
@@ -0,0 +1,244 @@
+/** @file mon.c
+ *  @brief Implemenation of the interrupt and DMA monitor.
+ *
+ *  This contains the implementations of the monitor
+ *  functions.
+ *
+ *  @author Ben Heberlein
+ *  @bug No known bugs.
+ */
+
+/*************************************
+ * Includes and definitions
+ */
+
+#ifdef __MON
+#include "mon.h"
+#include "err.h"
+#include "log.h"
+#include "sched.h"
+#include "tick.h"
+#include "stm32f4xx.h"
+#include "stm32f4xx_rcc.h"
+#include "stm32f4xx_tim.h"
+#include <stdint.h>
+#include <stddef.h>
+
+/* @brief Statistics
+ */
+static mon_irqStats_t mon_irqStats[MON_IRQ_NUM];
+static mon_dmaStats_t mon_dmaStats[MON_DMA_NUM];
+
+/* @brief Handlers currently running
+ */
+static volatile uint8_t mon_nesting = 0;
+
+/* @brief Set while a telemetry task is queued
+ */
+static volatile uint8_t mon_telemetryPending = 0;
+
+/* @brief Report buffer for the telemetry task
+ */
+static mon_report_t mon_telemetry;
+
+/* @brief Initialization flag
+ */
+static uint8_t mon_initialized = 0;
+#endif
+
+/**************************************
+ * Private functions
+ */
+
+#ifdef __MON
+uint32_t mon_irqEnter(mon_irq_t irq) {
+    uint32_t start = TICK_CYCLES();
+
+    // Nested handlers restore the count before we resume
+    uint8_t nesting = ++mon_nesting;
+    if (nesting > mon_irqStats[irq].mon_irqStats_nesting) {
+        mon_irqStats[irq].mon_irqStats_nesting = nesting;
+    }
+
+    return start;
+}
+
+void mon_irqExit(mon_irq_t irq, uint32_t start) {
+    uint32_t cycles = TICK_CYCLES() - start;
+
+    // A handler can't preempt itself, only mon_Reset races
+    mon_irqStats_t *stats = &mon_irqStats[irq];
+    stats->mon_irqStats_count++;
+    stats->mon_irqStats_total += cycles;
+    if (cycles > stats->mon_irqStats_max) {
+        stats->mon_irqStats_max = cycles;
+    }
+
+    mon_nesting--;
+}
+
+void mon_snapshot(mon_report_t *report) {
+    report->mon_report_coreHz = SystemCoreClock;
+    report->mon_report_uptime = tick_Now();
+    report->mon_report_irqs = MON_IRQ_NUM;
+    report->mon_report_dmas = MON_DMA_NUM;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    for (uint8_t i = 0; i < MON_IRQ_NUM; i++) {
+        report->mon_report_irq[i] = mon_irqStats[i];
+    }
+    for (uint8_t d = 0; d < MON_DMA_NUM; d++) {
+        report->mon_report_dma[d] = mon_dmaStats[d];
+    }
+    __set_PRIMASK(primask);
+}
+
+void mon_telemetryTask(void *arg) {
+    mon_telemetryPending = 0;
+
+    mon_snapshot(&mon_telemetry);
+    log_Log(MON, MON_INFO_TELEMETRY, "\0", sizeof(mon_telemetry), (uint8_t *) &mon_telemetry);
+}
+
+void TIM6_DAC_IRQHandler(void) {
+    if (TIM_GetITStatus(TIM6, TIM_IT_Update) != RESET) {
+        TIM_ClearITPendingBit(TIM6, TIM_IT_Update);
+
+        // Skip a period rather than queue up reports
+        if (mon_telemetryPending == 0 &&
+            sched_Post(SCHED_PRIO_BACKGROUND, mon_telemetryTask, NULL) == SCHED_INFO_OK) {
+            mon_telemetryPending = 1;
+        }
+    }
+}
+#endif
+
+/**************************************
+ * Public functions
+ */
+
+#ifdef __MON
+mon_status_t mon_Init() {
+    if (mon_initialized == 1) {
+        return MON_WARN_ALINIT;
+    }
+
+    tick_CycleInit();
+    uint32_t timClk = tick_TimerClock();
+
+    RCC_APB1PeriphClockCmd(RCC_APB1Periph_TIM6, ENABLE);
+
+    // Count at 10 kHz so a 16-bit period covers seconds
+    TIM_TimeBaseInitTypeDef timeInit;
+    timeInit.TIM_Prescaler = timClk/10000 - 1;
+    timeInit.TIM_CounterMode = TIM_CounterMode_Up;
+    timeInit.TIM_Period = MON_TELEMETRY_MS*10 - 1;
+    timeInit.TIM_ClockDivision = TIM_CKD_DIV1;
+    timeInit.TIM_RepetitionCounter = 0;
+    TIM_TimeBaseInit(TIM6, &timeInit);
+
+    TIM_ClearFlag(TIM6, TIM_FLAG_Update);
+    TIM_ITConfig(TIM6, TIM_IT_Update, ENABLE);
+
+    NVIC_InitTypeDef nvicInit;
+    nvicInit.NVIC_IRQChannel = TIM6_DAC_IRQn;
+    nvicInit.NVIC_IRQChannelPreemptionPriority = MON_NVIC_PRIO;
+    nvicInit.NVIC_IRQChannelSubPriority = 0;
+    nvicInit.NVIC_IRQChannelCmd = ENABLE;
+    NVIC_Init(&nvicInit);
+
+    mon_initialized = 1;
+
+    return mon_Reset();
+}
+
+void mon_DmaComplete(mon_dma_t dma, uint32_t bytes) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    mon_dmaStats[dma].mon_dmaStats_bytes += bytes;
+    mon_dmaStats[dma].mon_dmaStats_transfers++;
+    __set_PRIMASK(primask);
+}
+
+void mon_DmaError(mon_dma_t dma, mon_dmaErr_t err) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    switch (err) {
+        case MON_DMAERR_TRANSFER:
+            mon_dmaStats[dma].mon_dmaStats_errTransfer++;
+            break;
+        case MON_DMAERR_FIFO:
+            mon_dmaStats[dma].mon_dmaStats_errFifo++;
+            break;
+        case MON_DMAERR_DIRECT:
+            mon_dmaStats[dma].mon_dmaStats_errDirect++;
+            break;
+    }
+    __set_PRIMASK(primask);
+}
+
+mon_status_t mon_StatsGet(mon_report_t *report) {
+    if (report == NULL) {
+        return MON_ERR_NULLPTR;
+    }
+
+    mon_snapshot(report);
+
+    return MON_INFO_OK;
+}
+
+mon_status_t mon_Stats() {
+    if (mon_initialized != 1) {
+        return MON_ERR_INIT;
+    }
+
+    mon_report_t report;
+    mon_snapshot(&report);
+    log_Log(MON, MON_INFO_STATS, "\0", sizeof(report), (uint8_t *) &report);
+
+    return MON_INFO_OK;
+}
+
+mon_status_t mon_Reset() {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    for (uint8_t i = 0; i < MON_IRQ_NUM; i++) {
+        mon_irqStats[i].mon_irqStats_count = 0;
+        mon_irqStats[i].mon_irqStats_total = 0;
+        mon_irqStats[i].mon_irqStats_max = 0;
+        mon_irqStats[i].mon_irqStats_nesting = 0;
+    }
+    for (uint8_t d = 0; d < MON_DMA_NUM; d++) {
+        mon_dmaStats[d].mon_dmaStats_bytes = 0;
+        mon_dmaStats[d].mon_dmaStats_transfers = 0;
+        mon_dmaStats[d].mon_dmaStats_errTransfer = 0;
+        mon_dmaStats[d].mon_dmaStats_errFifo = 0;
+        mon_dmaStats[d].mon_dmaStats_errDirect = 0;
+    }
+    __set_PRIMASK(primask);
+
+    return MON_INFO_OK;
+}
+
+mon_status_t mon_TelemetryStart() {
+    if (mon_initialized != 1) {
+        return MON_ERR_INIT;
+    }
+
+    TIM_SetCounter(TIM6, 0);
+    TIM_Cmd(TIM6, ENABLE);
+
+    return MON_INFO_OK;
+}
+
+mon_status_t mon_TelemetryStop() {
+    if (mon_initialized != 1) {
+        return MON_ERR_INIT;
+    }
+
+    TIM_Cmd(TIM6, DISABLE);
+
+    return MON_INFO_OK;
+}
+#endif
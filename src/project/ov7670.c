@@ -16,6 +16,12 @@
 #include "ov7670.h"
 #include "ov7670_regs.h"
 #include "sdram.h"
+#include "mem.h"
+#include "tick.h"
+#include "prof.h"
+#include "trace.h"
+#include "mon.h"
+#include "cam.h"
 #include "log.h"
 #include "err.h"
 #include "stm32f4xx_gpio.h"
@@ -92,9 +98,9 @@ ov7670_status_t ov7670_dmaInit() {
     // Construct initialization config
     dmaInit.DMA_Channel = DMA_Channel_1;
     dmaInit.DMA_PeripheralBaseAddr = OV7670_DCMI_PERIPHADDR;
-    dmaInit.DMA_Memory0BaseAddr = (uint32_t) SDRAM_IMAGEADDR;
+    dmaInit.DMA_Memory0BaseAddr = (uint32_t) SDRAM_POOLADDR;
     dmaInit.DMA_DIR = DMA_DIR_PeripheralToMemory;
-    dmaInit.DMA_BufferSize = OV7670_IMAGE_BUFSIZE/ 4;
+    dmaInit.DMA_BufferSize = OV7670_DMA_BUFSIZE;
     dmaInit.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
     dmaInit.DMA_MemoryInc = DMA_MemoryInc_Enable;
     dmaInit.DMA_PeripheralDataSize = DMA_PeripheralDataSize_Word;
@@ -109,12 +115,43 @@ ov7670_status_t ov7670_dmaInit() {
     // Initialize
     DMA_Init(DMA2_Stream1, &dmaInit);
 
+    #ifdef __MON
+    // Interrupt per buffer and on errors for the monitor
+    DMA_ITConfig(DMA2_Stream1, DMA_IT_TC | DMA_IT_TE | DMA_IT_FE | DMA_IT_DME, ENABLE);
+
+    NVIC_InitTypeDef nvicInit;
+    nvicInit.NVIC_IRQChannel = DMA2_Stream1_IRQn;
+    nvicInit.NVIC_IRQChannelPreemptionPriority = 0;
+    nvicInit.NVIC_IRQChannelSubPriority = 0;
+    nvicInit.NVIC_IRQChannelCmd = ENABLE;
+    NVIC_Init(&nvicInit);
+    #endif
+
     // Enable
     DMA_Cmd(DMA2_Stream1, ENABLE);
 
     return OV7670_INFO_OK;
 }
 
+ov7670_status_t ov7670_dmaTarget(uint32_t addr) {
+    DMA_Cmd(DMA2_Stream1, DISABLE);
+
+    // Wait for the stream to finish its burst
+    uint64_t deadline = tick_Deadline(OV7670_DMA_TIMEOUT_US);
+    while (DMA_GetCmdStatus(DMA2_Stream1) != DISABLE) {
+        if (tick_Expired(deadline)) {
+            log_Log(OV7670, OV7670_ERR_DMA, "DMA stream did not stop.\0");
+            return OV7670_ERR_DMA;
+        }
+    }
+
+    DMA_MemoryTargetConfig(DMA2_Stream1, addr, DMA_Memory_0);
+    DMA_SetCurrDataCounter(DMA2_Stream1, OV7670_DMA_BUFSIZE);
+    DMA_Cmd(DMA2_Stream1, ENABLE);
+
+    return OV7670_INFO_OK;
+}
+
 ov7670_status_t ov7670_dcmiInit() {
     GPIO_InitTypeDef gpioInit;
 
@@ -227,7 +264,7 @@ ov7670_status_t ov7670_dcmiInit() {
     // DCMI_JPEGCmd(ENABLE);
 
     // Enable interrupt on frame complete in DCMI
-    DCMI_ITConfig(DCMI_IT_OVF, ENABLE);
+    DCMI_ITConfig(DCMI_IT_FRAME | DCMI_IT_OVF, ENABLE);
 
     // NVIC Enable interrupt on frame complete
     NVIC_InitTypeDef nvicInit;
@@ -292,11 +329,11 @@ ov7670_status_t ov7670_i2cStart(uint8_t address, uint8_t direction) {
         return OV7670_ERR_I2CSTART;
     }
     
-    uint32_t timeout = OV7670_I2C2_TIMEOUT;
+    uint64_t deadline = tick_Deadline(OV7670_I2C2_TIMEOUT_US);
 
     // Wait until I2C2 is not busy
     while (I2C_GetFlagStatus(I2C2, I2C_FLAG_BUSY)) {
-        if (timeout-- == 0) {
+        if (tick_Expired(deadline)) {
             log_Log(OV7670, OV7670_ERR_I2CTIMEOUT, "I2C timed out.\0");
             return OV7670_ERR_I2CTIMEOUT;
         }
@@ -306,9 +343,9 @@ ov7670_status_t ov7670_i2cStart(uint8_t address, uint8_t direction) {
     I2C_GenerateSTART(I2C2, ENABLE);
 
     // Wait for slave acknowledge
-    timeout = OV7670_I2C2_TIMEOUT;
+    deadline = tick_Deadline(OV7670_I2C2_TIMEOUT_US);
     while(!I2C_CheckEvent(I2C2, I2C_EVENT_MASTER_MODE_SELECT)) {
-        if (timeout-- == 0) {
+        if (tick_Expired(deadline)) {
             log_Log(OV7670, OV7670_ERR_I2CTIMEOUT, "I2C timed out.\0");
             return OV7670_ERR_I2CTIMEOUT;
         }
@@ -318,17 +355,17 @@ ov7670_status_t ov7670_i2cStart(uint8_t address, uint8_t direction) {
     I2C_Send7bitAddress(I2C2, address, direction);
 
     // Wait for acknowledgement
-    timeout = OV7670_I2C2_TIMEOUT;
+    deadline = tick_Deadline(OV7670_I2C2_TIMEOUT_US);
     if (direction == I2C_Direction_Transmitter) {
         while (!I2C_CheckEvent(I2C2, I2C_EVENT_MASTER_TRANSMITTER_MODE_SELECTED)) {
-            if (timeout-- == 0) {
+            if (tick_Expired(deadline)) {
                 log_Log(OV7670, OV7670_ERR_I2CTIMEOUT, "I2C timed out.\0");
                 return OV7670_ERR_I2CTIMEOUT;
             }   
         }
     } else if (direction == I2C_Direction_Receiver)  {
         while (!I2C_CheckEvent(I2C2, I2C_EVENT_MASTER_RECEIVER_MODE_SELECTED)) {
-            if (timeout-- == 0) {
+            if (tick_Expired(deadline)) {
                 log_Log(OV7670, OV7670_ERR_I2CTIMEOUT, "I2C timed out.\0");
                 return OV7670_ERR_I2CTIMEOUT;
             }   
@@ -350,8 +387,6 @@ ov7670_status_t ov7670_i2cRead(uint8_t *data, uint8_t ack) {
         return OV7670_ERR_I2CREAD;
     }
    
-    uint32_t timeout = OV7670_I2C2_TIMEOUT;            
-
     if (ack == OV7670_I2C2_ACK) { 
         I2C_AcknowledgeConfig(I2C2, ENABLE);
     } else {
@@ -359,9 +394,9 @@ ov7670_status_t ov7670_i2cRead(uint8_t *data, uint8_t ack) {
     }
     
     // Wait for a byte
-    timeout = OV7670_I2C2_TIMEOUT;
+    uint64_t deadline = tick_Deadline(OV7670_I2C2_TIMEOUT_US);
     while (!I2C_CheckEvent(I2C2, I2C_EVENT_MASTER_BYTE_RECEIVED)) {
-        if (timeout-- == 0) {
+        if (tick_Expired(deadline)) {
             log_Log(OV7670, OV7670_ERR_I2CTIMEOUT, "I2C timed out.\0");
             return OV7670_ERR_I2CTIMEOUT;
         }   
@@ -376,9 +411,9 @@ ov7670_status_t ov7670_i2cRead(uint8_t *data, uint8_t ack) {
 ov7670_status_t ov7670_i2cWrite(uint8_t data) {
     I2C_SendData(I2C2, data);
     // Wait for transmission
-    uint32_t timeout = OV7670_I2C2_TIMEOUT;
+    uint64_t deadline = tick_Deadline(OV7670_I2C2_TIMEOUT_US);
     while (!I2C_CheckEvent(I2C2, I2C_EVENT_MASTER_BYTE_TRANSMITTED)) {
-        if (timeout-- == 0) {
+        if (tick_Expired(deadline)) {
             log_Log(OV7670, OV7670_ERR_I2CTIMEOUT, "I2C timed out.\0");
             return OV7670_ERR_I2CTIMEOUT;
         }   
@@ -475,14 +510,14 @@ ov7670_status_t ov7670_regWriteArray(const ov7670_reg_t *reg) {
     // reg is terminated with [0xff, 0xff]
     ov7670_status_t ret;
     while (reg->reg != 0xff || reg->val != 0xff) {
-        ret = ov7670_regWrite(reg->reg, reg->val);
+        prof_Probe(ret = ov7670_regWrite(reg->reg, reg->val), PROF_PROBE_SCCB_WRITE);
         if (ret != OV7670_INFO_OK) {
             log_Log(OV7670, ret, "Couldn't write OV7670 register array.\0");
             return ret;
         }
 
         // Wait
-        for (uint32_t i = 0; i < 10000; i++) {}
+        tick_DelayUs(OV7670_REG_DELAY_US);
 
         // Increase register pointer
         reg++;
@@ -491,11 +526,54 @@ ov7670_status_t ov7670_regWriteArray(const ov7670_reg_t *reg) {
     return OV7670_INFO_OK;
 }
 
-void DCMI_IRQHandler() {
-    log_Log(OV7670, OV7670_INFO_OK, "OVF IRQ.\0");
-    return;
+MEM_RAMFUNC void DCMI_IRQHandler() {
+    trace_Begin(TRACE_CAT_IRQ, DCMI_IRQn);
+    mon_IrqEnter(MON_IRQ_DCMI);
+
+    if (DCMI_GetITStatus(DCMI_IT_FRAME) != RESET) {
+        DCMI_ClearITPendingBit(DCMI_IT_FRAME);
+        cam_FrameComplete();
+    }
+
+    if (DCMI_GetITStatus(DCMI_IT_OVF) != RESET) {
+        DCMI_ClearITPendingBit(DCMI_IT_OVF);
+        log_Log(OV7670, OV7670_INFO_OK, "OVF IRQ.\0");
+    }
+
+    mon_IrqExit(MON_IRQ_DCMI);
+    trace_End(TRACE_CAT_IRQ, DCMI_IRQn);
 }
 
+#ifdef __MON
+MEM_RAMFUNC void DMA2_Stream1_IRQHandler() {
+    trace_Begin(TRACE_CAT_IRQ, DMA2_Stream1_IRQn);
+    mon_IrqEnter(MON_IRQ_DMA2_STREAM1);
+
+    if (DMA_GetITStatus(DMA2_Stream1, DMA_IT_TCIF1) != RESET) {
+        DMA_ClearITPendingBit(DMA2_Stream1, DMA_IT_TCIF1);
+        mon_DmaComplete(MON_DMA_DCMI, OV7670_DMA_BUFSIZE*4);
+    }
+
+    if (DMA_GetITStatus(DMA2_Stream1, DMA_IT_TEIF1) != RESET) {
+        DMA_ClearITPendingBit(DMA2_Stream1, DMA_IT_TEIF1);
+        mon_DmaError(MON_DMA_DCMI, MON_DMAERR_TRANSFER);
+    }
+
+    if (DMA_GetITStatus(DMA2_Stream1, DMA_IT_FEIF1) != RESET) {
+        DMA_ClearITPendingBit(DMA2_Stream1, DMA_IT_FEIF1);
+        mon_DmaError(MON_DMA_DCMI, MON_DMAERR_FIFO);
+    }
+
+    if (DMA_GetITStatus(DMA2_Stream1, DMA_IT_DMEIF1) != RESET) {
+        DMA_ClearITPendingBit(DMA2_Stream1, DMA_IT_DMEIF1);
+        mon_DmaError(MON_DMA_DCMI, MON_DMAERR_DIRECT);
+    }
+
+    mon_IrqExit(MON_IRQ_DMA2_STREAM1);
+    trace_End(TRACE_CAT_IRQ, DMA2_Stream1_IRQn);
+}
+#endif
+
 /**************************************
  * Public functions
  */
@@ -538,14 +616,19 @@ ov7670_status_t ov7670_Configure() {
     return OV7670_INFO_OK;
 }
 
-ov7670_status_t ov7670_Capture() {
+ov7670_status_t ov7670_Capture(uint32_t addr) {
+    ov7670_status_t ret = ov7670_dmaTarget(addr);
+    if (ret != OV7670_INFO_OK) {
+        return ret;
+    }
+
     DCMI_CaptureCmd(ENABLE);
     return OV7670_INFO_OK;
 }
 
-ov7670_status_t ov7670_Transfer() {
+ov7670_status_t ov7670_Transfer(uint32_t addr) {
     log_Log(OV7670, OV7670_INFO_OK, "Beginning image transfer.\0");
-    log_Log(OV7670, OV7670_INFO_IMAGE, "\0", OV7670_IMAGE_BUFSIZE, (uint8_t *) SDRAM_IMAGEADDR);
+    log_Log(OV7670, OV7670_INFO_IMAGE, "\0", OV7670_IMAGE_BUFSIZE, (uint8_t *) addr);
     
     return OV7670_INFO_OK;
 }
@@ -16,17 +16,58 @@
 #ifdef __PROF
 #include "prof.h"
 #include "err.h"
+#include "mem.h"
 #include "log.h"
-#include "stm32f4xx_tim.h"
+#include "tick.h"
 #include "stm32f4xx.h"
+#include "stm32f4xx_rcc.h"
+#include "stm32f4xx_tim.h"
+#include "misc.h"
 #include <stdint.h>
 
-/* @brief Timer configuration parameters
+/* @brief Scope stack of region start times. The depth
+ * keeps counting past PROF_SCOPE_DEPTH so that starts
+ * and stops stay matched.
+ */
+static uint32_t prof_scopes[PROF_SCOPE_DEPTH];
+static uint8_t prof_depth = 0;
+
+/* @brief Sample ring buffer
+ */
+static prof_sample_t prof_samples[PROF_SAMPLE_CAP] MEM_CCM;
+static uint16_t prof_head = 0;
+static uint16_t prof_tail = 0;
+static uint16_t prof_size = 0;
+static uint32_t prof_dropped = 0;
+
+/* @brief Probe statistics
+ */
+static prof_stats_t prof_stats[PROF_PROBE_NUM] MEM_CCM;
+
+/* @brief Dump packet, filled from prof_stats with
+ * interrupts masked so each probe is consistent
  */
-// 1 uS resolution
-#define PROF_PRESCALE SystemCoreClock/1000000
-// 100 second max
-#define PROF_PERIOD 1000000*100
+static struct __attribute__ ((packed)) {
+    prof_dumpHeader_t header;
+    prof_stats_t stats[PROF_PROBE_NUM];
+} prof_dump;
+
+/* @brief PC histogram, sampled straight into the
+ * packet that prof_SampleDump() sends
+ */
+static struct __attribute__ ((packed)) {
+    prof_pcHeader_t header;
+    prof_pcBucket_t buckets[PROF_PC_BUCKETS];
+} prof_pc;
+
+/* @brief Cycles taken by an empty region
+ */
+static uint32_t prof_overhead = 0;
+
+/* @brief Cycles taken by an empty probe, which has no
+ * function calls between its counter reads
+ */
+static uint32_t prof_probeOverhead = 0;
 
 /* @brief flag to keep track of initialization
  */
@@ -38,76 +79,107 @@ static uint8_t prof_initialized = 0;
  */
 
 #ifdef __PROF
-prof_status_t prof_itoa(uint8_t *str, uint32_t data) {
-    uint8_t i = 0;
-    uint8_t temp = 0;
-    while (data > 0) {
-        // find lowest digit, add ASCII base
-        *(str+i) = data % 10 + '0';
-        data /= 10;
-        i++;
-    }
+prof_status_t prof_start() {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
 
-    *(str+i) = '\0';
-    // reverse string
-    while(i/2 > 0) {
-        temp = *str;
-        *str = *(str+i-1);
-        *(str++ + i-1) = temp;
-        i -= 2;
-    }
+    uint8_t depth = prof_depth++;
 
-    return PROF_INFO_OK;
-}
+    __set_PRIMASK(primask);
 
-prof_status_t prof_concat(uint8_t *buf, uint8_t *str1, uint8_t *str2) {
-    while(*str1 != '\0') {
-        *buf++ = *str1++;
-    }
-    while(*str2 != '\0') {
-        *buf++ = *str2++;
+    if (depth >= PROF_SCOPE_DEPTH) {
+        return PROF_ERR_DEPTH;
     }
-    *buf = '\0';
-    return PROF_INFO_OK;
-}
 
-prof_status_t prof_start() {
-    TIM2->CNT = 0;
+    prof_scopes[depth] = TICK_CYCLES();
+
     return PROF_INFO_OK;
 }
 
 prof_status_t prof_stop(char *msg) {
-    uint8_t mBuf[256];
-    uint8_t *msgBuf = (uint8_t *) mBuf;
-    uint8_t nBuf[6];
-    uint8_t *numBuf = (uint8_t *) nBuf;
-    uint32_t time = (uint32_t) TIM2->CNT;
-
-    // Decide units to display
-    if (time > 1000000000) {
-        time /= 1000000;
-        prof_itoa(numBuf, time);
-        prof_concat(msgBuf, (uint8_t *) msg, (uint8_t *) "\t\0");
-        prof_concat(msgBuf, msgBuf, numBuf);
-        prof_concat(msgBuf, msgBuf, (uint8_t *) " s");
-    } else if (time > 1000000) {
-        time /= 1000;
-        prof_itoa(numBuf, time);
-        prof_concat(msgBuf, (uint8_t *) msg, (uint8_t *) "\t\0");
-        prof_concat(msgBuf, msgBuf, numBuf);
-        prof_concat(msgBuf, msgBuf, (uint8_t *) " ms\0");
+    uint32_t end = TICK_CYCLES();
+    prof_status_t st = PROF_INFO_OK;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if (prof_depth == 0) {
+        st = PROF_ERR_UNDERFLOW;
+    } else if (--prof_depth >= PROF_SCOPE_DEPTH) {
+        st = PROF_ERR_DEPTH;
+    } else if (prof_size == PROF_SAMPLE_CAP) {
+        prof_dropped++;
+        st = PROF_WARN_DROPPED;
     } else {
-        prof_itoa(numBuf, time);
-        prof_concat(msgBuf, (uint8_t *) msg, (uint8_t *) "\t\0");
-        prof_concat(msgBuf, msgBuf, numBuf);
-        prof_concat(msgBuf, msgBuf, (uint8_t *) " us\0");
+        // Wraps correctly for regions under 2^32 cycles
+        uint32_t cycles = end - prof_scopes[prof_depth];
+        cycles = cycles > prof_overhead ? cycles - prof_overhead : 0;
+
+        prof_sample_t *sample = &prof_samples[prof_head];
+        sample->prof_sample_msg = msg;
+        sample->prof_sample_cycles = cycles;
+        sample->prof_sample_depth = prof_depth;
+
+        // Increment head and check for wrap
+        prof_head++;
+        if (prof_head >= PROF_SAMPLE_CAP) {
+            prof_head = 0;
+        }
+        prof_size++;
     }
 
-    log_Log(PROF, PROF_INFO_RESULTS, (char *) msgBuf);
+    __set_PRIMASK(primask);
 
-    return PROF_INFO_OK;
+    return st;
 }
 
+void prof_pcSample(uint32_t *frame) {
+    TIM7->SR = (uint16_t) ~TIM_IT_Update;
+
+    uint32_t pc = frame[6];
+    prof_pc.header.prof_pcHeader_total++;
+
+    // Fibonacci hash, then linear probing
+    uint32_t index = ((pc >> 1) * 2654435761u) >> (32 - PROF_PC_BUCKETBITS);
+    for (uint8_t i = 0; i < PROF_PC_PROBES; i++) {
+        prof_pcBucket_t *bucket = &prof_pc.buckets[index];
+        if (bucket->prof_pcBucket_count == 0) {
+            bucket->prof_pcBucket_pc = pc;
+        }
+        if (bucket->prof_pcBucket_pc == pc) {
+            bucket->prof_pcBucket_count++;
+            return;
+        }
+        index = (index + 1) & (PROF_PC_BUCKETS - 1);
+    }
+
+    prof_pc.header.prof_pcHeader_dropped++;
+}
+
+// No exception frame to sample on the host
+#ifndef __HOST
+void __attribute__ ((naked)) TIM7_IRQHandler(void) {
+    // EXC_RETURN bit 2 tells which stack holds the frame
+    __asm volatile (
+        "tst lr, #4          \n"
+        "ite eq              \n"
+        "mrseq r0, msp       \n"
+        "mrsne r0, psp       \n"
+        "b prof_pcSample     \n"
+    );
+}
+#endif
+
+void prof_statsReset(prof_stats_t *stats) {
+    stats->prof_stats_count = 0;
+    stats->prof_stats_min = 0xFFFFFFFF;
+    stats->prof_stats_max = 0;
+    stats->prof_stats_sum = 0;
+    stats->prof_stats_sumsq = 0;
+    for (uint8_t b = 0; b < PROF_HIST_BINS; b++) {
+        stats->prof_stats_hist[b] = 0;
+    }
+}
 #endif
 
 /**************************************
@@ -120,21 +192,224 @@ prof_status_t prof_Init() {
         return PROF_WARN_ALINIT;
     }
 
-    TIM_TimeBaseInitTypeDef timeInit;
+    prof_Reset();
+
+    tick_CycleInit();
+
+    // Time empty regions and keep the fastest
+    prof_sample_t sample;
+    prof_overhead = 0;
+    uint32_t overhead = 0xFFFFFFFF;
+    for (uint8_t i = 0; i < PROF_CALIBRATE_RUNS; i++) {
+        prof_start();
+        prof_stop("\0");
+        if (prof_SampleGet(&sample) == PROF_INFO_OK &&
+            sample.prof_sample_cycles < overhead) {
+            overhead = sample.prof_sample_cycles;
+        }
+    }
+    prof_overhead = overhead;
+
+    // Same for the two counter reads of an empty prof_Probe()
+    overhead = 0xFFFFFFFF;
+    for (uint8_t i = 0; i < PROF_CALIBRATE_RUNS; i++) {
+        uint32_t start = TICK_CYCLES();
+        uint32_t cycles = TICK_CYCLES() - start;
+        if (cycles < overhead) {
+            overhead = cycles;
+        }
+    }
+    prof_probeOverhead = overhead;
+
+    // Initialization flag
+    prof_initialized = 1;
+
+    return PROF_INFO_OK;
+}
+
+prof_status_t prof_SampleGet(prof_sample_t *sample) {
+    prof_status_t st = PROF_INFO_OK;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if (prof_size == 0) {
+        st = PROF_INFO_EMPTY;
+    } else {
+        *sample = prof_samples[prof_tail];
+
+        // Increment tail and check for wrap
+        prof_tail++;
+        if (prof_tail >= PROF_SAMPLE_CAP) {
+            prof_tail = 0;
+        }
+        prof_size--;
+    }
+
+    __set_PRIMASK(primask);
+
+    return st;
+}
 
-    RCC_APB1PeriphClockCmd(RCC_APB1Periph_TIM2, ENABLE);
+prof_status_t prof_Flush() {
+    prof_sample_t sample;
+    prof_result_t result;
 
-    timeInit.TIM_Prescaler = PROF_PRESCALE;
+    while (prof_SampleGet(&sample) == PROF_INFO_OK) {
+        result.prof_result_cycles = sample.prof_sample_cycles;
+        result.prof_result_depth = sample.prof_sample_depth;
+        log_Log(PROF, PROF_INFO_RESULTS, (char *) sample.prof_sample_msg,
+                sizeof(result), (uint8_t *) &result);
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint32_t dropped = prof_dropped;
+    prof_dropped = 0;
+    __set_PRIMASK(primask);
+
+    if (dropped != 0) {
+        log_Log(PROF, PROF_WARN_DROPPED, "Profiler samples dropped.\0",
+                sizeof(dropped), (uint8_t *) &dropped);
+    }
+
+    return PROF_INFO_OK;
+}
+
+prof_status_t prof_Record(prof_probe_t probe, uint32_t cycles) {
+    if (probe >= PROF_PROBE_NUM) {
+        return PROF_ERR_PROBE;
+    }
+
+    cycles = cycles > prof_probeOverhead ? cycles - prof_probeOverhead : 0;
+
+    // Square before masking interrupts, it's the slow part
+    uint64_t square = (uint64_t) cycles * cycles;
+    uint8_t bin = cycles == 0 ? 0 : 31 - __CLZ(cycles);
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    prof_stats_t *stats = &prof_stats[probe];
+    stats->prof_stats_count++;
+    if (cycles < stats->prof_stats_min) {
+        stats->prof_stats_min = cycles;
+    }
+    if (cycles > stats->prof_stats_max) {
+        stats->prof_stats_max = cycles;
+    }
+    stats->prof_stats_sum += cycles;
+    // Saturate, the host reports no deviation then
+    if (stats->prof_stats_sumsq + square < stats->prof_stats_sumsq) {
+        stats->prof_stats_sumsq = 0xFFFFFFFFFFFFFFFF;
+    } else {
+        stats->prof_stats_sumsq += square;
+    }
+    stats->prof_stats_hist[bin]++;
+
+    __set_PRIMASK(primask);
+
+    return PROF_INFO_OK;
+}
+
+prof_status_t prof_StatsGet(prof_probe_t probe, prof_stats_t *stats) {
+    if (probe >= PROF_PROBE_NUM) {
+        return PROF_ERR_PROBE;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    *stats = prof_stats[probe];
+    __set_PRIMASK(primask);
+
+    return PROF_INFO_OK;
+}
+
+prof_status_t prof_Dump() {
+    prof_dump.header.prof_dumpHeader_coreHz = SystemCoreClock;
+    prof_dump.header.prof_dumpHeader_overhead = prof_probeOverhead;
+    prof_dump.header.prof_dumpHeader_probes = PROF_PROBE_NUM;
+    prof_dump.header.prof_dumpHeader_bins = PROF_HIST_BINS;
+
+    for (uint8_t p = 0; p < PROF_PROBE_NUM; p++) {
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+        prof_dump.stats[p] = prof_stats[p];
+        __set_PRIMASK(primask);
+    }
+
+    log_Log(PROF, PROF_INFO_STATS, "\0", sizeof(prof_dump), (uint8_t *) &prof_dump);
+
+    return PROF_INFO_OK;
+}
+
+prof_status_t prof_Reset() {
+    for (uint8_t p = 0; p < PROF_PROBE_NUM; p++) {
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+        prof_statsReset(&prof_stats[p]);
+        __set_PRIMASK(primask);
+    }
+
+    return PROF_INFO_OK;
+}
+
+prof_status_t prof_SampleStart() {
+    uint32_t timClk = tick_TimerClock();
+
+    prof_SampleStop();
+
+    prof_pc.header.prof_pcHeader_hz = PROF_PC_HZ;
+    prof_pc.header.prof_pcHeader_total = 0;
+    prof_pc.header.prof_pcHeader_dropped = 0;
+    prof_pc.header.prof_pcHeader_buckets = PROF_PC_BUCKETS;
+    for (uint16_t b = 0; b < PROF_PC_BUCKETS; b++) {
+        prof_pc.buckets[b].prof_pcBucket_pc = 0;
+        prof_pc.buckets[b].prof_pcBucket_count = 0;
+    }
+
+    RCC_APB1PeriphClockCmd(RCC_APB1Periph_TIM7, ENABLE);
+
+    TIM_TimeBaseInitTypeDef timeInit;
+    timeInit.TIM_Prescaler = timClk/1000000 - 1;
     timeInit.TIM_CounterMode = TIM_CounterMode_Up;
-    timeInit.TIM_Period = PROF_PERIOD;
+    timeInit.TIM_Period = 1000000/PROF_PC_HZ - 1;
     timeInit.TIM_ClockDivision = TIM_CKD_DIV1;
     timeInit.TIM_RepetitionCounter = 0;
-    TIM_TimeBaseInit(TIM2, &timeInit);
+    TIM_TimeBaseInit(TIM7, &timeInit);
 
-    TIM_Cmd(TIM2, ENABLE);
+    TIM_ClearFlag(TIM7, TIM_FLAG_Update);
+    TIM_ITConfig(TIM7, TIM_IT_Update, ENABLE);
 
-    // Initialization flag
-    prof_initialized = 1;
+    NVIC_InitTypeDef nvicInit;
+    nvicInit.NVIC_IRQChannel = TIM7_IRQn;
+    nvicInit.NVIC_IRQChannelPreemptionPriority = PROF_PC_NVIC_PRIO;
+    nvicInit.NVIC_IRQChannelSubPriority = 0;
+    nvicInit.NVIC_IRQChannelCmd = ENABLE;
+    NVIC_Init(&nvicInit);
+
+    TIM_Cmd(TIM7, ENABLE);
+
+    return PROF_INFO_OK;
+}
+
+prof_status_t prof_SampleStop() {
+    TIM_Cmd(TIM7, DISABLE);
+    NVIC_DisableIRQ(TIM7_IRQn);
+
+    return PROF_INFO_OK;
+}
+
+prof_status_t prof_SampleDump() {
+    uint8_t running = (TIM7->CR1 & TIM_CR1_CEN) != 0;
+    prof_SampleStop();
+
+    log_Log(PROF, PROF_INFO_PCSAMPLES, "\0", sizeof(prof_pc), (uint8_t *) &prof_pc);
+
+    if (running) {
+        TIM_Cmd(TIM7, ENABLE);
+        NVIC_EnableIRQ(TIM7_IRQn);
+    }
 
     return PROF_INFO_OK;
 }
@@ -143,6 +418,4 @@ prof_status_t prof_Init() {
  * This will be the main profiler function called by
  * the user.
  */
-// #define prof_Prof()... 
 #endif
-
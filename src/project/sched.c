@@ -0,0 +1,184 @@
+/** @file sched.c
+ *  @brief Implemenation of the task scheduler.
+ *
+ *  This contains the implementations of the
+ *  scheduler functions.
+ *
+ *  @author Ben Heberlein
+ *  @bug No known bugs.
+ */
+
+/*************************************
+ * Includes and definitions
+ */
+
+#include "sched.h"
+#include "err.h"
+#include "mem.h"
+#include "log.h"
+#include "stm32f4xx.h"
+#ifdef __KERN
+#include "kern.h"
+#endif
+#include <stdint.h>
+#include <stddef.h>
+
+/* @brief Ready queues, one per priority
+ */
+static sched_queue_t sched_queues[SCHED_PRIO_NUM] MEM_CCM;
+
+#ifdef __KERN
+/* @brief Wakes the scheduler task when a task is posted
+ */
+static kern_sem_t sched_wakeup;
+#endif
+
+/* @brief Initialization flag
+ */
+static uint8_t sched_initialized = 0;
+
+/**************************************
+ * Private functions
+ */
+
+sched_status_t sched_queuePut(sched_queue_t *queue, sched_handler_t handler, void *arg) {
+    if (queue->sched_queue_size == SCHED_QUEUE_CAP) {
+        return SCHED_ERR_QUEUEFULL;
+    }
+
+    queue->sched_queue_buf[queue->sched_queue_head].sched_task_handler = handler;
+    queue->sched_queue_buf[queue->sched_queue_head].sched_task_arg = arg;
+
+    // Increment head and check for wrap
+    queue->sched_queue_head++;
+    if (queue->sched_queue_head >= SCHED_QUEUE_CAP) {
+        queue->sched_queue_head = 0;
+    }
+    queue->sched_queue_size++;
+
+    return SCHED_INFO_OK;
+}
+
+sched_status_t sched_queueGet(sched_task_t *task) {
+    for (uint8_t p = 0; p < SCHED_PRIO_NUM; p++) {
+        sched_queue_t *queue = &sched_queues[p];
+        if (queue->sched_queue_size == 0) {
+            continue;
+        }
+
+        *task = queue->sched_queue_buf[queue->sched_queue_tail];
+
+        // Increment tail and check for wrap
+        queue->sched_queue_tail++;
+        if (queue->sched_queue_tail >= SCHED_QUEUE_CAP) {
+            queue->sched_queue_tail = 0;
+        }
+        queue->sched_queue_size--;
+
+        return SCHED_INFO_OK;
+    }
+
+    return SCHED_INFO_IDLE;
+}
+
+void sched_idle() {
+    #ifdef __KERN
+    // Under the kernel we block instead so other tasks run
+    if (kern_Running()) {
+        kern_SemTake(&sched_wakeup, KERN_WAIT_FOREVER);
+        return;
+    }
+    #endif
+
+    __disable_irq();
+
+    uint16_t pending = 0;
+    for (uint8_t p = 0; p < SCHED_PRIO_NUM; p++) {
+        pending += sched_queues[p].sched_queue_size;
+    }
+
+    // A pending interrupt wakes the core even while masked
+    if (pending == 0) {
+        __WFI();
+    }
+
+    __enable_irq();
+}
+
+/**************************************
+ * Public functions
+ */
+
+sched_status_t sched_Init() {
+    if (sched_initialized == 1) {
+        return SCHED_WARN_ALINIT;
+    }
+
+    __disable_irq();
+    for (uint8_t p = 0; p < SCHED_PRIO_NUM; p++) {
+        sched_queues[p].sched_queue_head = 0;
+        sched_queues[p].sched_queue_tail = 0;
+        sched_queues[p].sched_queue_size = 0;
+    }
+    #ifdef __KERN
+    kern_SemInit(&sched_wakeup, 0, 1);
+    #endif
+    __enable_irq();
+
+    sched_initialized = 1;
+
+    return SCHED_INFO_OK;
+}
+
+sched_status_t sched_Post(sched_prio_t prio, sched_handler_t handler, void *arg) {
+    if (handler == NULL) {
+        return SCHED_ERR_NULLPTR;
+    }
+    if (prio >= SCHED_PRIO_NUM) {
+        return SCHED_ERR_PRIO;
+    }
+
+    // Keep the caller's interrupt state, we may be in an ISR
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    sched_status_t st = sched_queuePut(&sched_queues[prio], handler, arg);
+    #ifdef __KERN
+    if (st == SCHED_INFO_OK) {
+        kern_SemGive(&sched_wakeup);
+    }
+    #endif
+    __set_PRIMASK(primask);
+
+    return st;
+}
+
+sched_status_t sched_Run() {
+    sched_task_t task;
+    sched_status_t st;
+
+    while (1) {
+        __disable_irq();
+        st = sched_queueGet(&task);
+        __enable_irq();
+
+        if (st == SCHED_INFO_IDLE) {
+            return SCHED_INFO_OK;
+        }
+
+        // Run to completion
+        task.sched_task_handler(task.sched_task_arg);
+    }
+}
+
+sched_status_t sched_Loop() {
+    sched_status_t st;
+    while (1) {
+        st = sched_Run();
+        if (st != SCHED_INFO_OK) {
+            log_Log(SCHED, st, "Scheduler stopped.\0");
+            return st;
+        }
+
+        sched_idle();
+    }
+}
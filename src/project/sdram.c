@@ -4,6 +4,10 @@
  *  This file implements the SDRAM functions
  *  depending on the flag __STM32F429I_DISCOVERY
  *
+ *  Background copies go through a queue on DMA2 stream
+ *  0. Long copies take several stream runs, one per
+ *  65535 items.
+ *
  *  @author Ben Heberlein
  *  @bug No known bugs.
  */
@@ -13,7 +17,17 @@
  */
 
 #include "sdram.h"
+#include "tick.h"
+#include "trace.h"
+#include "mon.h"
+#include "mem.h"
+#include "stm32f4xx.h"
+#include "stm32f4xx_rcc.h"
+#include "stm32f4xx_dma.h"
+#include "misc.h"
 #include <stdint.h>
+#include <stddef.h>
+#include <string.h>
 #include "err.h"
 
 #ifdef __STM32F429I_DISCOVERY
@@ -25,6 +39,188 @@
  */
 static uint8_t sdram_initialized = 0;
 
+/* @brief Slot classes, smallest first
+ */
+static const uint32_t sdram_classSize[SDRAM_CLASS_NUM] = {
+    SDRAM_SMALL_SIZE, SDRAM_MEDIUM_SIZE, SDRAM_LARGE_SIZE
+};
+static const uint8_t sdram_classNum[SDRAM_CLASS_NUM] = {
+    SDRAM_SMALL_NUM, SDRAM_MEDIUM_NUM, SDRAM_LARGE_NUM
+};
+
+/* @brief Frame slots, grouped by class
+ */
+static sdram_frame_t sdram_frames[SDRAM_FRAME_NUM];
+static uint8_t sdram_poolReady = 0;
+
+/* @brief Next free byte in each arena
+ */
+static uint32_t sdram_arenaUsed[SDRAM_ARENA_NUM];
+
+/* @brief MEM_SDRAM section, from the linker script
+ */
+extern uint32_t _ssdram_bss;
+extern uint32_t _esdram_bss;
+
+/* @brief Copy queue, the head is on the stream
+ */
+static sdram_copy_t sdram_copyQueue[SDRAM_COPY_QUEUE];
+static uint8_t sdram_copyHead = 0;
+static volatile uint8_t sdram_copyCount = 0;
+
+/* @brief Bytes of the head copy done, and in the current
+ * stream run
+ */
+static uint32_t sdram_copyDone = 0;
+static uint32_t sdram_copyRun = 0;
+
+/**************************************
+ * Private functions
+ */
+
+void sdram_poolInit() {
+    uint32_t addr = SDRAM_POOLADDR;
+    uint8_t f = 0;
+
+    for (uint8_t c = 0; c < SDRAM_CLASS_NUM; c++) {
+        for (uint8_t i = 0; i < sdram_classNum[c]; i++) {
+            sdram_frames[f].sdram_frame_addr = addr;
+            sdram_frames[f].sdram_frame_size = sdram_classSize[c];
+            sdram_frames[f].sdram_frame_len = 0;
+            sdram_frames[f].sdram_frame_class = c;
+            sdram_frames[f].sdram_frame_refs = 0;
+            addr += sdram_classSize[c];
+            f++;
+        }
+    }
+
+    for (uint8_t a = 0; a < SDRAM_ARENA_NUM; a++) {
+        sdram_arenaUsed[a] = 0;
+    }
+
+    sdram_poolReady = 1;
+}
+
+sdram_status_t sdram_copyInit() {
+    RCC_AHB1PeriphClockCmd(RCC_AHB1Periph_DMA2, ENABLE);
+
+    DMA_Cmd(DMA2_Stream0, DISABLE);
+    DMA_DeInit(DMA2_Stream0);
+
+    NVIC_InitTypeDef nvicInit;
+    nvicInit.NVIC_IRQChannel = DMA2_Stream0_IRQn;
+    nvicInit.NVIC_IRQChannelPreemptionPriority = SDRAM_COPY_NVIC_PRIO;
+    nvicInit.NVIC_IRQChannelSubPriority = 0;
+    nvicInit.NVIC_IRQChannelCmd = ENABLE;
+    NVIC_Init(&nvicInit);
+
+    return SDRAM_INFO_OK;
+}
+
+void sdram_copyStart() {
+    sdram_copy_t *copy = &sdram_copyQueue[sdram_copyHead];
+    uint32_t src = copy->sdram_copy_src + sdram_copyDone;
+    uint32_t dst = copy->sdram_copy_dst + sdram_copyDone;
+    uint32_t left = copy->sdram_copy_size - sdram_copyDone;
+
+    // Words if everything lines up, four word bursts on
+    // top when 16 byte aligned, so none crosses 1 KB
+    uint8_t shift = ((src | dst | left) & 3) == 0 ? 2 : 0;
+    uint8_t burst = shift == 2 && ((src | dst) & 15) == 0 && left >= 16;
+    uint32_t items = left >> shift;
+    if (items > SDRAM_COPY_MAXITEMS) {
+        items = SDRAM_COPY_MAXITEMS;
+    }
+    if (burst) {
+        items &= ~3;
+    }
+    sdram_copyRun = items << shift;
+
+    DMA_InitTypeDef dmaInit;
+    DMA_StructInit(&dmaInit);
+    dmaInit.DMA_Channel = DMA_Channel_0;
+    dmaInit.DMA_PeripheralBaseAddr = src;
+    dmaInit.DMA_Memory0BaseAddr = dst;
+    dmaInit.DMA_DIR = DMA_DIR_MemoryToMemory;
+    dmaInit.DMA_BufferSize = items;
+    dmaInit.DMA_PeripheralInc = DMA_PeripheralInc_Enable;
+    dmaInit.DMA_MemoryInc = DMA_MemoryInc_Enable;
+    dmaInit.DMA_PeripheralDataSize = shift ? DMA_PeripheralDataSize_Word : DMA_PeripheralDataSize_Byte;
+    dmaInit.DMA_MemoryDataSize = shift ? DMA_MemoryDataSize_Word : DMA_MemoryDataSize_Byte;
+    dmaInit.DMA_Mode = DMA_Mode_Normal;
+    // Below the DCMI, a frame can't wait
+    dmaInit.DMA_Priority = DMA_Priority_Low;
+    dmaInit.DMA_FIFOMode = DMA_FIFOMode_Enable;
+    dmaInit.DMA_FIFOThreshold = DMA_FIFOThreshold_Full;
+    dmaInit.DMA_PeripheralBurst = burst ? DMA_PeripheralBurst_INC4 : DMA_PeripheralBurst_Single;
+    dmaInit.DMA_MemoryBurst = burst ? DMA_MemoryBurst_INC4 : DMA_MemoryBurst_Single;
+
+    DMA_Init(DMA2_Stream0, &dmaInit);
+    DMA_ClearFlag(DMA2_Stream0, DMA_FLAG_TCIF0 | DMA_FLAG_HTIF0 | DMA_FLAG_TEIF0 |
+                                DMA_FLAG_FEIF0 | DMA_FLAG_DMEIF0);
+    DMA_ITConfig(DMA2_Stream0, DMA_IT_TC | DMA_IT_TE, ENABLE);
+    DMA_Cmd(DMA2_Stream0, ENABLE);
+}
+
+void sdram_copyFinish(sdram_status_t status) {
+    sdram_copy_t copy = sdram_copyQueue[sdram_copyHead];
+    sdram_copyHead = (sdram_copyHead + 1) % SDRAM_COPY_QUEUE;
+    sdram_copyCount--;
+    sdram_copyDone = 0;
+
+    // Next copy first, the callback may queue more
+    if (sdram_copyCount > 0) {
+        sdram_copyStart();
+    }
+
+    if (copy.sdram_copy_callback != NULL) {
+        copy.sdram_copy_callback(status, copy.sdram_copy_arg);
+    }
+}
+
+MEM_RAMFUNC void DMA2_Stream0_IRQHandler() {
+    trace_Begin(TRACE_CAT_IRQ, DMA2_Stream0_IRQn);
+    mon_IrqEnter(MON_IRQ_DMA2_STREAM0);
+
+    if (DMA_GetITStatus(DMA2_Stream0, DMA_IT_TEIF0) != RESET) {
+        DMA_ClearITPendingBit(DMA2_Stream0, DMA_IT_TEIF0);
+        #ifdef __MON
+        mon_DmaError(MON_DMA_COPY, MON_DMAERR_TRANSFER);
+        #endif
+
+        // The stream stopped itself, drop the rest
+        sdram_copyFinish(SDRAM_ERR_DMA);
+    } else if (DMA_GetITStatus(DMA2_Stream0, DMA_IT_TCIF0) != RESET) {
+        DMA_ClearITPendingBit(DMA2_Stream0, DMA_IT_TCIF0);
+        #ifdef __MON
+        mon_DmaComplete(MON_DMA_COPY, sdram_copyRun);
+        #endif
+
+        sdram_copyDone += sdram_copyRun;
+        if (sdram_copyDone < sdram_copyQueue[sdram_copyHead].sdram_copy_size) {
+            sdram_copyStart();
+        } else {
+            sdram_copyFinish(SDRAM_INFO_OK);
+        }
+    }
+
+    mon_IrqExit(MON_IRQ_DMA2_STREAM0);
+    trace_End(TRACE_CAT_IRQ, DMA2_Stream0_IRQn);
+}
+
+uint8_t sdram_inCcm(uint32_t addr, uint32_t size) {
+    return addr + size > SDRAM_CCMADDR && addr < SDRAM_CCMADDR + SDRAM_CCMSIZE;
+}
+
+/* Smallest class holding size, SDRAM_CLASS_NUM if none */
+uint8_t sdram_classFor(uint32_t size) {
+    uint8_t c = 0;
+    while (c < SDRAM_CLASS_NUM && sdram_classSize[c] < size) {
+        c++;
+    }
+    return c;
+}
+
 /**************************************
  * Public functions
  */
@@ -37,6 +233,11 @@ sdram_status_t sdram_Init() {
     #ifdef __STM32F429I_DISCOVERY
     // Call discovery board function
     SDRAM_Init();
+
+    // The startup code can't zero this, the SDRAM was off
+    memset(&_ssdram_bss, 0, (uint32_t) &_esdram_bss - (uint32_t) &_ssdram_bss);
+
+    sdram_copyInit();
     sdram_initialized = 1;
     return SDRAM_INFO_OK;
     #endif
@@ -45,9 +246,19 @@ sdram_status_t sdram_Init() {
 }
 
 sdram_status_t sdram_write(uint32_t *buf, uint32_t addr, uint32_t size) {
+    if (buf == NULL) {
+        return SDRAM_ERR_NULLPTR;
+    }
+    if ((size & 3) != 0) {
+        return SDRAM_ERR_SIZE;
+    }
+    if (addr < SDRAM_BANKADDR || size > SDRAM_BANKADDR + SDRAM_BANKSIZE - addr) {
+        return SDRAM_ERR_RANGE;
+    }
 
     #ifdef __STM32F429I_DISCOVERY
-    SDRAM_WriteBuffer(buf, addr, size);
+    // The driver takes an offset into the bank and words
+    SDRAM_WriteBuffer(buf, addr - SDRAM_BANKADDR, size/4);
     return SDRAM_INFO_OK;
     #endif
 
@@ -56,11 +267,209 @@ sdram_status_t sdram_write(uint32_t *buf, uint32_t addr, uint32_t size) {
 }
 
 sdram_status_t sdram_read(uint32_t *buf, uint32_t addr, uint32_t size) {
+    if (buf == NULL) {
+        return SDRAM_ERR_NULLPTR;
+    }
+    if ((size & 3) != 0) {
+        return SDRAM_ERR_SIZE;
+    }
+    if (addr < SDRAM_BANKADDR || size > SDRAM_BANKADDR + SDRAM_BANKSIZE - addr) {
+        return SDRAM_ERR_RANGE;
+    }
 
     #ifdef __STM32F429I_DISCOVERY
-    SDRAM_ReadBuffer(buf, addr, size);
+    SDRAM_ReadBuffer(buf, addr - SDRAM_BANKADDR, size/4);
     return SDRAM_INFO_OK;
     #endif
     
     return SDRAM_ERR_UNKNOWN;
 }
+
+sdram_status_t sdram_CopyAsync(void *dst, const void *src, uint32_t size,
+                               sdram_callback_t callback, void *arg) {
+    if (dst == NULL || src == NULL) {
+        return SDRAM_ERR_NULLPTR;
+    }
+    if (size == 0) {
+        return SDRAM_ERR_SIZE;
+    }
+
+    // Only the CPU reaches core coupled RAM
+    if (sdram_inCcm((uint32_t) dst, size) || sdram_inCcm((uint32_t) src, size)) {
+        memcpy(dst, src, size);
+        if (callback != NULL) {
+            callback(SDRAM_INFO_OK, arg);
+        }
+        return SDRAM_INFO_OK;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if (sdram_copyCount == SDRAM_COPY_QUEUE) {
+        __set_PRIMASK(primask);
+        return SDRAM_ERR_BUSY;
+    }
+
+    sdram_copy_t *copy = &sdram_copyQueue[(sdram_copyHead + sdram_copyCount) % SDRAM_COPY_QUEUE];
+    copy->sdram_copy_dst = (uint32_t) dst;
+    copy->sdram_copy_src = (uint32_t) src;
+    copy->sdram_copy_size = size;
+    copy->sdram_copy_callback = callback;
+    copy->sdram_copy_arg = arg;
+    sdram_copyCount++;
+
+    // An idle stream starts now, otherwise the interrupt
+    // gets to it
+    if (sdram_copyCount == 1) {
+        sdram_copyStart();
+    }
+
+    __set_PRIMASK(primask);
+
+    return SDRAM_INFO_OK;
+}
+
+uint8_t sdram_CopyBusy() {
+    return sdram_copyCount;
+}
+
+sdram_status_t sdram_CopyWait() {
+    uint64_t deadline = tick_Deadline(SDRAM_COPY_TIMEOUT_US);
+    while (sdram_copyCount > 0) {
+        if (tick_Expired(deadline)) {
+            return SDRAM_ERR_TIMEOUT;
+        }
+    }
+
+    return SDRAM_INFO_OK;
+}
+
+sdram_frame_t *sdram_FrameAlloc(uint32_t size) {
+    uint8_t c = sdram_classFor(size);
+    if (size == 0 || c == SDRAM_CLASS_NUM) {
+        return NULL;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if (sdram_poolReady != 1) {
+        sdram_poolInit();
+    }
+
+    sdram_frame_t *frame = NULL;
+    for (uint8_t f = 0; f < SDRAM_FRAME_NUM && frame == NULL; f++) {
+        if (sdram_frames[f].sdram_frame_class == c && sdram_frames[f].sdram_frame_refs == 0) {
+            frame = &sdram_frames[f];
+            frame->sdram_frame_refs = 1;
+            frame->sdram_frame_len = 0;
+        }
+    }
+
+    __set_PRIMASK(primask);
+
+    return frame;
+}
+
+sdram_status_t sdram_FrameRetain(sdram_frame_t *frame) {
+    if (frame == NULL) {
+        return SDRAM_ERR_NULLPTR;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    // A free slot may already belong to someone else
+    if (frame->sdram_frame_refs == 0) {
+        __set_PRIMASK(primask);
+        return SDRAM_ERR_FREED;
+    }
+    frame->sdram_frame_refs++;
+
+    __set_PRIMASK(primask);
+
+    return SDRAM_INFO_OK;
+}
+
+sdram_status_t sdram_FrameRelease(sdram_frame_t *frame) {
+    if (frame == NULL) {
+        return SDRAM_ERR_NULLPTR;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if (frame->sdram_frame_refs == 0) {
+        __set_PRIMASK(primask);
+        return SDRAM_ERR_FREED;
+    }
+    frame->sdram_frame_refs--;
+
+    __set_PRIMASK(primask);
+
+    return SDRAM_INFO_OK;
+}
+
+uint8_t sdram_FrameAvailable(uint32_t size) {
+    uint8_t c = sdram_classFor(size);
+    if (c == SDRAM_CLASS_NUM) {
+        return 0;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if (sdram_poolReady != 1) {
+        sdram_poolInit();
+    }
+
+    uint8_t n = 0;
+    for (uint8_t f = 0; f < SDRAM_FRAME_NUM; f++) {
+        if (sdram_frames[f].sdram_frame_class == c && sdram_frames[f].sdram_frame_refs == 0) {
+            n++;
+        }
+    }
+
+    __set_PRIMASK(primask);
+
+    return n;
+}
+
+void *sdram_ArenaAlloc(uint8_t arena, uint32_t size) {
+    if (arena >= SDRAM_ARENA_NUM) {
+        return NULL;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if (sdram_poolReady != 1) {
+        sdram_poolInit();
+    }
+
+    // Round up so the next block stays aligned
+    uint32_t need = (size + SDRAM_ALIGN - 1) & ~(SDRAM_ALIGN - 1);
+    void *ptr = NULL;
+    if (need <= SDRAM_ARENA_SIZE - sdram_arenaUsed[arena]) {
+        ptr = (void *) (SDRAM_ARENAADDR + arena*SDRAM_ARENA_SIZE + sdram_arenaUsed[arena]);
+        sdram_arenaUsed[arena] += need;
+    }
+
+    __set_PRIMASK(primask);
+
+    return ptr;
+}
+
+sdram_status_t sdram_ArenaReset(uint8_t arena) {
+    if (arena >= SDRAM_ARENA_NUM) {
+        return SDRAM_ERR_ARENA;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    sdram_arenaUsed[arena] = 0;
+    __set_PRIMASK(primask);
+
+    return SDRAM_INFO_OK;
+}
@@ -0,0 +1,160 @@
+/** @file tick.c
+ *  @brief Implemenation of the system time base.
+ *
+ *  This contains the implementations of the time base
+ *  and deadline functions.
+ *
+ *  @author Ben Heberlein
+ *  @bug No known bugs.
+ */
+
+/*************************************
+ * Includes and definitions
+ */
+
+#include "tick.h"
+#include "err.h"
+#include "mem.h"
+#include "stm32f4xx.h"
+#include "stm32f4xx_rcc.h"
+#include "stm32f4xx_tim.h"
+#include "misc.h"
+#include "trace.h"
+#include "mon.h"
+#ifdef __KERN
+#include "kern.h"
+#endif
+#include <stdint.h>
+
+/* @brief Upper 32 bits of the time base
+ */
+static volatile uint32_t tick_high = 0;
+
+/* @brief Initialization flag
+ */
+static uint8_t tick_initialized = 0;
+
+/**************************************
+ * Private functions
+ */
+
+MEM_RAMFUNC void TIM5_IRQHandler() {
+    trace_Begin(TRACE_CAT_IRQ, TIM5_IRQn);
+    mon_IrqEnter(MON_IRQ_TIM5);
+
+    if (TIM_GetITStatus(TIM5, TIM_IT_Update) != RESET) {
+        TIM_ClearITPendingBit(TIM5, TIM_IT_Update);
+        tick_high++;
+    }
+
+    mon_IrqExit(MON_IRQ_TIM5);
+    trace_End(TRACE_CAT_IRQ, TIM5_IRQn);
+}
+
+/**************************************
+ * Public functions
+ */
+
+tick_status_t tick_Init() {
+    if (tick_initialized == 1) {
+        return TICK_WARN_ALINIT;
+    }
+
+    uint32_t timClk = tick_TimerClock();
+
+    RCC_APB1PeriphClockCmd(RCC_APB1Periph_TIM5, ENABLE);
+
+    TIM_TimeBaseInitTypeDef timeInit;
+    timeInit.TIM_Prescaler = timClk/TICK_HZ - 1;
+    timeInit.TIM_CounterMode = TIM_CounterMode_Up;
+    timeInit.TIM_Period = 0xFFFFFFFF;
+    timeInit.TIM_ClockDivision = TIM_CKD_DIV1;
+    timeInit.TIM_RepetitionCounter = 0;
+    TIM_TimeBaseInit(TIM5, &timeInit);
+
+    // Init generates an update event to load the prescaler
+    TIM_ClearFlag(TIM5, TIM_FLAG_Update);
+    TIM_ITConfig(TIM5, TIM_IT_Update, ENABLE);
+
+    NVIC_InitTypeDef nvicInit;
+    nvicInit.NVIC_IRQChannel = TIM5_IRQn;
+    nvicInit.NVIC_IRQChannelPreemptionPriority = TICK_NVIC_PRIO;
+    nvicInit.NVIC_IRQChannelSubPriority = 0;
+    nvicInit.NVIC_IRQChannelCmd = ENABLE;
+    NVIC_Init(&nvicInit);
+
+    TIM_Cmd(TIM5, ENABLE);
+
+    tick_initialized = 1;
+
+    return TICK_INFO_OK;
+}
+
+void tick_CycleInit() {
+    if (DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk) {
+        return;
+    }
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+uint32_t tick_TimerClock() {
+    // APB1 timers run at twice PCLK1 when APB1 is divided
+    RCC_ClocksTypeDef clocks;
+    RCC_GetClocksFreq(&clocks);
+    uint32_t timClk = clocks.PCLK1_Frequency;
+    if (clocks.PCLK1_Frequency != clocks.HCLK_Frequency) {
+        timClk *= 2;
+    }
+
+    return timClk;
+}
+
+uint64_t tick_Now() {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    uint32_t high = tick_high;
+    uint32_t low = TICK_COUNT();
+
+    // Overflow that the interrupt hasn't counted yet
+    if ((TIM5->SR & TIM_FLAG_Update) && low < 0x80000000) {
+        high++;
+    }
+
+    __set_PRIMASK(primask);
+
+    return ((uint64_t) high << 32) | low;
+}
+
+uint64_t tick_Deadline(uint32_t us) {
+    return tick_Now() + us;
+}
+
+uint8_t tick_Expired(uint64_t deadline) {
+    if (tick_initialized != 1) {
+        return 1;
+    }
+
+    return tick_Now() >= deadline;
+}
+
+void tick_DelayUs(uint32_t us) {
+    uint64_t deadline = tick_Deadline(us);
+    while (!tick_Expired(deadline)) {}
+}
+
+void tick_DelayMs(uint32_t ms) {
+    #ifdef __KERN
+    // Let other tasks run while we wait
+    if (kern_Running() && __get_IPSR() == 0) {
+        kern_Sleep((ms*KERN_TICK_HZ + 999)/1000);
+        return;
+    }
+    #endif
+
+    uint64_t deadline = tick_Now() + (uint64_t) ms*1000;
+    while (!tick_Expired(deadline)) {}
+}
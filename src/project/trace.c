@@ -0,0 +1,157 @@
+/** @file trace.c
+ *  @brief Implemenation of the trace recorder.
+ *
+ *  This contains the implementations of the trace
+ *  recorder functions.
+ *
+ *  @author Ben Heberlein
+ *  @bug No known bugs.
+ */
+
+/*************************************
+ * Includes and definitions
+ */
+
+#ifdef __TRACE
+#include "trace.h"
+#include "err.h"
+#include "log.h"
+#include "lz.h"
+#include "sdram.h"
+#include "tick.h"
+#include "stm32f4xx.h"
+#include <stdint.h>
+
+/* @brief Event ring buffer in SDRAM
+ */
+static trace_event_t * const trace_events = (trace_event_t *) TRACE_ADDR;
+static uint32_t trace_head = 0;
+static uint32_t trace_count = 0;
+static uint32_t trace_lost = 0;
+
+/* @brief Recording flag
+ */
+static volatile uint8_t trace_recording = 0;
+
+/* @brief Initialization flag
+ */
+static uint8_t trace_initialized = 0;
+#endif
+
+/**************************************
+ * Private functions
+ */
+
+#ifdef __TRACE
+void trace_event(trace_type_t type, trace_cat_t cat, uint16_t id) {
+    if (trace_recording == 0) {
+        return;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    trace_event_t *event = &trace_events[trace_head];
+    event->trace_event_cycles = TICK_CYCLES();
+    event->trace_event_type = type;
+    event->trace_event_cat = cat;
+    event->trace_event_id = id;
+
+    // Increment head and check for wrap, oldest is lost
+    trace_head++;
+    if (trace_head >= TRACE_CAP) {
+        trace_head = 0;
+    }
+    if (trace_count < TRACE_CAP) {
+        trace_count++;
+    } else {
+        trace_lost++;
+    }
+
+    __set_PRIMASK(primask);
+}
+#endif
+
+/**************************************
+ * Public functions
+ */
+
+#ifdef __TRACE
+trace_status_t trace_Init() {
+    if (trace_initialized == 1) {
+        return TRACE_WARN_ALINIT;
+    }
+
+    tick_CycleInit();
+
+    trace_initialized = 1;
+
+    return TRACE_INFO_OK;
+}
+
+trace_status_t trace_Start() {
+    if (trace_initialized != 1) {
+        return TRACE_ERR_INIT;
+    }
+
+    __disable_irq();
+    trace_head = 0;
+    trace_count = 0;
+    trace_lost = 0;
+    trace_recording = 1;
+    __enable_irq();
+
+    return TRACE_INFO_OK;
+}
+
+trace_status_t trace_Stop() {
+    if (trace_initialized != 1) {
+        return TRACE_ERR_INIT;
+    }
+
+    trace_recording = 0;
+
+    return TRACE_INFO_OK;
+}
+
+trace_status_t trace_Dump() {
+    if (trace_initialized != 1) {
+        return TRACE_ERR_INIT;
+    }
+
+    // Pause so the buffer holds still
+    uint8_t recording = trace_recording;
+    trace_recording = 0;
+
+    trace_header_t header;
+    header.trace_header_coreHz = SystemCoreClock;
+    header.trace_header_count = trace_count;
+    header.trace_header_lost = trace_lost;
+    log_Log(TRACE, TRACE_INFO_HEADER, "\0", sizeof(header), (uint8_t *) &header);
+
+    // Oldest event is at head once the buffer has wrapped
+    uint32_t index = trace_count < TRACE_CAP ? 0 : trace_head;
+    uint32_t left = trace_count;
+    while (left > 0) {
+        uint32_t n = left < TRACE_DUMP_CHUNK ? left : TRACE_DUMP_CHUNK;
+        if (index + n > TRACE_CAP) {
+            n = TRACE_CAP - index;
+        }
+
+        lz_Send(TRACE, TRACE_INFO_DATA, n*sizeof(trace_event_t),
+                (uint8_t *) &trace_events[index]);
+
+        index += n;
+        if (index >= TRACE_CAP) {
+            index = 0;
+        }
+        left -= n;
+    }
+
+    log_Log(TRACE, TRACE_INFO_END, "\0");
+
+    trace_recording = recording;
+
+    return TRACE_INFO_OK;
+}
+#endif
@@ -87,6 +87,41 @@ LoopCopyDataInit:
   adds  r2, r0, r1
   cmp  r2, r3
   bcc  CopyDataInit
+
+/* Copy the RAM resident code from flash to SRAM */
+  movs  r1, #0
+  b  LoopCopyRamfunc
+
+CopyRamfunc:
+  ldr  r3, =_siramfunc
+  ldr  r3, [r3, r1]
+  str  r3, [r0, r1]
+  adds  r1, r1, #4
+
+LoopCopyRamfunc:
+  ldr  r0, =_sramfunc
+  ldr  r3, =_eramfunc
+  adds  r2, r0, r1
+  cmp  r2, r3
+  bcc  CopyRamfunc
+
+/* Copy the CCM data initializers from flash to CCM RAM */
+  movs  r1, #0
+  b  LoopCopyCcmram
+
+CopyCcmram:
+  ldr  r3, =_siccmram
+  ldr  r3, [r3, r1]
+  str  r3, [r0, r1]
+  adds  r1, r1, #4
+
+LoopCopyCcmram:
+  ldr  r0, =_sccmram
+  ldr  r3, =_eccmram
+  adds  r2, r0, r1
+  cmp  r2, r3
+  bcc  CopyCcmram
+
   ldr  r2, =_sbss
   b  LoopFillZerobss
 /* Zero fill the bss segment. */  
@@ -99,6 +134,18 @@ LoopFillZerobss:
   cmp  r2, r3
   bcc  FillZerobss
 
+/* Zero fill the CCM bss segment. */
+  ldr  r2, =_sccmram_bss
+  b  LoopFillZeroCcmbss
+FillZeroCcmbss:
+  movs  r3, #0
+  str  r3, [r2], #4
+
+LoopFillZeroCcmbss:
+  ldr  r3, =_eccmram_bss
+  cmp  r2, r3
+  bcc  FillZeroCcmbss
+
 /* Call the clock system intitialization function.*/
   bl  SystemInit   
 /* Call static constructors */
@@ -29,6 +29,9 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "stm32f4xx_it.h"
+#ifdef __KERN
+#include "kern.h"
+#endif
 
 /** @addtogroup Template_Project
   * @{
@@ -125,14 +128,17 @@ void DebugMon_Handler(void)
 {
 }
 
+#ifndef __KERN
 /**
   * @brief  This function handles PendSVC exception.
+  * @note   The kernel provides its own handler in kern.c
   * @param  None
   * @retval None
   */
 void PendSV_Handler(void)
 {
 }
+#endif
 
 /**
   * @brief  This function handles SysTick Handler.
@@ -141,6 +147,9 @@ void PendSV_Handler(void)
   */
 void SysTick_Handler(void)
 {
+#ifdef __KERN
+  kern_Tick();
+#endif
 }
 
 /******************************************************************************/
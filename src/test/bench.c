@@ -0,0 +1,397 @@
+/** @file bench.c
+ *  @brief Benchmark framework and benchmark suite.
+ *
+ *  This contains the benchmark runner and the
+ *  registered benchmarks.
+ *
+ *  @author Ben Heberlein
+ *  @bug No known bugs.
+ */
+
+/*************************************
+ * Includes and definitions
+ */
+
+#include "bench.h"
+#include "log.h"
+#include "cmd.h"
+#include "sdram.h"
+#include "img.h"
+#include "jpeg.h"
+#include "lz.h"
+#include "cam.h"
+#include "tick.h"
+#include "err.h"
+#include "stm32f4xx.h"
+#ifdef __OV5642
+#include "ov5642.h"
+#endif
+#ifdef __OV7670
+#include "ov7670.h"
+#endif
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/* @brief Keeps read loops from being optimized away
+ */
+static volatile uint32_t bench_sink;
+
+/* @brief Command moved through the command queue
+ */
+static cmd_cmd_t bench_cmd;
+
+/* @brief UART payload
+ */
+static uint8_t bench_uartBuf[BENCH_UART_SIZE];
+
+/**************************************
+ * Benchmarks
+ */
+
+/* Raw word loops on the SDRAM bus, not the sdram_write()
+ * and sdram_read() API */
+static uint8_t bench_sdramCpuStore() {
+    uint32_t *p = (uint32_t *) SDRAM_SCRATCHADDR;
+    for (uint32_t i = 0; i < BENCH_SDRAM_SIZE/4; i++) {
+        p[i] = i;
+    }
+
+    return 0;
+}
+
+static uint8_t bench_sdramCpuLoad() {
+    volatile uint32_t *p = (volatile uint32_t *) SDRAM_SCRATCHADDR;
+    uint32_t sum = 0;
+    for (uint32_t i = 0; i < BENCH_SDRAM_SIZE/4; i++) {
+        sum += p[i];
+    }
+    bench_sink = sum;
+
+    return 0;
+}
+
+/* The same block both ways, the DMA version waits so the
+ * time covers the whole copy */
+static uint8_t bench_sdramDmaCopy() {
+    uint8_t *p = (uint8_t *) SDRAM_SCRATCHADDR;
+    if (sdram_CopyAsync(p + BENCH_SDRAM_SIZE, p, BENCH_SDRAM_SIZE, NULL, NULL) != SDRAM_INFO_OK) {
+        return 1;
+    }
+
+    return sdram_CopyWait() != SDRAM_INFO_OK;
+}
+
+static uint8_t bench_sdramCpuCopy() {
+    uint8_t *p = (uint8_t *) SDRAM_SCRATCHADDR;
+    memcpy(p + BENCH_SDRAM_SIZE, p, BENCH_SDRAM_SIZE);
+    bench_sink = p[BENCH_SDRAM_SIZE];
+
+    return 0;
+}
+
+/* Luma of a block of YUV422, out to the next block */
+static uint8_t bench_imgLuma() {
+    uint8_t *p = (uint8_t *) SDRAM_SCRATCHADDR;
+    return img_Luma(p + BENCH_SDRAM_SIZE, p, BENCH_SDRAM_SIZE/IMG_YUV_BPP) != IMG_INFO_OK;
+}
+
+/* Color from a block of YUV422, the reference straight
+ * between SDRAM blocks and the SIMD kernels through CCM */
+static uint8_t bench_imgRgb565Ref() {
+    uint8_t *p = (uint8_t *) SDRAM_SCRATCHADDR;
+    img_rgb565Ref((uint16_t *) (p + BENCH_SDRAM_SIZE), p, BENCH_SDRAM_SIZE/IMG_YUV_BPP);
+    bench_sink = p[BENCH_SDRAM_SIZE];
+
+    return 0;
+}
+
+static uint8_t bench_imgRgb565() {
+    uint8_t *p = (uint8_t *) SDRAM_SCRATCHADDR;
+    return img_Rgb565(p + BENCH_SDRAM_SIZE, p, BENCH_SDRAM_SIZE/IMG_YUV_BPP) != IMG_INFO_OK;
+}
+
+static uint8_t bench_imgRgb888() {
+    uint8_t *p = (uint8_t *) SDRAM_SCRATCHADDR;
+    return img_Rgb888(p + BENCH_SDRAM_SIZE, p, BENCH_SDRAM_SIZE/IMG_YUV_BPP) != IMG_INFO_OK;
+}
+
+/* The luma block out to RGB565 on the DMA2D, waiting so
+ * the time covers the whole conversion */
+static uint8_t bench_imgConvert() {
+    uint8_t *p = (uint8_t *) SDRAM_SCRATCHADDR;
+    if (img_ConvertAsync(p + BENCH_SDRAM_SIZE, IMG_FMT_RGB565, p, IMG_FMT_L8,
+                         BENCH_SDRAM_SIZE/2/256, 256, NULL, NULL) != IMG_INFO_OK) {
+        return 1;
+    }
+
+    return img_ConvertWait() != IMG_INFO_OK;
+}
+
+/* A frame of YUV422 to JPEG, out to the next block */
+static uint8_t bench_jpegEncode() {
+    uint8_t *p = (uint8_t *) SDRAM_SCRATCHADDR;
+    uint32_t len;
+    if (jpeg_Encode(p + BENCH_SDRAM_SIZE, BENCH_SDRAM_SIZE, &len, p, BENCH_FRAME_WIDTH,
+                    BENCH_FRAME_HEIGHT, JPEG_QUALITY_DEFAULT) != JPEG_INFO_OK) {
+        return 1;
+    }
+    bench_sink = len;
+
+    return 0;
+}
+
+/* Tiles of a block of YUV422 against a reference in the
+ * next block. After the first run nothing changes, so
+ * this is the cost of the comparison. */
+static uint8_t bench_imgDelta() {
+    uint8_t *p = (uint8_t *) SDRAM_SCRATCHADDR;
+    uint32_t len;
+    if (img_DeltaEncode(p + 2*BENCH_SDRAM_SIZE, BENCH_SDRAM_SIZE, &len, p, p + BENCH_SDRAM_SIZE,
+                        BENCH_FRAME_WIDTH, BENCH_FRAME_HEIGHT, 0, 0) != IMG_INFO_OK) {
+        return 1;
+    }
+    bench_sink = len;
+
+    return 0;
+}
+
+/* A frame of YUV422 to its pyramid, out to the next
+ * block */
+static uint8_t bench_imgPyramid() {
+    uint8_t *p = (uint8_t *) SDRAM_SCRATCHADDR;
+    uint32_t len;
+    if (img_Pyramid(p + BENCH_SDRAM_SIZE, BENCH_SDRAM_SIZE, &len, p, BENCH_FRAME_WIDTH,
+                    BENCH_FRAME_HEIGHT) != IMG_INFO_OK) {
+        return 1;
+    }
+    bench_sink = len;
+
+    return 0;
+}
+
+/* Statistics of a frame of YUV422, with motion against
+ * the next block */
+static uint8_t bench_imgStats() {
+    static img_stats_t stats;
+    uint8_t *p = (uint8_t *) SDRAM_SCRATCHADDR;
+    return img_Stats(&stats, p, p + BENCH_SDRAM_SIZE, BENCH_FRAME_WIDTH,
+                     BENCH_FRAME_HEIGHT) != IMG_INFO_OK;
+}
+
+/* Change detection on the smallest pyramid level of a
+ * frame, against a background that follows it */
+static uint8_t bench_imgMotion() {
+    static uint16_t background[(BENCH_FRAME_WIDTH >> IMG_PYRAMID_LEVELS)*
+                               (BENCH_FRAME_HEIGHT >> IMG_PYRAMID_LEVELS)];
+    static const img_region_t region = {0, 0, 0xFFFF, 0xFFFF, 1};
+    img_motion_t motion;
+    if (img_Motion(&motion, background, (uint8_t *) SDRAM_SCRATCHADDR,
+                   BENCH_FRAME_WIDTH >> IMG_PYRAMID_LEVELS, BENCH_FRAME_HEIGHT >> IMG_PYRAMID_LEVELS,
+                   24, 4, &region, 1) != IMG_INFO_OK) {
+        return 1;
+    }
+    bench_sink = motion.img_motion_count;
+
+    return 0;
+}
+
+/* A frame sized block from the start of the last captured
+ * frame, so the ratio is that of real data. Skipped until
+ * there is a frame. */
+#define BENCH_LZ_SIZE (BENCH_FRAME_WIDTH*BENCH_FRAME_HEIGHT*IMG_YUV_BPP)
+
+static uint8_t bench_lzSetup() {
+    sdram_frame_t *frame = cam_FrameAcquire();
+    if (frame == NULL) {
+        return 1;
+    }
+    if (frame->sdram_frame_len < BENCH_LZ_SIZE) {
+        sdram_FrameRelease(frame);
+        return 1;
+    }
+    memcpy((uint8_t *) SDRAM_SCRATCHADDR, (uint8_t *) frame->sdram_frame_addr, BENCH_LZ_SIZE);
+    sdram_FrameRelease(frame);
+
+    uint8_t *p = (uint8_t *) SDRAM_SCRATCHADDR;
+    uint32_t len;
+    if (lz_Compress(p + BENCH_SDRAM_SIZE, LZ_BOUND(BENCH_LZ_SIZE), &len,
+                    p, BENCH_LZ_SIZE) != LZ_INFO_OK) {
+        return 1;
+    }
+    lz_ratio_t ratio;
+    ratio.lz_ratio_raw = BENCH_LZ_SIZE;
+    ratio.lz_ratio_packed = len;
+    log_Log(LZ, LZ_INFO_RATIO, "\0", sizeof(ratio), (uint8_t *) &ratio);
+
+    return 0;
+}
+
+static uint8_t bench_lzCompress() {
+    uint8_t *p = (uint8_t *) SDRAM_SCRATCHADDR;
+    uint32_t len;
+    if (lz_Compress(p + BENCH_SDRAM_SIZE, LZ_BOUND(BENCH_LZ_SIZE), &len,
+                    p, BENCH_LZ_SIZE) != LZ_INFO_OK) {
+        return 1;
+    }
+    bench_sink = len;
+
+    return 0;
+}
+
+static uint8_t bench_sramCopy() {
+    static uint32_t src[256];
+    static uint32_t dst[256];
+    memcpy(dst, src, sizeof(dst));
+    bench_sink = dst[0];
+
+    return 0;
+}
+
+/* The chip id registers are read only, so writes go out
+ * on the bus and change nothing. */
+#ifdef __OV5642
+static uint8_t bench_sccbSetup() {
+    uint8_t value;
+    return ov5642_regRead(0x300A, &value) != OV5642_INFO_OK;
+}
+
+static uint8_t bench_sccbWrite() {
+    return ov5642_regWrite(0x300A, 0x56) != OV5642_INFO_OK;
+}
+#endif
+#ifdef __OV7670
+static uint8_t bench_sccbSetup() {
+    uint8_t value;
+    return ov7670_regRead(0x0A, &value) != OV7670_INFO_OK;
+}
+
+static uint8_t bench_sccbWrite() {
+    return ov7670_regWrite(0x0A, 0x76) != OV7670_INFO_OK;
+}
+#endif
+
+static uint8_t bench_uartSend() {
+    // The host drops filler packets
+    return log_Log(TEST, TEST_INFO_FILLER, "\0", BENCH_UART_SIZE, bench_uartBuf) != LOG_INFO_OK;
+}
+
+static uint8_t bench_cmdQueue() {
+    cmd_cmd_t *cmd;
+
+    // Only with the queue empty, so we get our own command back
+    __disable_irq();
+    if (cmd_QueueGetStatus() != CMD_INFO_QUEUEEMPTY) {
+        __enable_irq();
+        return 1;
+    }
+    cmd_QueuePut(&bench_cmd);
+    cmd_QueueGet(&cmd);
+    __enable_irq();
+
+    return cmd != &bench_cmd;
+}
+
+/* @brief The benchmark suite
+ */
+static const bench_bench_t bench_suite[] = {
+    {"sdram_cpu_store", NULL, bench_sdramCpuStore, BENCH_UNIT_BYTES, BENCH_SDRAM_SIZE, BENCH_WARMUP, BENCH_REPS},
+    {"sdram_cpu_load", NULL, bench_sdramCpuLoad, BENCH_UNIT_BYTES, BENCH_SDRAM_SIZE, BENCH_WARMUP, BENCH_REPS},
+    {"sdram_dma_copy", NULL, bench_sdramDmaCopy, BENCH_UNIT_BYTES, BENCH_SDRAM_SIZE, BENCH_WARMUP, BENCH_REPS},
+    {"sdram_cpu_copy", NULL, bench_sdramCpuCopy, BENCH_UNIT_BYTES, BENCH_SDRAM_SIZE, BENCH_WARMUP, BENCH_REPS},
+    {"img_luma", NULL, bench_imgLuma, BENCH_UNIT_BYTES, BENCH_SDRAM_SIZE, BENCH_WARMUP, BENCH_REPS},
+    {"img_rgb565_ref", NULL, bench_imgRgb565Ref, BENCH_UNIT_BYTES, BENCH_SDRAM_SIZE, BENCH_WARMUP, BENCH_REPS},
+    {"img_rgb565", NULL, bench_imgRgb565, BENCH_UNIT_BYTES, BENCH_SDRAM_SIZE, BENCH_WARMUP, BENCH_REPS},
+    {"img_rgb888", NULL, bench_imgRgb888, BENCH_UNIT_BYTES, BENCH_SDRAM_SIZE, BENCH_WARMUP, BENCH_REPS},
+    {"img_dma2d_565", NULL, bench_imgConvert, BENCH_UNIT_BYTES, BENCH_SDRAM_SIZE, BENCH_WARMUP, BENCH_REPS},
+    {"img_delta", NULL, bench_imgDelta, BENCH_UNIT_BYTES, BENCH_FRAME_WIDTH*BENCH_FRAME_HEIGHT*IMG_YUV_BPP,
+     BENCH_WARMUP, BENCH_REPS},
+    {"img_pyramid", NULL, bench_imgPyramid, BENCH_UNIT_BYTES, BENCH_FRAME_WIDTH*BENCH_FRAME_HEIGHT*IMG_YUV_BPP,
+     BENCH_WARMUP, BENCH_REPS},
+    {"img_stats", NULL, bench_imgStats, BENCH_UNIT_BYTES, BENCH_FRAME_WIDTH*BENCH_FRAME_HEIGHT*IMG_YUV_BPP,
+     BENCH_WARMUP, BENCH_REPS},
+    {"img_motion", NULL, bench_imgMotion, BENCH_UNIT_OPS, 1, BENCH_WARMUP, BENCH_REPS},
+    {"jpeg_encode", NULL, bench_jpegEncode, BENCH_UNIT_BYTES, BENCH_FRAME_WIDTH*BENCH_FRAME_HEIGHT*IMG_YUV_BPP,
+     BENCH_WARMUP, BENCH_REPS},
+    {"lz_frame", bench_lzSetup, bench_lzCompress, BENCH_UNIT_BYTES, BENCH_LZ_SIZE, BENCH_WARMUP, BENCH_REPS},
+    {"sram_memcpy", NULL, bench_sramCopy, BENCH_UNIT_BYTES, 1024, BENCH_WARMUP, BENCH_REPS},
+    #if defined(__OV5642) || defined(__OV7670)
+    {"sccb_write", bench_sccbSetup, bench_sccbWrite, BENCH_UNIT_OPS, 1, BENCH_WARMUP, BENCH_REPS},
+    #endif
+    {"uart_send", NULL, bench_uartSend, BENCH_UNIT_BYTES, BENCH_UART_SIZE, 1, 4},
+    {"cmd_queue", NULL, bench_cmdQueue, BENCH_UNIT_OPS, 1, BENCH_WARMUP, BENCH_REPS},
+};
+
+#define BENCH_NUM (sizeof(bench_suite)/sizeof(bench_suite[0]))
+
+/* @brief Results packet
+ */
+static struct __attribute__ ((packed)) {
+    bench_header_t header;
+    bench_result_t results[BENCH_NUM];
+} bench_packet;
+
+/**************************************
+ * Private functions
+ */
+
+test_status_t bench_run(const bench_bench_t *bench, bench_result_t *result) {
+    memset(result, 0, sizeof(*result));
+    strncpy(result->bench_result_name, bench->bench_name, BENCH_NAME_LEN-1);
+    result->bench_result_unit = bench->bench_unit;
+    result->bench_result_work = bench->bench_work;
+    result->bench_result_min = 0xFFFFFFFF;
+
+    if (bench->bench_setup != NULL && bench->bench_setup() != 0) {
+        result->bench_result_skipped = 1;
+        return TEST_WARN_SKIPPED;
+    }
+
+    for (uint16_t i = 0; i < bench->bench_warmup; i++) {
+        if (bench->bench_run() != 0) {
+            result->bench_result_skipped = 1;
+            return TEST_WARN_SKIPPED;
+        }
+    }
+
+    for (uint16_t i = 0; i < bench->bench_reps; i++) {
+        uint32_t start = TICK_CYCLES();
+        uint8_t failed = bench->bench_run();
+        uint32_t cycles = TICK_CYCLES() - start;
+
+        if (failed != 0) {
+            result->bench_result_skipped = 1;
+            return TEST_WARN_SKIPPED;
+        }
+
+        result->bench_result_reps++;
+        result->bench_result_sum += cycles;
+        if (cycles < result->bench_result_min) {
+            result->bench_result_min = cycles;
+        }
+        if (cycles > result->bench_result_max) {
+            result->bench_result_max = cycles;
+        }
+    }
+
+    return TEST_INFO_OK;
+}
+
+/**************************************
+ * Public functions
+ */
+
+test_status_t bench_Run() {
+    tick_CycleInit();
+
+    bench_packet.header.bench_header_coreHz = SystemCoreClock;
+    bench_packet.header.bench_header_count = BENCH_NUM;
+
+    for (uint8_t b = 0; b < BENCH_NUM; b++) {
+        bench_run(&bench_suite[b], &bench_packet.results[b]);
+    }
+
+    log_Log(TEST, TEST_INFO_BENCH, "\0", sizeof(bench_packet), (uint8_t *) &bench_packet);
+
+    return TEST_INFO_OK;
+}
@@ -0,0 +1,450 @@
+/** @file test_img.c
+ *  @brief Test functions for the image processing.
+ *
+ *  This contains the implementations of the image
+ *  processing test functions. Each stage is checked
+ *  against its byte at a time reference on a small frame
+ *  in SRAM. The DMA2D is off when the tests run, so only
+ *  the conversion argument checks are tested. The delta
+ *  encoder runs on a frame of two by two tiles, and the
+ *  pyramid and statistics on the same frame.
+ *
+ *  @author Ben Heberlein
+ *  @bug No known bugs.
+ */
+
+/*************************************
+ * Includes and definitions
+ */
+
+#include "test.h"
+#include "log.h"
+#include "img.h"
+#include "sdram.h"
+#include "err.h"
+#include "stm32f4xx.h"
+#include <stdint.h>
+
+#define NULL ((void *)0)
+
+/* @brief Pixels in the test frame, not a multiple of four
+ * so the tail runs too
+ */
+#define TEST_IMG_PIXELS 37
+
+/* @brief Test frame and outputs, word aligned
+ */
+static uint32_t test_img_src[(TEST_IMG_PIXELS*IMG_YUV_BPP + 3)/4 + 1];
+static uint32_t test_img_dst[(TEST_IMG_PIXELS + 3)/4 + 1];
+static uint32_t test_img_ref[(TEST_IMG_PIXELS + 3)/4 + 1];
+
+/* @brief Color outputs, RGB888 is the larger
+ */
+static uint32_t test_img_rgb[(TEST_IMG_PIXELS*3 + 3)/4];
+static uint32_t test_img_rgbRef[(TEST_IMG_PIXELS*3 + 3)/4];
+
+/* @brief Delta frame, its reference, and the output
+ */
+#define TEST_IMG_DELTA_SIZE (2*IMG_DELTA_TILE)
+static uint32_t test_img_deltaSrc[TEST_IMG_DELTA_SIZE*TEST_IMG_DELTA_SIZE*IMG_YUV_BPP/4];
+static uint32_t test_img_deltaRef[TEST_IMG_DELTA_SIZE*TEST_IMG_DELTA_SIZE*IMG_YUV_BPP/4];
+static uint8_t test_img_delta[IMG_DELTA_MAXSIZE(TEST_IMG_DELTA_SIZE, TEST_IMG_DELTA_SIZE)];
+
+/* @brief Pyramid of the delta frame, and a level made by
+ * the reference
+ */
+static uint32_t test_img_pyramid[IMG_PYRAMID_SIZE(TEST_IMG_DELTA_SIZE, TEST_IMG_DELTA_SIZE)/4];
+static uint32_t test_img_halve[TEST_IMG_DELTA_SIZE*TEST_IMG_DELTA_SIZE*IMG_YUV_BPP/16];
+
+/* @brief Statistics and the reference's
+ */
+static img_stats_t test_img_stats;
+static img_stats_t test_img_statsRef;
+
+/* @brief Change detector background
+ */
+static uint16_t test_img_background[TEST_IMG_DELTA_SIZE*TEST_IMG_DELTA_SIZE];
+
+/**************************************
+ * Private functions
+ */
+
+/* Compare statistics a byte at a time, they are packed */
+uint8_t test_img_statsSame(const img_stats_t *a, const img_stats_t *b) {
+    const uint8_t *p = (const uint8_t *) a;
+    const uint8_t *q = (const uint8_t *) b;
+    for (uint32_t i = 0; i < sizeof(img_stats_t); i++) {
+        if (p[i] != q[i]) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/**************************************
+ * Public functions
+ */
+
+test_status_t test_img() {
+    test_Test(test_img_Luma, "test_img_Luma passed.\0");
+    test_Test(test_img_Rgb, "test_img_Rgb passed.\0");
+    test_Test(test_img_Convert, "test_img_Convert passed.\0");
+    test_Test(test_img_Delta, "test_img_Delta passed.\0");
+    test_Test(test_img_Pyramid, "test_img_Pyramid passed.\0");
+    test_Test(test_img_Stats, "test_img_Stats passed.\0");
+    test_Test(test_img_Motion, "test_img_Motion passed.\0");
+
+    log_Log(TEST, TEST_INFO_PASSED, "test_img passed all tests.\0");
+
+    return TEST_INFO_PASSED;
+}
+
+char *test_img_Luma() {
+    uint8_t *src = (uint8_t *) test_img_src;
+    uint8_t *dst = (uint8_t *) test_img_dst;
+    uint8_t *ref = (uint8_t *) test_img_ref;
+
+    for (uint32_t i = 0; i < sizeof(test_img_src); i++) {
+        src[i] = i*7 + 3;
+    }
+
+    // Aligned, the SIMD loop and the tail
+    for (uint32_t i = 0; i < sizeof(test_img_dst); i++) {
+        dst[i] = 0xAA;
+        ref[i] = 0xAA;
+    }
+    img_lumaRef(ref, src, TEST_IMG_PIXELS);
+    test_Assert(img_Luma(dst, src, TEST_IMG_PIXELS) == IMG_INFO_OK, "img_Luma failed.\0");
+    for (uint32_t i = 0; i < sizeof(test_img_dst); i++) {
+        test_Assert(dst[i] == ref[i], "img_Luma doesn't match the reference.\0");
+    }
+    test_Assert(dst[0] == src[IMG_YUV_LUMA], "img_Luma picked a chroma byte.\0");
+
+    // Unaligned source, byte at a time
+    for (uint32_t i = 0; i < sizeof(test_img_dst); i++) {
+        dst[i] = 0xAA;
+        ref[i] = 0xAA;
+    }
+    img_lumaRef(ref, src + 2, TEST_IMG_PIXELS);
+    test_Assert(img_Luma(dst, src + 2, TEST_IMG_PIXELS) == IMG_INFO_OK, "img_Luma failed.\0");
+    for (uint32_t i = 0; i < sizeof(test_img_dst); i++) {
+        test_Assert(dst[i] == ref[i], "img_Luma doesn't match the reference unaligned.\0");
+    }
+
+    test_Assert(img_Luma(NULL, src, 4) == IMG_ERR_NULLPTR,
+                "img_Luma should reject a NULL buffer.\0");
+
+    return NULL;
+}
+
+char *test_img_Rgb() {
+    uint8_t *src = (uint8_t *) test_img_src;
+    uint8_t *rgb = (uint8_t *) test_img_rgb;
+    uint8_t *ref = (uint8_t *) test_img_rgbRef;
+    uint32_t pixels = TEST_IMG_PIXELS & ~1;
+
+    for (uint32_t i = 0; i < sizeof(test_img_src); i++) {
+        src[i] = i*7 + 3;
+    }
+
+    // Both ends of the chroma, so every channel clamps
+    uint8_t corners[] = {0x00, 0xFF, 0xFF, 0x00, 0xFF, 0x00, 0x00, 0xFF};
+    for (uint32_t i = 0; i < sizeof(corners); i++) {
+        src[i] = corners[i];
+    }
+
+    img_rgb565Ref((uint16_t *) ref, src, pixels);
+    test_Assert(img_Rgb565(rgb, src, pixels) == IMG_INFO_OK, "img_Rgb565 failed.\0");
+    for (uint32_t i = 0; i < pixels*2; i++) {
+        test_Assert(rgb[i] == ref[i], "img_Rgb565 doesn't match the reference.\0");
+    }
+
+    // U 0 and V 255 is red, the bright pixel's red and
+    // the dark one's blue clamp
+    img_rgb888Ref(ref, src, pixels);
+    test_Assert(ref[2] == 0xFF && ref[3] == 0x00, "img_rgb888Ref got the chroma wrong.\0");
+    test_Assert(img_Rgb888(rgb, src, pixels) == IMG_INFO_OK, "img_Rgb888 failed.\0");
+    for (uint32_t i = 0; i < pixels*3; i++) {
+        test_Assert(rgb[i] == ref[i], "img_Rgb888 doesn't match the reference.\0");
+    }
+
+    test_Assert(img_Rgb565(rgb, src, 3) == IMG_ERR_SIZE,
+                "img_Rgb565 should reject half a pixel pair.\0");
+    test_Assert(img_Rgb888(NULL, src, 2) == IMG_ERR_NULLPTR,
+                "img_Rgb888 should reject a NULL buffer.\0");
+
+    return NULL;
+}
+
+char *test_img_Convert() {
+    uint8_t *src = (uint8_t *) test_img_src;
+    uint8_t *dst = (uint8_t *) test_img_dst;
+
+    test_Assert(img_ConvertAsync(NULL, IMG_FMT_RGB565, src, IMG_FMT_L8, 4, 1, NULL, NULL) ==
+                IMG_ERR_NULLPTR, "img_ConvertAsync should reject a NULL buffer.\0");
+    test_Assert(img_ConvertAsync(dst, IMG_FMT_L8, src, IMG_FMT_RGB565, 4, 1, NULL, NULL) ==
+                IMG_ERR_FORMAT, "img_ConvertAsync should reject L8 output.\0");
+    test_Assert(img_ConvertAsync(dst, IMG_FMT_RGB565, src, (img_fmt_t) 3, 4, 1, NULL, NULL) ==
+                IMG_ERR_FORMAT, "img_ConvertAsync should reject an unknown format.\0");
+    test_Assert(img_ConvertAsync(dst, IMG_FMT_RGB565, src, IMG_FMT_L8, 0, 1, NULL, NULL) ==
+                IMG_ERR_SIZE, "img_ConvertAsync should reject an empty image.\0");
+    test_Assert(img_ConvertAsync(dst, IMG_FMT_RGB565, src, IMG_FMT_L8, IMG_CONVERT_MAXWIDTH + 1, 1,
+                                 NULL, NULL) == IMG_ERR_SIZE,
+                "img_ConvertAsync should reject a line past the DMA2D.\0");
+    test_Assert(img_ConvertAsync(dst + 1, IMG_FMT_RGB565, src, IMG_FMT_L8, 4, 1, NULL, NULL) ==
+                IMG_ERR_ALIGN, "img_ConvertAsync should reject a split RGB565 pixel.\0");
+    test_Assert(img_ConvertAsync(dst, IMG_FMT_RGB565, src + 2, IMG_FMT_ARGB8888, 4, 1, NULL, NULL) ==
+                IMG_ERR_ALIGN, "img_ConvertAsync should reject a split ARGB8888 pixel.\0");
+    test_Assert(img_ConvertAsync((void *) SDRAM_CCMADDR, IMG_FMT_RGB565, src, IMG_FMT_L8, 4, 1,
+                                 NULL, NULL) == IMG_ERR_RANGE,
+                "img_ConvertAsync should reject core coupled RAM.\0");
+    test_Assert(img_ConvertBusy() == 0, "Rejected conversions were queued.\0");
+
+    return NULL;
+}
+
+char *test_img_Delta() {
+    uint8_t *src = (uint8_t *) test_img_deltaSrc;
+    uint8_t *ref = (uint8_t *) test_img_deltaRef;
+    uint8_t *out = test_img_delta;
+    img_delta_t *hdr = (img_delta_t *) test_img_delta;
+    uint32_t stride = TEST_IMG_DELTA_SIZE*IMG_YUV_BPP;
+    uint32_t len;
+
+    for (uint32_t i = 0; i < sizeof(test_img_deltaSrc); i++) {
+        src[i] = i*7 + 3;
+        ref[i] = 0;
+    }
+
+    // A keyframe sends everything and fills the reference
+    test_Assert(img_DeltaEncode(out, sizeof(test_img_delta), &len, src, ref, TEST_IMG_DELTA_SIZE,
+                                TEST_IMG_DELTA_SIZE, 1, 0) == IMG_INFO_OK,
+                "img_DeltaEncode failed on a keyframe.\0");
+    test_Assert(hdr->img_delta_count == 4 && hdr->img_delta_key == 1 &&
+                len == sizeof(test_img_delta), "Keyframe didn't send every tile.\0");
+    for (uint32_t i = 0; i < sizeof(test_img_deltaSrc); i++) {
+        test_Assert(ref[i] == src[i], "Keyframe didn't update the reference.\0");
+    }
+
+    // Nothing changed, nothing sent
+    test_Assert(img_DeltaEncode(out, sizeof(test_img_delta), &len, src, ref, TEST_IMG_DELTA_SIZE,
+                                TEST_IMG_DELTA_SIZE, 0, 0) == IMG_INFO_OK,
+                "img_DeltaEncode failed.\0");
+    test_Assert(hdr->img_delta_count == 0 && len == sizeof(img_delta_t),
+                "An unchanged frame sent tiles.\0");
+
+    // A small change stays under the threshold, a big one
+    // in the bottom right tile goes out
+    src[IMG_DELTA_TILE*IMG_YUV_BPP + 1] += 4;
+    src[IMG_DELTA_TILE*stride + IMG_DELTA_TILE*IMG_YUV_BPP + 5*stride + 1] += 100;
+    test_Assert(img_DeltaEncode(out, sizeof(test_img_delta), &len, src, ref, TEST_IMG_DELTA_SIZE,
+                                TEST_IMG_DELTA_SIZE, 0, 8) == IMG_INFO_OK,
+                "img_DeltaEncode failed.\0");
+    test_Assert(hdr->img_delta_count == 1 && hdr->img_delta_key == 0 &&
+                out[sizeof(img_delta_t)] == 1 && out[sizeof(img_delta_t) + 1] == 1,
+                "The delta has the wrong tiles.\0");
+    test_Assert(out[sizeof(img_delta_t) + 2 + 5*IMG_DELTA_TILE*IMG_YUV_BPP + 1] ==
+                src[IMG_DELTA_TILE*stride + IMG_DELTA_TILE*IMG_YUV_BPP + 5*stride + 1],
+                "The delta tile has the wrong lines.\0");
+    test_Assert(ref[IMG_DELTA_TILE*IMG_YUV_BPP + 1] != src[IMG_DELTA_TILE*IMG_YUV_BPP + 1],
+                "A tile that wasn't sent changed the reference.\0");
+
+    test_Assert(img_DeltaEncode(out, sizeof(test_img_delta), &len, src, ref, 24,
+                                TEST_IMG_DELTA_SIZE, 0, 0) == IMG_ERR_SIZE,
+                "img_DeltaEncode should reject part of a tile.\0");
+    test_Assert(img_DeltaEncode(out, sizeof(test_img_delta), &len, src + 2, ref,
+                                TEST_IMG_DELTA_SIZE, TEST_IMG_DELTA_SIZE, 0, 0) == IMG_ERR_ALIGN,
+                "img_DeltaEncode should reject an unaligned frame.\0");
+    test_Assert(img_DeltaEncode(out, sizeof(img_delta_t) + 2, &len, src, ref, TEST_IMG_DELTA_SIZE,
+                                TEST_IMG_DELTA_SIZE, 1, 0) == IMG_ERR_FULL,
+                "img_DeltaEncode should stop at the end of the buffer.\0");
+
+    return NULL;
+}
+
+char *test_img_Pyramid() {
+    uint8_t *src = (uint8_t *) test_img_deltaSrc;
+    uint8_t *half = (uint8_t *) test_img_halve;
+    uint32_t len;
+
+    for (uint32_t i = 0; i < sizeof(test_img_deltaSrc); i++) {
+        src[i] = i*7 + 3 + (i >> 5)*13;
+    }
+
+    test_Assert(img_Pyramid(test_img_pyramid, sizeof(test_img_pyramid), &len, src,
+                            TEST_IMG_DELTA_SIZE, TEST_IMG_DELTA_SIZE) == IMG_INFO_OK,
+                "img_Pyramid failed.\0");
+    test_Assert(len == sizeof(test_img_pyramid), "The pyramid is the wrong size.\0");
+
+    // Each level is the reference run on the one above
+    const uint8_t *above = src;
+    uint16_t width = TEST_IMG_DELTA_SIZE;
+    for (uint8_t l = 1; l <= IMG_PYRAMID_LEVELS; l++) {
+        uint32_t size;
+        const img_thumb_t *hdr = img_PyramidLevel(test_img_pyramid, l, &size);
+        test_Assert(hdr != NULL, "img_PyramidLevel didn't find a level.\0");
+        test_Assert(hdr->img_thumb_width == TEST_IMG_DELTA_SIZE >> l &&
+                    hdr->img_thumb_height == TEST_IMG_DELTA_SIZE >> l,
+                    "A pyramid level is the wrong size.\0");
+        test_Assert(size == sizeof(img_thumb_t) + (width/2)*(width/2)*IMG_YUV_BPP,
+                    "img_PyramidLevel got the wrong length.\0");
+
+        const uint8_t *level = (const uint8_t *) (hdr + 1);
+        for (uint16_t y = 0; y < width/2; y++) {
+            img_halveRef(half, above + 2*y*width*IMG_YUV_BPP, above + (2*y + 1)*width*IMG_YUV_BPP,
+                         width/2);
+            for (uint32_t i = 0; i < width/2*IMG_YUV_BPP; i++) {
+                test_Assert(level[y*width/2*IMG_YUV_BPP + i] == half[i],
+                            "img_Pyramid doesn't match the reference.\0");
+            }
+        }
+        above = level;
+        width /= 2;
+    }
+    test_Assert(img_PyramidLevel(test_img_pyramid, IMG_PYRAMID_LEVELS + 1, &len) == NULL,
+                "img_PyramidLevel found a level past the last.\0");
+
+    // A flat frame stays flat
+    for (uint32_t i = 0; i < sizeof(test_img_deltaSrc); i++) {
+        src[i] = (i & 1) ? 0xA0 : 0x80;
+    }
+    test_Assert(img_Pyramid(test_img_pyramid, sizeof(test_img_pyramid), &len, src,
+                            TEST_IMG_DELTA_SIZE, TEST_IMG_DELTA_SIZE) == IMG_INFO_OK,
+                "img_Pyramid failed.\0");
+    const uint8_t *last = (const uint8_t *) (img_PyramidLevel(test_img_pyramid,
+                                                               IMG_PYRAMID_LEVELS, &len) + 1);
+    test_Assert(last[0] == 0x80 && last[1] == 0xA0 && last[3] == 0xA0,
+                "A flat frame changed in the pyramid.\0");
+
+    test_Assert(img_Pyramid(test_img_pyramid, sizeof(test_img_pyramid), &len, src, 24,
+                            TEST_IMG_DELTA_SIZE) == IMG_ERR_SIZE,
+                "img_Pyramid should reject a width that doesn't halve.\0");
+    test_Assert(img_Pyramid(test_img_pyramid, sizeof(test_img_pyramid), &len, src + 2,
+                            TEST_IMG_DELTA_SIZE, TEST_IMG_DELTA_SIZE) == IMG_ERR_ALIGN,
+                "img_Pyramid should reject an unaligned frame.\0");
+    test_Assert(img_Pyramid(test_img_pyramid, sizeof(test_img_pyramid) - 4, &len, src,
+                            TEST_IMG_DELTA_SIZE, TEST_IMG_DELTA_SIZE) == IMG_ERR_FULL,
+                "img_Pyramid should stop at the end of the buffer.\0");
+
+    return NULL;
+}
+
+char *test_img_Stats() {
+    uint8_t *src = (uint8_t *) test_img_deltaSrc;
+    uint8_t *prev = (uint8_t *) test_img_deltaRef;
+    img_stats_t *stats = &test_img_stats;
+    img_stats_t *ref = &test_img_statsRef;
+
+    for (uint32_t i = 0; i < sizeof(test_img_deltaSrc); i++) {
+        src[i] = i*7 + 3 + (i >> 6)*29;
+        prev[i] = i*5 + 1;
+    }
+
+    // The reference, with and without a frame before
+    test_Assert(img_Stats(stats, src, prev, TEST_IMG_DELTA_SIZE, TEST_IMG_DELTA_SIZE) ==
+                IMG_INFO_OK, "img_Stats failed.\0");
+    img_statsRef(ref, src, prev, TEST_IMG_DELTA_SIZE, TEST_IMG_DELTA_SIZE);
+    test_Assert(test_img_statsSame(stats, ref), "img_Stats doesn't match the reference.\0");
+    test_Assert(stats->img_stats_flags == IMG_STATS_MOTION && stats->img_stats_motion != 0,
+                "img_Stats didn't measure the motion.\0");
+
+    test_Assert(img_Stats(stats, src, NULL, TEST_IMG_DELTA_SIZE, TEST_IMG_DELTA_SIZE) ==
+                IMG_INFO_OK, "img_Stats failed.\0");
+    img_statsRef(ref, src, NULL, TEST_IMG_DELTA_SIZE, TEST_IMG_DELTA_SIZE);
+    test_Assert(test_img_statsSame(stats, ref), "img_Stats doesn't match the reference.\0");
+    test_Assert(stats->img_stats_flags == 0 && stats->img_stats_motion == 0,
+                "img_Stats measured motion without a frame before.\0");
+
+    uint32_t count = 0;
+    for (uint8_t i = 0; i < IMG_STATS_BINS; i++) {
+        count += stats->img_stats_hist[i];
+    }
+    test_Assert(count == TEST_IMG_DELTA_SIZE*TEST_IMG_DELTA_SIZE,
+                "The histogram doesn't count every pixel.\0");
+
+    // A flat frame is all in one bin, with nothing in
+    // focus and no motion against itself
+    for (uint32_t i = 0; i < sizeof(test_img_deltaSrc); i++) {
+        src[i] = (i & 1) ? 0x60 : 0x80;
+    }
+    test_Assert(img_Stats(stats, src, src, TEST_IMG_DELTA_SIZE, TEST_IMG_DELTA_SIZE) ==
+                IMG_INFO_OK, "img_Stats failed.\0");
+    test_Assert(stats->img_stats_mean == 0x60 << 8 && stats->img_stats_variance == 0 &&
+                stats->img_stats_focus == 0 && stats->img_stats_motion == 0,
+                "A flat frame has the wrong statistics.\0");
+    test_Assert(stats->img_stats_hist[0x60 >> IMG_STATS_BINSHIFT] ==
+                TEST_IMG_DELTA_SIZE*TEST_IMG_DELTA_SIZE, "A flat frame isn't in one bin.\0");
+
+    // A sharp edge is in focus
+    src[TEST_IMG_DELTA_SIZE*IMG_YUV_BPP*8 + 9] = 0xFF;
+    test_Assert(img_Stats(stats, src, NULL, TEST_IMG_DELTA_SIZE, TEST_IMG_DELTA_SIZE) ==
+                IMG_INFO_OK, "img_Stats failed.\0");
+    test_Assert(stats->img_stats_focus != 0, "A sharp point isn't in focus.\0");
+
+    test_Assert(img_Stats(stats, src, NULL, IMG_STATS_MAXWIDTH + 2, TEST_IMG_DELTA_SIZE) ==
+                IMG_ERR_SIZE, "img_Stats should reject a line past the buffers.\0");
+    test_Assert(img_Stats(stats, src, NULL, TEST_IMG_DELTA_SIZE, 2) == IMG_ERR_SIZE,
+                "img_Stats should reject a frame without an inside.\0");
+    test_Assert(img_Stats(stats, src, prev + 2, TEST_IMG_DELTA_SIZE, TEST_IMG_DELTA_SIZE) ==
+                IMG_ERR_ALIGN, "img_Stats should reject an unaligned frame.\0");
+
+    return NULL;
+}
+
+char *test_img_Motion() {
+    uint8_t *src = (uint8_t *) test_img_deltaSrc;
+    uint16_t *bg = test_img_background;
+    img_motion_t motion;
+    img_region_t regions[2] = {
+        {0, 0, TEST_IMG_DELTA_SIZE, TEST_IMG_DELTA_SIZE/2, 4},
+        {0, TEST_IMG_DELTA_SIZE/2, TEST_IMG_DELTA_SIZE, TEST_IMG_DELTA_SIZE/2, 4},
+    };
+
+    for (uint32_t i = 0; i < sizeof(test_img_deltaSrc); i++) {
+        src[i] = i*7 + (i >> 6)*29;
+    }
+
+    // Load the background, then the same frame is still
+    test_Assert(img_Motion(&motion, bg, src, TEST_IMG_DELTA_SIZE, TEST_IMG_DELTA_SIZE, 16, 0,
+                           regions, 2) == IMG_INFO_OK, "img_Motion failed.\0");
+    test_Assert(img_Motion(&motion, bg, src, TEST_IMG_DELTA_SIZE, TEST_IMG_DELTA_SIZE, 16, 2,
+                           regions, 2) == IMG_INFO_OK, "img_Motion failed.\0");
+    test_Assert(motion.img_motion_region == IMG_MOTION_NONE && motion.img_motion_count == 0,
+                "img_Motion fired on a still frame.\0");
+
+    // A 3 by 2 block changes in the lower half
+    for (uint8_t y = 20; y < 22; y++) {
+        for (uint8_t x = 5; x < 8; x++) {
+            src[(y*TEST_IMG_DELTA_SIZE + x)*IMG_YUV_BPP + IMG_YUV_LUMA] += 100;
+        }
+    }
+    test_Assert(img_Motion(&motion, bg, src, TEST_IMG_DELTA_SIZE, TEST_IMG_DELTA_SIZE, 16, 2,
+                           regions, 2) == IMG_INFO_OK, "img_Motion failed.\0");
+    test_Assert(motion.img_motion_region == 1 && motion.img_motion_count == 6,
+                "img_Motion didn't fire in the region that changed.\0");
+    test_Assert(motion.img_motion_x0 == 5 && motion.img_motion_y0 == 20 &&
+                motion.img_motion_x1 == 7 && motion.img_motion_y1 == 21,
+                "img_Motion has the wrong box.\0");
+
+    // The background follows, until the change is gone
+    uint8_t frames = 1;
+    do {
+        img_Motion(&motion, bg, src, TEST_IMG_DELTA_SIZE, TEST_IMG_DELTA_SIZE, 16, 2, regions, 2);
+    } while (motion.img_motion_region != IMG_MOTION_NONE && ++frames < 32);
+    test_Assert(frames > 2 && frames < 32, "The background didn't follow the frame.\0");
+
+    // Too few changed pixels, or a region that is off
+    src[(20*TEST_IMG_DELTA_SIZE + 5)*IMG_YUV_BPP + IMG_YUV_LUMA] += 100;
+    regions[0].img_region_width = 0;
+    img_Motion(&motion, bg, src, TEST_IMG_DELTA_SIZE, TEST_IMG_DELTA_SIZE, 16, 2, regions, 2);
+    test_Assert(motion.img_motion_region == IMG_MOTION_NONE,
+                "img_Motion fired under the region count.\0");
+
+    test_Assert(img_Motion(&motion, bg, src, TEST_IMG_DELTA_SIZE, TEST_IMG_DELTA_SIZE, 16, 9,
+                           regions, 2) == IMG_ERR_RANGE, "img_Motion should reject a slow rate.\0");
+    test_Assert(img_Motion(&motion, bg, src, TEST_IMG_DELTA_SIZE, TEST_IMG_DELTA_SIZE, 16, 2,
+                           NULL, 2) == IMG_ERR_NULLPTR, "img_Motion should reject NULL regions.\0");
+
+    return NULL;
+}
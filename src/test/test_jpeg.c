@@ -0,0 +1,126 @@
+/** @file test_jpeg.c
+ *  @brief Test functions for the JPEG encoder.
+ *
+ *  This contains the implementations of the JPEG
+ *  encoder test functions. A small frame in SRAM is
+ *  encoded and the output checked for its markers and
+ *  how its size follows the content and quality.
+ *
+ *  @author Ben Heberlein
+ *  @bug No known bugs.
+ */
+
+/*************************************
+ * Includes and definitions
+ */
+
+#include "test.h"
+#include "log.h"
+#include "jpeg.h"
+#include "img.h"
+#include "err.h"
+#include <stdint.h>
+
+#define NULL ((void *)0)
+
+/* @brief Test frame, two minimum coded units wide
+ */
+#define TEST_JPEG_WIDTH 32
+#define TEST_JPEG_HEIGHT 16
+
+/* @brief Test frame and output, the headers alone are
+ * over 600 bytes
+ */
+static uint32_t test_jpeg_src[TEST_JPEG_WIDTH*TEST_JPEG_HEIGHT*IMG_YUV_BPP/4];
+static uint8_t test_jpeg_dst[4096];
+
+/**************************************
+ * Private functions
+ */
+
+/* Fill the frame, a gradient with chroma or flat gray */
+void test_jpeg_fill(uint8_t flat) {
+    uint8_t *src = (uint8_t *) test_jpeg_src;
+    for (uint32_t i = 0; i < sizeof(test_jpeg_src); i++) {
+        if (flat) {
+            src[i] = 0x80;
+        } else {
+            src[i] = (i & 1) ? i*3 : 0x40 + (i & 0x7F);
+        }
+    }
+}
+
+/**************************************
+ * Public functions
+ */
+
+test_status_t test_jpeg() {
+    test_Test(test_jpeg_Encode, "test_jpeg_Encode passed.\0");
+    test_Test(test_jpeg_Args, "test_jpeg_Args passed.\0");
+
+    log_Log(TEST, TEST_INFO_PASSED, "test_jpeg passed all tests.\0");
+
+    return TEST_INFO_PASSED;
+}
+
+char *test_jpeg_Encode() {
+    uint8_t *src = (uint8_t *) test_jpeg_src;
+    uint8_t *dst = test_jpeg_dst;
+    uint32_t len = 0;
+    uint32_t flat, low, high;
+
+    test_jpeg_fill(0);
+    test_Assert(jpeg_Encode(dst, sizeof(test_jpeg_dst), &len, src, TEST_JPEG_WIDTH,
+                            TEST_JPEG_HEIGHT, JPEG_QUALITY_DEFAULT) == JPEG_INFO_OK,
+                "jpeg_Encode failed.\0");
+    test_Assert(dst[0] == 0xFF && dst[1] == 0xD8, "JPEG doesn't start with SOI.\0");
+    test_Assert(dst[len - 2] == 0xFF && dst[len - 1] == 0xD9, "JPEG doesn't end with EOI.\0");
+
+    // The frame size is in the SOF0 segment
+    uint32_t i = 2;
+    while (i + 4 < len && !(dst[i] == 0xFF && dst[i + 1] == 0xC0)) {
+        i += 2 + (dst[i + 2] << 8 | dst[i + 3]);
+    }
+    test_Assert(i + 9 < len, "JPEG has no SOF0 segment.\0");
+    test_Assert((dst[i + 5] << 8 | dst[i + 6]) == TEST_JPEG_HEIGHT &&
+                (dst[i + 7] << 8 | dst[i + 8]) == TEST_JPEG_WIDTH, "SOF0 has the wrong size.\0");
+
+    // Less detail or quality, fewer bytes
+    test_Assert(jpeg_Encode(dst, sizeof(test_jpeg_dst), &low, src, TEST_JPEG_WIDTH,
+                            TEST_JPEG_HEIGHT, 10) == JPEG_INFO_OK, "jpeg_Encode failed.\0");
+    test_Assert(jpeg_Encode(dst, sizeof(test_jpeg_dst), &high, src, TEST_JPEG_WIDTH,
+                            TEST_JPEG_HEIGHT, 100) == JPEG_INFO_OK, "jpeg_Encode failed.\0");
+    test_Assert(low < len && len < high, "JPEG size doesn't follow the quality.\0");
+
+    test_jpeg_fill(1);
+    test_Assert(jpeg_Encode(dst, sizeof(test_jpeg_dst), &flat, src, TEST_JPEG_WIDTH,
+                            TEST_JPEG_HEIGHT, JPEG_QUALITY_DEFAULT) == JPEG_INFO_OK,
+                "jpeg_Encode failed.\0");
+    test_Assert(flat < len, "A flat frame should code smaller.\0");
+
+    return NULL;
+}
+
+char *test_jpeg_Args() {
+    uint8_t *src = (uint8_t *) test_jpeg_src;
+    uint8_t *dst = test_jpeg_dst;
+    uint32_t len;
+
+    test_Assert(jpeg_Encode(NULL, sizeof(test_jpeg_dst), &len, src, 16, 16, 75) ==
+                JPEG_ERR_NULLPTR, "jpeg_Encode should reject a NULL buffer.\0");
+    test_Assert(jpeg_Encode(dst, sizeof(test_jpeg_dst), &len, src, 16, 16, 0) ==
+                JPEG_ERR_QUALITY, "jpeg_Encode should reject quality 0.\0");
+    test_Assert(jpeg_Encode(dst, sizeof(test_jpeg_dst), &len, src, 16, 16, 101) ==
+                JPEG_ERR_QUALITY, "jpeg_Encode should reject quality over 100.\0");
+    test_Assert(jpeg_Encode(dst, sizeof(test_jpeg_dst), &len, src, 24, 16, 75) ==
+                JPEG_ERR_SIZE, "jpeg_Encode should reject part of a coded unit.\0");
+    test_Assert(jpeg_Encode(dst, sizeof(test_jpeg_dst), &len, src, 16, 0, 75) ==
+                JPEG_ERR_SIZE, "jpeg_Encode should reject an empty frame.\0");
+    test_Assert(jpeg_Encode(dst, sizeof(test_jpeg_dst), &len, src, JPEG_MAXWIDTH + JPEG_MCU, 16,
+                            75) == JPEG_ERR_SIZE,
+                "jpeg_Encode should reject a line past the strip.\0");
+    test_Assert(jpeg_Encode(dst, 64, &len, src, 16, 16, 75) == JPEG_ERR_FULL,
+                "jpeg_Encode should stop at the end of the buffer.\0");
+
+    return NULL;
+}
@@ -0,0 +1,166 @@
+/** @file test_lz.c
+ *  @brief Test functions for the LZ compressor.
+ *
+ *  This contains the implementations of the LZ compressor
+ *  test functions. Blocks are decoded again here and
+ *  compared with what went in.
+ *
+ *  @author Ben Heberlein
+ *  @bug No known bugs.
+ */
+
+/*************************************
+ * Includes and definitions
+ */
+
+#include "test.h"
+#include "log.h"
+#include "lz.h"
+#include "err.h"
+#include <stdint.h>
+
+#define NULL ((void *)0)
+
+/* @brief Test input size
+ */
+#define TEST_LZ_SIZE 2048
+
+/* @brief Test input, output, and decoded copy
+ */
+static uint8_t test_lz_src[TEST_LZ_SIZE];
+static uint8_t test_lz_dst[LZ_BOUND(TEST_LZ_SIZE)];
+static uint8_t test_lz_out[TEST_LZ_SIZE];
+
+/**************************************
+ * Private functions
+ */
+
+/* Read a length past the 15 in the token */
+uint32_t test_lz_length(const uint8_t *src, uint32_t *i, uint32_t len) {
+    uint8_t b;
+    do {
+        b = src[(*i)++];
+        len += b;
+    } while (b == 255);
+
+    return len;
+}
+
+/* Decode a block, returns the decoded size or 0 if it is
+ * malformed */
+uint32_t test_lz_decode(uint8_t *dst, uint32_t max, const uint8_t *src, uint32_t len) {
+    uint32_t i = 0;
+    uint32_t o = 0;
+    while (i < len) {
+        uint8_t token = src[i++];
+        uint32_t lit = token >> 4;
+        if (lit == 15) {
+            lit = test_lz_length(src, &i, lit);
+        }
+        if (i + lit > len || o + lit > max) {
+            return 0;
+        }
+        for (uint32_t j = 0; j < lit; j++) {
+            dst[o++] = src[i++];
+        }
+        if (i == len) {
+            break;
+        }
+
+        uint32_t dist = src[i] | src[i + 1] << 8;
+        i += 2;
+        uint32_t mlen = token & 0x0F;
+        if (mlen == 15) {
+            mlen = test_lz_length(src, &i, mlen);
+        }
+        mlen += LZ_MINMATCH;
+        if (dist == 0 || dist > o || o + mlen > max) {
+            return 0;
+        }
+        for (uint32_t j = 0; j < mlen; j++, o++) {
+            dst[o] = dst[o - dist];
+        }
+    }
+
+    return o;
+}
+
+/* Compress and decode size bytes, returns the block size
+ * or 0 if it didn't come back the same */
+uint32_t test_lz_roundtrip(uint32_t size) {
+    uint32_t len = 0;
+    if (lz_Compress(test_lz_dst, sizeof(test_lz_dst), &len, test_lz_src, size) != LZ_INFO_OK) {
+        return 0;
+    }
+    if (test_lz_decode(test_lz_out, sizeof(test_lz_out), test_lz_dst, len) != size) {
+        return 0;
+    }
+    for (uint32_t i = 0; i < size; i++) {
+        if (test_lz_out[i] != test_lz_src[i]) {
+            return 0;
+        }
+    }
+
+    return len;
+}
+
+/**************************************
+ * Public functions
+ */
+
+test_status_t test_lz() {
+    test_Test(test_lz_Compress, "test_lz_Compress passed.\0");
+    test_Test(test_lz_Args, "test_lz_Args passed.\0");
+
+    log_Log(TEST, TEST_INFO_PASSED, "test_lz passed all tests.\0");
+
+    return TEST_INFO_PASSED;
+}
+
+char *test_lz_Compress() {
+    uint32_t len;
+
+    // A repeating pattern, long matches and lengths
+    // past 255
+    for (uint32_t i = 0; i < TEST_LZ_SIZE; i++) {
+        test_lz_src[i] = "camera frame "[i % 13];
+    }
+    len = test_lz_roundtrip(TEST_LZ_SIZE);
+    test_Assert(len != 0, "A repeating block didn't decode the same.\0");
+    test_Assert(len < TEST_LZ_SIZE/16, "A repeating block should compress well.\0");
+
+    // Noise doesn't compress but stays in the bound
+    uint32_t seed = 1;
+    for (uint32_t i = 0; i < TEST_LZ_SIZE; i++) {
+        seed = seed*1103515245 + 12345;
+        test_lz_src[i] = seed >> 16;
+    }
+    len = test_lz_roundtrip(TEST_LZ_SIZE);
+    test_Assert(len != 0, "A noise block didn't decode the same.\0");
+    test_Assert(len <= LZ_BOUND(TEST_LZ_SIZE), "A noise block went past the bound.\0");
+
+    // Too short to match, all literals
+    test_Assert(test_lz_roundtrip(LZ_MFLIMIT) == LZ_MFLIMIT + 1,
+                "A short block should be literals.\0");
+    test_Assert(test_lz_roundtrip(0) == 1, "An empty block should be one token.\0");
+
+    return NULL;
+}
+
+char *test_lz_Args() {
+    uint32_t len;
+
+    for (uint32_t i = 0; i < TEST_LZ_SIZE; i++) {
+        test_lz_src[i] = i;
+    }
+    test_Assert(lz_Compress(NULL, sizeof(test_lz_dst), &len, test_lz_src, TEST_LZ_SIZE) ==
+                LZ_ERR_NULLPTR, "lz_Compress should reject a NULL buffer.\0");
+    test_Assert(lz_Compress(test_lz_dst, sizeof(test_lz_dst), NULL, test_lz_src, TEST_LZ_SIZE) ==
+                LZ_ERR_NULLPTR, "lz_Compress should reject a NULL length.\0");
+    test_Assert(lz_Compress(test_lz_dst, 64, &len, test_lz_src, TEST_LZ_SIZE) == LZ_ERR_FULL,
+                "lz_Compress should stop at the end of the buffer.\0");
+    test_Assert(lz_Send(TEST, TEST_INFO_PASSED, 0, NULL) == LZ_ERR_NULLPTR,
+                "lz_Send should reject a NULL payload.\0");
+
+    return NULL;
+}
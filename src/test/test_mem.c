@@ -0,0 +1,128 @@
+/** @file test_mem.c
+ *  @brief Test functions for the memory monitor.
+ *
+ *  This contains the implementations of the memory
+ *  monitor test functions.
+ *
+ *  @author Ben Heberlein
+ *  @bug No known bugs.
+ */
+
+/*************************************
+ * Includes and definitions
+ */
+
+#include "test.h"
+#include "log.h"
+#include "mem.h"
+#include "err.h"
+#include <stdint.h>
+
+/* @brief One of each placement, the initializers are
+ * checked after startup
+ */
+static uint32_t test_mem_ccm[4] MEM_CCM;
+static uint32_t test_mem_ccmData MEM_CCMDATA = 0xC0FFEE;
+
+/**************************************
+ * Private functions
+ */
+
+MEM_RAMFUNC uint32_t test_mem_ramfunc(uint32_t x) {
+    return x*3 + 1;
+}
+
+/**************************************
+ * Public functions
+ */
+
+test_status_t test_mem() {
+    test_Test(test_mem_Malloc, "test_mem_Malloc passed.\0");
+    test_Test(test_mem_Stack, "test_mem_Stack passed.\0");
+    test_Test(test_mem_Sections, "test_mem_Sections passed.\0");
+
+    log_Log(TEST, TEST_INFO_PASSED, "test_mem passed all tests.\0");
+
+    return TEST_INFO_PASSED;
+}
+
+char *test_mem_Malloc() {
+    mem_report_t before;
+    mem_report_t after;
+
+    mem_ReportGet(&before);
+
+    uint8_t *a = (uint8_t *) mem_Malloc(100);
+    uint8_t *b = (uint8_t *) mem_Malloc(28);
+    test_Assert(a != NULL && b != NULL, "mem_Malloc failed.\0");
+    test_Assert(((uint32_t) a & 7) == 0, "mem_Malloc returned unaligned memory.\0");
+
+    mem_ReportGet(&after);
+    test_Assert(after.mem_report_heapCurrent == before.mem_report_heapCurrent + 128,
+                "mem_Malloc miscounted current use.\0");
+    test_Assert(after.mem_report_heapPeak >= after.mem_report_heapCurrent,
+                "Heap peak is below current use.\0");
+    test_Assert(after.mem_report_allocs == before.mem_report_allocs + 2,
+                "mem_Malloc miscounted allocations.\0");
+
+    mem_Free(a);
+    mem_Free(b);
+    mem_Free(NULL);
+
+    mem_ReportGet(&after);
+    test_Assert(after.mem_report_heapCurrent == before.mem_report_heapCurrent,
+                "mem_Free miscounted current use.\0");
+    test_Assert(after.mem_report_frees == before.mem_report_frees + 2,
+                "mem_Free miscounted frees.\0");
+
+    // More than the whole of RAM
+    test_Assert(mem_Malloc(0x100000) == NULL, "mem_Malloc should fail on a huge block.\0");
+    mem_ReportGet(&after);
+    test_Assert(after.mem_report_failures == before.mem_report_failures + 1,
+                "mem_Malloc didn't count a failure.\0");
+
+    return NULL;
+}
+
+char *test_mem_Stack() {
+    mem_report_t report;
+    mem_status_t st = mem_ReportGet(NULL);
+    test_Assert(st == MEM_ERR_NULLPTR, "mem_ReportGet should reject a NULL report.\0");
+
+    st = mem_ReportGet(&report);
+    test_Assert(st == MEM_INFO_OK, "Main stack overflowed its reservation.\0");
+    test_Assert(report.mem_report_stackUsed > 0, "Stack high-water mark not measured.\0");
+
+    // The frame holding this buffer is below the mark
+    volatile uint8_t deep[512];
+    for (uint32_t i = 0; i < sizeof(deep); i++) {
+        deep[i] = 0;
+    }
+    uint32_t used = report.mem_report_stackUsed;
+    mem_ReportGet(&report);
+    test_Assert(report.mem_report_stackUsed >= used, "Stack high-water mark went down.\0");
+    // The host build doesn't run on the painted stack
+    #ifndef __HOST
+    test_Assert(report.mem_report_stackUsed > sizeof(deep),
+                "Stack high-water mark missed a deep frame.\0");
+    #endif
+    test_Assert(report.mem_report_stackUsed <= report.mem_report_stackReserved,
+                "Stack high-water mark is past the reservation.\0");
+
+    return NULL;
+}
+
+char *test_mem_Sections() {
+    test_Assert(test_mem_ccm[0] == 0 && test_mem_ccm[3] == 0, "CCM data wasn't zeroed.\0");
+    test_Assert(test_mem_ccmData == 0xC0FFEE, "CCM data lost its initializer.\0");
+    test_Assert(test_mem_ramfunc(4) == 13, "RAM function returned the wrong value.\0");
+
+    // The host build has no CCM or SRAM at fixed addresses
+    #ifndef __HOST
+    test_Assert(((uint32_t) test_mem_ccm >> 16) == 0x1000, "MEM_CCM data isn't in CCM.\0");
+    test_Assert(((uint32_t) &test_mem_ccmData >> 16) == 0x1000, "MEM_CCMDATA data isn't in CCM.\0");
+    test_Assert(((uint32_t) test_mem_ramfunc >> 24) == 0x20, "MEM_RAMFUNC code isn't in SRAM.\0");
+    #endif
+
+    return NULL;
+}
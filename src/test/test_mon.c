@@ -0,0 +1,97 @@
+/** @file test_mon.c
+ *  @brief Test functions for the interrupt and DMA monitor.
+ *
+ *  This contains the implementations of the monitor
+ *  test functions.
+ *
+ *  @author Ben Heberlein
+ *  @bug No known bugs.
+ */
+
+/*************************************
+ * Includes and definitions
+ */
+
+#include "test.h"
+#include "log.h"
+#include "mon.h"
+#include "err.h"
+#include <stdint.h>
+
+#define NULL ((void *)0)
+
+/* @brief Report buffer, too big for the stack
+ */
+static mon_report_t test_mon_report;
+
+/**************************************
+ * Private functions
+ */
+
+/**************************************
+ * Public functions
+ */
+
+test_status_t test_mon() {
+    test_Test(test_mon_Irq, "test_mon_Irq passed.\0");
+    test_Test(test_mon_Dma, "test_mon_Dma passed.\0");
+
+    log_Log(TEST, TEST_INFO_PASSED, "test_mon passed all tests.\0");
+
+    return TEST_INFO_PASSED;
+}
+
+char *test_mon_Irq() {
+    mon_Reset();
+
+    // Simulate a timer interrupt nested in the UART one
+    uint32_t outer = mon_irqEnter(MON_IRQ_USART2);
+    uint32_t inner = mon_irqEnter(MON_IRQ_TIM5);
+    mon_irqExit(MON_IRQ_TIM5, inner);
+    mon_irqExit(MON_IRQ_USART2, outer);
+
+    outer = mon_irqEnter(MON_IRQ_USART2);
+    mon_irqExit(MON_IRQ_USART2, outer);
+
+    mon_status_t st = mon_StatsGet(NULL);
+    test_Assert(st == MON_ERR_NULLPTR, "mon_StatsGet should reject a NULL report.\0");
+    st = mon_StatsGet(&test_mon_report);
+    test_Assert(st == MON_INFO_OK, "mon_StatsGet failed.\0");
+
+    mon_irqStats_t *uart = &test_mon_report.mon_report_irq[MON_IRQ_USART2];
+    mon_irqStats_t *tim = &test_mon_report.mon_report_irq[MON_IRQ_TIM5];
+    test_Assert(uart->mon_irqStats_count == 2, "Monitor miscounted handler entries.\0");
+    test_Assert(tim->mon_irqStats_count == 1, "Monitor miscounted nested entries.\0");
+    test_Assert(uart->mon_irqStats_nesting == 1, "Outer handler should not be nested.\0");
+    test_Assert(tim->mon_irqStats_nesting == 2, "Inner handler nesting wasn't recorded.\0");
+    test_Assert(uart->mon_irqStats_max <= uart->mon_irqStats_total,
+                "Handler maximum is larger than the total.\0");
+    test_Assert(test_mon_report.mon_report_irq[MON_IRQ_DCMI].mon_irqStats_count == 0,
+                "Monitor counted a handler that didn't run.\0");
+
+    mon_Reset();
+
+    return NULL;
+}
+
+char *test_mon_Dma() {
+    mon_Reset();
+
+    mon_DmaComplete(MON_DMA_DCMI, 1000);
+    mon_DmaComplete(MON_DMA_DCMI, 24);
+    mon_DmaError(MON_DMA_DCMI, MON_DMAERR_FIFO);
+    mon_DmaError(MON_DMA_DCMI, MON_DMAERR_FIFO);
+    mon_DmaError(MON_DMA_DCMI, MON_DMAERR_TRANSFER);
+
+    mon_StatsGet(&test_mon_report);
+    mon_dmaStats_t *dma = &test_mon_report.mon_report_dma[MON_DMA_DCMI];
+    test_Assert(dma->mon_dmaStats_bytes == 1024, "Monitor miscounted DMA bytes.\0");
+    test_Assert(dma->mon_dmaStats_transfers == 2, "Monitor miscounted DMA transfers.\0");
+    test_Assert(dma->mon_dmaStats_errFifo == 2, "Monitor miscounted FIFO errors.\0");
+    test_Assert(dma->mon_dmaStats_errTransfer == 1, "Monitor miscounted transfer errors.\0");
+    test_Assert(dma->mon_dmaStats_errDirect == 0, "Monitor counted a direct mode error.\0");
+
+    mon_Reset();
+
+    return NULL;
+}
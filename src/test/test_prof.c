@@ -31,6 +31,7 @@
 test_status_t test_prof() {
     test_Test(test_prof_Init, "test_prof_Init passed.\0");
     test_Test(test_prof_Profile, "test_prof_Profile passed.\0");
+    test_Test(test_prof_Record, "test_prof_Record passed.\0");
    
     log_Log(TEST, TEST_INFO_PASSED, "test_prof passed all tests.\0"); 
 
@@ -41,44 +42,81 @@ char *test_prof_Init() {
 
     prof_status_t st = prof_Init();
     test_Assert(st == PROF_INFO_OK, "prof_Init couldn't initialize profiler.\0");
-    st = log_Init();
+    st = prof_Init();
     test_Assert(st == PROF_WARN_ALINIT, "prof_Init should issue a warning on second initialization call.\0");
 
     return NULL;
 }
 
 char * test_prof_Profile() {
-    
-    prof_Profile(
-        for (int i = 0; i < 1000; i++) {},
-        "Test loop 1000\t\0"
-    );
+    prof_sample_t sample;
 
-    prof_Profile(
-        for (int i = 0; i < 10000; i++) {},
-        "Test loop 10000\t\0"
-    );
+    // Empty the buffer first
+    while (prof_SampleGet(&sample) == PROF_INFO_OK) {}
 
     prof_Profile(
-        for (int i = 0; i < 100000; i++) {},
-        "Test loop 100000\0"
+        for (volatile int i = 0; i < 1000; i++) {}
+        prof_Profile(
+            for (volatile int i = 0; i < 100; i++) {},
+            "Test loop 100\0"
+        ),
+        "Test loop 1000\0"
     );
 
-    prof_Profile(
-        for (int i = 0; i < 1000000; i++) {},
-        "Test loop 1000000\0"
-    );
+    // Inner region finishes first
+    prof_status_t st = prof_SampleGet(&sample);
+    test_Assert(st == PROF_INFO_OK, "prof_Profile didn't store the inner sample.\0");
+    test_Assert(sample.prof_sample_depth == 1, "Inner sample should be at depth 1.\0");
+    uint32_t inner = sample.prof_sample_cycles;
+    // The host runs the loop faster than the M4
+    #ifndef __HOST
+    test_Assert(inner >= 100, "Inner sample is too short.\0");
+    #endif
 
-    prof_Profile(
-        for (int i = 0; i < 10000000; i++) {},
-        "Test loop 10000000\0"
-    );
+    st = prof_SampleGet(&sample);
+    test_Assert(st == PROF_INFO_OK, "prof_Profile didn't store the outer sample.\0");
+    test_Assert(sample.prof_sample_depth == 0, "Outer sample should be at depth 0.\0");
+    test_Assert(sample.prof_sample_cycles > inner, "Outer sample should include the inner one.\0");
+
+    st = prof_SampleGet(&sample);
+    test_Assert(st == PROF_INFO_EMPTY, "prof_Profile stored too many samples.\0");
+
+    st = prof_stop("\0");
+    test_Assert(st == PROF_ERR_UNDERFLOW, "prof_stop should fail without prof_start.\0");
 
     return NULL;
 }
-#endif
 
+char *test_prof_Record() {
+    prof_stats_t stats;
+    prof_Reset();
+
+    prof_status_t st = prof_Record(PROF_PROBE_NUM, 1);
+    test_Assert(st == PROF_ERR_PROBE, "prof_Record should reject a bad probe.\0");
 
+    prof_Record(PROF_PROBE_USER0, 0);
+    prof_StatsGet(PROF_PROBE_USER0, &stats);
+    test_Assert(stats.prof_stats_count == 1, "prof_Record didn't count a sample.\0");
+    test_Assert(stats.prof_stats_max == 0, "A zero sample should stay zero.\0");
+    test_Assert(stats.prof_stats_hist[0] == 1, "A zero sample should go in bin 0.\0");
 
+    prof_Reset();
+    prof_Probe(for (volatile int i = 0; i < 100; i++) {}, PROF_PROBE_USER1);
+    prof_Probe(for (volatile int i = 0; i < 1000; i++) {}, PROF_PROBE_USER1);
+    prof_StatsGet(PROF_PROBE_USER1, &stats);
+    test_Assert(stats.prof_stats_count == 2, "prof_Probe didn't count both regions.\0");
+    test_Assert(stats.prof_stats_min < stats.prof_stats_max, "Probe min should be below max.\0");
+    test_Assert(stats.prof_stats_sum == (uint64_t) stats.prof_stats_min + stats.prof_stats_max,
+                "Probe sum should add both regions.\0");
 
+    uint32_t binned = 0;
+    for (uint8_t b = 0; b < PROF_HIST_BINS; b++) {
+        binned += stats.prof_stats_hist[b];
+    }
+    test_Assert(binned == 2, "Probe histogram should hold both regions.\0");
 
+    prof_Reset();
+
+    return NULL;
+}
+#endif
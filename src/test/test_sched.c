@@ -0,0 +1,89 @@
+/** @file test_sched.c
+ *  @brief Test functions for the scheduler.
+ *
+ *  This contains the implementations of the scheduler
+ *  test functions.
+ *
+ *  @author Ben Heberlein
+ *  @bug No known bugs.
+ */
+
+/*************************************
+ * Includes and definitions
+ */
+
+#include "test.h"
+#include "log.h"
+#include "sched.h"
+#include "err.h"
+#include <stdint.h>
+
+#define NULL ((void *)0)
+
+/* @brief Order that test tasks ran in
+ */
+static uint8_t test_sched_order[SCHED_QUEUE_CAP+1];
+static uint8_t test_sched_count;
+
+/**************************************
+ * Private functions
+ */
+
+static void test_sched_task(void *arg) {
+    test_sched_order[test_sched_count++] = (uint8_t)(uintptr_t) arg;
+}
+
+/**************************************
+ * Public functions
+ */
+
+test_status_t test_sched() {
+    test_Test(test_sched_Post, "test_sched_Post passed.\0");
+    test_Test(test_sched_Run, "test_sched_Run passed.\0");
+
+    log_Log(TEST, TEST_INFO_PASSED, "test_sched passed all tests.\0");
+
+    return TEST_INFO_PASSED;
+}
+
+char *test_sched_Post() {
+    sched_status_t st = sched_Post(SCHED_PRIO_CMD, NULL, NULL);
+    test_Assert(st == SCHED_ERR_NULLPTR, "sched_Post should reject a NULL handler.\0");
+    st = sched_Post(SCHED_PRIO_NUM, test_sched_task, NULL);
+    test_Assert(st == SCHED_ERR_PRIO, "sched_Post should reject a bad priority.\0");
+
+    // Fill a queue and check for overflow
+    for (uint32_t i = 0; i < SCHED_QUEUE_CAP; i++) {
+        st = sched_Post(SCHED_PRIO_BACKGROUND, test_sched_task, (void *) 0);
+        test_Assert(st == SCHED_INFO_OK, "sched_Post couldn't post a task.\0");
+    }
+    st = sched_Post(SCHED_PRIO_BACKGROUND, test_sched_task, (void *) 0);
+    test_Assert(st == SCHED_ERR_QUEUEFULL, "sched_Post should report a full queue.\0");
+
+    // Drain the queue again
+    test_sched_count = 0;
+    sched_Run();
+    test_Assert(test_sched_count == SCHED_QUEUE_CAP, "sched_Run didn't run every posted task.\0");
+
+    return NULL;
+}
+
+char *test_sched_Run() {
+    test_sched_count = 0;
+
+    // Post lowest priority first
+    sched_Post(SCHED_PRIO_BACKGROUND, test_sched_task, (void *) 3);
+    sched_Post(SCHED_PRIO_CMD, test_sched_task, (void *) 2);
+    sched_Post(SCHED_PRIO_ISR, test_sched_task, (void *) 1);
+    sched_Post(SCHED_PRIO_CMD, test_sched_task, (void *) 2);
+
+    sched_status_t st = sched_Run();
+    test_Assert(st == SCHED_INFO_OK, "sched_Run failed.\0");
+    test_Assert(test_sched_count == 4, "sched_Run didn't run every posted task.\0");
+    test_Assert(test_sched_order[0] == 1, "sched_Run didn't run the ISR task first.\0");
+    test_Assert(test_sched_order[1] == 2 && test_sched_order[2] == 2,
+                "sched_Run didn't run command tasks in order.\0");
+    test_Assert(test_sched_order[3] == 3, "sched_Run didn't run the background task last.\0");
+
+    return NULL;
+}
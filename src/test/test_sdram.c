@@ -0,0 +1,146 @@
+/** @file test_sdram.c
+ *  @brief Test functions for the SDRAM frame pool.
+ *
+ *  This contains the implementations of the frame slot
+ *  and scratch arena test functions, and the argument
+ *  checks of the copy functions. They only touch the pool
+ *  bookkeeping, so they run before the SDRAM is up.
+ *
+ *  @author Ben Heberlein
+ *  @bug No known bugs.
+ */
+
+/*************************************
+ * Includes and definitions
+ */
+
+#include "test.h"
+#include "log.h"
+#include "sdram.h"
+#include "err.h"
+#include "stm32f4xx.h"
+#include <stdint.h>
+
+#define NULL ((void *)0)
+
+/* @brief Handles for the exhaustion test
+ */
+static sdram_frame_t *test_sdram_frames[SDRAM_SMALL_NUM];
+
+/**************************************
+ * Private functions
+ */
+
+/**************************************
+ * Public functions
+ */
+
+test_status_t test_sdram() {
+    test_Test(test_sdram_Frame, "test_sdram_Frame passed.\0");
+    test_Test(test_sdram_Arena, "test_sdram_Arena passed.\0");
+    test_Test(test_sdram_Copy, "test_sdram_Copy passed.\0");
+
+    log_Log(TEST, TEST_INFO_PASSED, "test_sdram passed all tests.\0");
+
+    return TEST_INFO_PASSED;
+}
+
+char *test_sdram_Frame() {
+    uint8_t before = sdram_FrameAvailable(SDRAM_MEDIUM_SIZE);
+
+    // A QVGA frame at two bytes a pixel is a medium slot
+    sdram_frame_t *frame = sdram_FrameAlloc(320*240*2);
+    test_Assert(frame != NULL, "sdram_FrameAlloc failed.\0");
+    test_Assert(frame->sdram_frame_size == SDRAM_MEDIUM_SIZE,
+                "sdram_FrameAlloc picked the wrong slot class.\0");
+    test_Assert((frame->sdram_frame_addr & (SDRAM_ALIGN - 1)) == 0,
+                "Frame slot is not aligned.\0");
+    test_Assert(frame->sdram_frame_addr >= SDRAM_POOLADDR &&
+                frame->sdram_frame_addr + frame->sdram_frame_size <= SDRAM_ARENAADDR,
+                "Frame slot is outside the frame pool.\0");
+    test_Assert(sdram_FrameAvailable(SDRAM_MEDIUM_SIZE) == before - 1,
+                "sdram_FrameAvailable miscounted free slots.\0");
+
+    // Two holders, the slot stays taken until both let go
+    test_Assert(sdram_FrameRetain(frame) == SDRAM_INFO_OK, "sdram_FrameRetain failed.\0");
+    test_Assert(sdram_FrameRelease(frame) == SDRAM_INFO_OK, "sdram_FrameRelease failed.\0");
+    test_Assert(sdram_FrameAvailable(SDRAM_MEDIUM_SIZE) == before - 1,
+                "Frame was freed with a reference left.\0");
+    test_Assert(sdram_FrameRelease(frame) == SDRAM_INFO_OK, "sdram_FrameRelease failed.\0");
+    test_Assert(sdram_FrameAvailable(SDRAM_MEDIUM_SIZE) == before,
+                "Frame wasn't freed with its last reference.\0");
+    test_Assert(sdram_FrameRetain(frame) == SDRAM_ERR_FREED,
+                "sdram_FrameRetain should reject a free slot.\0");
+    test_Assert(sdram_FrameRelease(frame) == SDRAM_ERR_FREED,
+                "sdram_FrameRelease should reject a free slot.\0");
+    test_Assert(sdram_FrameRelease(NULL) == SDRAM_ERR_NULLPTR,
+                "sdram_FrameRelease should reject a NULL frame.\0");
+
+    test_Assert(sdram_FrameAlloc(SDRAM_LARGE_SIZE + 1) == NULL,
+                "sdram_FrameAlloc should fail past the largest slot.\0");
+
+    // Take every free small slot, the next one fails
+    uint8_t n = sdram_FrameAvailable(1);
+    for (uint8_t i = 0; i < n; i++) {
+        test_sdram_frames[i] = sdram_FrameAlloc(1);
+        test_Assert(test_sdram_frames[i] != NULL, "sdram_FrameAlloc failed on a free slot.\0");
+    }
+    test_Assert(sdram_FrameAlloc(1) == NULL, "sdram_FrameAlloc should fail with no free slot.\0");
+    for (uint8_t i = 0; i < n; i++) {
+        sdram_FrameRelease(test_sdram_frames[i]);
+    }
+    test_Assert(sdram_FrameAvailable(1) == n, "Small slots weren't all freed.\0");
+
+    return NULL;
+}
+
+char *test_sdram_Arena() {
+    sdram_ArenaReset(0);
+
+    uint8_t *a = (uint8_t *) sdram_ArenaAlloc(0, 100);
+    uint8_t *b = (uint8_t *) sdram_ArenaAlloc(0, 4);
+    test_Assert(a != NULL && b != NULL, "sdram_ArenaAlloc failed.\0");
+    test_Assert(((uint32_t) b & (SDRAM_ALIGN - 1)) == 0, "Arena memory is not aligned.\0");
+    test_Assert(b >= a + 100, "Arena blocks overlap.\0");
+
+    test_Assert(sdram_ArenaAlloc(0, SDRAM_ARENA_SIZE) == NULL,
+                "sdram_ArenaAlloc should fail past the arena.\0");
+    test_Assert(sdram_ArenaAlloc(SDRAM_ARENA_NUM, 4) == NULL,
+                "sdram_ArenaAlloc should reject a bad arena.\0");
+    test_Assert(sdram_ArenaReset(SDRAM_ARENA_NUM) == SDRAM_ERR_ARENA,
+                "sdram_ArenaReset should reject a bad arena.\0");
+
+    // Reset hands out the same memory again
+    test_Assert(sdram_ArenaReset(0) == SDRAM_INFO_OK, "sdram_ArenaReset failed.\0");
+    test_Assert(sdram_ArenaAlloc(0, 100) == a, "sdram_ArenaReset didn't free the arena.\0");
+    sdram_ArenaReset(0);
+
+    return NULL;
+}
+
+char *test_sdram_Copy() {
+    static uint32_t buf[4];
+
+    test_Assert(sdram_write(NULL, SDRAM_SCRATCHADDR, 4) == SDRAM_ERR_NULLPTR,
+                "sdram_write should reject a NULL buffer.\0");
+    test_Assert(sdram_write(buf, SDRAM_SCRATCHADDR, 3) == SDRAM_ERR_SIZE,
+                "sdram_write should reject a partial word.\0");
+    test_Assert(sdram_read(buf, SDRAM_BANKADDR - 4, 4) == SDRAM_ERR_RANGE,
+                "sdram_read should reject an address below the bank.\0");
+    test_Assert(sdram_read(buf, SDRAM_BANKADDR + SDRAM_BANKSIZE - 4, 8) == SDRAM_ERR_RANGE,
+                "sdram_read should reject a block past the bank.\0");
+
+    test_Assert(sdram_CopyAsync(NULL, buf, 4, NULL, NULL) == SDRAM_ERR_NULLPTR,
+                "sdram_CopyAsync should reject a NULL pointer.\0");
+    test_Assert(sdram_CopyAsync(buf, buf + 2, 0, NULL, NULL) == SDRAM_ERR_SIZE,
+                "sdram_CopyAsync should reject an empty copy.\0");
+    test_Assert(sdram_CopyBusy() == 0, "Rejected copies were queued.\0");
+
+    // Core coupled RAM is never handed to the DMA
+    test_Assert(sdram_inCcm(SDRAM_CCMADDR + SDRAM_CCMSIZE - 1, 1) == 1,
+                "sdram_inCcm missed the end of CCM.\0");
+    test_Assert(sdram_inCcm(SDRAM_CCMADDR - 4, 4) == 0,
+                "sdram_inCcm matched a block before CCM.\0");
+
+    return NULL;
+}
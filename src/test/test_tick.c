@@ -0,0 +1,63 @@
+/** @file test_tick.c
+ *  @brief Test functions for the time base.
+ *
+ *  This contains the implementations of the time base
+ *  test functions.
+ *
+ *  @author Ben Heberlein
+ *  @bug No known bugs.
+ */
+
+/*************************************
+ * Includes and definitions
+ */
+
+#include "test.h"
+#include "log.h"
+#include "tick.h"
+#include "err.h"
+#include <stdint.h>
+
+#define NULL ((void *)0)
+
+/**************************************
+ * Private functions
+ */
+
+/**************************************
+ * Public functions
+ */
+
+test_status_t test_tick() {
+    test_Test(test_tick_Now, "test_tick_Now passed.\0");
+    test_Test(test_tick_Deadline, "test_tick_Deadline passed.\0");
+
+    log_Log(TEST, TEST_INFO_PASSED, "test_tick passed all tests.\0");
+
+    return TEST_INFO_PASSED;
+}
+
+char *test_tick_Now() {
+    uint64_t last = tick_Now();
+    for (uint32_t i = 0; i < 1000; i++) {
+        uint64_t now = tick_Now();
+        test_Assert(now >= last, "tick_Now went backwards.\0");
+        last = now;
+    }
+
+    uint64_t start = tick_Now();
+    tick_DelayUs(1000);
+    test_Assert(tick_Now() - start >= 1000, "tick_DelayUs returned early.\0");
+
+    return NULL;
+}
+
+char *test_tick_Deadline() {
+    uint64_t deadline = tick_Deadline(500);
+    test_Assert(tick_Expired(deadline) == 0, "tick_Expired expired too soon.\0");
+
+    tick_DelayUs(500);
+    test_Assert(tick_Expired(deadline) == 1, "tick_Expired didn't expire.\0");
+
+    return NULL;
+}